@@ -1,4 +1,5 @@
 QT -= gui
+QT += network
 
 TEMPLATE = lib
 DEFINES += MYLIB_LIBRARY
@@ -17,14 +18,55 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    binary_export.cpp \
+    bit_mask.cpp \
+    bricked_volume.cpp \
+    cine_series.cpp \
     ct_dataset.cpp \
-    mylib.cpp
+    dicom_series.cpp \
+    distance_field.cpp \
+    kd_tree.cpp \
+    label_snapshot.cpp \
+    mylib.cpp \
+    normal_volume.cpp \
+    parallel.cpp \
+    prefilter.cpp \
+    render_client.cpp \
+    render_protocol.cpp \
+    render_server.cpp \
+    resampler.cpp \
+    slice_cache.cpp \
+    surface_clusters.cpp \
+    surface_nets.cpp \
+    voxel_kernels.cpp
 
 HEADERS += \
     MyLib_global.h \
+    binary_export.h \
+    bit_mask.h \
+    bricked_volume.h \
+    cine_series.h \
     ct_dataset.h \
+    dicom_series.h \
+    distance_field.h \
+    guarded_buffer.h \
+    kd_tree.h \
+    label_snapshot.h \
     mylib.h \
-    status.h
+    normal_volume.h \
+    parallel.h \
+    prefilter.h \
+    render_client.h \
+    render_protocol.h \
+    render_server.h \
+    resampler.h \
+    simd.h \
+    slice_cache.h \
+    status.h \
+    surface_clusters.h \
+    surface_nets.h \
+    triangle_mesh.h \
+    voxel_kernels.h
 
 CONFIG += warn_off
 CONFIG += optimize_full
@@ -0,0 +1,284 @@
+#include "binary_export.h"
+#include "Eigen/Geometry"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <string>
+
+constexpr size_t BufferedFileWriter::kChunkSize;
+constexpr char BinaryExport::kMaskMagic[8];
+
+BufferedFileWriter::BufferedFileWriter() : m_buffer(new char[kChunkSize]) {
+}
+
+BufferedFileWriter::~BufferedFileWriter() {
+  if (m_file.isOpen()) {
+	Status stat = Close();
+	(void) stat;
+  }
+}
+
+/**
+ * @details The file is opened unbuffered, since all buffering happens in this class.
+ * @param path Path of the file
+ * @return StatusCode::OK, or StatusCode::FOPEN_ERROR if the file cannot be created
+ */
+Status BufferedFileWriter::Open(QString const &path) {
+  m_file.setFileName(path);
+  m_used = 0;
+  if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+	m_status = Status(StatusCode::FOPEN_ERROR);
+	return m_status;
+  }
+  m_status = Status(StatusCode::OK);
+  return m_status;
+}
+
+/**
+ * @details Copies into the buffer if the bytes fit into a chunk, otherwise flushes the buffer and writes the bytes
+ * straight from the caller's memory.
+ */
+void BufferedFileWriter::Write(const void *data, size_t size) {
+  if (size >= kChunkSize) {
+	FlushBuffer();
+	if (m_status.Ok() && static_cast<size_t>(m_file.write(static_cast<const char *>(data), size)) != size) {
+	  m_status = Status(StatusCode::FWRITE_ERROR);
+	}
+	return;
+  }
+  if (m_used + size > kChunkSize) {
+	FlushBuffer();
+  }
+  std::memcpy(m_buffer.get() + m_used, data, size);
+  m_used += size;
+}
+
+void BufferedFileWriter::WriteText(char const *text) {
+  Write(text, std::strlen(text));
+}
+
+/**
+ * @return StatusCode::OK, or the first error of Open() or any write
+ */
+Status BufferedFileWriter::Close() {
+  FlushBuffer();
+  m_file.close();
+  return m_status;
+}
+
+void BufferedFileWriter::FlushBuffer() {
+  if (m_used > 0 && m_status.Ok() && static_cast<size_t>(m_file.write(m_buffer.get(), m_used)) != m_used) {
+	m_status = Status(StatusCode::FWRITE_ERROR);
+  }
+  m_used = 0;
+}
+
+namespace {
+/// Common PLY header lines up to the first element
+void WritePLYPreamble(BufferedFileWriter &writer, Eigen::Vector3d const &spacing) {
+  writer.WriteText("ply\nformat binary_little_endian 1.0\n");
+  writer.WriteText(("comment voxel spacing " + std::to_string(spacing.x()) + " " + std::to_string(spacing.y()) + " "
+	+ std::to_string(spacing.z()) + "\n").c_str());
+}
+} // namespace
+
+/**
+ * @details The points are written as three int32 voxel coordinates each, straight from the vector's memory.
+ * @param path Path of the file
+ * @param points The points, e.g. the surface points of the region growing result
+ * @param spacing Voxel spacing in mm, recorded as a header comment
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR or StatusCode::FWRITE_ERROR
+ */
+Status BinaryExport::WritePointCloudPLY(QString const &path, std::vector<Eigen::Vector3i> const &points,
+										Eigen::Vector3d const &spacing) {
+  static_assert(sizeof(Eigen::Vector3i) == 3 * sizeof(int32_t), "Eigen::Vector3i must be tightly packed");
+  BufferedFileWriter writer;
+  Status stat = writer.Open(path);
+  if (!stat.Ok()) {
+	return stat;
+  }
+  WritePLYPreamble(writer, spacing);
+  writer.WriteText(("element vertex " + std::to_string(points.size()) + "\n").c_str());
+  writer.WriteText("property int x\nproperty int y\nproperty int z\nend_header\n");
+  writer.Write(points.data(), points.size() * sizeof(Eigen::Vector3i));
+  return writer.Close();
+}
+
+/**
+ * @details Without normals, the vertices are written straight from the mesh. With normals, position and normal of
+ * every vertex are interleaved through the write buffer.
+ * @param path Path of the file
+ * @param mesh The mesh, in voxel coordinates
+ * @param spacing Voxel spacing in mm, recorded as a header comment
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR or StatusCode::FWRITE_ERROR
+ */
+Status BinaryExport::WriteMeshPLY(QString const &path, TriangleMesh const &mesh, Eigen::Vector3d const &spacing) {
+  static_assert(sizeof(Eigen::Vector3f) == 3 * sizeof(float), "Eigen::Vector3f must be tightly packed");
+  BufferedFileWriter writer;
+  Status stat = writer.Open(path);
+  if (!stat.Ok()) {
+	return stat;
+  }
+  bool const has_normals = !mesh.normals.empty() && mesh.normals.size() == mesh.vertices.size();
+  WritePLYPreamble(writer, spacing);
+  writer.WriteText(("element vertex " + std::to_string(mesh.vertices.size()) + "\n").c_str());
+  writer.WriteText("property float x\nproperty float y\nproperty float z\n");
+  if (has_normals) {
+	writer.WriteText("property float nx\nproperty float ny\nproperty float nz\n");
+  }
+  writer.WriteText(("element face " + std::to_string(mesh.TriangleCount()) + "\n").c_str());
+  writer.WriteText("property list uchar int vertex_indices\nend_header\n");
+
+  if (has_normals) {
+	for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+	  std::array<float, 6> const record{{mesh.vertices[i].x(), mesh.vertices[i].y(), mesh.vertices[i].z(),
+										 mesh.normals[i].x(), mesh.normals[i].y(), mesh.normals[i].z()}};
+	  writer.WriteValue(record);
+	}
+  } else {
+	writer.Write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Eigen::Vector3f));
+  }
+
+  std::array<char, 1 + 3 * sizeof(int32_t)> face{};
+  face[0] = 3;
+  for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+	std::memcpy(face.data() + 1, mesh.indices.data() + 3 * t, 3 * sizeof(uint32_t));
+	writer.WriteValue(face);
+  }
+  return writer.Close();
+}
+
+/**
+ * @details Binary STL has no shared vertices, so every triangle is written with its three positions and its facet
+ * normal (50 bytes) through the write buffer.
+ * @param path Path of the file
+ * @param mesh The mesh, in voxel coordinates
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR or StatusCode::FWRITE_ERROR
+ */
+Status BinaryExport::WriteMeshSTL(QString const &path, TriangleMesh const &mesh) {
+  BufferedFileWriter writer;
+  Status stat = writer.Open(path);
+  if (!stat.Ok()) {
+	return stat;
+  }
+  std::array<char, 80> header{};
+  std::string const title = "MyLib binary STL, voxel coordinates";
+  std::copy(title.begin(), title.end(), header.begin());
+  writer.WriteValue(header);
+  writer.WriteValue(static_cast<uint32_t>(mesh.TriangleCount()));
+
+  std::array<char, 12 * sizeof(float) + sizeof(uint16_t)> facet{};
+  for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+	Eigen::Vector3f const &a = mesh.vertices[mesh.indices[3 * t]];
+	Eigen::Vector3f const &b = mesh.vertices[mesh.indices[3 * t + 1]];
+	Eigen::Vector3f const &c = mesh.vertices[mesh.indices[3 * t + 2]];
+	Eigen::Vector3f const normal = (b - a).cross(c - a).normalized();
+	std::memcpy(facet.data(), normal.data(), sizeof(Eigen::Vector3f));
+	std::memcpy(facet.data() + 3 * sizeof(float), a.data(), sizeof(Eigen::Vector3f));
+	std::memcpy(facet.data() + 6 * sizeof(float), b.data(), sizeof(Eigen::Vector3f));
+	std::memcpy(facet.data() + 9 * sizeof(float), c.data(), sizeof(Eigen::Vector3f));
+	writer.WriteValue(facet);
+  }
+  return writer.Close();
+}
+
+/**
+ * @details File layout: kMaskMagic, int32 width, height and layers, followed by uint32 run lengths in x-fastest voxel
+ * order that alternate between outside and inside, starting with outside (the first run may be empty). A run longer
+ * than the uint32 range is split by an empty run of the other kind. The runs are streamed while scanning the labels.
+ * @param path Path of the file
+ * @param labels Flat x-fastest label volume, e.g. the region growing buffer
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param label Label of the voxels inside the mask
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY for an empty volume, StatusCode::FOPEN_ERROR or
+ * StatusCode::FWRITE_ERROR
+ */
+Status BinaryExport::WriteMaskRLE(QString const &path, const int *labels, int width, int height, int layers,
+								  int label) {
+  if (labels == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  BufferedFileWriter writer;
+  Status stat = writer.Open(path);
+  if (!stat.Ok()) {
+	return stat;
+  }
+  writer.WriteValue(kMaskMagic);
+  writer.WriteValue(static_cast<int32_t>(width));
+  writer.WriteValue(static_cast<int32_t>(height));
+  writer.WriteValue(static_cast<int32_t>(layers));
+
+  size_t const voxel_count = static_cast<size_t>(width) * height * layers;
+  bool inside = false;
+  size_t position = 0;
+  while (position < voxel_count) {
+	// The run of the current kind ends at the first voxel of the other kind
+	const int *run_end = inside ? std::find_if(labels + position, labels + voxel_count,
+											   [label](int value) { return value != label; })
+								: std::find(labels + position, labels + voxel_count, label);
+	size_t run = static_cast<size_t>(run_end - labels) - position;
+	position += run;
+	while (run > std::numeric_limits<uint32_t>::max()) {
+	  writer.WriteValue(std::numeric_limits<uint32_t>::max());
+	  writer.WriteValue(uint32_t{0});
+	  run -= std::numeric_limits<uint32_t>::max();
+	}
+	writer.WriteValue(static_cast<uint32_t>(run));
+	inside = !inside;
+  }
+  return writer.Close();
+}
+
+/**
+ * @param path Path of the file written by WriteMaskRLE()
+ * @param width Output: width of the volume in voxels
+ * @param height Output: height of the volume in voxels
+ * @param layers Output: number of layers of the volume
+ * @param mask Output: 1 for every voxel inside the mask, 0 outside, in x-fastest order
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR, or StatusCode::FILE_FORMAT_ERROR if the file is not a mask file or
+ * its runs do not cover the volume exactly
+ */
+Status BinaryExport::ReadMaskRLE(QString const &path, int &width, int &height, int &layers,
+								 std::vector<uint8_t> &mask) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+	return Status(StatusCode::FOPEN_ERROR);
+  }
+  char magic[sizeof(kMaskMagic)];
+  int32_t dimensions[3];
+  if (file.read(magic, sizeof(magic)) != static_cast<qint64>(sizeof(magic))
+	|| !std::equal(magic, magic + sizeof(magic), kMaskMagic)
+	|| file.read(reinterpret_cast<char *>(dimensions), sizeof(dimensions)) != static_cast<qint64>(sizeof(dimensions))
+	|| dimensions[0] <= 0 || dimensions[1] <= 0 || dimensions[2] <= 0) {
+	return Status(StatusCode::FILE_FORMAT_ERROR);
+  }
+  width = dimensions[0];
+  height = dimensions[1];
+  layers = dimensions[2];
+  size_t const voxel_count = static_cast<size_t>(width) * height * layers;
+  mask.assign(voxel_count, 0);
+
+  std::vector<uint32_t> runs(BufferedFileWriter::kChunkSize / sizeof(uint32_t));
+  size_t position = 0;
+  bool inside = false;
+  while (true) {
+	qint64 const bytes = file.read(reinterpret_cast<char *>(runs.data()), runs.size() * sizeof(uint32_t));
+	if (bytes <= 0) {
+	  break;
+	}
+	for (size_t i = 0; i < static_cast<size_t>(bytes) / sizeof(uint32_t); ++i) {
+	  if (runs[i] > voxel_count - position) {
+		return Status(StatusCode::FILE_FORMAT_ERROR);
+	  }
+	  if (inside) {
+		std::fill_n(mask.begin() + position, runs[i], uint8_t{1});
+	  }
+	  position += runs[i];
+	  inside = !inside;
+	}
+  }
+  return (position == voxel_count) ? Status(StatusCode::OK) : Status(StatusCode::FILE_FORMAT_ERROR);
+}
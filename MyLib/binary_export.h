@@ -0,0 +1,98 @@
+#ifndef BINARY_EXPORT_H
+#define BINARY_EXPORT_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "triangle_mesh.h"
+#include "Eigen/Core"
+
+#include <QFile>
+#include <QString>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Buffered binary output to a file, the single I/O path of all exports
+ * @details Small writes (headers, formatted records) are collected in a chunk of kChunkSize bytes, which is handed to
+ * the unbuffered file in one call when full. Writes of at least a chunk go to the file directly from the caller's
+ * memory, so large tightly packed buffers are never copied. The first failure is latched and reported by Close().
+ * Values are written in host byte order, i.e. little-endian on all supported platforms.
+ */
+class MYLIB_EXPORT BufferedFileWriter {
+ public:
+  /// Size of the write buffer in bytes
+  static constexpr size_t kChunkSize = size_t{1} << 20;
+
+  BufferedFileWriter();
+  ~BufferedFileWriter();
+
+  BufferedFileWriter(BufferedFileWriter const &) = delete;
+  BufferedFileWriter &operator=(BufferedFileWriter const &) = delete;
+
+  /// Creates or truncates the file
+  Status Open(QString const &path);
+
+  /// Appends raw bytes
+  void Write(const void *data, size_t size);
+
+  /// Appends the bytes of a trivially copyable value
+  template<typename T>
+  void WriteValue(T const &value) {
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written as bytes");
+	if (m_used + sizeof(T) > kChunkSize) {
+	  FlushBuffer();
+	}
+	std::memcpy(m_buffer.get() + m_used, &value, sizeof(T));
+	m_used += sizeof(T);
+  }
+
+  /// Appends a string without its terminating zero
+  void WriteText(char const *text);
+
+  /// Flushes the buffer and closes the file
+  Status Close();
+
+ private:
+  /// Hands the buffered bytes to the file
+  void FlushBuffer();
+
+  QFile m_file;
+  std::unique_ptr<char[]> m_buffer;
+  size_t m_used{0};
+
+  /// First error, StatusCode::OK while all writes succeeded
+  Status m_status;
+};
+
+/**
+ * @brief Streaming binary writers for point clouds, meshes and label masks
+ * @details All writers stream through BufferedFileWriter. Geometry is written in voxel coordinates; the voxel spacing
+ * is recorded in the file header where the format allows it.
+ */
+class MYLIB_EXPORT BinaryExport {
+ public:
+  /// Magic number at the start of a run-length encoded mask file
+  static constexpr char kMaskMagic[8] = {'M', 'Y', 'L', 'I', 'B', 'R', 'L', 'E'};
+
+  /// Writes integer points as a binary little-endian PLY vertex list
+  static Status WritePointCloudPLY(QString const &path, std::vector<Eigen::Vector3i> const &points,
+								   Eigen::Vector3d const &spacing);
+
+  /// Writes a triangle mesh as binary little-endian PLY with optional vertex normals
+  static Status WriteMeshPLY(QString const &path, TriangleMesh const &mesh, Eigen::Vector3d const &spacing);
+
+  /// Writes a triangle mesh as binary STL with facet normals
+  static Status WriteMeshSTL(QString const &path, TriangleMesh const &mesh);
+
+  /// Writes the voxels of a linear x-fastest label volume that carry the given label as a run-length encoded mask
+  static Status WriteMaskRLE(QString const &path, const int *labels, int width, int height, int layers, int label);
+
+  /// Reads a run-length encoded mask into one byte per voxel (1 inside, 0 outside)
+  static Status ReadMaskRLE(QString const &path, int &width, int &height, int &layers, std::vector<uint8_t> &mask);
+};
+
+#endif  // BINARY_EXPORT_H
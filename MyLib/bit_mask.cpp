@@ -0,0 +1,441 @@
+#include "bit_mask.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <bitset>
+#include <memory>
+
+constexpr int BitMask::kMaxRadius;
+constexpr int BitMask::kSlabLayers;
+
+namespace {
+/// Extends every run of set bits of seeds that lies inside mask towards the higher bits of the word (Kogge-Stone fill)
+inline uint64_t FillUp(uint64_t seeds, uint64_t mask) {
+  seeds &= mask;
+  seeds |= mask & (seeds << 1);
+  mask &= mask << 1;
+  seeds |= mask & (seeds << 2);
+  mask &= mask << 2;
+  seeds |= mask & (seeds << 4);
+  mask &= mask << 4;
+  seeds |= mask & (seeds << 8);
+  mask &= mask << 8;
+  seeds |= mask & (seeds << 16);
+  mask &= mask << 16;
+  return seeds | (mask & (seeds << 32));
+}
+
+/// Extends every run of set bits of seeds that lies inside mask towards the lower bits of the word
+inline uint64_t FillDown(uint64_t seeds, uint64_t mask) {
+  seeds &= mask;
+  seeds |= mask & (seeds >> 1);
+  mask &= mask >> 1;
+  seeds |= mask & (seeds >> 2);
+  mask &= mask >> 2;
+  seeds |= mask & (seeds >> 4);
+  mask &= mask >> 4;
+  seeds |= mask & (seeds >> 8);
+  mask &= mask >> 8;
+  seeds |= mask & (seeds >> 16);
+  mask &= mask >> 16;
+  return seeds | (mask & (seeds >> 32));
+}
+
+/// Spreads the set bits of a row through the runs of mask in both directions along x, across word boundaries
+void FillRow(uint64_t *row, const uint64_t *mask, int words) {
+  uint64_t carry = 0;
+  for (int k = 0; k < words; ++k) {
+	row[k] = FillUp(row[k] | carry, mask[k]);
+	carry = row[k] >> 63;
+  }
+  carry = 0;
+  for (int k = words - 1; k >= 0; --k) {
+	row[k] = FillDown(row[k] | carry, mask[k]);
+	carry = row[k] << 63;
+  }
+}
+} // namespace
+
+/**
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if a dimension is not positive
+ */
+Status BitMask::Resize(int width, int height, int layers) {
+  if (width <= 0 || height <= 0 || layers <= 0) {
+	Clear();
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  m_width = width;
+  m_height = height;
+  m_layers = layers;
+  m_wordsPerRow = (width + 63) / 64;
+  m_words.assign(static_cast<size_t>(m_wordsPerRow) * height * layers, 0);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Packs 64 labels into one word, one layer per thread.
+ * @param labels Flat x-fastest label volume, e.g. the region growing buffer
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param label Label of the voxels that are set in the mask
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the volume is empty
+ */
+Status BitMask::Build(const int *labels, int width, int height, int layers, int label) {
+  if (labels == nullptr) {
+	Clear();
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  Status const status = Resize(width, height, layers);
+  if (!status.Ok()) {
+	return status;
+  }
+  utils::ParallelFor(0, layers, [&](int z) {
+	for (int y = 0; y < height; ++y) {
+	  const int *labels_row = labels + (static_cast<size_t>(z) * height + y) * width;
+	  uint64_t *row = Row(y, z);
+	  for (int x = 0; x < width; ++x) {
+		row[x >> 6] |= static_cast<uint64_t>(labels_row[x] == label) << (x & 63);
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @param labels Flat x-fastest label volume with the dimensions of the mask
+ * @param inside_label Label written for set voxels
+ */
+void BitMask::WriteLabels(int *labels, int inside_label) const {
+  utils::ParallelFor(0, m_layers, [&](int z) {
+	for (int y = 0; y < m_height; ++y) {
+	  int *labels_row = labels + (static_cast<size_t>(z) * m_height + y) * m_width;
+	  const uint64_t *row = Row(y, z);
+	  for (int x = 0; x < m_width; ++x) {
+		labels_row[x] = ((row[x >> 6] >> (x & 63)) & 1u) ? inside_label : 0;
+	  }
+	}
+  });
+}
+
+void BitMask::Clear() {
+  m_width = 0;
+  m_height = 0;
+  m_layers = 0;
+  m_wordsPerRow = 0;
+  std::vector<uint64_t>().swap(m_words);
+}
+
+/**
+ * @return Population count of all words, one layer per thread
+ */
+size_t BitMask::Count() const {
+  std::vector<size_t> layer_counts(m_layers, 0);
+  size_t const layer_words = static_cast<size_t>(m_wordsPerRow) * m_height;
+  utils::ParallelFor(0, m_layers, [&](int z) {
+	const uint64_t *words = m_words.data() + z * layer_words;
+	size_t count = 0;
+	for (size_t k = 0; k < layer_words; ++k) {
+	  count += std::bitset<64>(words[k]).count();
+	}
+	layer_counts[z] = count;
+  });
+  size_t count = 0;
+  for (size_t layer_count : layer_counts) {
+	count += layer_count;
+  }
+  return count;
+}
+
+uint64_t BitMask::LastWordMask() const {
+  int const used_bits = m_width - 64 * (m_wordsPerRow - 1);
+  return used_bits == 64 ? ~uint64_t{0} : (uint64_t{1} << used_bits) - 1;
+}
+
+void BitMask::Invert() {
+  uint64_t const last_word_mask = LastWordMask();
+  utils::ParallelFor(0, m_layers, [&](int z) {
+	for (int y = 0; y < m_height; ++y) {
+	  uint64_t *row = Row(y, z);
+	  for (int k = 0; k < m_wordsPerRow; ++k) {
+		row[k] = ~row[k];
+	  }
+	  row[m_wordsPerRow - 1] &= last_word_mask;
+	}
+  });
+}
+
+/**
+ * @details Opening and closing run the two passes one after the other. source and result may be the same mask.
+ * @param source Mask to process
+ * @param operation Morphological operation
+ * @param radius Radius of the structuring ball in voxels, 0 to kMaxRadius
+ * @param result Output: the processed mask
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if source is empty, or StatusCode::MORPHOLOGY_ERROR if the radius
+ * is out of range
+ */
+Status BitMask::Apply(BitMask const &source, MorphologyOperation operation, int radius, BitMask &result) {
+  switch (operation) {
+	case MorphologyOperation::ERODE:
+	  return Erode(source, radius, result);
+	case MorphologyOperation::DILATE:
+	  return Dilate(source, radius, result);
+	case MorphologyOperation::OPEN: {
+	  Status const status = Erode(source, radius, result);
+	  return status.Ok() ? Dilate(result, radius, result) : status;
+	}
+	case MorphologyOperation::CLOSE: {
+	  Status const status = Dilate(source, radius, result);
+	  return status.Ok() ? Erode(result, radius, result) : status;
+	}
+	case MorphologyOperation::FILL_HOLES:
+	  return FillHoles(source, result);
+  }
+  return Status(StatusCode::MORPHOLOGY_ERROR);
+}
+
+/**
+ * @details The ball of radius r is the union of the x-segments [-hx, hx] at the offsets (dy, dz) with
+ * dy^2 + dz^2 <= r^2, where hx is the largest integer with hx^2 + dy^2 + dz^2 <= r^2. Every slab of kSlabLayers output
+ * layers first dilates the rows of its source layers along x by every segment length 0..r, each length from the
+ * previous one with two shifts. An output row is then the OR of the dilated source rows of all offsets. Empty source
+ * rows are skipped and a full one completes the output row at once, which saves most of the work far from the
+ * boundary of the mask. source and result may be the same mask.
+ * @param source Mask to dilate
+ * @param radius Radius of the structuring ball in voxels, 0 to kMaxRadius
+ * @param result Output: the dilated mask
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if source is empty, or StatusCode::MORPHOLOGY_ERROR if the radius
+ * is out of range
+ */
+Status BitMask::Dilate(BitMask const &source, int radius, BitMask &result) {
+  if (source.Empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  if (radius < 0 || radius > kMaxRadius) {
+	return Status(StatusCode::MORPHOLOGY_ERROR);
+  }
+  if (radius == 0) {
+	if (&result != &source) {
+	  result = source;
+	}
+	return Status(StatusCode::OK);
+  }
+
+  struct Segment {
+	int dy;
+	int dz;
+	int half_length;
+  };
+  enum class RowState : uint8_t { EMPTY, PARTIAL, FULL };
+  std::vector<Segment> segments;
+  for (int dz = -radius; dz <= radius; ++dz) {
+	for (int dy = -radius; dy <= radius; ++dy) {
+	  int const remaining = radius * radius - dy * dy - dz * dz;
+	  if (remaining < 0) {
+		continue;
+	  }
+	  int half_length = 0;
+	  while ((half_length + 1) * (half_length + 1) <= remaining) {
+		++half_length;
+	  }
+	  segments.push_back({dy, dz, half_length});
+	}
+  }
+
+  int const width_words = source.m_wordsPerRow;
+  int const height = source.m_height;
+  int const layers = source.m_layers;
+  uint64_t const last_word_mask = source.LastWordMask();
+  BitMask output;
+  Status const status = output.Resize(source.m_width, height, layers);
+  if (!status.Ok()) {
+	return status;
+  }
+
+  int const slab_count = (layers + kSlabLayers - 1) / kSlabLayers;
+  utils::ParallelFor(0, slab_count, [&](int slab) {
+	int const z_begin = slab * kSlabLayers;
+	int const z_end = std::min(layers, z_begin + kSlabLayers);
+	int const source_begin = std::max(0, z_begin - radius);
+	int const source_end = std::min(layers, z_end + radius);
+	int const source_layers = source_end - source_begin;
+	size_t const level_words = static_cast<size_t>(source_layers) * height * width_words;
+
+	// levels[h]: the source rows of the slab dilated along x by h voxels. Empty and full rows are only flagged, since
+	// they contribute nothing or decide the output row on their own.
+	std::unique_ptr<uint64_t[]> levels(new uint64_t[(radius + 1) * level_words]);
+	std::vector<RowState> row_states(static_cast<size_t>(source_layers) * height);
+	for (int z = source_begin; z < source_end; ++z) {
+	  for (int y = 0; y < height; ++y) {
+		const uint64_t *row = source.Row(y, z);
+		uint64_t any = 0;
+		uint64_t all = row[width_words - 1] | ~last_word_mask;
+		for (int k = 0; k < width_words; ++k) {
+		  any |= row[k];
+		}
+		for (int k = 0; k + 1 < width_words; ++k) {
+		  all &= row[k];
+		}
+		size_t const row_index = static_cast<size_t>(z - source_begin) * height + y;
+		row_states[row_index] = any == 0 ? RowState::EMPTY : (~all == 0 ? RowState::FULL : RowState::PARTIAL);
+		if (row_states[row_index] != RowState::PARTIAL) {
+		  continue;
+		}
+		uint64_t *level = levels.get() + row_index * width_words;
+		std::copy(row, row + width_words, level);
+		for (int h = 1; h <= radius; ++h) {
+		  const uint64_t *previous = level + (h - 1) * level_words;
+		  uint64_t *current = level + h * level_words;
+		  for (int k = 0; k < width_words; ++k) {
+			uint64_t const towards_high = (row[k] << h) | (k > 0 ? row[k - 1] >> (64 - h) : 0);
+			uint64_t const towards_low = (row[k] >> h) | (k + 1 < width_words ? row[k + 1] << (64 - h) : 0);
+			current[k] = previous[k] | towards_high | towards_low;
+		  }
+		}
+	  }
+	}
+
+	for (int z = z_begin; z < z_end; ++z) {
+	  for (int y = 0; y < height; ++y) {
+		uint64_t *out = output.Row(y, z);
+		for (Segment const &segment : segments) {
+		  int const source_y = y + segment.dy;
+		  int const source_z = z + segment.dz;
+		  if (source_y < 0 || source_y >= height || source_z < 0 || source_z >= layers) {
+			continue;
+		  }
+		  size_t const row_index = static_cast<size_t>(source_z - source_begin) * height + source_y;
+		  if (row_states[row_index] == RowState::FULL) {
+			std::fill_n(out, width_words, ~uint64_t{0});
+			break;
+		  }
+		  if (row_states[row_index] == RowState::EMPTY) {
+			continue;
+		  }
+		  const uint64_t *in = levels.get() + segment.half_length * level_words + row_index * width_words;
+		  for (int k = 0; k < width_words; ++k) {
+			out[k] |= in[k];
+		  }
+		}
+		out[width_words - 1] &= last_word_mask;
+	  }
+	}
+  });
+  result = std::move(output);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Dual of the dilation: the background is dilated and the result inverted. Outside the volume the
+ * background is empty, so voxels at the border only erode from inside. This keeps closing extensive for regions that
+ * touch the border. source and result may be the same mask.
+ * @param source Mask to erode
+ * @param radius Radius of the structuring ball in voxels, 0 to kMaxRadius
+ * @param result Output: the eroded mask
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if source is empty, or StatusCode::MORPHOLOGY_ERROR if the radius
+ * is out of range
+ */
+Status BitMask::Erode(BitMask const &source, int radius, BitMask &result) {
+  if (source.Empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  BitMask background = source;
+  background.Invert();
+  Status const status = Dilate(background, radius, background);
+  if (!status.Ok()) {
+	return status;
+  }
+  background.Invert();
+  result = std::move(background);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The background voxels that can be reached from the border of the volume are flood-filled, and everything
+ * else is foreground. The fill spreads along x with word-parallel carry fills, and along y and z with sweeps in both
+ * directions, each sweep step filling its row along x again. The y-sweeps run one layer per thread and the z-sweeps
+ * one row index y per thread. Sweeps repeat until the reached set no longer grows, which takes a few rounds unless
+ * the background winds back and forth.
+ * @param source Mask to fill
+ * @param result Output: source plus all enclosed cavities
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if source is empty
+ */
+Status BitMask::FillHoles(BitMask const &source, BitMask &result) {
+  if (source.Empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  int const width = source.m_width;
+  int const height = source.m_height;
+  int const layers = source.m_layers;
+  int const words = source.m_wordsPerRow;
+  int const last_word = (width - 1) >> 6;
+  uint64_t const last_bit = uint64_t{1} << ((width - 1) & 63);
+  BitMask background = source;
+  background.Invert();
+
+  // Seeds: the background on the faces of the volume
+  BitMask reached;
+  Status const status = reached.Resize(width, height, layers);
+  if (!status.Ok()) {
+	return status;
+  }
+  utils::ParallelFor(0, layers, [&](int z) {
+	for (int y = 0; y < height; ++y) {
+	  const uint64_t *open = background.Row(y, z);
+	  uint64_t *row = reached.Row(y, z);
+	  if (y == 0 || y == height - 1 || z == 0 || z == layers - 1) {
+		std::copy(open, open + words, row);
+	  } else {
+		row[0] |= open[0] & 1u;
+		row[last_word] |= open[last_word] & last_bit;
+		FillRow(row, open, words);
+	  }
+	}
+  });
+
+  auto sweep_step = [&](int y, int z, int from_y, int from_z) {
+	const uint64_t *open = background.Row(y, z);
+	const uint64_t *from = reached.Row(from_y, from_z);
+	uint64_t *row = reached.Row(y, z);
+	bool grown = false;
+	for (int k = 0; k < words; ++k) {
+	  uint64_t const next = row[k] | (from[k] & open[k]);
+	  grown |= next != row[k];
+	  row[k] = next;
+	}
+	if (grown) {
+	  FillRow(row, open, words);
+	}
+  };
+  size_t reached_count = reached.Count();
+  for (;;) {
+	utils::ParallelFor(0, layers, [&](int z) {
+	  for (int y = 1; y < height; ++y) {
+		sweep_step(y, z, y - 1, z);
+	  }
+	  for (int y = height - 2; y >= 0; --y) {
+		sweep_step(y, z, y + 1, z);
+	  }
+	});
+	utils::ParallelFor(0, height, [&](int y) {
+	  for (int z = 1; z < layers; ++z) {
+		sweep_step(y, z, y, z - 1);
+	  }
+	  for (int z = layers - 2; z >= 0; --z) {
+		sweep_step(y, z, y, z + 1);
+	  }
+	});
+	size_t const count = reached.Count();
+	if (count == reached_count) {
+	  break;
+	}
+	reached_count = count;
+  }
+
+  reached.Invert();
+  result = std::move(reached);
+  return Status(StatusCode::OK);
+}
@@ -0,0 +1,125 @@
+#ifndef BIT_MASK_H
+#define BIT_MASK_H
+
+#include "MyLib_global.h"
+#include "status.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Morphological operation on a binary mask
+ */
+enum class MorphologyOperation {
+  /// Removes every voxel whose ball neighbourhood is not completely inside the mask
+  ERODE,
+  /// Adds every voxel whose ball neighbourhood touches the mask
+  DILATE,
+  /// Erosion followed by dilation, removes speckle and thin bridges
+  OPEN,
+  /// Dilation followed by erosion, closes thin gaps
+  CLOSE,
+  /// Adds all background voxels that are not 6-connected to the border of the volume
+  FILL_HOLES
+};
+
+/**
+ * @brief Binary volume with one bit per voxel and morphological operators
+ * @details Every row along x is stored in 64-bit words, bit i of word k holding voxel x = 64 k + i; unused bits at the
+ * end of a row are always zero. Shifts move 64 voxels at once along x, and the neighbours along y and z are whole
+ * words of other rows, so the operators combine 64 voxels per instruction.
+ * The structuring element is the voxel ball of the given radius. It is decomposed into one x-segment per (dy, dz)
+ * offset, and the x-dilations of all rows are computed once per slab of layers for every segment length, so an output
+ * word costs one OR per offset of the ball's yz-projection. Slabs are processed by all hardware threads.
+ */
+class MYLIB_EXPORT BitMask {
+ public:
+  /// Largest supported radius of the structuring element in voxels
+  static constexpr int kMaxRadius = 32;
+
+  /// Number of layers one thread processes at once
+  static constexpr int kSlabLayers = 16;
+
+  BitMask() = default;
+
+  /// Allocates an empty mask
+  Status Resize(int width, int height, int layers);
+
+  /// Sets the bits of all voxels of a linear x-fastest label volume that carry the given label
+  Status Build(const int *labels, int width, int height, int layers, int label);
+
+  /// Writes the mask into a linear x-fastest label volume: inside_label for set voxels, 0 for all others
+  void WriteLabels(int *labels, int inside_label) const;
+
+  /// Releases the mask
+  void Clear();
+
+  /// @return True if no mask has been allocated
+  [[nodiscard]] bool Empty() const { return m_words.empty(); }
+
+  /// Width of the volume in voxels
+  [[nodiscard]] int Width() const { return m_width; }
+
+  /// Height of the volume in voxels
+  [[nodiscard]] int Height() const { return m_height; }
+
+  /// Number of layers of the volume
+  [[nodiscard]] int Layers() const { return m_layers; }
+
+  /// Number of 64-bit words of one row
+  [[nodiscard]] int WordsPerRow() const { return m_wordsPerRow; }
+
+  /// @return True if voxel (x, y, z) is set
+  [[nodiscard]] inline bool Get(int x, int y, int z) const {
+	return (Row(y, z)[x >> 6] >> (x & 63)) & 1u;
+  }
+
+  /// Sets or clears voxel (x, y, z)
+  inline void Set(int x, int y, int z, bool value) {
+	uint64_t const bit = uint64_t{1} << (x & 63);
+	uint64_t &word = Row(y, z)[x >> 6];
+	word = value ? (word | bit) : (word & ~bit);
+  }
+
+  /// First word of row (y, z)
+  [[nodiscard]] inline const uint64_t *Row(int y, int z) const {
+	return m_words.data() + (static_cast<size_t>(z) * m_height + y) * m_wordsPerRow;
+  }
+
+  /// First word of row (y, z)
+  [[nodiscard]] inline uint64_t *Row(int y, int z) {
+	return m_words.data() + (static_cast<size_t>(z) * m_height + y) * m_wordsPerRow;
+  }
+
+  /// Number of set voxels
+  [[nodiscard]] size_t Count() const;
+
+  /// Applies a morphological operation with a ball of the given radius (ignored by FILL_HOLES)
+  static Status Apply(BitMask const &source, MorphologyOperation operation, int radius, BitMask &result);
+
+  /// Dilation with a ball; voxels outside the volume count as background
+  static Status Dilate(BitMask const &source, int radius, BitMask &result);
+
+  /// Erosion with a ball; voxels outside the volume count as foreground, so the mask is not eaten from the border
+  static Status Erode(BitMask const &source, int radius, BitMask &result);
+
+  /// Fills all cavities that are not connected to the border of the volume
+  static Status FillHoles(BitMask const &source, BitMask &result);
+
+ private:
+  /// Inverts every voxel, keeping the unused bits zero
+  void Invert();
+
+  /// Bits of the last word of a row that belong to voxels
+  [[nodiscard]] uint64_t LastWordMask() const;
+
+  int m_width{0};
+  int m_height{0};
+  int m_layers{0};
+  int m_wordsPerRow{0};
+
+  /// Rows in y-fastest, z-slowest order
+  std::vector<uint64_t> m_words;
+};
+
+#endif  // BIT_MASK_H
@@ -0,0 +1,176 @@
+#include "bricked_volume.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @details Bits are interleaved round-robin (x, y, z, x, y, z, ...). An axis whose brick count needs fewer bits simply
+ * drops out of the rotation once its bits are used up, so non-cubic volumes (e.g. 64x64x32 bricks) get a dense code
+ * range without holes.
+ * @param bricks_x Number of bricks along x
+ * @param bricks_y Number of bricks along y
+ * @param bricks_z Number of bricks along z
+ * @param code_x Output: Morton code contribution of every brick column along x
+ * @param code_y Output: Morton code contribution of every brick row along y
+ * @param code_z Output: Morton code contribution of every brick layer along z
+ */
+void BrickedVolume::InterleaveBrickBits(int bricks_x, int bricks_y, int bricks_z, std::vector<uint32_t> &code_x,
+										std::vector<uint32_t> &code_y, std::vector<uint32_t> &code_z) {
+  int const counts[3] = {bricks_x, bricks_y, bricks_z};
+  std::vector<uint32_t> *codes[3] = {&code_x, &code_y, &code_z};
+
+  int bits[3] = {0, 0, 0};
+  for (int axis = 0; axis < 3; ++axis) {
+	while ((1 << bits[axis]) < counts[axis]) {
+	  ++bits[axis];
+	}
+	codes[axis]->assign(counts[axis], 0);
+  }
+
+  int out_bit = 0;
+  int const max_bits = std::max(bits[0], std::max(bits[1], bits[2]));
+  for (int bit = 0; bit < max_bits; ++bit) {
+	for (int axis = 0; axis < 3; ++axis) {
+	  if (bit >= bits[axis]) {
+		continue;
+	  }
+	  for (int i = 0; i < counts[axis]; ++i) {
+		(*codes[axis])[i] |= static_cast<uint32_t>((i >> bit) & 1) << out_bit;
+	  }
+	  ++out_bit;
+	}
+  }
+}
+
+/**
+ * @details The conversion walks the volume brick by brick and copies one 8-voxel row (16 bytes) at a time, so every
+ * brick is written contiguously and every source cache line is read exactly once. Voxels of border bricks that lie
+ * outside the volume are filled with the padding value.
+ * @param linear_data Flat x-fastest source volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param padding_value Grey value for the padding voxels of partial bricks (air by default)
+ * @return StatusCode::OK on success, StatusCode::BUFFER_EMPTY if the source is null or has no voxels
+ */
+Status BrickedVolume::Build(const int16_t *linear_data, int width, int height, int layers, int16_t padding_value) {
+  if (linear_data == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  m_width = width;
+  m_height = height;
+  m_layers = layers;
+
+  int const bricks_x = (width + kBrickEdge - 1) >> kBrickShift;
+  int const bricks_y = (height + kBrickEdge - 1) >> kBrickShift;
+  int const bricks_z = (layers + kBrickEdge - 1) >> kBrickShift;
+
+  std::vector<uint32_t> code_x, code_y, code_z;
+  InterleaveBrickBits(bricks_x, bricks_y, bricks_z, code_x, code_y, code_z);
+
+  m_offsetX.resize(width);
+  m_offsetY.resize(height);
+  m_offsetZ.resize(layers);
+  for (int x = 0; x < width; ++x) {
+	m_offsetX[x] = code_x[x >> kBrickShift] * kBrickVoxels + (x & (kBrickEdge - 1));
+  }
+  for (int y = 0; y < height; ++y) {
+	m_offsetY[y] = code_y[y >> kBrickShift] * kBrickVoxels + (y & (kBrickEdge - 1)) * kBrickEdge;
+  }
+  for (int z = 0; z < layers; ++z) {
+	m_offsetZ[z] = code_z[z >> kBrickShift] * kBrickVoxels + (z & (kBrickEdge - 1)) * kBrickEdge * kBrickEdge;
+  }
+
+  // Codes increase monotonically along each axis, so the last brick of every axis yields the highest address
+  size_t const brick_count = static_cast<size_t>(code_x.back() + code_y.back() + code_z.back()) + 1;
+  m_data.assign(brick_count * kBrickVoxels, padding_value);
+
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  for (int bz = 0; bz < bricks_z; ++bz) {
+	for (int by = 0; by < bricks_y; ++by) {
+	  for (int bx = 0; bx < bricks_x; ++bx) {
+		int16_t *brick = m_data.data() + static_cast<size_t>(code_x[bx] + code_y[by] + code_z[bz]) * kBrickVoxels;
+		int const x0 = bx << kBrickShift;
+		int const row_length = std::min(kBrickEdge, width - x0);
+		for (int lz = 0; lz < kBrickEdge; ++lz) {
+		  int const z = (bz << kBrickShift) + lz;
+		  if (z >= layers) {
+			break;
+		  }
+		  for (int ly = 0; ly < kBrickEdge; ++ly) {
+			int const y = (by << kBrickShift) + ly;
+			if (y >= height) {
+			  break;
+			}
+			std::memcpy(brick + (lz * kBrickEdge + ly) * kBrickEdge,
+						linear_data + x0 + static_cast<size_t>(y) * width + slice_size * z,
+						row_length * sizeof(int16_t));
+		  }
+		}
+	  }
+	}
+  }
+
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The ranges are stored per brick in x-fastest brick order (not in Morton order), so that they can be used
+ * with either voxel layout. Each range also covers the first voxel layer of the neighbouring bricks in +x, +y and +z,
+ * because trilinear interpolation inside a brick reads those voxels as well. Renderers can therefore skip a brick as
+ * a whole if nothing in its range is visible.
+ * @param linear_data Flat x-fastest volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param brick_min Output: minimum value of every brick
+ * @param brick_max Output: maximum value of every brick
+ */
+void BrickedVolume::ComputeBrickRanges(const int16_t *linear_data, int width, int height, int layers,
+									   std::vector<int16_t> &brick_min, std::vector<int16_t> &brick_max) {
+  int const bricks_x = (width + kBrickEdge - 1) >> kBrickShift;
+  int const bricks_y = (height + kBrickEdge - 1) >> kBrickShift;
+  int const bricks_z = (layers + kBrickEdge - 1) >> kBrickShift;
+  brick_min.assign(static_cast<size_t>(bricks_x) * bricks_y * bricks_z, INT16_MAX);
+  brick_max.assign(brick_min.size(), INT16_MIN);
+  if (linear_data == nullptr) {
+	return;
+  }
+
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  utils::ParallelFor(0, bricks_z, [&](int bz) {
+	int const z_end = std::min(layers, ((bz + 1) << kBrickShift) + 1);
+	for (int by = 0; by < bricks_y; ++by) {
+	  int const y_end = std::min(height, ((by + 1) << kBrickShift) + 1);
+	  for (int bx = 0; bx < bricks_x; ++bx) {
+		int const x_begin = bx << kBrickShift;
+		int const x_end = std::min(width, ((bx + 1) << kBrickShift) + 1);
+		int16_t lo = INT16_MAX;
+		int16_t hi = INT16_MIN;
+		for (int z = bz << kBrickShift; z < z_end; ++z) {
+		  for (int y = by << kBrickShift; y < y_end; ++y) {
+			const int16_t *row = linear_data + slice_size * z + static_cast<size_t>(y) * width;
+			for (int x = x_begin; x < x_end; ++x) {
+			  lo = std::min(lo, row[x]);
+			  hi = std::max(hi, row[x]);
+			}
+		  }
+		}
+		size_t const brick = bx + static_cast<size_t>(by) * bricks_x + static_cast<size_t>(bz) * bricks_x * bricks_y;
+		brick_min[brick] = lo;
+		brick_max[brick] = hi;
+	  }
+	}
+  });
+}
+
+void BrickedVolume::Clear() {
+  m_data.clear();
+  m_data.shrink_to_fit();
+  m_offsetX.clear();
+  m_offsetY.clear();
+  m_offsetZ.clear();
+  m_width = m_height = m_layers = 0;
+}
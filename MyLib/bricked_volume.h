@@ -0,0 +1,113 @@
+#ifndef BRICKED_VOLUME_H
+#define BRICKED_VOLUME_H
+
+#include "MyLib_global.h"
+#include "status.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Selects how CTDataset stores the voxel volume that its kernels read from
+ */
+enum class VoxelLayout {
+  /// Flat x-fastest, z-slowest array (the layout of the raw image file)
+  LINEAR,
+  /// 8x8x8 voxel bricks stored in Morton (Z-curve) order
+  BRICKED
+};
+
+/**
+ * @brief Stores a 3D voxel volume as cubic bricks laid out along a Morton (Z-order) curve
+ * @details Each brick holds 8x8x8 voxels (1 KiB of int16_t) in x-fastest order, so all 26 neighbours of a voxel are at
+ * most one brick away. The brick coordinates are bit-interleaved, which keeps bricks that are close in 3D close in
+ * memory as well. Steps along z therefore cost 128 bytes inside a brick instead of a whole slice in the linear
+ * layout.
+ * The address of a voxel is split into three per-axis offsets that are precomputed at build time, so a lookup is
+ * three table reads and two additions.
+ */
+class MYLIB_EXPORT BrickedVolume {
+ public:
+  /// Edge length of a brick as power of two
+  static constexpr int kBrickShift = 3;
+
+  /// Edge length of a brick in voxels
+  static constexpr int kBrickEdge = 1 << kBrickShift;
+
+  /// Number of voxels in one brick
+  static constexpr int kBrickVoxels = kBrickEdge * kBrickEdge * kBrickEdge;
+
+  BrickedVolume() = default;
+
+  /// Converts a linear x-fastest volume into the bricked layout
+  Status Build(const int16_t *linear_data, int width, int height, int layers, int16_t padding_value = -1024);
+
+  /// Computes the value range of every brick of a linear volume
+  static void ComputeBrickRanges(const int16_t *linear_data, int width, int height, int layers,
+								 std::vector<int16_t> &brick_min, std::vector<int16_t> &brick_max);
+
+  /// Releases the bricked copy
+  void Clear();
+
+  /// @return True if no volume has been built yet
+  [[nodiscard]] bool Empty() const { return m_data.empty(); }
+
+  /// Offset of voxel (x, y, z) into Data()
+  [[nodiscard]] inline uint32_t Offset(int x, int y, int z) const {
+	return m_offsetX[x] + m_offsetY[y] + m_offsetZ[z];
+  }
+
+  /// Grey value of voxel (x, y, z)
+  [[nodiscard]] inline int16_t At(int x, int y, int z) const { return m_data[Offset(x, y, z)]; }
+
+  /// Pointer to the raw bricked data
+  [[nodiscard]] const int16_t *Data() const { return m_data.data(); }
+
+  /// Number of allocated bricks, including padding bricks at the volume borders
+  [[nodiscard]] int BrickCount() const { return static_cast<int>(m_data.size() / kBrickVoxels); }
+
+  [[nodiscard]] int Width() const { return m_width; }
+  [[nodiscard]] int Height() const { return m_height; }
+  [[nodiscard]] int Layers() const { return m_layers; }
+
+ private:
+  /// Spreads the bits of the brick coordinates of all three axes into a Morton code
+  static void InterleaveBrickBits(int bricks_x, int bricks_y, int bricks_z, std::vector<uint32_t> &code_x,
+								  std::vector<uint32_t> &code_y, std::vector<uint32_t> &code_z);
+
+  int m_width{0};
+  int m_height{0};
+  int m_layers{0};
+
+  /// Per-axis voxel offsets, Offset(x, y, z) = m_offsetX[x] + m_offsetY[y] + m_offsetZ[z]
+  std::vector<uint32_t> m_offsetX;
+  std::vector<uint32_t> m_offsetY;
+  std::vector<uint32_t> m_offsetZ;
+
+  /// The bricks in Morton order
+  std::vector<int16_t> m_data;
+};
+
+/**
+ * @brief Reads voxels from a flat x-fastest volume
+ * @details Accessors are the template parameter of the CTDataset kernels, so the layout is resolved once per call and
+ * not per voxel.
+ */
+struct LinearVoxelAccessor {
+  const int16_t *data;
+  int width;
+  int slice_size;
+
+  inline int16_t operator()(int x, int y, int z) const { return data[x + y * width + slice_size * z]; }
+};
+
+/**
+ * @brief Reads voxels from a BrickedVolume
+ */
+struct BrickedVoxelAccessor {
+  const BrickedVolume *volume;
+
+  inline int16_t operator()(int x, int y, int z) const { return volume->At(x, y, z); }
+};
+
+#endif  // BRICKED_VOLUME_H
@@ -0,0 +1,277 @@
+#include "cine_series.h"
+
+constexpr int CineSeries::kDefaultRingSize;
+
+/**
+ * @param ring_size Number of frames the ring buffer holds, i.e. how far the prefetch thread runs ahead of playback
+ */
+CineSeries::CineSeries(int const ring_size)
+  : m_ringSize(std::max(1, ring_size)),
+	m_ring(m_ringSize),
+	m_worker(&CineSeries::PrefetchLoop, this) {
+}
+
+CineSeries::~CineSeries() {
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stop = true;
+	m_phasePaths.clear();
+	++m_generation;
+  }
+  m_wakeUp.notify_all();
+  m_frameReady.notify_all();
+  m_worker.join();
+}
+
+/**
+ * @details Playback starts at phase 0, which the prefetch thread loads first. Frames of the previous series that are
+ * still in use stay valid.
+ * @param phase_paths Raw volume file of every phase, in playback order
+ * @param threshold HU threshold of the surface render
+ * @param slice_layer Layer of the axial slice
+ * @return StatusCode::OK, or StatusCode::CINE_ERROR if there are no phases or the slice layer is negative
+ */
+Status CineSeries::Open(std::vector<QString> const &phase_paths, int const threshold, int const slice_layer) {
+  if (phase_paths.empty() || slice_layer < 0) {
+	return Status(StatusCode::CINE_ERROR);
+  }
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_phasePaths = phase_paths;
+	m_threshold = threshold;
+	m_sliceLayer = slice_layer;
+	std::fill(m_ring.begin(), m_ring.end(), RingSlot());
+	m_position = 0;
+	m_loadedPhases = 0;
+	++m_generation;
+  }
+  m_wakeUp.notify_one();
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Also releases the dataset of the prefetch thread, so a closed series holds no volume memory.
+ */
+void CineSeries::Close() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_phasePaths.clear();
+  std::fill(m_ring.begin(), m_ring.end(), RingSlot());
+  ++m_generation;
+  m_frameReady.notify_all();
+  m_frameReady.wait(lock, [this] { return m_loadingPhase < 0; });
+  m_dataset.reset();
+}
+
+/**
+ * @details Drops all prefetched frames; the prefetch thread starts over from the playback position.
+ * @param threshold HU threshold of the surface render
+ * @param slice_layer Layer of the axial slice
+ * @return StatusCode::OK, or StatusCode::CINE_ERROR if no series is open or the slice layer is negative
+ */
+Status CineSeries::SetRenderParameters(int const threshold, int const slice_layer) {
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_phasePaths.empty() || slice_layer < 0) {
+	  return Status(StatusCode::CINE_ERROR);
+	}
+	if (threshold == m_threshold && slice_layer == m_sliceLayer) {
+	  return Status(StatusCode::OK);
+	}
+	m_threshold = threshold;
+	m_sliceLayer = slice_layer;
+	std::fill(m_ring.begin(), m_ring.end(), RingSlot());
+	++m_generation;
+  }
+  m_wakeUp.notify_one();
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Meant for the playback timer: a frame that is not ready yet is skipped instead of stalling the display,
+ * so playback keeps a steady rate and only holds the previous frame if the disk cannot keep up.
+ * @param phase Phase of the frame, also the new playback position
+ * @param frame Output: the frame, nullptr unless StatusCode::OK is returned
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if the frame is not prefetched yet, StatusCode::CINE_ERROR if no
+ * series is open or the phase is out of range, or the error that occurred while loading the phase
+ */
+Status CineSeries::TryGetFrame(int const phase, std::shared_ptr<const CineFrame> &frame) {
+  frame.reset();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (phase < 0 || phase >= static_cast<int>(m_phasePaths.size())) {
+	return Status(StatusCode::CINE_ERROR);
+  }
+  SeekLocked(phase);
+  int const slot = FindSlotLocked(phase);
+  if (slot < 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  frame = m_ring[slot].frame;
+  return m_ring[slot].status;
+}
+
+/**
+ * @param phase Phase of the frame, also the new playback position
+ * @param frame Output: the frame, nullptr unless StatusCode::OK is returned
+ * @return StatusCode::OK, StatusCode::CINE_ERROR if no series is open (or it is closed while waiting) or the phase
+ * is out of range, or the error that occurred while loading the phase
+ */
+Status CineSeries::GetFrame(int const phase, std::shared_ptr<const CineFrame> &frame) {
+  frame.reset();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+	if (phase < 0 || phase >= static_cast<int>(m_phasePaths.size())) {
+	  return Status(StatusCode::CINE_ERROR);
+	}
+	int const slot = FindSlotLocked(phase);
+	if (slot >= 0) {
+	  frame = m_ring[slot].frame;
+	  return m_ring[slot].status;
+	}
+	// Another thread may have moved the playback position away in the meantime
+	if (phase != m_position) {
+	  SeekLocked(phase);
+	}
+	m_frameReady.wait(lock);
+  }
+}
+
+void CineSeries::WaitForPrefetch() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_frameReady.wait(lock, [this] {
+	return m_phasePaths.empty() || (m_loadingPhase < 0 && NextMissingPhaseLocked() < 0);
+  });
+}
+
+int CineSeries::PhaseCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<int>(m_phasePaths.size());
+}
+
+int CineSeries::RingSize() const {
+  return m_ringSize;
+}
+
+int64_t CineSeries::LoadedPhases() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_loadedPhases;
+}
+
+void CineSeries::SeekLocked(int const phase) {
+  m_position = phase;
+  m_wakeUp.notify_one();
+}
+
+int CineSeries::FindSlotLocked(int const phase) const {
+  for (int slot = 0; slot < m_ringSize; ++slot) {
+	if (m_ring[slot].phase == phase) {
+	  return slot;
+	}
+  }
+  return -1;
+}
+
+int CineSeries::NextMissingPhaseLocked() const {
+  int const phase_count = static_cast<int>(m_phasePaths.size());
+  for (int step = 0; step < std::min(m_ringSize, phase_count); ++step) {
+	int const phase = (m_position + step) % phase_count;
+	if (phase != m_loadingPhase && FindSlotLocked(phase) < 0) {
+	  return phase;
+	}
+  }
+  return -1;
+}
+
+bool CineSeries::InWindowLocked(int const phase) const {
+  int const phase_count = static_cast<int>(m_phasePaths.size());
+  if (phase < 0 || phase >= phase_count) {
+	return false;
+  }
+  return (phase - m_position + phase_count) % phase_count < std::min(m_ringSize, phase_count);
+}
+
+/**
+ * @details Runs on the prefetch thread. The dataset of the prefetch thread holds the only volume of the series in
+ * memory; its kernels run on the shared thread pool.
+ * @param path Raw volume file of the phase
+ * @param phase Index of the phase
+ * @param threshold HU threshold of the surface render
+ * @param slice_layer Layer of the axial slice
+ * @param frame Output: the computed frame
+ * @return StatusCode::OK, StatusCode::SLICE_OUT_OF_RANGE if the slice layer is beyond the volume, or the error of
+ * loading or rendering the phase
+ */
+Status CineSeries::ComputeFrame(QString path, int const phase, int const threshold, int const slice_layer,
+								std::shared_ptr<CineFrame> &frame) {
+  if (!m_dataset) {
+	m_dataset.reset(new CTDataset());
+  }
+  if (slice_layer >= m_dataset->GetSliceCount(SliceOrientation::AXIAL)) {
+	return Status(StatusCode::SLICE_OUT_OF_RANGE);
+  }
+  Status status = m_dataset->load(path);
+  if (!status.Ok()) {
+	return status;
+  }
+
+  auto result = std::make_shared<CineFrame>();
+  result->phase = phase;
+  result->threshold = threshold;
+  result->slice_layer = slice_layer;
+  SlicePlane const plane = m_dataset->GetSlicePlane(SliceOrientation::AXIAL, slice_layer);
+  result->width = plane.width;
+  result->height = plane.height;
+  status = m_dataset->ExtractSlice(plane, result->slice);
+  if (!status.Ok()) {
+	return status;
+  }
+  status = m_dataset->CalculateDepthBuffer(threshold);
+  if (status.Ok()) {
+	status = m_dataset->RenderDepthBuffer();
+  }
+  if (!status.Ok()) {
+	return status;
+  }
+  // The depth buffer covers the axial plane
+  result->rendered_image.assign(m_dataset->GetRenderedDepthBuffer(),
+								m_dataset->GetRenderedDepthBuffer() + plane.width * plane.height);
+  frame = std::move(result);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Loads the missing phase closest to the playback position, one at a time. A result is only kept if the
+ * frames have not been invalidated in the meantime and its phase is still among the next ring_size phases; it
+ * replaces a slot whose phase has fallen out of that window.
+ */
+void CineSeries::PrefetchLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+	m_wakeUp.wait(lock, [this] { return m_stop || (!m_phasePaths.empty() && NextMissingPhaseLocked() >= 0); });
+	if (m_stop) {
+	  return;
+	}
+
+	int const phase = NextMissingPhaseLocked();
+	QString const path = m_phasePaths[phase];
+	int const threshold = m_threshold;
+	int const slice_layer = m_sliceLayer;
+	uint64_t const generation = m_generation;
+	m_loadingPhase = phase;
+	lock.unlock();
+
+	std::shared_ptr<CineFrame> frame;
+	Status const status = ComputeFrame(path, phase, threshold, slice_layer, frame);
+
+	lock.lock();
+	m_loadingPhase = -1;
+	if (generation == m_generation) {
+	  ++m_loadedPhases;
+	  if (InWindowLocked(phase)) {
+		auto const slot = std::find_if(m_ring.begin(), m_ring.end(),
+									   [this](RingSlot const &entry) { return !InWindowLocked(entry.phase); });
+		*slot = RingSlot{phase, frame, status};
+	  }
+	}
+	m_frameReady.notify_all();
+  }
+}
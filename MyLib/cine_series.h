@@ -0,0 +1,135 @@
+#ifndef CINE_SERIES_H
+#define CINE_SERIES_H
+
+#include "ct_dataset.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Everything the viewer shows of one phase of a time-resolved (4D) CT series
+ */
+struct CineFrame {
+  /// Phase the frame belongs to
+  int phase;
+  /// Threshold and axial slice layer the frame was computed with
+  int threshold;
+  int slice_layer;
+  /// Dimensions of the axial plane, which the slice and the rendered image both cover
+  int width;
+  int height;
+  /// HU values of the axial slice
+  std::vector<int16_t> slice;
+  /// Shaded threshold surface in the layout of CTDataset::GetRenderedDepthBuffer()
+  std::vector<int> rendered_image;
+};
+
+/**
+ * @brief Time-resolved CT series (e.g. the phases of a respiratory-gated 4D CT) played back from disk
+ * @details Every phase is a raw volume file in the format of CTDataset::load(). The phases are never all held in
+ * memory: a prefetch thread loads one phase at a time into its own dataset, computes the threshold surface render and
+ * the axial slice of it and keeps only these in a ring buffer of ring_size frames. Requesting a frame moves the
+ * playback position; the prefetch thread always works on the missing frames of the next ring_size phases from there
+ * (wrapping around at the end of the series), so looped playback mostly finds its next frame prepared.
+ * Frames are immutable and shared, so a frame that is on screen stays valid when its ring slot is reused.
+ */
+class MYLIB_EXPORT CineSeries {
+ public:
+  /// Number of frames the ring buffer holds by default
+  static constexpr int kDefaultRingSize = 4;
+
+  explicit CineSeries(int const ring_size = kDefaultRingSize);
+  ~CineSeries();
+
+  CineSeries(CineSeries const &) = delete;
+  CineSeries &operator=(CineSeries const &) = delete;
+
+  /// Start playing a series of phase files, dropping the frames of the previous series
+  Status Open(std::vector<QString> const &phase_paths, int const threshold, int const slice_layer);
+
+  /// Drop the series and wait until the prefetch thread is idle
+  void Close();
+
+  /// Recompute the frames for another threshold or axial slice layer
+  Status SetRenderParameters(int const threshold, int const slice_layer);
+
+  /// Get the frame of a phase if it has been prefetched, without blocking
+  Status TryGetFrame(int const phase, std::shared_ptr<const CineFrame> &frame);
+
+  /// Get the frame of a phase, waiting for the prefetch thread if needed
+  Status GetFrame(int const phase, std::shared_ptr<const CineFrame> &frame);
+
+  /// Block until all frames of the ring buffer are prefetched
+  void WaitForPrefetch();
+
+  /// Number of phases of the series, 0 without a series
+  [[nodiscard]] int PhaseCount() const;
+
+  /// Number of frames the ring buffer holds
+  [[nodiscard]] int RingSize() const;
+
+  /// Number of phases that have been read from disk since the series was opened
+  [[nodiscard]] int64_t LoadedPhases() const;
+
+ private:
+  /// Moves the playback position and makes the prefetch thread work on the phases that follow it
+  void SeekLocked(int const phase);
+
+  /// @return The ring slot holding the frame of a phase, -1 if it is not prefetched
+  [[nodiscard]] int FindSlotLocked(int const phase) const;
+
+  /// @return The first phase after the playback position that has no frame yet and is not being loaded, -1 if none
+  [[nodiscard]] int NextMissingPhaseLocked() const;
+
+  /// @return True if the phase is one of the ring_size phases from the playback position on
+  [[nodiscard]] bool InWindowLocked(int const phase) const;
+
+  /// Loads a phase into the dataset of the prefetch thread and computes its frame
+  Status ComputeFrame(QString path, int const phase, int const threshold, int const slice_layer,
+					  std::shared_ptr<CineFrame> &frame);
+
+  /// Main loop of the prefetch thread
+  void PrefetchLoop();
+
+  struct RingSlot {
+	/// Phase of the slot, -1 for a free slot
+	int phase{-1};
+	std::shared_ptr<const CineFrame> frame;
+	/// Result of computing the frame; a phase that failed keeps its error, so playback does not retry it forever
+	Status status;
+  };
+
+  int const m_ringSize;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+  std::condition_variable m_frameReady;
+
+  std::vector<QString> m_phasePaths;
+  int m_threshold{0};
+  int m_sliceLayer{0};
+
+  /// Ring buffer of prefetched frames
+  std::vector<RingSlot> m_ring;
+
+  /// Phase that was requested last
+  int m_position{0};
+
+  /// Phase the prefetch thread is working on, -1 if it is idle
+  int m_loadingPhase{-1};
+
+  /// Incremented whenever the frames become invalid, so that stale prefetch results are discarded
+  uint64_t m_generation{0};
+  bool m_stop{false};
+  int64_t m_loadedPhases{0};
+
+  /// Dataset the prefetch thread loads the phases into, created on first use and released by Close()
+  std::unique_ptr<CTDataset> m_dataset;
+
+  std::thread m_worker;
+};
+
+#endif  // CINE_SERIES_H
@@ -1,26 +1,119 @@
 #include "ct_dataset.h"
 
+#include <unordered_set>
+
+namespace {
+/**
+ * @brief Trilinear interpolation of the voxel values around (x, y, z)
+ * @attention The position must lie inside the volume, i.e. 0 <= x <= max_x etc.
+ */
+template<typename VoxelAccessor>
+inline float SampleTrilinear(VoxelAccessor const &voxel, float x, float y, float z, int max_x, int max_y,
+							 int max_z) {
+  int const x0 = static_cast<int>(x);
+  int const y0 = static_cast<int>(y);
+  int const z0 = static_cast<int>(z);
+  int const x1 = std::min(x0 + 1, max_x);
+  int const y1 = std::min(y0 + 1, max_y);
+  int const z1 = std::min(z0 + 1, max_z);
+  float const fx = x - x0;
+  float const fy = y - y0;
+  float const fz = z - z0;
+  float const c00 = voxel(x0, y0, z0) + fx * (voxel(x1, y0, z0) - voxel(x0, y0, z0));
+  float const c10 = voxel(x0, y1, z0) + fx * (voxel(x1, y1, z0) - voxel(x0, y1, z0));
+  float const c01 = voxel(x0, y0, z1) + fx * (voxel(x1, y0, z1) - voxel(x0, y0, z1));
+  float const c11 = voxel(x0, y1, z1) + fx * (voxel(x1, y1, z1) - voxel(x0, y1, z1));
+  float const c0 = c00 + fy * (c10 - c00);
+  float const c1 = c01 + fy * (c11 - c01);
+  return c0 + fz * (c1 - c0);
+}
+
+/**
+ * @brief Evenly distributed unit directions on the sphere (Fibonacci lattice)
+ * @details The lattice is ordered by latitude. Bands of about sqrt(count) consecutive directions are additionally
+ * sorted by longitude, so that neighbouring directions are also close to each other on the sphere.
+ */
+std::vector<Eigen::Vector3d> FibonacciDirections(int const count) {
+  std::vector<Eigen::Vector3d> directions(count);
+  double const golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+  for (int i = 0; i < count; ++i) {
+	double const z = 1.0 - (2.0 * i + 1.0) / count;
+	double const radius = std::sqrt(std::max(0.0, 1.0 - z * z));
+	directions[i] = Eigen::Vector3d(radius * std::cos(golden_angle * i), radius * std::sin(golden_angle * i), z);
+  }
+  int const band = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count))));
+  for (int first = 0; first < count; first += band) {
+	std::sort(directions.begin() + first, directions.begin() + std::min(count, first + band),
+			  [](Eigen::Vector3d const &a, Eigen::Vector3d const &b) {
+				return std::atan2(a.y(), a.x()) < std::atan2(b.y(), b.x());
+			  });
+  }
+  return directions;
+}
+
+/**
+ * @brief Collects the voxels of a volume that satisfy a predicate, ordered by y, then x, then z
+ * @details The y-planes are spread over the thread pool. Each plane is scanned along its contiguous rows, layer by
+ * layer, and its points are sorted by x afterwards, which gives the order of a loop over y, x and z without striding
+ * through memory by a whole layer per voxel.
+ */
+template<typename Predicate>
+std::vector<Eigen::Vector3i> CollectVoxels(int const width, int const height, int const layers,
+										   Predicate const &predicate) {
+  return utils::ParallelCollect<Eigen::Vector3i>(0, height, [&](int y, std::vector<Eigen::Vector3i> &points) {
+	size_t const first = points.size();
+	for (int d = 0; d < layers; ++d) {
+	  for (int x = 0; x < width; ++x) {
+		if (predicate(x, y, d)) {
+		  points.emplace_back(x, y, d);
+		}
+	  }
+	}
+	std::stable_sort(points.begin() + first, points.end(),
+					 [](Eigen::Vector3i const &a, Eigen::Vector3i const &b) { return a.x() < b.x(); });
+  });
+}
+} // namespace
+
+constexpr int CTDataset::kRegionHistoryLevels;
+constexpr int CTDataset::kRawWidth;
+constexpr int CTDataset::kRawHeight;
+constexpr int CTDataset::kRawLayers;
+constexpr double CTDataset::kRawPixelSpacing;
+constexpr double CTDataset::kRawLayerSpacing;
+constexpr int CTDataset::kImageGuard;
+constexpr int CTDataset::kTemporalTileSize;
+constexpr double CTDataset::kTemporalMaxAngle;
+constexpr int CTDataset::kTemporalRefreshFrames;
+
 CTDataset::CTDataset() :
-  m_imgHeight(512),
-  m_imgWidth(512),
-  m_imgLayers(256),
+  m_imgHeight(kRawHeight),
+  m_imgWidth(kRawWidth),
+  m_imgLayers(kRawLayers),
   m_imgData(new int16_t[m_imgHeight * m_imgWidth * m_imgLayers]{0}),
   m_regionBuffer(new int[m_imgHeight * m_imgWidth * m_imgLayers]{0}),
   m_visitedBuffer(new int[m_imgHeight * m_imgWidth * m_imgLayers]{0}),
-  m_depthBuffer(new int[m_imgHeight * m_imgWidth]{0}),
   m_renderedDepthBuffer(new int[m_imgHeight * m_imgWidth]{0}) {
+  m_depthBuffer.Allocate(m_imgWidth, m_imgHeight, 1, kImageGuard, 0, m_imgLayers - 1);
+  m_idBuffer.Allocate(m_imgWidth, m_imgHeight, 1, kImageGuard, -1, -1);
+  m_normalBuffer.Allocate(m_imgWidth, m_imgHeight, 1, kImageGuard, 0, 0);
+  m_pointBuffer.Allocate(m_imgWidth, m_imgHeight, 1, kImageGuard, -1, -1);
+  m_previousPointBuffer.Allocate(m_imgWidth, m_imgHeight, 1, kImageGuard, -1, -1);
+  m_voxelData = m_imgData;
+  SelectKernels();
 }
 
 CTDataset::~CTDataset() {
   delete[] m_imgData;
   delete[] m_regionBuffer;
   delete[] m_visitedBuffer;
-  delete[] m_depthBuffer;
   delete[] m_renderedDepthBuffer;
 }
 
 /**
- * @details File location is specified via a GUI window selection
+ * @details File location is specified via a GUI window selection. Raw files have no header, so the dataset returns
+ * to the dimensions kRawWidth, kRawHeight and kRawLayers and to the raw voxel spacing, e.g. after
+ * ImportDicomSeries(). A file that is too short leaves the image data incomplete.
  * @param img_path The file path of the CT image.
  * @return StatusCode::OK if loading was succesfull, else StatusCode::FOPEN_ERROR.
  */
@@ -31,9 +124,100 @@ Status MYLIB_EXPORT CTDataset::load(QString &img_path) {
 	return Status(StatusCode::FOPEN_ERROR);
   }
 
-  img_file.read(reinterpret_cast<char *>(m_imgData), m_imgHeight * m_imgWidth * m_imgLayers * sizeof(int16_t));
+  if (m_imgWidth != kRawWidth || m_imgHeight != kRawHeight || m_imgLayers != kRawLayers) {
+	Allocate(kRawWidth, kRawHeight, kRawLayers);
+  }
+  m_voxelSpacing = Eigen::Vector3d(kRawPixelSpacing, kRawPixelSpacing, kRawLayerSpacing);
+  qint64 const bytes = static_cast<qint64>(m_imgHeight) * m_imgWidth * m_imgLayers * sizeof(int16_t);
+  bool const complete = img_file.read(reinterpret_cast<char *>(m_imgData), bytes) == bytes;
   img_file.close();
-  return Status(StatusCode::OK);
+  Status const reset_status = ResetAfterLoad();
+  return complete ? reset_status : Status(StatusCode::FOPEN_ERROR);
+}
+
+/**
+ * @details The series is read by DicomSeries: the headers of all files are parsed in parallel, the slices are sorted
+ * along the slice normal and their pixel data is read and rescaled to HU straight into the image data, one slice per
+ * task. The dataset takes over the number of rows, columns and slices of the series as its dimensions and the pixel
+ * spacing and slice distance as its voxel spacing. If the headers cannot be read, the previous image data is kept;
+ * an error while reading the pixel data leaves the image data incomplete.
+ * @param directory Directory holding the DICOM files of the series
+ * @return StatusCode::OK, or the error of DicomSeries::ScanDirectory() or DicomSeries::ReadPixelData()
+ */
+Status CTDataset::ImportDicomSeries(QString const &directory) {
+  std::vector<DicomSliceInfo> slices;
+  Eigen::Vector3d spacing;
+  Status status = DicomSeries::ScanDirectory(directory, slices, spacing);
+  if (!status.Ok()) {
+	return status;
+  }
+  int const width = slices.front().columns;
+  int const height = slices.front().rows;
+  int const layers = static_cast<int>(slices.size());
+  if (width != m_imgWidth || height != m_imgHeight || layers != m_imgLayers) {
+	Allocate(width, height, layers);
+  }
+  m_voxelSpacing = spacing;
+  status = DicomSeries::ReadPixelData(slices, m_imgData);
+  Status const reset_status = ResetAfterLoad();
+  return status.Ok() ? reset_status : status;
+}
+
+void CTDataset::Allocate(int const width, int const height, int const layers) {
+  delete[] m_imgData;
+  delete[] m_regionBuffer;
+  delete[] m_visitedBuffer;
+  delete[] m_renderedDepthBuffer;
+  m_imgWidth = width;
+  m_imgHeight = height;
+  m_imgLayers = layers;
+  size_t const voxel_count = static_cast<size_t>(width) * height * layers;
+  size_t const pixel_count = static_cast<size_t>(width) * height;
+  m_imgData = new int16_t[voxel_count]{0};
+  m_regionBuffer = new int[voxel_count]{0};
+  m_visitedBuffer = new int[voxel_count]{0};
+  m_renderedDepthBuffer = new int[pixel_count]{0};
+  m_depthBuffer.Allocate(width, height, 1, kImageGuard, 0, layers - 1);
+  m_idBuffer.Allocate(width, height, 1, kImageGuard, -1, -1);
+  m_normalBuffer.Allocate(width, height, 1, kImageGuard, 0, 0);
+  m_pointBuffer.Allocate(width, height, 1, kImageGuard, -1, -1);
+  m_previousPointBuffer.Allocate(width, height, 1, kImageGuard, -1, -1);
+  m_normalBufferValid = false;
+  m_pointBufferValid = false;
+  m_voxelData = m_imgData;
+  m_prefilterValid = false;
+  m_allPointsInRegion.clear();
+  m_allRenderedPoints.clear();
+  m_surfacePoints.clear();
+  m_surfaceClusters.Clear();
+  ++m_surfaceGeneration;
+  m_surfaceResultsValid = true;
+}
+
+/**
+ * @return StatusCode::OK if the prefilter and the voxel layout could be rebuilt
+ */
+Status CTDataset::ResetAfterLoad() {
+  m_normalVolume.Clear();
+  m_surfaceNormals.clear();
+  m_surfaceClusters.Clear();
+  ++m_surfaceGeneration;
+  m_pointBufferValid = false;
+  m_regionDistance.Clear();
+  m_regionMesh = TriangleMesh();
+  m_regionMeshValid = false;
+  m_regionHistory.clear();
+  m_regionHistoryIndex = -1;
+  SelectKernels();
+  return RebuildVoxelLayout();
+}
+
+/**
+ * @details The image data holds HU values, which every loader stores as int16_t, so the int16_t instantiations are
+ * selected; volumes of the other voxel types use the same kernels through voxel_kernels::SelectRegionGrowing().
+ */
+void CTDataset::SelectKernels() {
+  m_regionGrowingKernel = voxel_kernels::SelectRegionGrowing(VoxelType::INT16, m_regionConnectivity);
 }
 
 /**
@@ -45,11 +229,101 @@ int16_t *CTDataset::Data() const {
 }
 
 /**
- * @return Pointer of type int to the non-3D rendered depth buffer
+ * @details With VoxelLayout::BRICKED a bricked copy of the image data is built immediately (and after every load),
+ * switching back to VoxelLayout::LINEAR releases it again. Data() always points to the linear image data. The depth
+ * rays, slices, projections, volume rendering and region growing read their voxels from the selected layout; labels
+ * such as the region growing buffer, which the surface point search reads, are always linear.
+ * @param layout The layout the processing kernels should read from
+ * @return StatusCode::OK if the layout could be built
+ */
+Status CTDataset::SetVoxelLayout(VoxelLayout layout) {
+  m_voxelLayout = layout;
+  return UpdateVoxelLayout();
+}
+
+VoxelLayout CTDataset::GetVoxelLayout() const {
+  return m_voxelLayout;
+}
+
+/**
+ * @details Must be called whenever the image data was written to through Data(), otherwise the prefiltered volume,
+ * the bricked copy and the brick value ranges used for empty space skipping are stale.
+ * @return StatusCode::OK if the prefilter and the layout could be built
+ */
+Status CTDataset::RebuildVoxelLayout() {
+  m_prefilterValid = false;
+  return UpdateVoxelLayout();
+}
+
+/**
+ * @details The prefilter runs only if its result is outdated, i.e. after a change of the image data or of the filter
+ * parameters. The bricked copy and the brick value ranges are always derived from the volume the kernels read.
+ * @return StatusCode::OK if the prefilter and the layout could be built
+ */
+Status CTDataset::UpdateVoxelLayout() {
+  if (!m_prefilterValid) {
+	if (m_prefilterParameters.type == PrefilterType::NONE) {
+	  std::vector<int16_t>().swap(m_filteredData);
+	  m_voxelData = m_imgData;
+	} else {
+	  m_filteredData.resize(static_cast<size_t>(m_imgWidth) * m_imgHeight * m_imgLayers);
+	  Status const status = Prefilter::Apply(m_imgData, m_imgWidth, m_imgHeight, m_imgLayers, m_prefilterParameters,
+											 m_filteredData.data());
+	  if (!status.Ok()) {
+		return status;
+	  }
+	  m_voxelData = m_filteredData.data();
+	}
+	m_prefilterValid = true;
+  }
+  BrickedVolume::ComputeBrickRanges(m_voxelData, m_imgWidth, m_imgHeight, m_imgLayers, m_brickMin, m_brickMax);
+  if (m_voxelLayout == VoxelLayout::LINEAR) {
+	m_brickedVolume.Clear();
+	return Status(StatusCode::OK);
+  }
+  return m_brickedVolume.Build(m_voxelData, m_imgWidth, m_imgHeight, m_imgLayers);
+}
+
+/**
+ * @details Setting the current parameters again keeps the cached result. Any other change recomputes the filtered
+ * volume and the voxel layout derived from it, but leaves the raw image data and the region growing result alone.
+ * The normal volume is discarded because it was computed from the old filtered volume.
+ * @param params Filter and its parameters, PrefilterType::NONE to let the kernels read the raw image data
+ * @return StatusCode::OK, or StatusCode::PREFILTER_ERROR if the parameters are out of range
+ */
+Status CTDataset::SetPrefilter(PrefilterParameters const &params) {
+  if (params == m_prefilterParameters && m_prefilterValid) {
+	return Status(StatusCode::OK);
+  }
+  if (params.type == PrefilterType::GAUSSIAN && (!(params.sigma > 0.0) || params.sigma > Prefilter::kMaxSigma)) {
+	return Status(StatusCode::PREFILTER_ERROR);
+  }
+  m_prefilterParameters = params;
+  m_prefilterValid = false;
+  m_normalVolume.Clear();
+  return UpdateVoxelLayout();
+}
+
+PrefilterParameters const &CTDataset::GetPrefilter() const {
+  return m_prefilterParameters;
+}
+
+/**
+ * @return The volume all processing kernels read: the prefiltered image data, or the raw image data without a
+ * prefilter
  * @attention Null-checks and bounds-checks are caller's responsiblity
  */
-int *CTDataset::GetDepthBuffer() const {
-  return m_depthBuffer;
+const int16_t *CTDataset::FilteredData() const {
+  return m_voxelData;
+}
+
+/**
+ * @return View of the non-3D rendered depth buffer. Rows are padded by kImageGuard pixels on both sides, so pixel
+ * (x, y) is at x + y * row_stride from the origin, not at x + y * width.
+ * @attention Bounds-checks are caller's responsiblity
+ */
+StridedView<const int> CTDataset::GetDepthBuffer() const {
+  return m_depthBuffer.View();
 }
 
 /**
@@ -60,6 +334,59 @@ int *CTDataset::GetRenderedDepthBuffer() const {
   return m_renderedDepthBuffer;
 }
 
+/**
+ * @return View of the ID buffer, with the same strides as GetDepthBuffer(). Every pixel holds
+ * x + y * width + z * width * height of the voxel that was hit by the last depth buffer calculation, or -1 if the
+ * pixel shows background.
+ * @attention Bounds-checks are caller's responsiblity
+ */
+StridedView<const int> CTDataset::GetIdBuffer() const {
+  return m_idBuffer.View();
+}
+
+/**
+ * @details The ID buffer costs one extra store per hit. If it is disabled, it is reset to background once and
+ * PickVoxel() fails until it is enabled again and the depth buffer is recalculated.
+ * @param enabled Whether CalculateDepthBuffer() and CalculateDepthBufferFromRegionGrowing() write the ID buffer
+ */
+void CTDataset::SetIdBufferEnabled(bool enabled) {
+  m_idBufferEnabled = enabled;
+  if (!enabled) {
+	m_idBuffer.Reset(-1);
+  }
+}
+
+/**
+ * @details Culling only skips points that cannot be seen. The arms of the five-pixel splats are not depth tested, so
+ * without culling the far side of a surface shows through at some pixels.
+ * @param enabled Whether CalculateDepthBufferFromRegionGrowing() rejects clusters that face away or lie outside of the
+ * image
+ */
+void CTDataset::SetClusterCullingEnabled(bool enabled) {
+  m_clusterCullingEnabled = enabled;
+}
+
+/**
+ * @details Constant-time lookup in the ID buffer, so the picked voxel is exact for any rotation of the view and needs
+ * no reprojection of the depth value.
+ * @param x Pixel column of the 3D view
+ * @param y Pixel row of the 3D view
+ * @param voxel Output: voxel coordinates in the original (unrotated) volume
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the pixel is outside of the image or shows background
+ */
+Status CTDataset::PickVoxel(int const x, int const y, Eigen::Vector3i &voxel) const {
+  if (x < 0 || x >= m_imgWidth || y < 0 || y >= m_imgHeight) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  int const id = m_idBuffer.View()(x, y);
+  if (id < 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  int const slice_size = m_imgWidth * m_imgHeight;
+  voxel = Eigen::Vector3i(id % m_imgWidth, (id % slice_size) / m_imgWidth, id / slice_size);
+  return Status(StatusCode::OK);
+}
+
 /**
  * @return Pointer of type int16 to the region growing buffer
  * @attention Null-checks and bounds-checks are caller's responsiblity
@@ -68,26 +395,91 @@ int *CTDataset::GetRegionGrowingBuffer() const {
   return m_regionBuffer;
 }
 
+void CTDataset::SetVoxelSpacing(Eigen::Vector3d const &spacing) {
+  m_voxelSpacing = spacing;
+  m_regionDistance.Clear();
+}
+
+Eigen::Vector3d const &CTDataset::GetVoxelSpacing() const {
+  return m_voxelSpacing;
+}
+
 /**
- * @details Traverses the image and checks, if the depth buffer at the point location has been written to. If yes, aggregates the point into a member vector
+ * @details Exact Euclidean distance transform of the region growing result with the voxel spacing of the dataset.
+ * The field stays valid until the next region growing, load() or SetVoxelSpacing().
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the region growing result is empty
  */
-void CTDataset::CalculateAllRenderedPoints() {
-  m_allRenderedPoints.clear();
+Status CTDataset::ComputeRegionDistanceField() {
+  return m_regionDistance.Build(m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, 1, m_voxelSpacing);
+}
 
-  Eigen::Vector3i rendered_point(0, 0, 0);
-  for (int y = 0; y < m_imgHeight; ++y) {
-	for (int x = 0; x < m_imgWidth; ++x) {
-	  for (int d = 0; d < m_imgLayers; ++d) {
-		int pt = x + y * m_imgWidth + (m_imgHeight * m_imgWidth * d);
-		if (m_depthBuffer[pt] != 0) {
-		  rendered_point.x() = x;
-		  rendered_point.y() = y;
-		  rendered_point.z() = d;
-		  m_allRenderedPoints.push_back(rendered_point);
+/**
+ * @return The distance field of the last ComputeRegionDistanceField() call, empty if it is outdated
+ */
+DistanceField const &CTDataset::GetRegionDistanceField() const {
+  return m_regionDistance;
+}
+
+/**
+ * @param spacing Edge length of the output voxels in mm
+ * @return Axis-aligned grid whose first voxel is the first voxel of the volume, see Resampler::IsotropicGrid()
+ */
+ResampleGrid CTDataset::IsotropicGrid(double const spacing) const {
+  return Resampler::IsotropicGrid(Eigen::Vector3i(m_imgWidth, m_imgHeight, m_imgLayers), m_voxelSpacing, spacing);
+}
+
+/**
+ * @param frame_from_volume Rigid transformation from the mm frame of the volume (voxel (0, 0, 0) at the origin) into
+ * the other frame, e.g. the calibrated device frame
+ * @param spacing Edge length of the output voxels in mm
+ * @return Grid that covers all voxel centers, see Resampler::FrameGrid()
+ */
+ResampleGrid CTDataset::FrameGrid(Eigen::Isometry3d const &frame_from_volume, double const spacing) const {
+  return Resampler::FrameGrid(Eigen::Vector3i(m_imgWidth, m_imgHeight, m_imgLayers), m_voxelSpacing,
+							  frame_from_volume, spacing);
+}
+
+/**
+ * @details Samples the (possibly prefiltered) volume with the voxel spacing of the dataset. Output voxels outside of
+ * the volume are air (-1024 HU). Only one slab of the output is held in memory at a time.
+ * @param grid Output grid, e.g. from IsotropicGrid() or FrameGrid()
+ * @param mode Interpolation between the voxels
+ * @param callback Receives the output slabs in ascending layer order
+ * @return See Resampler::Resample()
+ */
+Status CTDataset::ResampleVolume(ResampleGrid const &grid, InterpolationMode const mode,
+								 Resampler::SlabCallback const &callback) const {
+  return Resampler::Resample(m_voxelData, Eigen::Vector3i(m_imgWidth, m_imgHeight, m_imgLayers), m_voxelSpacing,
+							 grid, mode, -1024, callback);
+}
+
+/**
+ * @param grid Output grid, e.g. from IsotropicGrid() or FrameGrid()
+ * @param mode Interpolation of the mask, see Resampler::ResampleMask()
+ * @param callback Receives the output slabs in ascending layer order, 1 for voxels of the region and 0 for all others
+ * @return See Resampler::ResampleMask()
+ */
+Status CTDataset::ResampleRegion(ResampleGrid const &grid, InterpolationMode const mode,
+								 Resampler::MaskSlabCallback const &callback) const {
+  return Resampler::ResampleMask(m_regionBuffer, Eigen::Vector3i(m_imgWidth, m_imgHeight, m_imgLayers),
+								 m_voxelSpacing, 1, grid, mode, callback);
+}
+
+/**
+ * @details Traverses the depth buffer and aggregates the point seen in every pixel the depth buffer has been written
+ * to (i.e. whose depth is not the background depth) into a member vector, in row order. The rows are spread over the
+ * thread pool.
+ */
+void CTDataset::CalculateAllRenderedPoints() {
+  m_allRenderedPoints = utils::ParallelCollect<Eigen::Vector3i>(
+	  0, m_imgHeight, [this](int y, std::vector<Eigen::Vector3i> &rendered_points) {
+		for (int x = 0; x < m_imgWidth; ++x) {
+		  int const depth = m_depthBuffer.View()(x, y);
+		  if (depth != m_imgLayers - 1) {
+			rendered_points.emplace_back(x, y, depth);
+		  }
 		}
-	  }
-	}
-  }
+	  });
 }
 
 /**
@@ -128,272 +520,1744 @@ StatusOr<int> CTDataset::WindowInputValue(int const input_value, int const cente
 }
 
 /**
- * @details The calculation is accomplished by traversing all image layers for each pixel. If a pixel with an HU
- * value greater than a chosen threshold is reached, its depth value (the number of layer the pixel is on) is written
- * to a buffer. If no value greater than the threshold value was encountered, the maximum depth value is written to
- * the buffer.
- * @param threshold Pixel grey value (HU value) above which the depth value will be buffered.
- * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ * @details The table has one entry per valid HU value (-1024 to 3071) and is filled through WindowInputValue, so
+ * windowing a pixel through the table gives exactly the same result as calling WindowInputValue for it.
+ * @param center The center of the range window
+ * @param window_size The size of the range window in which to normalize the HU values
+ * @param lut Output: 4096 windowed grey values, indexed by HU + 1024
+ * @return StatusCode::OK, or the center/window size error of WindowInputValue
  */
-Status CTDataset::CalculateDepthBuffer(int const threshold) {
-  std::fill_n(m_depthBuffer, m_imgWidth * m_imgHeight, m_imgLayers - 1);
-  m_allRenderedPoints.clear();
-  Eigen::Vector3i rendered_point(0, 0, 0);
-  for (int y = 0; y < m_imgHeight; ++y) {
-	for (int x = 0; x < m_imgWidth; ++x) {
-	  for (int d = 0; d < m_imgLayers; ++d) {
-		int curr_pt = (x + y * m_imgWidth) + (m_imgHeight * m_imgWidth * d);
-		if (m_imgData[curr_pt] >= threshold) {
-		  m_depthBuffer[x + y * m_imgWidth] = d;
-		  rendered_point.x() = x;
-		  rendered_point.y() = y;
-		  rendered_point.z() = d;
-		  m_allRenderedPoints.push_back(rendered_point);
-		  break;
-		}
-	  }
+Status CTDataset::CreateWindowingLUT(int const center, int const window_size, std::vector<uint8_t> &lut) {
+  lut.resize(4096);
+  for (int hu = -1024; hu <= 3071; ++hu) {
+	auto windowed_value = WindowInputValue(hu, center, window_size);
+	if (!windowed_value.Ok()) {
+	  return windowed_value.status();
 	}
-  }
-  if (m_depthBuffer == nullptr) {
-	return Status(StatusCode::BUFFER_EMPTY);
+	lut[hu + 1024] = static_cast<uint8_t>(windowed_value.value());
   }
   return Status(StatusCode::OK);
 }
 
 /**
- * @details Traverses the list of all surface points determined by the region growing algorithm.
- * Checks if the x and y values fall inside the array boundaries and subsequently writes the z-value of the point
- * (it's depth) into the depth buffer
- * @param rotation_mat Rotation matrix determined from the mouse position delta.
- * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ * @details HU values outside of the valid range are clamped to it.
+ * @param input HU values to window
+ * @param count Number of values in input and output
+ * @param lut Lookup table created by CreateWindowingLUT
+ * @param output Windowed grey values
  */
-Status CTDataset::CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d const &rotation_mat) {
-  std::fill_n(m_depthBuffer, m_imgWidth * m_imgHeight, m_imgLayers - 1);
+void CTDataset::ApplyWindowingLUT(const int16_t *input, int const count, std::vector<uint8_t> const &lut,
+								  uint8_t *output) {
+  const uint8_t *table = lut.data();
+  for (int i = 0; i < count; ++i) {
+	int const index = std::min(std::max(static_cast<int>(input[i]) + 1024, 0), 4095);
+	output[i] = table[index];
+  }
+}
 
-  if (m_surfacePoints.empty()) {
-	qDebug() << "No surface points!" << "\n";
-	return Status(StatusCode::BUFFER_EMPTY);
+/**
+ * @details Axial slices are indexed by layer, coronal slices by row and sagittal slices by column. Oblique slices are
+ * indexed by their signed distance to the volume center plus half the volume diagonal, so index GetSliceCount() / 2
+ * cuts through the center.
+ * @param orientation The slice orientation
+ * @return The number of valid slice indices
+ */
+int CTDataset::GetSliceCount(SliceOrientation const orientation) const {
+  switch (orientation) {
+	case SliceOrientation::AXIAL:
+	  return m_imgLayers;
+	case SliceOrientation::CORONAL:
+	  return m_imgHeight;
+	case SliceOrientation::SAGITTAL:
+	  return m_imgWidth;
+	case SliceOrientation::OBLIQUE:
+	  return static_cast<int>(std::ceil(
+		std::sqrt(static_cast<double>(m_imgWidth * m_imgWidth + m_imgHeight * m_imgHeight + m_imgLayers * m_imgLayers))));
   }
+  return 0;
+}
 
-  Eigen::Vector3d pt_rot(0, 0, 0);
-  for (auto &point : m_surfacePoints) {
-	pt_rot = (rotation_mat * (point.cast<double>() - m_regionVolumeCenter)) + m_regionVolumeCenter;
-	auto pt_rot_int = pt_rot.cast<int>();
-	if (pt_rot_int.z() <= m_depthBuffer[pt_rot_int.x() + (pt_rot_int.y() * m_imgWidth)]
-	  && (pt_rot_int.x() >= 0 && pt_rot_int.x() < m_imgWidth)
-	  && (pt_rot_int.y() >= 0 && pt_rot_int.y() < m_imgHeight)) {
-	  m_depthBuffer[pt_rot_int.x() + (pt_rot_int.y() * m_imgWidth)]
-		= m_depthBuffer[(pt_rot_int.x() - 1) + pt_rot_int.y() * m_imgWidth]
-		= m_depthBuffer[(pt_rot_int.x() + 1) + pt_rot_int.y() * m_imgWidth]
-		= m_depthBuffer[pt_rot_int.x() + (pt_rot_int.y() - 1) * m_imgWidth]
-		= m_depthBuffer[pt_rot_int.x() + (pt_rot_int.y() + 1) * m_imgWidth]
-		= pt_rot_int.z();
+/**
+ * @details Axis-aligned slices keep the voxel grid (x runs horizontally in axial and coronal slices, y in sagittal
+ * slices, z runs downwards in coronal and sagittal slices). An oblique slice is the plane perpendicular to the viewing
+ * direction of the 3D render for the given rotation matrix, i.e. the plane that would show up as one depth layer of
+ * the rotated volume.
+ * @param orientation The slice orientation
+ * @param index The slice index, see GetSliceCount()
+ * @param rotation_mat Rotation of the 3D view, only used for SliceOrientation::OBLIQUE
+ * @return The plane geometry in voxel coordinates
+ */
+SlicePlane CTDataset::GetSlicePlane(SliceOrientation const orientation, int const index,
+									Eigen::Matrix3d const &rotation_mat) const {
+  switch (orientation) {
+	case SliceOrientation::CORONAL:
+	  return SlicePlane{Eigen::Vector3d(0, index, 0), Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitZ(),
+						m_imgWidth, m_imgLayers};
+	case SliceOrientation::SAGITTAL:
+	  return SlicePlane{Eigen::Vector3d(index, 0, 0), Eigen::Vector3d::UnitY(), Eigen::Vector3d::UnitZ(),
+						m_imgHeight, m_imgLayers};
+	case SliceOrientation::OBLIQUE: {
+	  Eigen::Vector3d center(0.5 * m_imgWidth, 0.5 * m_imgHeight, 0.5 * m_imgLayers);
+	  Eigen::Vector3d corner(-0.5 * m_imgWidth, -0.5 * m_imgHeight, index - GetSliceCount(orientation) / 2);
+	  Eigen::Matrix3d inverse_rotation = rotation_mat.transpose();
+	  return SlicePlane{inverse_rotation * corner + center, inverse_rotation.col(0), inverse_rotation.col(1),
+						m_imgWidth, m_imgHeight};
 	}
+	case SliceOrientation::AXIAL:
+	default:
+	  return SlicePlane{Eigen::Vector3d(0, 0, index), Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitY(),
+						m_imgWidth, m_imgHeight};
   }
+}
 
-  if (m_depthBuffer == nullptr) {
-	qDebug()
-	  << "Depth buffer empty!" << "\n";
-	return
-	  Status(StatusCode::BUFFER_EMPTY);
+/**
+ * @details The slice is sampled in square tiles that are distributed over all hardware threads. A tile covers a
+ * compact region of the volume, so the voxels (or bricks) it touches stay in cache while the tile is sampled, no
+ * matter how the plane is oriented. Planes that run along the voxel grid are copied exactly, all other planes are
+ * sampled with trilinear interpolation. Samples outside of the volume are air (-1024 HU).
+ * @param plane The plane to sample, see GetSlicePlane()
+ * @param slice Output: plane.width * plane.height HU values, row by row
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the plane has no pixels
+ */
+Status CTDataset::ExtractSlice(SlicePlane const &plane, std::vector<int16_t> &slice) const {
+  if (plane.width <= 0 || plane.height <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
   }
-
-  return
-	Status(StatusCode::OK);
+  slice.resize(static_cast<size_t>(plane.width) * plane.height);
+  if (m_voxelLayout == VoxelLayout::BRICKED) {
+	ExtractSliceImpl(BrickedVoxelAccessor{&m_brickedVolume}, plane, slice.data());
+  } else {
+	ExtractSliceImpl(LinearVoxelAccessor{m_voxelData, m_imgWidth, m_imgWidth * m_imgHeight}, plane, slice.data());
+  }
+  return Status(StatusCode::OK);
 }
 
 /**
- * @details The 3D image is rendered by computing the depth-value gradient in x and y for each pixel (in essence,
- * computing the dot product). The step-size
- * of the algorithm is two, i.e. each pixel is compared to it's left and right as well as it's above and below
- * neighbor. The result is then normalized, multiplied by 255 to yield a valid RGB value and written to an ouput buffer.
- * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ * @details Same as the overload with an output parameter, but the caller receives its own buffer, which is moved out
+ * without a copy.
+ * @param plane The plane to sample, see GetSlicePlane()
+ * @return plane.width * plane.height HU values, or StatusCode::BUFFER_EMPTY if the plane has no pixels
  */
-Status CTDataset::RenderDepthBuffer() {
-  if (m_depthBuffer == nullptr) {
-	qDebug() << "Depth buffer empty!" << "\n";
-	return Status(StatusCode::BUFFER_EMPTY);
+StatusOr<std::vector<int16_t>> CTDataset::ExtractSlice(SlicePlane const &plane) const {
+  std::vector<int16_t> slice;
+  Status stat = ExtractSlice(plane, slice);
+  if (!stat.Ok()) {
+	return StatusOr<std::vector<int16_t>>(stat);
   }
+  return StatusOr<std::vector<int16_t>>(std::move(slice));
+}
 
-  int s_x = 4;
-  int s_y = 4;
-  int T_x = 0;
-  int T_y = 0;
-  double sxTy_sq = 0;
-  double syTx_sq = 0;
-  double denom = 0;
-  double inv = 0;
-  int I_ref = 0;
+template<typename VoxelAccessor>
+void CTDataset::ExtractSliceImpl(VoxelAccessor const &voxel, SlicePlane const &plane, int16_t *slice) const {
+  int const tile = 32;
+  int const tiles_x = (plane.width + tile - 1) / tile;
+  int const tiles_y = (plane.height + tile - 1) / tile;
 
-  double s_x_sq = s_x * s_x;
-  double s_y_sq = s_y * s_y;
-  double s_pow_four = s_x_sq * s_y_sq;
+  auto is_grid_aligned = [](Eigen::Vector3d const &v) {
+	return v.cwiseAbs().sum() == 1.0 && v.cwiseAbs().maxCoeff() == 1.0;
+  };
+  bool const nearest = is_grid_aligned(plane.axis_u) && is_grid_aligned(plane.axis_v)
+	&& plane.origin == plane.origin.array().round().matrix();
 
-  auto n = Eigen::Vector3d::UnitZ();
-  auto s = Eigen::Vector3d(0, 0, s_x * s_y);
+  Eigen::Vector3f const origin = plane.origin.cast<float>();
+  Eigen::Vector3f const axis_u = plane.axis_u.cast<float>();
+  Eigen::Vector3f const axis_v = plane.axis_v.cast<float>();
+  int const max_x = m_imgWidth - 1;
+  int const max_y = m_imgHeight - 1;
+  int const max_z = m_imgLayers - 1;
 
-  for (int y = 0; y < m_imgHeight; ++y) {
-	for (int x = 0; x < m_imgWidth; ++x) {
-	  auto current_point = x + y * m_imgWidth;
-	  T_x = m_depthBuffer[(x + 1) + y * m_imgWidth] - m_depthBuffer[(x - 1) + y * m_imgWidth];
-	  T_y = m_depthBuffer[x + (y + 1) * m_imgWidth] - m_depthBuffer[x + (y - 1) * m_imgWidth];
-	  syTx_sq = s_y_sq * T_x * T_x;
-	  sxTy_sq = s_x_sq * T_y * T_y;
-	  s.x() = -s_y * T_x;
-	  s.y() = -s_x * T_y;
-	  auto nom = 255 * n.dot(s);
-	  denom = std::sqrt(syTx_sq + sxTy_sq + s_pow_four);
-	  inv = 1 / denom;
-	  I_ref = nom * inv;
-	  m_renderedDepthBuffer[current_point] = I_ref;
+  utils::ParallelFor(0, tiles_y, [&](int tile_row) {
+	int const v_begin = tile_row * tile;
+	int const v_end = std::min(v_begin + tile, plane.height);
+	for (int tile_col = 0; tile_col < tiles_x; ++tile_col) {
+	  int const u_begin = tile_col * tile;
+	  int const u_end = std::min(u_begin + tile, plane.width);
+	  for (int v = v_begin; v < v_end; ++v) {
+		int16_t *row = slice + static_cast<size_t>(v) * plane.width;
+		for (int u = u_begin; u < u_end; ++u) {
+		  Eigen::Vector3f p = origin + axis_u * static_cast<float>(u) + axis_v * static_cast<float>(v);
+		  if (p.x() < 0 || p.y() < 0 || p.z() < 0 || p.x() > max_x || p.y() > max_y || p.z() > max_z) {
+			row[u] = -1024;
+			continue;
+		  }
+		  if (nearest) {
+			row[u] = voxel(static_cast<int>(p.x()), static_cast<int>(p.y()), static_cast<int>(p.z()));
+			continue;
+		  }
+		  row[u] = static_cast<int16_t>(std::lround(SampleTrilinear(voxel, p.x(), p.y(), p.z(), max_x, max_y, max_z)));
+		}
+	  }
 	}
-  }
-
-  if (m_renderedDepthBuffer == nullptr) {
-	qDebug() << "Depth buffer couldn't be rendered!" << "\n";
-	return Status(StatusCode::BUFFER_EMPTY);
-  }
-
-  return Status(StatusCode::OK);
-}
-
-int CTDataset::GetGreyValue(Eigen::Vector3i const &pt) const {
-  return m_imgData[(pt.x() + pt.y() * m_imgWidth) + (m_imgHeight * m_imgWidth * pt.z())];
+  });
 }
 
 /**
- * @details Iterate through the region determined by region growing and find points that do not have six neighbors.
- * Construct an Eigen::Vector3i from the coordinates of these surface points.
- * @return StatusCode::OK if the region growin buffer is not empty
+ * @details The projection streams the linear image data with SIMD row operations and is parallelized over the output
+ * rows:
+ * - axial (along z): every output row accumulates the same row of all layers,
+ * - coronal (along y): every output row accumulates all rows of one layer,
+ * - sagittal (along x): every output pixel reduces one contiguous image row.
+ * All reads are sequential, so the projection is bound by memory bandwidth. The output has the size of a slice of the
+ * same orientation and holds HU values that can be windowed with ApplyWindowingLUT.
+ * @param mode The reduction along the rays
+ * @param orientation Orientation of the output image, must not be SliceOrientation::OBLIQUE
+ * @param projection Output: the projected HU values, row by row
+ * @param width Output: width of the projection
+ * @param height Output: height of the projection
+ * @return StatusCode::OK, or StatusCode::SLICE_OUT_OF_RANGE for SliceOrientation::OBLIQUE
  */
-Status CTDataset::FindSurfacePoints() {
-  if (m_regionBuffer == nullptr) {
-	return Status(StatusCode::BUFFER_EMPTY);
+Status CTDataset::CalculateProjection(ProjectionMode const mode, SliceOrientation const orientation,
+									  std::vector<int16_t> &projection, int &width, int &height) const {
+  if (orientation == SliceOrientation::OBLIQUE) {
+	return Status(StatusCode::SLICE_OUT_OF_RANGE);
   }
-  m_surfacePoints.clear();
-  Eigen::Vector3i surface_point(0, 0, 0);
-  Eigen::Vector3i point(0, 0, 0);
 
-  for (int y = 0; y < m_imgHeight; ++y) {
-	for (int x = 0; x < m_imgWidth; ++x) {
-	  for (int d = 0; d < m_imgLayers; ++d) {
-		int current_pos = x + y * m_imgWidth + (m_imgHeight * m_imgWidth * d);
-		point.x() = x;
-		point.y() = y;
-		point.z() = d;
-		if (m_regionBuffer[current_pos] == 1) {
-		  if (MyLib::IsSurfacePoint(m_regionBuffer, point, m_imgWidth, m_imgHeight)) {
-			surface_point.x() = x;
-			surface_point.y() = y;
-			surface_point.z() = d;
-			m_surfacePoints.push_back(surface_point);
-		  }
+  SlicePlane plane = GetSlicePlane(orientation, 0);
+  width = plane.width;
+  height = plane.height;
+  projection.resize(static_cast<size_t>(width) * height);
+  int16_t *output = projection.data();
+
+  int const slice_size = m_imgWidth * m_imgHeight;
+  int const ray_length = (orientation == SliceOrientation::AXIAL) ? m_imgLayers
+	: (orientation == SliceOrientation::CORONAL) ? m_imgHeight : m_imgWidth;
+
+  utils::ParallelFor(0, height, [&](int row) {
+	int16_t *out_row = output + static_cast<size_t>(row) * width;
+
+	if (orientation == SliceOrientation::SAGITTAL) {
+	  // Output row = layer, output column = image row, each pixel reduces one contiguous image row
+	  for (int y = 0; y < width; ++y) {
+		const int16_t *image_row = m_voxelData + static_cast<size_t>(row) * slice_size + y * m_imgWidth;
+		switch (mode) {
+		  case ProjectionMode::MAXIMUM:
+			out_row[y] = simd::ReduceMax(image_row, m_imgWidth);
+			break;
+		  case ProjectionMode::MINIMUM:
+			out_row[y] = simd::ReduceMin(image_row, m_imgWidth);
+			break;
+		  case ProjectionMode::AVERAGE:
+			out_row[y] = static_cast<int16_t>(simd::ReduceSum(image_row, m_imgWidth) / m_imgWidth);
+			break;
 		}
 	  }
+	  return;
 	}
-  }
+
+	// Axial: output row = image row y, rays run over the layers
+	// Coronal: output row = layer z, rays run over the image rows
+	auto image_row = [&](int step) -> const int16_t * {
+	  return (orientation == SliceOrientation::AXIAL)
+			 ? m_voxelData + static_cast<size_t>(step) * slice_size + static_cast<size_t>(row) * m_imgWidth
+			 : m_voxelData + static_cast<size_t>(row) * slice_size + static_cast<size_t>(step) * m_imgWidth;
+	};
+	if (mode == ProjectionMode::AVERAGE) {
+	  std::vector<int32_t> sum(width, 0);
+	  for (int step = 0; step < ray_length; ++step) {
+		simd::SumRow(sum.data(), image_row(step), width);
+	  }
+	  for (int x = 0; x < width; ++x) {
+		out_row[x] = static_cast<int16_t>(sum[x] / ray_length);
+	  }
+	  return;
+	}
+	std::copy_n(image_row(0), width, out_row);
+	for (int step = 1; step < ray_length; ++step) {
+	  if (mode == ProjectionMode::MAXIMUM) {
+		simd::MaxRow(out_row, image_row(step), width);
+	  } else {
+		simd::MinRow(out_row, image_row(step), width);
+	  }
+	}
+  });
+
   return Status(StatusCode::OK);
 }
 
 /**
- * @details Iterate through all points in the RG buffer and sum up their respective coordinates and take the average.
- * @return StatusCode::OK if the region growin buffer is not empty
+ * @details Uses the same geometry as the rotated 3D render and the oblique slices: output pixel (u, v) is the ray
+ * through the rotated volume at (u, v) that runs along the viewing direction. Every ray is clipped to the volume and
+ * sampled once per voxel length (nearest neighbour) through the active voxel layout, rays are distributed over all
+ * hardware threads. Rays that miss the volume are air (-1024 HU). Without rotation the streaming axial projection of
+ * CalculateProjection is used instead.
+ * @param mode The reduction along the rays
+ * @param rotation_mat Rotation of the 3D view
+ * @param projection Output: width * height projected HU values, row by row
+ * @return StatusCode::OK
  */
-Status CTDataset::FindPointCloudCenter() {
-  AggregatePointsInRegion();
-  if (m_allPointsInRegion.empty()) {
-	return Status(StatusCode::BUFFER_EMPTY);
+Status CTDataset::CalculateRotatedProjection(ProjectionMode const mode, Eigen::Matrix3d const &rotation_mat,
+											 std::vector<int16_t> &projection) const {
+  if (rotation_mat.isIdentity(1e-12)) {
+	int width = 0;
+	int height = 0;
+	return CalculateProjection(mode, SliceOrientation::AXIAL, projection, width, height);
   }
 
-  int64_t x_tot = 0;
-  int64_t y_tot = 0;
-  int64_t z_tot = 0;
-  for (auto &pt : m_allPointsInRegion) {
-	x_tot += pt.x();
-	y_tot += pt.y();
-	z_tot += pt.z();
+  projection.resize(static_cast<size_t>(m_imgWidth) * m_imgHeight);
+  if (m_voxelLayout == VoxelLayout::BRICKED) {
+	CalculateRotatedProjectionImpl(BrickedVoxelAccessor{&m_brickedVolume}, mode, rotation_mat, projection.data());
+  } else {
+	CalculateRotatedProjectionImpl(LinearVoxelAccessor{m_voxelData, m_imgWidth, m_imgWidth * m_imgHeight}, mode,
+								   rotation_mat, projection.data());
   }
-
-  auto region_size = static_cast<double>(m_allPointsInRegion.size());
-
-  m_regionVolumeCenter = Eigen::Vector3d(static_cast<double>(x_tot) / region_size,
-										 static_cast<double>(y_tot) / region_size,
-										 static_cast<double>(z_tot) / region_size);
-
   return Status(StatusCode::OK);
 }
 
 /**
- * @details Implementation of an interative region growing algorithm. Start with an initial seed, neighboring pixel
- * are determined and checked in turn for if their HU value is greater than the threshold. If yes, they are added
- * to the region. If not, they are simply marked as visited and not added to the region. Once all neighbors have been
- * checked, the next seed is determined as the last checked neighbor and the algorithm starts again. It terminates once
- * no new pixel are available. Once completed, the surface points of the region as well as the barycenter of the region
- * are determined.
- * @param seed User-picked initial seed point of the algorithm
- * @param threshold HU value above which points will be added to the region
+ * @param mode The reduction along the rays
+ * @param rotation_mat Rotation of the 3D view
+ * @return width * height projected HU values, row by row, in a buffer owned by the caller
  */
-void CTDataset::RegionGrowing3D(Eigen::Vector3i &seed, int const threshold) {
-  std::fill_n(m_regionBuffer, m_imgHeight * m_imgWidth * m_imgLayers, 0);
-  std::cout << "Starting region growing algorithm!" << "\n";
-  auto t1 = std::chrono::high_resolution_clock::now();
+StatusOr<std::vector<int16_t>> CTDataset::CalculateRotatedProjection(ProjectionMode const mode,
+																	 Eigen::Matrix3d const &rotation_mat) const {
+  std::vector<int16_t> projection;
+  Status stat = CalculateRotatedProjection(mode, rotation_mat, projection);
+  if (!stat.Ok()) {
+	return StatusOr<std::vector<int16_t>>(stat);
+  }
+  return StatusOr<std::vector<int16_t>>(std::move(projection));
+}
 
-  std::stack<Eigen::Vector3i> stack;
-  std::vector<Eigen::Vector3i> neighbors;
-
-  stack.push(seed);
-  while (!stack.empty()) {
-	m_regionBuffer[seed.x() + seed.y() * m_imgWidth + (m_imgHeight * m_imgWidth * seed.z())] = 1;
-	stack.pop();
-
-	MyLib::FindNeighbors3D(seed, neighbors);
-	for (auto &nb : neighbors) {
-	  // 0: Voxel has not been visited
-	  if (m_regionBuffer[nb.x() + nb.y() * m_imgWidth + (m_imgHeight * m_imgWidth * nb.z())] == 0) {
-		// 2: Voxel has been visited
-		m_regionBuffer[nb.x() + nb.y() * m_imgWidth + (m_imgHeight * m_imgWidth * nb.z())] = 2;
-		if (GetGreyValue(nb) >= threshold) {
-		  // 1: Voxel belongs to region
-		  m_regionBuffer[nb.x() + nb.y() * m_imgWidth + (m_imgHeight * m_imgWidth * nb.z())] = 1;
-		  stack.push(nb);
+template<typename VoxelAccessor>
+void CTDataset::CalculateRotatedProjectionImpl(VoxelAccessor const &voxel, ProjectionMode const mode,
+											   Eigen::Matrix3d const &rotation_mat, int16_t *projection) const {
+  Eigen::Vector3d const center(0.5 * m_imgWidth, 0.5 * m_imgHeight, 0.5 * m_imgLayers);
+  Eigen::Matrix3d const inverse_rotation = rotation_mat.transpose();
+  Eigen::Vector3d const direction = inverse_rotation.col(2);
+  Eigen::Vector3d const lower(0, 0, 0);
+  Eigen::Vector3d const upper(m_imgWidth - 1, m_imgHeight - 1, m_imgLayers - 1);
+  double const half_diagonal = 0.5 * GetSliceCount(SliceOrientation::OBLIQUE);
+
+  utils::ParallelFor(0, m_imgHeight, [&](int v) {
+	for (int u = 0; u < m_imgWidth; ++u) {
+	  // Start of the ray in front of the volume, t runs along the viewing direction
+	  Eigen::Vector3d origin = inverse_rotation * (Eigen::Vector3d(u, v, center.z() - half_diagonal) - center) + center;
+
+	  // Slab test against the volume box
+	  double t_near = 0.0;
+	  double t_far = 2.0 * half_diagonal;
+	  for (int axis = 0; axis < 3; ++axis) {
+		if (std::abs(direction[axis]) < 1e-12) {
+		  if (origin[axis] < lower[axis] || origin[axis] > upper[axis]) {
+			t_near = t_far + 1.0;
+		  }
+		  continue;
 		}
+		double t0 = (lower[axis] - origin[axis]) / direction[axis];
+		double t1 = (upper[axis] - origin[axis]) / direction[axis];
+		t_near = std::max(t_near, std::min(t0, t1));
+		t_far = std::min(t_far, std::max(t0, t1));
 	  }
-	}
-	if (!stack.empty()) {
-	  seed = stack.top();
+
+	  int16_t *out = projection + u + static_cast<size_t>(v) * m_imgWidth;
+	  if (t_near > t_far) {
+		*out = -1024;
+		continue;
+	  }
+
+	  int const steps = static_cast<int>(t_far - t_near) + 1;
+	  Eigen::Vector3f p = (origin + t_near * direction).cast<float>();
+	  Eigen::Vector3f const step = direction.cast<float>();
+	  int result = (mode == ProjectionMode::MINIMUM) ? INT16_MAX : INT16_MIN;
+	  int64_t sum = 0;
+	  int count = 0;
+	  for (int i = 0; i < steps; ++i, p += step) {
+		int const x = static_cast<int>(p.x() + 0.5f);
+		int const y = static_cast<int>(p.y() + 0.5f);
+		int const z = static_cast<int>(p.z() + 0.5f);
+		if (x < 0 || y < 0 || z < 0 || x >= m_imgWidth || y >= m_imgHeight || z >= m_imgLayers) {
+		  continue;
+		}
+		int const value = voxel(x, y, z);
+		result = (mode == ProjectionMode::MINIMUM) ? std::min(result, value) : std::max(result, value);
+		sum += value;
+		++count;
+	  }
+	  if (count == 0) {
+		*out = -1024;
+	  } else if (mode == ProjectionMode::AVERAGE) {
+		*out = static_cast<int16_t>(sum / count);
+	  } else {
+		*out = static_cast<int16_t>(result);
+	  }
+	}
+  });
+}
+
+/**
+ * @details Colour and opacity are interpolated linearly between neighbouring control points and held constant below
+ * the first and above the last control point.
+ * @param points Control points, sorted by HU value
+ * @param lut Output: 4096 entries, indexed by HU + 1024
+ * @return StatusCode::OK, or StatusCode::TRANSFER_FUNCTION_ERROR if there are no control points or they are not
+ * sorted
+ */
+Status CTDataset::CreateTransferFunctionLUT(std::vector<TransferFunctionPoint> const &points,
+											std::vector<TransferFunctionEntry> &lut) {
+  if (points.empty()) {
+	return Status(StatusCode::TRANSFER_FUNCTION_ERROR);
+  }
+  for (size_t i = 1; i < points.size(); ++i) {
+	if (points[i].hu < points[i - 1].hu) {
+	  return Status(StatusCode::TRANSFER_FUNCTION_ERROR);
 	}
   }
 
-  if (FindSurfacePoints().Ok()) {
-	std::cout << m_surfacePoints.size() << " surface points calculated!" << "\n";
+  lut.resize(4096);
+  size_t segment = 0;
+  for (int hu = -1024; hu <= 3071; ++hu) {
+	while (segment + 1 < points.size() && points[segment + 1].hu <= hu) {
+	  ++segment;
+	}
+	TransferFunctionPoint const &lower = points[segment];
+	TransferFunctionPoint const &upper = points[std::min(segment + 1, points.size() - 1)];
+	float f = 0.0f;
+	if (upper.hu > lower.hu && hu > lower.hu) {
+	  f = std::min(1.0f, static_cast<float>(hu - lower.hu) / static_cast<float>(upper.hu - lower.hu));
+	}
+	lut[hu + 1024] = TransferFunctionEntry{lower.red + f * (upper.red - lower.red),
+										   lower.green + f * (upper.green - lower.green),
+										   lower.blue + f * (upper.blue - lower.blue),
+										   lower.opacity + f * (upper.opacity - lower.opacity)};
   }
-  if (FindPointCloudCenter().Ok()) {
-	std::cout << m_allPointsInRegion.size() << " total points in the region!" << "\n";
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @return Air and fat are transparent, soft tissue is a faint red and bone is an opaque off-white.
+ */
+std::vector<TransferFunctionPoint> CTDataset::DefaultTransferFunction() {
+  return {TransferFunctionPoint{-1024, 0.0f, 0.0f, 0.0f, 0.0f},
+		  TransferFunctionPoint{-100, 0.0f, 0.0f, 0.0f, 0.0f},
+		  TransferFunctionPoint{40, 0.8f, 0.35f, 0.3f, 0.01f},
+		  TransferFunctionPoint{150, 0.9f, 0.6f, 0.5f, 0.02f},
+		  TransferFunctionPoint{300, 1.0f, 0.95f, 0.85f, 0.3f},
+		  TransferFunctionPoint{1000, 1.0f, 1.0f, 1.0f, 0.9f}};
+}
+
+/**
+ * @details Emission-absorption ray casting with the geometry of the rotated 3D render (see
+ * CalculateRotatedProjection()). Every ray is sampled once per voxel length with trilinear interpolation, the sample
+ * is classified through the transfer function lookup table and composited front to back. A ray stops as soon as its
+ * accumulated opacity reaches 98 % (early ray termination).
+ * Empty space is skipped brick by brick: a brick whose value range maps to zero opacity is left in a single step.
+ * The image is rendered in 16x16 pixel tiles that are distributed over all hardware threads.
+ * @param transfer_lut Lookup table created by CreateTransferFunctionLUT
+ * @param rotation_mat Rotation of the 3D view
+ * @param image Output: width * height pixels, packed as 0xffRRGGBB (the QRgb layout)
+ * @return StatusCode::OK, StatusCode::TRANSFER_FUNCTION_ERROR for an invalid lookup table or
+ * StatusCode::BUFFER_EMPTY if the brick value ranges have not been computed (see RebuildVoxelLayout())
+ */
+Status CTDataset::RenderVolume(std::vector<TransferFunctionEntry> const &transfer_lut,
+							   Eigen::Matrix3d const &rotation_mat, std::vector<uint32_t> &image) const {
+  if (transfer_lut.size() != 4096) {
+	return Status(StatusCode::TRANSFER_FUNCTION_ERROR);
+  }
+  if (m_brickMin.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  // A brick is visible if any HU value in its range has a non-zero opacity
+  std::vector<int> visible_prefix(4097, 0);
+  for (int i = 0; i < 4096; ++i) {
+	visible_prefix[i + 1] = visible_prefix[i] + (transfer_lut[i].opacity > 0.0f ? 1 : 0);
+  }
+  std::vector<uint8_t> brick_visible(m_brickMin.size());
+  for (size_t brick = 0; brick < brick_visible.size(); ++brick) {
+	int const lo = std::min(std::max(m_brickMin[brick] + 1024, 0), 4095);
+	int const hi = std::min(std::max(m_brickMax[brick] + 1024, 0), 4095);
+	brick_visible[brick] = (lo <= hi && visible_prefix[hi + 1] - visible_prefix[lo] > 0) ? 1 : 0;
+  }
+
+  image.resize(static_cast<size_t>(m_imgWidth) * m_imgHeight);
+  if (m_voxelLayout == VoxelLayout::BRICKED) {
+	RenderVolumeImpl(BrickedVoxelAccessor{&m_brickedVolume}, transfer_lut, brick_visible, rotation_mat, image.data());
+  } else {
+	RenderVolumeImpl(LinearVoxelAccessor{m_voxelData, m_imgWidth, m_imgWidth * m_imgHeight}, transfer_lut,
+					 brick_visible, rotation_mat, image.data());
+  }
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @param transfer_lut Lookup table created by CreateTransferFunctionLUT
+ * @param rotation_mat Rotation of the 3D view
+ * @return width * height pixels packed as 0xffRRGGBB in a buffer owned by the caller, or the error of the overload
+ * with an output parameter
+ */
+StatusOr<std::vector<uint32_t>> CTDataset::RenderVolume(std::vector<TransferFunctionEntry> const &transfer_lut,
+														Eigen::Matrix3d const &rotation_mat) const {
+  std::vector<uint32_t> image;
+  Status stat = RenderVolume(transfer_lut, rotation_mat, image);
+  if (!stat.Ok()) {
+	return StatusOr<std::vector<uint32_t>>(stat);
+  }
+  return StatusOr<std::vector<uint32_t>>(std::move(image));
+}
+
+template<typename VoxelAccessor>
+void CTDataset::RenderVolumeImpl(VoxelAccessor const &voxel, std::vector<TransferFunctionEntry> const &transfer_lut,
+								 std::vector<uint8_t> const &brick_visible, Eigen::Matrix3d const &rotation_mat,
+								 uint32_t *image) const {
+  int const shift = BrickedVolume::kBrickShift;
+  int const edge = BrickedVolume::kBrickEdge;
+  int const bricks_x = (m_imgWidth + edge - 1) >> shift;
+  int const bricks_y = (m_imgHeight + edge - 1) >> shift;
+  int const max_x = m_imgWidth - 1;
+  int const max_y = m_imgHeight - 1;
+  int const max_z = m_imgLayers - 1;
+
+  Eigen::Vector3d const center(0.5 * m_imgWidth, 0.5 * m_imgHeight, 0.5 * m_imgLayers);
+  Eigen::Matrix3d const inverse_rotation = rotation_mat.transpose();
+  Eigen::Vector3d const direction = inverse_rotation.col(2);
+  Eigen::Vector3d const upper(max_x, max_y, max_z);
+  double const half_diagonal = 0.5 * GetSliceCount(SliceOrientation::OBLIQUE);
+  float const termination_opacity = 0.98f;
+
+  int const tile = 16;
+  int const tiles_x = (m_imgWidth + tile - 1) / tile;
+  int const tiles_y = (m_imgHeight + tile - 1) / tile;
+
+  utils::ParallelFor(0, tiles_x * tiles_y, [&](int tile_index) {
+	int const u_begin = (tile_index % tiles_x) * tile;
+	int const v_begin = (tile_index / tiles_x) * tile;
+	int const u_end = std::min(u_begin + tile, m_imgWidth);
+	int const v_end = std::min(v_begin + tile, m_imgHeight);
+
+	for (int v = v_begin; v < v_end; ++v) {
+	  for (int u = u_begin; u < u_end; ++u) {
+		Eigen::Vector3d origin =
+		  inverse_rotation * (Eigen::Vector3d(u, v, center.z() - half_diagonal) - center) + center;
+
+		// Slab test against the volume box
+		double t_near = 0.0;
+		double t_far = 2.0 * half_diagonal;
+		for (int axis = 0; axis < 3; ++axis) {
+		  if (std::abs(direction[axis]) < 1e-12) {
+			if (origin[axis] < 0.0 || origin[axis] > upper[axis]) {
+			  t_near = t_far + 1.0;
+			}
+			continue;
+		  }
+		  double t0 = -origin[axis] / direction[axis];
+		  double t1 = (upper[axis] - origin[axis]) / direction[axis];
+		  t_near = std::max(t_near, std::min(t0, t1));
+		  t_far = std::min(t_far, std::max(t0, t1));
+		}
+
+		float red = 0.0f;
+		float green = 0.0f;
+		float blue = 0.0f;
+		float alpha = 0.0f;
+		double t = t_near;
+		while (t <= t_far && alpha < termination_opacity) {
+		  Eigen::Vector3d p = origin + t * direction;
+		  int const x = std::min(std::max(static_cast<int>(p.x()), 0), max_x);
+		  int const y = std::min(std::max(static_cast<int>(p.y()), 0), max_y);
+		  int const z = std::min(std::max(static_cast<int>(p.z()), 0), max_z);
+		  size_t const brick = (x >> shift) + static_cast<size_t>(y >> shift) * bricks_x
+			+ static_cast<size_t>(z >> shift) * bricks_x * bricks_y;
+
+		  if (!brick_visible[brick]) {
+			// Jump to the first sample position behind the brick
+			int const cell[3] = {x >> shift, y >> shift, z >> shift};
+			double t_exit = std::numeric_limits<double>::max();
+			for (int axis = 0; axis < 3; ++axis) {
+			  if (direction[axis] > 1e-12) {
+				t_exit = std::min(t_exit, ((cell[axis] + 1) * edge - p[axis]) / direction[axis]);
+			  } else if (direction[axis] < -1e-12) {
+				t_exit = std::min(t_exit, (cell[axis] * edge - p[axis]) / direction[axis]);
+			  }
+			}
+			t = t_near + std::floor(t + std::max(t_exit, 0.0) - t_near) + 1.0;
+			continue;
+		  }
+
+		  float const value = SampleTrilinear(voxel, static_cast<float>(p.x()), static_cast<float>(p.y()),
+											  static_cast<float>(p.z()), max_x, max_y, max_z);
+		  int const index = std::min(std::max(static_cast<int>(std::lround(value)) + 1024, 0), 4095);
+		  TransferFunctionEntry const &sample = transfer_lut[index];
+		  if (sample.opacity > 0.0f) {
+			float const weight = (1.0f - alpha) * sample.opacity;
+			red += weight * sample.red;
+			green += weight * sample.green;
+			blue += weight * sample.blue;
+			alpha += weight;
+		  }
+		  t += 1.0;
+		}
+
+		auto to_byte = [](float c) { return static_cast<uint32_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+		image[u + static_cast<size_t>(v) * m_imgWidth] =
+		  0xff000000u | (to_byte(red) << 16) | (to_byte(green) << 8) | to_byte(blue);
+	  }
+	}
+  });
+}
+
+/**
+ * @details The calculation is accomplished by traversing all image layers for each pixel. If a pixel with an HU
+ * value greater than a chosen threshold is reached, its depth value (the number of layer the pixel is on) is written
+ * to a buffer. If no value greater than the threshold value was encountered, the maximum depth value is written to
+ * the buffer. The ID buffer receives the linear index of the hit voxel.
+ * @param threshold Pixel grey value (HU value) above which the depth value will be buffered.
+ * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ */
+Status CTDataset::CalculateDepthBuffer(int const threshold) {
+  m_depthBuffer.Reset(m_imgLayers - 1);
+  m_idBuffer.Reset(-1);
+  m_viewRotation.setIdentity();
+  m_pointBufferValid = false;
+  m_normalBufferValid = !m_normalVolume.Empty();
+  m_allRenderedPoints.clear();
+  if (m_voxelLayout == VoxelLayout::BRICKED) {
+	CalculateDepthBufferImpl(BrickedVoxelAccessor{&m_brickedVolume}, threshold);
+  } else {
+	CalculateDepthBufferImpl(LinearVoxelAccessor{m_voxelData, m_imgWidth, m_imgWidth * m_imgHeight}, threshold);
+  }
+  if (m_depthBuffer.Empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The rays are cast in tiles of one brick edge squared, so that the rays of a tile walk down the same column
+ * of bricks and each brick is fetched from memory only once per tile. The rows of tiles are spread over the thread
+ * pool; the rendered points of every row of tiles are concatenated in order, as in a sequential loop.
+ * @param voxel Accessor for the active voxel layout
+ * @param threshold Pixel grey value (HU value) above which the depth value will be buffered.
+ */
+template<typename VoxelAccessor>
+void CTDataset::CalculateDepthBufferImpl(VoxelAccessor const &voxel, int const threshold) {
+  int const tile = BrickedVolume::kBrickEdge;
+  int const slice_size = m_imgWidth * m_imgHeight;
+  int const tile_rows = (m_imgHeight + tile - 1) / tile;
+  m_allRenderedPoints = utils::ParallelCollect<Eigen::Vector3i>(
+	  0, tile_rows, [&](int tile_row, std::vector<Eigen::Vector3i> &rendered_points) {
+		int const tile_y = tile_row * tile;
+		int const y_end = std::min(tile_y + tile, m_imgHeight);
+		for (int tile_x = 0; tile_x < m_imgWidth; tile_x += tile) {
+		  int const x_end = std::min(tile_x + tile, m_imgWidth);
+		  for (int y = tile_y; y < y_end; ++y) {
+			for (int x = tile_x; x < x_end; ++x) {
+			  for (int d = 0; d < m_imgLayers; ++d) {
+				if (voxel(x, y, d) >= threshold) {
+				  m_depthBuffer.View()(x, y) = d;
+				  if (m_idBufferEnabled) {
+					m_idBuffer.View()(x, y) = x + y * m_imgWidth + d * slice_size;
+				  }
+				  if (m_normalBufferValid) {
+					m_normalBuffer.View()(x, y) = m_normalVolume.At(x, y, d);
+				  }
+				  rendered_points.emplace_back(x, y, d);
+				  break;
+				}
+			  }
+			}
+		  }
+		}
+	  });
+}
+
+/**
+ * @details Checks if the x and y values of the rotated point fall inside the image and writes its z-value (its depth)
+ * into the depth buffer and its index into the point buffer if it is not behind the depth already there. The point is
+ * splatted as a cross of five pixels. Only the center is checked against the image; the arms of a cross on the image
+ * border land in the guard band of the buffers, so they need no checks of their own. The ID and normal of the point
+ * are looked up for the visible points only, see ResolveSurfaceBuffers().
+ * @param rotation_mat Rotation of the view
+ * @param index Index of the point into m_surfacePoints
+ */
+void CTDataset::SplatSurfacePoint(Eigen::Matrix3d const &rotation_mat, uint32_t const index) {
+  Eigen::Vector3i const &point = m_surfacePoints[index];
+  Eigen::Vector3d const pt_rot = (rotation_mat * (point.cast<double>() - m_regionVolumeCenter)) + m_regionVolumeCenter;
+  auto pt_rot_int = pt_rot.cast<int>();
+  if (!m_depthBuffer.View().Contains(pt_rot_int.x(), pt_rot_int.y())) {
+	return;
+  }
+  // The buffers share their extent and guard, so one offset addresses a pixel in all of them
+  int64_t const row_stride = m_depthBuffer.View().row_stride;
+  std::array<int64_t, 5> const cross{0, -1, 1, -row_stride, row_stride};
+  int64_t const center = m_depthBuffer.View().Offset(pt_rot_int.x(), pt_rot_int.y());
+  int *const depth = m_depthBuffer.View().origin;
+  if (pt_rot_int.z() > depth[center]) {
+	return;
+  }
+  for (int64_t const arm : cross) {
+	depth[center + arm] = pt_rot_int.z();
+  }
+  int *const points = m_pointBuffer.View().origin;
+  for (int64_t const arm : cross) {
+	points[center + arm] = static_cast<int>(index);
+  }
+}
+
+/**
+ * @details The points are gathered from m_surfacePoints through the order of the clusters.
+ * @param rotation_mat Rotation of the view
+ * @param cluster Index into m_surfaceClusters
+ * @return Number of points of the cluster
+ */
+size_t CTDataset::SplatSurfaceCluster(Eigen::Matrix3d const &rotation_mat, int const cluster) {
+  SurfaceCluster const &entry = m_surfaceClusters.Clusters()[cluster];
+  std::vector<uint32_t> const &order = m_surfaceClusters.Order();
+  for (uint32_t k = entry.begin; k < entry.end; ++k) {
+	SplatSurfacePoint(rotation_mat, order[k]);
+  }
+  return entry.end - entry.begin;
+}
+
+/**
+ * @details Traverses the list of all surface points determined by the region growing algorithm and splats them as
+ * crosses of five pixels, see SplatSurfacePoint(). The points are visited cluster by cluster (see SurfaceClusters),
+ * and clusters whose normal cone faces away from the viewer or whose bounding sphere lies outside of the image are
+ * skipped as a whole. On a closed surface that is close to half of the points. The point buffer the splats write
+ * lets UpdateDepthBufferFromRegionGrowing() reproject the frame, and ResolveSurfaceBuffers() looks up the IDs and
+ * normals of the visible points.
+ * @param rotation_mat Rotation matrix determined from the mouse position delta.
+ * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ */
+Status CTDataset::CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d const &rotation_mat) {
+  if (!m_surfaceResultsValid) {
+	UpdateSurfaceResults();
+  }
+  m_depthBuffer.Reset(m_imgLayers - 1);
+  m_pointBuffer.Reset(-1);
+  m_viewRotation = rotation_mat;
+  m_normalBufferValid = m_surfaceNormals.size() == m_surfacePoints.size() || !m_normalVolume.Empty();
+  m_pointBufferValid = false;
+  m_framesSinceRefresh = 0;
+
+  if (m_surfacePoints.empty()) {
+	m_idBuffer.Reset(-1);
+	qDebug() << "No surface points!" << "\n";
+	return Status(StatusCode::BUFFER_EMPTY);
   }
 
+  size_t projected = 0;
+  // The clusters are stale if the surface points were recomputed without them
+  if (m_clusterCullingEnabled && m_clusterGeneration == m_surfaceGeneration) {
+	Eigen::Matrix3f const rotation = rotation_mat.cast<float>();
+	Eigen::Vector3f const rotation_center = m_regionVolumeCenter.cast<float>();
+	std::vector<SurfaceCluster> const &clusters = m_surfaceClusters.Clusters();
+	for (size_t c = 0; c < clusters.size(); ++c) {
+	  if (SurfaceClusters::MayBeVisible(clusters[c], rotation, rotation_center, m_imgWidth, m_imgHeight, m_imgLayers)) {
+		projected += SplatSurfaceCluster(rotation_mat, static_cast<int>(c));
+	  }
+	}
+  } else {
+	for (size_t i = 0; i < m_surfacePoints.size(); ++i) {
+	  SplatSurfacePoint(rotation_mat, static_cast<uint32_t>(i));
+	}
+	projected = m_surfacePoints.size();
+  }
+  m_pointSeen.assign(m_surfacePoints.size(), 0);
+  ResolveSurfaceBuffers();
+  m_pointBufferValid = true;
+  m_temporalStats = TemporalSplatStats{true, 0, 0, projected};
+
+  if (m_depthBuffer.Empty()) {
+	qDebug()
+	  << "Depth buffer empty!" << "\n";
+	return
+	  Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  return
+	Status(StatusCode::OK);
+}
+
+/**
+ * @details While the view is dragged, consecutive rotations differ by a degree or two, so the frame changes little
+ * apart from the silhouette and the surfaces that the rotation uncovers. The frame is built in three passes:
+ * - Every point seen in a pixel since the last frame splatted from scratch, as flagged in m_pointSeen, is splatted
+ *   once under the new rotation. This reprojects the previous frames from the exact voxel positions, so no error
+ *   builds up from frame to frame, and the hidden surfaces cost nothing. A point that the neighbouring crosses hide in
+ *   one frame stays flagged, so it is back once the view turns towards it again.
+ * - Pinholes and cracks that the crosses of the reprojected points leave between them are closed, see
+ *   FillPinholesAndCountTiles(). Background pixels that the previous frame covered are gaps: the surface moved away
+ *   from them and left them to one that was hidden or back-facing before.
+ * - The image is split into tiles of kTemporalTileSize pixels. Tiles with at least a row of gap pixels are stale, and
+ *   so are the empty tiles within the distance the region moves in this frame and the tiles on the image border. The
+ *   clusters in the view that overlap a stale tile are splatted again, except for their reprojected points.
+ *
+ * The cost of a frame thus scales with the visible points and the gaps instead of the surface size. The pinholes
+ * differ from a frame splatted from scratch, and a silhouette that grows into the background away from any gap is
+ * only caught up with by the next frame from scratch, so CalculateDepthBufferFromRegionGrowing() starts from scratch
+ * every kTemporalRefreshFrames frames, for rotations above kTemporalMaxAngle, after any other depth buffer, and without
+ * clusters.
+ * @param rotation_mat Rotation of the view, usually close to that of the previous frame
+ * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ */
+Status CTDataset::UpdateDepthBufferFromRegionGrowing(Eigen::Matrix3d const &rotation_mat) {
+  double const angle = Eigen::AngleAxisd(rotation_mat * m_viewRotation.transpose()).angle();
+  if (!m_pointBufferValid || !m_clusterCullingEnabled || m_clusterGeneration != m_surfaceGeneration
+	|| angle > kTemporalMaxAngle || m_framesSinceRefresh >= kTemporalRefreshFrames) {
+	return CalculateDepthBufferFromRegionGrowing(rotation_mat);
+  }
+  ++m_framesSinceRefresh;
+  m_previousPointBuffer.Swap(m_pointBuffer);
+  m_depthBuffer.Reset(m_imgLayers - 1);
+  m_pointBuffer.Reset(-1);
+  m_viewRotation = rotation_mat;
+  m_normalBufferValid = m_surfaceNormals.size() == m_surfacePoints.size() || !m_normalVolume.Empty();
+
+  // The flags are visited in the order of m_surfacePoints, so the points are read in memory order
+  size_t reprojected = 0;
+  for (size_t index = 0; index < m_pointSeen.size(); ++index) {
+	if (m_pointSeen[index] != 0) {
+	  SplatSurfacePoint(rotation_mat, static_cast<uint32_t>(index));
+	  ++reprojected;
+	}
+  }
+  TemporalSplatStats stats{false, reprojected, 0, reprojected};
+
+  int const tiles_x = (m_imgWidth + kTemporalTileSize - 1) / kTemporalTileSize;
+  int const tiles_y = (m_imgHeight + kTemporalTileSize - 1) / kTemporalTileSize;
+  std::vector<int> covered(static_cast<size_t>(tiles_x) * tiles_y, 0);
+  std::vector<int> gaps(covered.size(), 0);
+  FillPinholesAndCountTiles(covered, gaps);
+
+  // Points move by at most the angle times their distance from the rotation center
+  Eigen::Matrix3f const rotation = rotation_mat.cast<float>();
+  Eigen::Vector3f const rotation_center = m_regionVolumeCenter.cast<float>();
+  std::vector<SurfaceCluster> const &clusters = m_surfaceClusters.Clusters();
+  std::vector<uint32_t> const &order = m_surfaceClusters.Order();
+  float extent = 0.0f;
+  for (SurfaceCluster const &cluster : clusters) {
+	extent = std::max(extent, (cluster.center - rotation_center).norm() + cluster.radius);
+  }
+  int const grow = static_cast<int>(std::ceil(angle * extent / kTemporalTileSize));
+  m_staleTiles.assign(covered.size(), 0);
+  for (int tile_y = 0; tile_y < tiles_y; ++tile_y) {
+	for (int tile_x = 0; tile_x < tiles_x; ++tile_x) {
+	  size_t const tile = tile_x + static_cast<size_t>(tile_y) * tiles_x;
+	  if (tile_x == 0 || tile_y == 0 || tile_x == tiles_x - 1 || tile_y == tiles_y - 1) {
+		m_staleTiles[tile] = 1;
+	  }
+	  if (gaps[tile] < kTemporalTileSize) {
+		continue;
+	  }
+	  m_staleTiles[tile] = 1;
+	  for (int y = std::max(tile_y - grow, 0); y <= std::min(tile_y + grow, tiles_y - 1); ++y) {
+		for (int x = std::max(tile_x - grow, 0); x <= std::min(tile_x + grow, tiles_x - 1); ++x) {
+		  m_staleTiles[x + static_cast<size_t>(y) * tiles_x] |= covered[x + static_cast<size_t>(y) * tiles_x] == 0;
+		}
+	  }
+	}
+  }
+  stats.stale_tiles = static_cast<int>(std::count(m_staleTiles.begin(), m_staleTiles.end(), 1));
+
+  // Pixels are truncated, so the points of a cluster land up to one pixel beyond its sphere
+  auto tile_range = [](float center, float radius, int tiles, int &begin, int &end) {
+	begin = std::min(std::max(static_cast<int>(std::floor((center - radius - 1.0f) / kTemporalTileSize)), 0),
+					 tiles - 1);
+	end = std::min(std::max(static_cast<int>(std::floor((center + radius + 1.0f) / kTemporalTileSize)), 0),
+				   tiles - 1);
+  };
+  auto overlaps_stale_tile = [&](SurfaceCluster const &cluster) {
+	Eigen::Vector3f const center = rotation * (cluster.center - rotation_center) + rotation_center;
+	int x_begin, x_end, y_begin, y_end;
+	tile_range(center.x(), cluster.radius, tiles_x, x_begin, x_end);
+	tile_range(center.y(), cluster.radius, tiles_y, y_begin, y_end);
+	for (int tile_y = y_begin; tile_y <= y_end; ++tile_y) {
+	  for (int tile_x = x_begin; tile_x <= x_end; ++tile_x) {
+		if (m_staleTiles[tile_x + static_cast<size_t>(tile_y) * tiles_x] != 0) {
+		  return true;
+		}
+	  }
+	}
+	return false;
+  };
+  for (size_t c = 0; c < clusters.size(); ++c) {
+	if (SurfaceClusters::MayBeVisible(clusters[c], rotation, rotation_center, m_imgWidth, m_imgHeight, m_imgLayers)
+	  && overlaps_stale_tile(clusters[c])) {
+	  // The points seen in the previous frame are already reprojected
+	  for (uint32_t k = clusters[c].begin; k < clusters[c].end; ++k) {
+		if (m_pointSeen[order[k]] == 0) {
+		  SplatSurfacePoint(rotation_mat, order[k]);
+		  ++stats.projected_points;
+		}
+	  }
+	}
+  }
+  ResolveSurfaceBuffers();
+  m_temporalStats = stats;
+
+  if (m_depthBuffer.Empty()) {
+	qDebug() << "Depth buffer empty!" << "\n";
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details A background pixel with at least three covered neighbours lies between the arms of the crosses of
+ * neighbouring points on one surface. It takes the depth and point of its nearest neighbour. The pixels are closed in
+ * scan order, so a crack of one pixel width is closed along its whole length. The same pass counts per tile of
+ * kTemporalTileSize pixels the covered pixels and the gaps, the background pixels that the previous frame covered
+ * according to m_previousPointBuffer.
+ * @param covered Covered pixels per tile, row by row, incremented
+ * @param gaps Gap pixels per tile, row by row, incremented
+ */
+void CTDataset::FillPinholesAndCountTiles(std::vector<int> &covered, std::vector<int> &gaps) {
+  int const background = m_imgLayers - 1;
+  int const tiles_x = (m_imgWidth + kTemporalTileSize - 1) / kTemporalTileSize;
+  int64_t const row_stride = m_depthBuffer.View().row_stride;
+  for (int y = 0; y < m_imgHeight; ++y) {
+	int *const depth = m_depthBuffer.View().Row(y);
+	int *const points = m_pointBuffer.View().Row(y);
+	const int *const previous_points = m_previousPointBuffer.View().Row(y);
+	int *const covered_row = covered.data() + static_cast<size_t>(y / kTemporalTileSize) * tiles_x;
+	int *const gap_row = gaps.data() + static_cast<size_t>(y / kTemporalTileSize) * tiles_x;
+	for (int x = 0; x < m_imgWidth; ++x) {
+	  // Most background pixels are outside of the silhouette, so the row neighbours decide first
+	  if (depth[x] == background && (depth[x - 1] != background || depth[x + 1] != background)) {
+		std::array<int64_t, 4> const neighbors{x - 1, x + 1, x - row_stride, x + row_stride};
+		int64_t nearest = x;
+		int neighbors_covered = 0;
+		for (int64_t const neighbor : neighbors) {
+		  neighbors_covered += depth[neighbor] != background ? 1 : 0;
+		  nearest = depth[neighbor] < depth[nearest] ? neighbor : nearest;
+		}
+		if (neighbors_covered >= 3) {
+		  depth[x] = depth[nearest];
+		  points[x] = points[nearest];
+		}
+	  }
+	  int const tile_x = x / kTemporalTileSize;
+	  covered_row[tile_x] += depth[x] != background ? 1 : 0;
+	  gap_row[tile_x] += depth[x] == background && previous_points[x] >= 0 ? 1 : 0;
+	}
+  }
+}
+
+/**
+ * @details Looks up the voxel ID and the normal of the point seen in every pixel, see m_pointBuffer, so that the
+ * splats themselves only write depth and point. This also flags the points seen in m_pointSeen for the next
+ * UpdateDepthBufferFromRegionGrowing(), in addition to those flagged before.
+ */
+void CTDataset::ResolveSurfaceBuffers() {
+  bool const surface_normals = m_surfaceNormals.size() == m_surfacePoints.size();
+  for (int y = 0; y < m_imgHeight; ++y) {
+	const int *const points = m_pointBuffer.View().Row(y);
+	int *const ids = m_idBuffer.View().Row(y);
+	uint16_t *const normals = m_normalBuffer.View().Row(y);
+	for (int x = 0; x < m_imgWidth; ++x) {
+	  if (points[x] < 0) {
+		if (m_idBufferEnabled) {
+		  ids[x] = -1;
+		}
+		continue;
+	  }
+	  // The arms of a cross repeat the point of their neighbour
+	  if (x > 0 && points[x] == points[x - 1]) {
+		ids[x] = ids[x - 1];
+		normals[x] = normals[x - 1];
+		continue;
+	  }
+	  m_pointSeen[points[x]] = 1;
+	  Eigen::Vector3i const &point = m_surfacePoints[points[x]];
+	  if (m_idBufferEnabled) {
+		ids[x] = point.x() + point.y() * m_imgWidth + point.z() * m_imgWidth * m_imgHeight;
+	  }
+	  if (m_normalBufferValid) {
+		normals[x] = surface_normals ? m_surfaceNormals[points[x]] : m_normalVolume.At(point.x(), point.y(), point.z());
+	  }
+	}
+  }
+}
+
+/**
+ * @return Work done by the last CalculateDepthBufferFromRegionGrowing() or UpdateDepthBufferFromRegionGrowing()
+ */
+TemporalSplatStats const &CTDataset::GetTemporalSplatStats() const {
+  return m_temporalStats;
+}
+
+/**
+ * @details Software rasterizer for m_regionMesh, with the same view geometry as the splats of
+ * CalculateDepthBufferFromRegionGrowing() (rotation about the region center, depth along z). The screen is split into
+ * bands of kRasterBandHeight rows. Front-facing triangles are binned into the bands they overlap, and every band is
+ * rasterized by one thread into a float z-buffer, keeping the nearest triangle and its barycentric coordinates per
+ * pixel. A resolve pass then writes depth, voxel ID and interpolated normal only for the visible surface. The mesh is
+ * extracted first if the region has changed since the last extraction, see ExtractRegionMesh().
+ * @param rotation_mat Rotation of the view
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if there is no mesh
+ */
+Status CTDataset::CalculateDepthBufferFromMesh(Eigen::Matrix3d const &rotation_mat) {
+  if (!m_regionMeshValid && !ExtractRegionMesh().Ok()) {
+	qDebug() << "No region mesh extracted!" << "\n";
+  }
+  m_depthBuffer.Reset(m_imgLayers - 1);
+  m_idBuffer.Reset(-1);
+  m_viewRotation = rotation_mat;
+  m_pointBufferValid = false;
+  TriangleMesh const &mesh = m_regionMesh;
+  m_normalBufferValid = !mesh.normals.empty() && mesh.normals.size() == mesh.vertices.size();
+  if (mesh.indices.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  Eigen::Matrix3f const rotation = rotation_mat.cast<float>();
+  Eigen::Vector3f const center = m_regionVolumeCenter.cast<float>();
+  std::vector<Eigen::Vector3f> screen(mesh.vertices.size());
+  int const block = 4096;
+  utils::ParallelFor(0, static_cast<int>((screen.size() + block - 1) / block), [&](int b) {
+	size_t const end = std::min(screen.size(), static_cast<size_t>(b + 1) * block);
+	for (size_t v = static_cast<size_t>(b) * block; v < end; ++v) {
+	  screen[v] = rotation * (mesh.vertices[v] - center) + center;
+	}
+  });
+
+  // Pixel (x, y) is sampled at (x + 0.5, y + 0.5); the view looks along +z, so front faces have a negative signed area
+  constexpr int kRasterBandHeight = 16;
+  int const band_count = (m_imgHeight + kRasterBandHeight - 1) / kRasterBandHeight;
+  std::vector<std::vector<uint32_t>> bands(band_count);
+  for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+	Eigen::Vector3f const &a = screen[mesh.indices[3 * t]];
+	Eigen::Vector3f const &b = screen[mesh.indices[3 * t + 1]];
+	Eigen::Vector3f const &c = screen[mesh.indices[3 * t + 2]];
+	float const area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	if (area >= 0.0f) {
+	  continue;
+	}
+	float const min_y = std::min({a.y(), b.y(), c.y()}) - 0.5f;
+	float const max_y = std::max({a.y(), b.y(), c.y()}) - 0.5f;
+	if (max_y < 0.0f || min_y >= static_cast<float>(m_imgHeight)) {
+	  continue;
+	}
+	int const first_band = std::max(0, static_cast<int>(std::ceil(min_y))) / kRasterBandHeight;
+	int const last_band = std::min(m_imgHeight - 1, static_cast<int>(std::floor(max_y))) / kRasterBandHeight;
+	for (int band = first_band; band <= last_band; ++band) {
+	  bands[band].push_back(static_cast<uint32_t>(t));
+	}
+  }
+
+  size_t const pixel_count = static_cast<size_t>(m_imgWidth) * m_imgHeight;
+  std::vector<float> z_buffer(pixel_count, std::numeric_limits<float>::max());
+  std::vector<int32_t> visible_triangle(pixel_count, -1);
+  std::vector<Eigen::Vector2f> visible_weights(pixel_count);
+  utils::ParallelFor(0, band_count, [&](int band) {
+	int const band_top = band * kRasterBandHeight;
+	int const band_bottom = std::min(m_imgHeight - 1, band_top + kRasterBandHeight - 1);
+	for (uint32_t t : bands[band]) {
+	  uint32_t const ia = mesh.indices[3 * t];
+	  uint32_t const ib = mesh.indices[3 * t + 1];
+	  uint32_t const ic = mesh.indices[3 * t + 2];
+	  Eigen::Vector3f const &a = screen[ia];
+	  Eigen::Vector3f const &b = screen[ib];
+	  Eigen::Vector3f const &c = screen[ic];
+	  float const area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	  int const x_begin = std::max(0, static_cast<int>(std::ceil(std::min({a.x(), b.x(), c.x()}) - 0.5f)));
+	  int const x_end = std::min(m_imgWidth - 1, static_cast<int>(std::floor(std::max({a.x(), b.x(), c.x()}) - 0.5f)));
+	  int const y_begin = std::max(band_top, static_cast<int>(std::ceil(std::min({a.y(), b.y(), c.y()}) - 0.5f)));
+	  int const y_end = std::min(band_bottom, static_cast<int>(std::floor(std::max({a.y(), b.y(), c.y()}) - 0.5f)));
+	  for (int y = y_begin; y <= y_end; ++y) {
+		float const py = static_cast<float>(y) + 0.5f;
+		for (int x = x_begin; x <= x_end; ++x) {
+		  float const px = static_cast<float>(x) + 0.5f;
+		  // Signed areas of the edges with the pixel. Shared edges are always evaluated from their lower vertex index,
+		  // so both triangles of an edge see the same value with opposite sign and no pixel on the edge is lost.
+		  auto edge = [&](uint32_t i, uint32_t j) {
+			Eigen::Vector3f const &p = screen[std::min(i, j)];
+			Eigen::Vector3f const &q = screen[std::max(i, j)];
+			float const value = (q.x() - p.x()) * (py - p.y()) - (q.y() - p.y()) * (px - p.x());
+			return i < j ? value : -value;
+		  };
+		  float const edge_bc = edge(ib, ic);
+		  float const edge_ca = edge(ic, ia);
+		  float const edge_ab = edge(ia, ib);
+		  if (edge_bc > 0.0f || edge_ca > 0.0f || edge_ab > 0.0f) {
+			continue;
+		  }
+		  // Barycentric weights of b and c
+		  float const weight_b = edge_ca / area;
+		  float const weight_c = edge_ab / area;
+		  float const z = a.z() + weight_b * (b.z() - a.z()) + weight_c * (c.z() - a.z());
+		  size_t const pixel = x + static_cast<size_t>(y) * m_imgWidth;
+		  if (z < z_buffer[pixel]) {
+			z_buffer[pixel] = z;
+			visible_triangle[pixel] = static_cast<int32_t>(t);
+			visible_weights[pixel] = Eigen::Vector2f(weight_b, weight_c);
+		  }
+		}
+	  }
+	}
+  });
+
+  utils::ParallelFor(0, m_imgHeight, [&](int y) {
+	for (int x = 0; x < m_imgWidth; ++x) {
+	  size_t const pixel = x + static_cast<size_t>(y) * m_imgWidth;
+	  int32_t const t = visible_triangle[pixel];
+	  if (t < 0) {
+		continue;
+	  }
+	  m_depthBuffer.View()(x, y) = std::min(std::max(static_cast<int>(z_buffer[pixel]), 0), m_imgLayers - 1);
+	  uint32_t const ia = mesh.indices[3 * t];
+	  uint32_t const ib = mesh.indices[3 * t + 1];
+	  uint32_t const ic = mesh.indices[3 * t + 2];
+	  float const wb = visible_weights[pixel].x();
+	  float const wc = visible_weights[pixel].y();
+	  float const wa = 1.0f - wb - wc;
+	  if (m_idBufferEnabled) {
+		Eigen::Vector3f const position = wa * mesh.vertices[ia] + wb * mesh.vertices[ib] + wc * mesh.vertices[ic];
+		int const vx = std::min(std::max(static_cast<int>(std::lround(position.x())), 0), m_imgWidth - 1);
+		int const vy = std::min(std::max(static_cast<int>(std::lround(position.y())), 0), m_imgHeight - 1);
+		int const vz = std::min(std::max(static_cast<int>(std::lround(position.z())), 0), m_imgLayers - 1);
+		m_idBuffer.View()(x, y) = vx + vy * m_imgWidth + vz * m_imgWidth * m_imgHeight;
+	  }
+	  if (m_normalBufferValid) {
+		Eigen::Vector3f const normal = wa * mesh.normals[ia] + wb * mesh.normals[ib] + wc * mesh.normals[ic];
+		m_normalBuffer.View()(x, y) = NormalVolume::EncodeNormal(normal.x(), normal.y(), normal.z());
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The 3D image is rendered by computing the depth-value gradient in x and y for each pixel (in essence,
+ * computing the dot product). The step-size
+ * of the algorithm is two, i.e. each pixel is compared to it's left and right as well as it's above and below
+ * neighbor. The result is then normalized, multiplied by 255 to yield a valid RGB value and written to an ouput buffer.
+ * If the depth buffer was calculated with precomputed gradient normals (see ComputeNormalVolume() and
+ * ComputeSurfaceNormals()), foreground pixels are instead shaded with a headlight from their normal. The shade of all
+ * 65536 normal codes under the current view rotation is tabulated once per frame, so each pixel costs one lookup and
+ * the result does not depend on depth differences between neighbouring splats.
+ * @return StatusCode::OK if the result buffer is not empty, else StatusCode::BUFFER_EMPTY
+ */
+Status CTDataset::RenderDepthBuffer() {
+  if (m_depthBuffer.Empty()) {
+	qDebug() << "Depth buffer empty!" << "\n";
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  int const s_x = 4;
+  int const s_y = 4;
+  double const s_x_sq = s_x * s_x;
+  double const s_y_sq = s_y * s_y;
+  double const s_pow_four = s_x_sq * s_y_sq;
+
+  // Headlight shade of every normal code: |z component of the rotated normal|
+  std::vector<uint8_t> shade_lut;
+  if (m_normalBufferValid) {
+	shade_lut.resize(65536);
+	Eigen::Vector3f const view_z = m_viewRotation.row(2).cast<float>();
+	utils::ParallelFor(0, 65536, [&](int code) {
+	  float nx = 0.0f;
+	  float ny = 0.0f;
+	  float nz = 0.0f;
+	  NormalVolume::DecodeNormal(static_cast<uint16_t>(code), nx, ny, nz);
+	  float const shade = std::abs(view_z.x() * nx + view_z.y() * ny + view_z.z() * nz);
+	  shade_lut[code] = static_cast<uint8_t>(std::lround(255.0f * std::min(shade, 1.0f)));
+	});
+  }
+
+  // Rows are shaded on the thread pool. The edge pixels are replicated into the guard band first, so the neighbours of
+  // border pixels are clamped to the image without a check per pixel.
+  m_depthBuffer.ReplicateEdges();
+  StridedView<const int> const depth = m_depthBuffer.View();
+  StridedView<const uint16_t> const normals = m_normalBuffer.View();
+  utils::ParallelFor2D(m_imgWidth, m_imgHeight, [&](int x, int y) {
+	int const current_point = x + y * m_imgWidth;
+	const int *center = depth.Row(y) + x;
+	if (m_normalBufferValid && *center != m_imgLayers - 1) {
+	  m_renderedDepthBuffer[current_point] = shade_lut[normals(x, y)];
+	  return;
+	}
+	int const T_x = center[1] - center[-1];
+	int const T_y = center[depth.row_stride] - center[-depth.row_stride];
+	double const syTx_sq = s_y_sq * T_x * T_x;
+	double const sxTy_sq = s_x_sq * T_y * T_y;
+	// Dot product of the surface normal (-s_y T_x, -s_x T_y, s_x s_y) with the viewing direction (0, 0, 1)
+	double const nom = 255.0 * s_x * s_y;
+	double const denom = std::sqrt(syTx_sq + sxTy_sq + s_pow_four);
+	double const inv = 1 / denom;
+	m_renderedDepthBuffer[current_point] = static_cast<int>(nom * inv);
+  });
+
+  if (m_renderedDepthBuffer == nullptr) {
+	qDebug() << "Depth buffer couldn't be rendered!" << "\n";
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Sobel gradient of the HU values, computed in parallel over layers and quantized to 16-bit octahedral
+ * codes (2 bytes per voxel). Needs to be called once per dataset; load() discards the normals.
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if there is no image data
+ */
+Status CTDataset::ComputeNormalVolume() {
+  return m_normalVolume.Build(m_voxelData, m_imgWidth, m_imgHeight, m_imgLayers);
+}
+
+/**
+ * @details Computes the normals of m_surfacePoints only, which is much cheaper than ComputeNormalVolume() for small
+ * regions. RegionGrowing3D() calls this automatically.
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if there are no surface points
+ */
+Status CTDataset::ComputeSurfaceNormals() {
+  if (m_surfacePoints.empty()) {
+	m_surfaceNormals.clear();
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  m_surfaceNormals.resize(m_surfacePoints.size());
+  utils::ParallelFor(0, static_cast<int>(m_surfacePoints.size()), [&](int i) {
+	Eigen::Vector3i const &point = m_surfacePoints[i];
+	m_surfaceNormals[i] = NormalVolume::ComputeNormal(m_voxelData, m_imgWidth, m_imgHeight, m_imgLayers, point.x(),
+													  point.y(), point.z());
+  });
+  return Status(StatusCode::OK);
+}
+
+int CTDataset::GetGreyValue(Eigen::Vector3i const &pt) const {
+  return Voxel(pt.x(), pt.y(), pt.z());
+}
+
+/**
+ * @details Stores the result of ExtractSurfacePoints() in a member vector, which is moved in without a copy.
+ * @return StatusCode::OK if the region growin buffer is not empty
+ */
+Status CTDataset::FindSurfacePoints() {
+  auto surface_points = ExtractSurfacePoints();
+  if (!surface_points.Ok()) {
+	return surface_points.status();
+  }
+  m_surfacePoints = std::move(surface_points).value();
+  ++m_surfaceGeneration;
+  m_pointBufferValid = false;
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Iterate through the region determined by region growing and find points that do not have six neighbors.
+ * Region voxels on the border of the volume are always surface points. Construct an Eigen::Vector3i from the
+ * coordinates of these surface points. The test stays 6-connected for every GetRegionConnectivity(): a voxel that
+ * touches the outside only at an edge or a corner shows no face to a viewer, it lies behind the face-exposed voxels
+ * around it. Testing the 18 or 26 neighbours would only thicken the shell that the splats, normals and clusters
+ * process, while the connectivity decides which voxels belong to the region. Only reads the region buffer, so the
+ * caller owns the result and concurrent callers do not share any state. The y-planes are scanned on the thread pool
+ * and the points keep the order of a sequential loop over y, x and z.
+ * @return The surface points, or StatusCode::BUFFER_EMPTY if there is no region growing buffer
+ */
+StatusOr<std::vector<Eigen::Vector3i>> CTDataset::ExtractSurfacePoints() const {
+  if (m_regionBuffer == nullptr) {
+	return StatusOr<std::vector<Eigen::Vector3i>>(Status(StatusCode::BUFFER_EMPTY));
+  }
+  auto const offsets = voxel_kernels::LinearOffsets<6>(m_imgWidth, m_imgHeight);
+  std::vector<Eigen::Vector3i> surface_points =
+	  CollectVoxels(m_imgWidth, m_imgHeight, m_imgLayers, [this, &offsets](int x, int y, int d) {
+		return m_regionBuffer[x + y * m_imgWidth + (m_imgHeight * m_imgWidth * d)] == voxel_kernels::kRegion
+		  && voxel_kernels::IsSurfaceVoxel<6>(m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, x, y, d, offsets);
+	  });
+  return StatusOr<std::vector<Eigen::Vector3i>>(std::move(surface_points));
+}
+
+/**
+ * @details Iterate through all points in the RG buffer and sum up their respective coordinates and take the average.
+ * @return StatusCode::OK if the region growin buffer is not empty
+ */
+Status CTDataset::FindPointCloudCenter() {
+  AggregatePointsInRegion();
+  if (m_allPointsInRegion.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  int64_t x_tot = 0;
+  int64_t y_tot = 0;
+  int64_t z_tot = 0;
+  for (auto &pt : m_allPointsInRegion) {
+	x_tot += pt.x();
+	y_tot += pt.y();
+	z_tot += pt.z();
+  }
+
+  auto region_size = static_cast<double>(m_allPointsInRegion.size());
+
+  m_regionVolumeCenter = Eigen::Vector3d(static_cast<double>(x_tot) / region_size,
+										 static_cast<double>(y_tot) / region_size,
+										 static_cast<double>(z_tot) / region_size);
+
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Implementation of an interative region growing algorithm. Start with an initial seed, neighboring pixel
+ * are determined and checked in turn for if their HU value is greater than the threshold. If yes, they are added
+ * to the region. If not, they are simply marked as visited and not added to the region. Once all neighbors have been
+ * checked, the next seed is determined as the last checked neighbor and the algorithm starts again. It terminates once
+ * no new pixel are available. Once completed, the surface points of the region as well as the barycenter of the region
+ * are determined. The neighbours are those of GetRegionConnectivity(); the kernel for it is selected when the data is
+ * loaded or the connectivity changes, see voxel_kernels::GrowRegion(). With VoxelLayout::BRICKED the voxels are read
+ * from the bricked copy, see GrowRegionBricked().
+ * @param seed User-picked initial seed point of the algorithm
+ * @param threshold HU value above which points will be added to the region
+ */
+void CTDataset::RegionGrowing3D(Eigen::Vector3i &seed, int const threshold) {
+  // The state before the first region growing becomes the oldest entry of the undo history
+  if (m_regionHistory.empty()) {
+	PushRegionState();
+  }
+  std::fill_n(m_regionBuffer, m_imgHeight * m_imgWidth * m_imgLayers, 0);
+  m_regionDistance.Clear();
+  m_regionThreshold = threshold;
+  std::cout << "Starting region growing algorithm!" << "\n";
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  if (m_voxelLayout == VoxelLayout::BRICKED) {
+	GrowRegionBricked(seed, threshold);
+  } else {
+	m_regionGrowingKernel(m_voxelData, m_imgWidth, m_imgHeight, m_imgLayers, seed, threshold, m_regionBuffer);
+  }
+
+  UpdateRegionResults();
+  PushRegionState();
+
   auto t2 = std::chrono::high_resolution_clock::now();
   auto duration_ms = std::chrono::duration<double, std::milli>(t2 - t1);
   std::cout << "Region growing, surface point search and barycenter computation took: " << duration_ms.count()
 			<< "ms\n";
 }
 
-void CTDataset::AggregatePointsInRegion() {
-  m_allPointsInRegion.clear();
-  Eigen::Vector3i region_point(0, 0, 0);
-  for (int y = 0; y < m_imgHeight; ++y) {
-	for (int x = 0; x < m_imgWidth; ++x) {
-	  for (int d = 0; d < m_imgLayers; ++d) {
-		int pt = x + y * m_imgWidth + (m_imgHeight * m_imgWidth * d);
-		if (m_regionBuffer[pt] == 1) {
-		  region_point.x() = x;
-		  region_point.y() = y;
-		  region_point.z() = d;
-		  m_allPointsInRegion.push_back(region_point);
-		}
+/**
+ * @details The voxels are read by their coordinates from the bricked copy, the labels stay in the linear region
+ * growing buffer.
+ * @param seed Initial seed point
+ * @param threshold HU value above which points will be added to the region
+ */
+void CTDataset::GrowRegionBricked(Eigen::Vector3i const &seed, int const threshold) {
+  BrickedVoxelAccessor const voxel{&m_brickedVolume};
+  auto const read = [&voxel](int64_t, int const x, int const y, int const z) { return voxel(x, y, z); };
+  switch (m_regionConnectivity) {
+	case Connectivity::EDGES:
+	  voxel_kernels::GrowRegionWith<int16_t, 18>(read, m_imgWidth, m_imgHeight, m_imgLayers, seed, threshold,
+												 m_regionBuffer);
+	  break;
+	case Connectivity::CORNERS:
+	  voxel_kernels::GrowRegionWith<int16_t, 26>(read, m_imgWidth, m_imgHeight, m_imgLayers, seed, threshold,
+												 m_regionBuffer);
+	  break;
+	default:
+	  voxel_kernels::GrowRegionWith<int16_t, 6>(read, m_imgWidth, m_imgHeight, m_imgLayers, seed, threshold,
+												m_regionBuffer);
+  }
+}
+
+/**
+ * @details Only affects the next RegionGrowing3D(); the current result and the undo history stay as they are.
+ * @param connectivity Neighbourhood region growing follows
+ */
+void CTDataset::SetRegionConnectivity(Connectivity const connectivity) {
+  m_regionConnectivity = connectivity;
+  SelectKernels();
+}
+
+Connectivity CTDataset::GetRegionConnectivity() const {
+  return m_regionConnectivity;
+}
+
+/**
+ * @details The region growing buffer is packed into a bit mask (see BitMask), processed and written back with 1 for
+ * the region and 0 for all other voxels, so the visited marks of the region growing are dropped. Surface points,
+ * normals and barycenter are recomputed, and the mesh and a distance field of the old region are discarded. The
+ * result is a new entry of the undo history, see UndoRegion().
+ * @param operation Morphological operation, e.g. MorphologyOperation::OPEN to cut thin leaks and remove speckle
+ * @param radius Radius of the structuring ball in voxels (ignored by MorphologyOperation::FILL_HOLES)
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if there is no region growing buffer, or
+ * StatusCode::MORPHOLOGY_ERROR if the radius is out of range
+ */
+Status CTDataset::ApplyRegionMorphology(MorphologyOperation const operation, int const radius) {
+  auto t1 = std::chrono::high_resolution_clock::now();
+  BitMask mask;
+  Status status = mask.Build(m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, 1);
+  if (!status.Ok()) {
+	return status;
+  }
+  status = BitMask::Apply(mask, operation, radius, mask);
+  if (!status.Ok()) {
+	return status;
+  }
+  if (m_regionHistory.empty()) {
+	PushRegionState();
+  }
+  mask.WriteLabels(m_regionBuffer, 1);
+  auto t2 = std::chrono::high_resolution_clock::now();
+  qDebug() << "Region morphology took:" << std::chrono::duration<double, std::milli>(t2 - t1).count() << "ms" << "\n";
+
+  m_regionDistance.Clear();
+  UpdateRegionResults();
+  PushRegionState();
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Every region growing and every morphological clean up adds an entry to the undo history, which keeps the
+ * last kRegionHistoryLevels results before the current one. The region growing buffer is stored as copy-on-write
+ * bricks (see LabelSnapshot), so unchanged bricks are shared between the entries, and only the threshold and the
+ * barycenter are stored alongside. Ten levels therefore cost little more than the bricks of a single result. Going
+ * back only rewrites the bricks that differ; surface points, normals and clusters are recomputed by the next splat
+ * render, the mesh by its next use, and a distance field of the region is discarded.
+ * @attention Writes to the region growing buffer through GetRegionGrowingBuffer() are not recorded.
+ * @return StatusCode::OK, or StatusCode::HISTORY_ERROR if there is no older result
+ */
+Status CTDataset::UndoRegion() {
+  if (!CanUndoRegion()) {
+	return Status(StatusCode::HISTORY_ERROR);
+  }
+  RestoreRegionState(m_regionHistoryIndex - 1);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Results that have been undone stay available until the next region growing or morphology.
+ * @return StatusCode::OK, or StatusCode::HISTORY_ERROR if there is no newer result
+ */
+Status CTDataset::RedoRegion() {
+  if (!CanRedoRegion()) {
+	return Status(StatusCode::HISTORY_ERROR);
+  }
+  RestoreRegionState(m_regionHistoryIndex + 1);
+  return Status(StatusCode::OK);
+}
+
+bool CTDataset::CanUndoRegion() const {
+  return m_regionHistoryIndex > 0;
+}
+
+bool CTDataset::CanRedoRegion() const {
+  return m_regionHistoryIndex >= 0 && m_regionHistoryIndex + 1 < static_cast<int>(m_regionHistory.size());
+}
+
+/**
+ * @details Counts the brick tables of all entries and every stored brick once, however many entries share it.
+ * @return Bytes of the labels, tables and entries of the undo history
+ */
+size_t CTDataset::GetRegionHistoryBytes() const {
+  std::unordered_set<const int *> bricks;
+  size_t bytes = 0;
+  for (RegionState const &state : m_regionHistory) {
+	bytes += sizeof(RegionState) + state.labels.BrickCount() * sizeof(std::shared_ptr<const std::vector<int>>);
+	for (int i = 0; i < state.labels.BrickCount(); ++i) {
+	  if (state.labels.Brick(i) != nullptr) {
+		bricks.insert(state.labels.Brick(i));
 	  }
 	}
   }
+  return bytes + bricks.size() * LabelSnapshot::kBrickVoxels * sizeof(int);
+}
+
+void CTDataset::PushRegionState() {
+  RegionState state;
+  LabelSnapshot const previous = m_regionHistoryIndex >= 0 ? m_regionHistory[m_regionHistoryIndex].labels
+														   : LabelSnapshot();
+  if (!LabelSnapshot::Capture(m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, previous, state.labels).Ok()) {
+	return;
+  }
+  state.threshold = m_regionThreshold;
+  state.center = m_regionVolumeCenter;
+
+  m_regionHistory.erase(m_regionHistory.begin() + (m_regionHistoryIndex + 1), m_regionHistory.end());
+  m_regionHistory.push_back(std::move(state));
+  if (static_cast<int>(m_regionHistory.size()) > kRegionHistoryLevels + 1) {
+	m_regionHistory.pop_front();
+  }
+  m_regionHistoryIndex = static_cast<int>(m_regionHistory.size()) - 1;
+}
+
+void CTDataset::RestoreRegionState(int const index) {
+  RegionState const &state = m_regionHistory[index];
+  if (!state.labels.Restore(m_regionBuffer, m_regionHistory[m_regionHistoryIndex].labels).Ok()) {
+	return;
+  }
+  m_regionThreshold = state.threshold;
+  m_regionVolumeCenter = state.center;
+  m_surfacePoints.clear();
+  m_surfaceNormals.clear();
+  m_surfaceClusters.Clear();
+  ++m_surfaceGeneration;
+  m_surfaceResultsValid = false;
+  m_regionMesh = TriangleMesh();
+  m_regionMeshValid = false;
+  m_allPointsInRegion.clear();
+  m_regionDistance.Clear();
+  m_pointBufferValid = false;
+  m_regionHistoryIndex = index;
+}
+
+void CTDataset::UpdateRegionResults() {
+  UpdateSurfaceResults();
+  // The mesh is only extracted once it is rendered or exported
+  m_regionMesh = TriangleMesh();
+  m_regionMeshValid = false;
+  if (FindPointCloudCenter().Ok()) {
+	std::cout << m_allPointsInRegion.size() << " total points in the region!" << "\n";
+  }
+}
+
+void CTDataset::UpdateSurfaceResults() {
+  if (FindSurfacePoints().Ok()) {
+	std::cout << m_surfacePoints.size() << " surface points calculated!" << "\n";
+  }
+  if (!ComputeSurfaceNormals().Ok()) {
+	qDebug() << "No surface normals calculated!" << "\n";
+  }
+  if (m_surfaceClusters.Build(m_surfacePoints, m_surfaceNormals).Ok()) {
+	m_clusterGeneration = m_surfaceGeneration;
+  } else {
+	qDebug() << "No surface clusters built!" << "\n";
+  }
+  m_surfaceResultsValid = true;
 }
 
+void CTDataset::AggregatePointsInRegion() {
+  auto points = ExtractPointsInRegion();
+  if (points.Ok()) {
+	m_allPointsInRegion = std::move(points).value();
+  } else {
+	m_allPointsInRegion.clear();
+  }
+}
+
+/**
+ * @details The y-planes are scanned on the thread pool, the points are ordered by y, then x, then z.
+ * @return All points of the region growing result, or StatusCode::BUFFER_EMPTY if there is no region growing buffer
+ */
+StatusOr<std::vector<Eigen::Vector3i>> CTDataset::ExtractPointsInRegion() const {
+  if (m_regionBuffer == nullptr) {
+	return StatusOr<std::vector<Eigen::Vector3i>>(Status(StatusCode::BUFFER_EMPTY));
+  }
+  std::vector<Eigen::Vector3i> points =
+	  CollectVoxels(m_imgWidth, m_imgHeight, m_imgLayers, [this](int x, int y, int d) {
+		return m_regionBuffer[x + y * m_imgWidth + (m_imgHeight * m_imgWidth * d)] == 1;
+	  });
+  return StatusOr<std::vector<Eigen::Vector3i>>(std::move(points));
+}
 
+/**
+ * @details Surface nets over the bounding box of the region, with sub-voxel vertex positions from the HU values and
+ * the threshold of the last region growing, see SurfaceNets::Extract(). Only the mesh rendering and the export need
+ * the mesh, so it is not part of RegionGrowing3D(); CalculateDepthBufferFromMesh() and ExportRegionMesh() call this
+ * on first use after the region has changed.
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the region growing result is empty
+ */
+Status CTDataset::ExtractRegionMesh() {
+  Status const status = SurfaceNets::Extract(m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, 1, m_voxelData,
+											 m_regionThreshold, m_regionMesh);
+  m_regionMeshValid = status.Ok();
+  return status;
+}
+
+TriangleMesh const &CTDataset::GetRegionMesh() const {
+  return m_regionMesh;
+}
 
+/**
+ * @return Clusters of the surface points, built by RegionGrowing3D() and ApplyRegionMorphology(); empty after
+ * UndoRegion() or RedoRegion() until the next splat render
+ */
+SurfaceClusters const &CTDataset::GetSurfaceClusters() const {
+  return m_surfaceClusters;
+}
+
+/**
+ * @details Extracts the mesh first if it is outdated, see ExtractRegionMesh().
+ * @param path Path of the PLY file
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if there is no mesh, or the file error
+ */
+Status CTDataset::ExportRegionMesh(QString const &path) {
+  if (!m_regionMeshValid && !ExtractRegionMesh().Ok()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  if (m_regionMesh.indices.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return BinaryExport::WriteMeshPLY(path, m_regionMesh, m_voxelSpacing);
+}
+
+/**
+ * @details Streams m_surfacePoints straight from the vector, see BinaryExport::WritePointCloudPLY(). Surface points
+ * dropped by UndoRegion() or RedoRegion() are recomputed first.
+ * @param path Path of the PLY file
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if there are no surface points, or the file error
+ */
+Status CTDataset::ExportSurfacePoints(QString const &path) {
+  if (!m_surfaceResultsValid) {
+	UpdateSurfaceResults();
+  }
+  if (m_surfacePoints.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return BinaryExport::WritePointCloudPLY(path, m_surfacePoints, m_voxelSpacing);
+}
+
+/**
+ * @details Run-length encodes the voxels of m_regionBuffer that belong to the region, see BinaryExport::WriteMaskRLE().
+ * @param path Path of the mask file
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if there is no region growing buffer, or the file error
+ */
+Status CTDataset::ExportRegionMask(QString const &path) const {
+  return BinaryExport::WriteMaskRLE(path, m_regionBuffer, m_imgWidth, m_imgHeight, m_imgLayers, 1);
+}
+
+/**
+ * @details Casts one ray per candidate direction from the target outwards through m_voxelData and the region growing
+ * buffer. The entry point is the first sample after the last body sample (HU > skin_threshold). Rays that leave the
+ * volume or exceed max_length while still inside the body are discarded, as are paths closer than min_clearance to
+ * the safe zone.
+ *
+ * The rays are marched in packets of kRayPacketSize in lockstep, with the sample positions and the per-ray state kept
+ * in structure-of-arrays form. The position and state updates are plain loops over the packet, which the compiler
+ * vectorizes across the rays; only the voxel fetches are scalar. The packets are spread over all hardware threads.
+ * @param target Target point in voxel coordinates
+ * @param safe_zone Sphere the paths have to avoid, disabled by a negative radius
+ * @param params Candidate generation and scoring
+ * @param trajectories Output: the valid trajectories, sorted by increasing cost
+ * @return StatusCode::OK, or StatusCode::PLANNING_ERROR if the target lies outside the volume or the parameters are
+ * invalid
+ */
+Status CTDataset::PlanTrajectories(Eigen::Vector3d const &target, PlanningSphere const &safe_zone,
+								   TrajectoryParameters const &params, std::vector<Trajectory> &trajectories) const {
+  trajectories.clear();
+  if (params.direction_count <= 0 || params.step <= 0.0 || params.max_length <= 0.0
+	|| (target.array() < 0.0).any() || target.x() > m_imgWidth - 1 || target.y() > m_imgHeight - 1
+	|| target.z() > m_imgLayers - 1) {
+	return Status(StatusCode::PLANNING_ERROR);
+  }
+
+  constexpr int kRayPacketSize = 8;
+  std::vector<Eigen::Vector3d> const directions = FibonacciDirections(params.direction_count);
+  int const packet_count = (params.direction_count + kRayPacketSize - 1) / kRayPacketSize;
+  int const step_count = static_cast<int>(params.max_length / params.step);
+  std::vector<Trajectory> candidates(directions.size());
+  std::vector<uint8_t> valid(directions.size(), 0);
+  Eigen::Vector3d const target_mm = target.cwiseProduct(m_voxelSpacing);
+  Eigen::Vector3d const safe_center_mm = safe_zone.center.cwiseProduct(m_voxelSpacing);
+  int const slice_size = m_imgWidth * m_imgHeight;
+
+  utils::ParallelFor(0, packet_count, [&](int packet) {
+	int const first = packet * kRayPacketSize;
+	int const lanes = std::min(kRayPacketSize, params.direction_count - first);
+
+	// Positions are offset by half a voxel, so that truncation rounds to the nearest voxel
+	float origin[3];
+	float delta[3][kRayPacketSize];
+	int32_t active[kRayPacketSize];
+	int32_t last_body[kRayPacketSize];
+	int32_t exited_in_body[kRayPacketSize];
+	int32_t in_bone[kRayPacketSize];
+	int32_t in_region[kRayPacketSize];
+	int32_t bone_crossings[kRayPacketSize];
+	int32_t region_crossings[kRayPacketSize];
+	int32_t index[kRayPacketSize];
+	int32_t in_volume[kRayPacketSize];
+	int32_t hu[kRayPacketSize];
+	int32_t region[kRayPacketSize];
+	for (int axis = 0; axis < 3; ++axis) {
+	  origin[axis] = static_cast<float>(target[axis] + 0.5);
+	}
+	for (int lane = 0; lane < kRayPacketSize; ++lane) {
+	  Eigen::Vector3d step_voxels = Eigen::Vector3d::Zero();
+	  if (lane < lanes) {
+		step_voxels = Eigen::Vector3d(directions[first + lane] * params.step).cwiseQuotient(m_voxelSpacing);
+	  }
+	  for (int axis = 0; axis < 3; ++axis) {
+		delta[axis][lane] = static_cast<float>(step_voxels[axis]);
+	  }
+	  active[lane] = (lane < lanes) ? 1 : 0;
+	  last_body[lane] = -1;
+	  exited_in_body[lane] = 0;
+	  in_bone[lane] = in_region[lane] = 0;
+	  bone_crossings[lane] = region_crossings[lane] = 0;
+	}
+
+	for (int step = 0; step <= step_count; ++step) {
+	  int any_active = 0;
+	  for (int lane = 0; lane < kRayPacketSize; ++lane) {
+		float const x = origin[0] + static_cast<float>(step) * delta[0][lane];
+		float const y = origin[1] + static_cast<float>(step) * delta[1][lane];
+		float const z = origin[2] + static_cast<float>(step) * delta[2][lane];
+		int32_t const inside = (x >= 0.0f) & (y >= 0.0f) & (z >= 0.0f) & (x < static_cast<float>(m_imgWidth))
+		  & (y < static_cast<float>(m_imgHeight)) & (z < static_cast<float>(m_imgLayers));
+		in_volume[lane] = inside & active[lane];
+		index[lane] = in_volume[lane] ? static_cast<int32_t>(x) + static_cast<int32_t>(y) * m_imgWidth
+										  + static_cast<int32_t>(z) * slice_size
+									  : 0;
+		exited_in_body[lane] |= active[lane] & (1 - inside) & static_cast<int32_t>(last_body[lane] == step - 1);
+		active[lane] = in_volume[lane];
+		any_active |= active[lane];
+	  }
+	  if (any_active == 0) {
+		break;
+	  }
+	  for (int lane = 0; lane < kRayPacketSize; ++lane) {
+		hu[lane] = m_voxelData[index[lane]];
+		region[lane] = m_regionBuffer[index[lane]];
+	  }
+	  for (int lane = 0; lane < kRayPacketSize; ++lane) {
+		int32_t const body = static_cast<int32_t>(hu[lane] > params.skin_threshold);
+		int32_t const bone = static_cast<int32_t>(hu[lane] >= params.bone_threshold);
+		int32_t const structure = static_cast<int32_t>(region[lane] == 1);
+		int32_t const on = active[lane];
+		last_body[lane] = (on & body) ? step : last_body[lane];
+		bone_crossings[lane] += on & in_bone[lane] & (1 - bone);
+		region_crossings[lane] += on & in_region[lane] & (1 - structure);
+		in_bone[lane] = on ? bone : in_bone[lane];
+		in_region[lane] = on ? structure : in_region[lane];
+	  }
+	}
+
+	for (int lane = 0; lane < lanes; ++lane) {
+	  // Still inside the body at the end of the march or where the ray left the volume
+	  if (exited_in_body[lane] || (active[lane] && last_body[lane] == step_count)) {
+		continue;
+	  }
+	  Trajectory &trajectory = candidates[first + lane];
+	  Eigen::Vector3d const &direction = directions[first + lane];
+	  trajectory.direction = direction;
+	  trajectory.length = (last_body[lane] + 1) * params.step;
+	  // Same arithmetic as the march, so that the entry point rounds to the sampled voxel
+	  for (int axis = 0; axis < 3; ++axis) {
+		trajectory.entry[axis] = origin[axis] + static_cast<float>(last_body[lane] + 1) * delta[axis][lane] - 0.5f;
+	  }
+	  trajectory.bone_crossings = bone_crossings[lane];
+	  trajectory.region_crossings = region_crossings[lane];
+
+	  trajectory.clearance = std::numeric_limits<double>::infinity();
+	  if (safe_zone.radius >= 0.0) {
+		double const along = std::min(std::max((safe_center_mm - target_mm).dot(direction), 0.0), trajectory.length);
+		trajectory.clearance = (target_mm + along * direction - safe_center_mm).norm() - safe_zone.radius;
+		if (trajectory.clearance < params.min_clearance) {
+		  continue;
+		}
+	  }
+	  trajectory.cost = params.length_weight * trajectory.length + params.bone_weight * trajectory.bone_crossings
+		+ params.region_weight * trajectory.region_crossings
+		- params.clearance_weight * std::min(trajectory.clearance, params.clearance_cap);
+	  valid[first + lane] = 1;
+	}
+  });
+
+  for (size_t i = 0; i < candidates.size(); ++i) {
+	if (valid[i]) {
+	  trajectories.push_back(candidates[i]);
+	}
+  }
+  std::stable_sort(trajectories.begin(), trajectories.end(),
+				   [](Trajectory const &a, Trajectory const &b) { return a.cost < b.cost; });
+  return Status(StatusCode::OK);
+}
+
+StatusOr<std::vector<Trajectory>> CTDataset::PlanTrajectories(Eigen::Vector3d const &target,
+															  PlanningSphere const &safe_zone,
+															  TrajectoryParameters const &params) const {
+  std::vector<Trajectory> trajectories;
+  Status stat = PlanTrajectories(target, safe_zone, params, trajectories);
+  if (!stat.Ok()) {
+	return StatusOr<std::vector<Trajectory>>(stat);
+  }
+  return StatusOr<std::vector<Trajectory>>(std::move(trajectories));
+}
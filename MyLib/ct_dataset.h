@@ -3,6 +3,21 @@
 
 #include "status.h"
 #include "mylib.h"
+#include "binary_export.h"
+#include "bit_mask.h"
+#include "bricked_volume.h"
+#include "dicom_series.h"
+#include "distance_field.h"
+#include "guarded_buffer.h"
+#include "label_snapshot.h"
+#include "normal_volume.h"
+#include "prefilter.h"
+#include "resampler.h"
+#include "surface_clusters.h"
+#include "surface_nets.h"
+#include "voxel_kernels.h"
+#include "parallel.h"
+#include "simd.h"
 #include "Eigen/Core"
 #include "Eigen/Dense"
 
@@ -10,11 +25,144 @@
 #include <QDebug>
 #include <QPoint>
 
+#include <deque>
 #include <stack>
 #include <cmath>
 #include <cassert>
 #include <chrono>
 
+/**
+ * @brief Orientation of a 2D slice through the volume
+ */
+enum class SliceOrientation {
+  /// xy-plane, indexed by layer (the orientation of the raw images)
+  AXIAL,
+  /// xz-plane, indexed by y
+  CORONAL,
+  /// yz-plane, indexed by x
+  SAGITTAL,
+  /// Plane perpendicular to the viewing direction of a rotation matrix, indexed by its distance to the volume center
+  OBLIQUE
+};
+
+/**
+ * @brief Reduction applied along the rays of an intensity projection
+ */
+enum class ProjectionMode {
+  /// Maximum intensity projection (MIP)
+  MAXIMUM,
+  /// Minimum intensity projection (MinIP)
+  MINIMUM,
+  /// Average intensity projection, similar to a digitally reconstructed radiograph (DRR)
+  AVERAGE
+};
+
+/**
+ * @brief Control point of a piecewise linear transfer function for direct volume rendering
+ */
+struct TransferFunctionPoint {
+  /// HU value of the control point
+  int hu;
+  /// Colour components (0 to 1)
+  float red;
+  float green;
+  float blue;
+  /// Opacity of one voxel length of material (0 to 1)
+  float opacity;
+};
+
+/**
+ * @brief Colour and opacity of a single HU value, one entry of a transfer function lookup table
+ */
+struct TransferFunctionEntry {
+  float red;
+  float green;
+  float blue;
+  float opacity;
+};
+
+/**
+ * @brief Sphere used as a planning area, e.g. the safe zone around a structure that must not be touched
+ */
+struct PlanningSphere {
+  /// Center in voxel coordinates
+  Eigen::Vector3d center;
+  /// Radius in mm, a negative radius disables the sphere
+  double radius;
+};
+
+/**
+ * @brief Candidate generation and scoring of PlanTrajectories()
+ * @details The cost of a trajectory is length_weight * length + bone_weight * bone crossings + region_weight * region
+ * crossings - clearance_weight * min(clearance, clearance_cap). Lower is better.
+ */
+struct TrajectoryParameters {
+  /// Number of candidate directions, spread evenly over the sphere
+  int direction_count{4096};
+  /// HU value above which a sample belongs to the body, the entry point is where the path leaves the body
+  int skin_threshold{-400};
+  /// HU value from which on a sample is bone
+  int bone_threshold{300};
+  /// Maximum path length (in mm)
+  double max_length{150.0};
+  /// Sampling distance along the path (in mm)
+  double step{0.5};
+  /// Minimum distance (in mm) the path has to keep from the surface of the safe zone
+  double min_clearance{0.0};
+  /// Clearance beyond which the cost does not improve any more (in mm)
+  double clearance_cap{20.0};
+  double clearance_weight{1.0};
+  double bone_weight{25.0};
+  double region_weight{25.0};
+  double length_weight{0.2};
+};
+
+/**
+ * @brief A straight path from a skin entry point to the target, see CTDataset::PlanTrajectories()
+ */
+struct Trajectory {
+  /// First sample outside the body, in voxel coordinates
+  Eigen::Vector3d entry;
+  /// Unit direction from the target towards the entry point, in mm space
+  Eigen::Vector3d direction;
+  /// Path length from the entry point to the target (in mm)
+  double length;
+  /// Distance of the path from the surface of the safe zone (in mm), infinity without a safe zone
+  double clearance;
+  /// Number of separate bone layers along the path
+  int bone_crossings;
+  /// Number of separate parts of the region growing result along the path
+  int region_crossings;
+  /// Weighted cost, see TrajectoryParameters
+  double cost;
+};
+
+/**
+ * @brief Describes a plane through the volume that is sampled into a 2D slice
+ * @details Pixel (u, v) of the slice samples the volume at voxel coordinate origin + u * axis_u + v * axis_v.
+ */
+struct SlicePlane {
+  Eigen::Vector3d origin;
+  Eigen::Vector3d axis_u;
+  Eigen::Vector3d axis_v;
+  int width;
+  int height;
+};
+
+/**
+ * @brief Work done for the last region depth buffer, see CTDataset::UpdateDepthBufferFromRegionGrowing()
+ */
+struct TemporalSplatStats {
+  /// True if every cluster in the view was splatted, without reprojecting the previous frame
+  bool full_refresh{true};
+  /// Number of points seen in the previous frame that were splatted again under the new rotation
+  size_t reprojected_points{0};
+  /// Number of tiles with gaps, next to them or on the image border, whose clusters were splatted again
+  int stale_tiles{0};
+  /// Number of surface points that were projected into the image, including the reprojected ones
+  size_t projected_points{0};
+};
+
 /**
  * @brief The CTDataset class is the central class to initialize and process CT scan images.
  * @details
@@ -24,55 +172,328 @@
 
 class MYLIB_EXPORT CTDataset {
  public:
+  /// Number of region growing results that UndoRegion() can go back
+  static constexpr int kRegionHistoryLevels = 10;
+
+  /// Width, height and number of layers of the raw image files read by load()
+  static constexpr int kRawWidth = 512;
+  static constexpr int kRawHeight = 512;
+  static constexpr int kRawLayers = 256;
+
+  /// Voxel spacing in mm of the raw image files, within the axial plane and between the layers
+  static constexpr double kRawPixelSpacing = 0.523;
+  static constexpr double kRawLayerSpacing = 0.7;
+
+  /// Guard band of the depth, ID and normal buffers in pixels, the radius of the largest stencil run on them
+  static constexpr int kImageGuard = 1;
+
+  /// Edge length in pixels of the tiles that UpdateDepthBufferFromRegionGrowing() marks stale
+  static constexpr int kTemporalTileSize = 8;
+
+  /// Largest rotation between two frames (in radians) for which UpdateDepthBufferFromRegionGrowing() reuses a frame
+  static constexpr double kTemporalMaxAngle = 0.1;
+
+  /// Number of frames UpdateDepthBufferFromRegionGrowing() reprojects before it splats one from scratch again
+  static constexpr int kTemporalRefreshFrames = 10;
+
   CTDataset();
   ~CTDataset();
 
   /// Load CT image data from the specified file path
   Status load(QString &img_path);
 
+  /// Import the uncompressed DICOM series in a directory, taking over its dimensions and voxel spacing
+  Status ImportDicomSeries(QString const &directory);
+
   /// Get a pointer to the image data
   [[nodiscard]] int16_t *Data() const;
 
-  /// Get a pointer to the non-3D rendered depth buffer
-  [[nodiscard]] int *GetDepthBuffer() const;
+  /// Select the memory layout the processing kernels read the voxel volume from
+  Status SetVoxelLayout(VoxelLayout layout);
+
+  /// Get the memory layout the processing kernels read the voxel volume from
+  [[nodiscard]] VoxelLayout GetVoxelLayout() const;
+
+  /// Re-derive the prefiltered volume, the active voxel layout and the brick value ranges after the image data has
+  /// been modified
+  Status RebuildVoxelLayout();
+
+  /// Select the denoising filter applied to the image data before all processing kernels
+  Status SetPrefilter(PrefilterParameters const &params);
+
+  /// Get the denoising filter applied to the image data before all processing kernels
+  [[nodiscard]] PrefilterParameters const &GetPrefilter() const;
+
+  /// Get a pointer to the (possibly prefiltered) volume the processing kernels read
+  [[nodiscard]] const int16_t *FilteredData() const;
+
+  /// Read a single voxel through the active voxel layout
+  [[nodiscard]] inline int16_t Voxel(int x, int y, int z) const {
+	return (m_voxelLayout == VoxelLayout::BRICKED) ? m_brickedVolume.At(x, y, z)
+												   : m_voxelData[x + y * m_imgWidth + (m_imgHeight * m_imgWidth * z)];
+  }
+
+  /// Get a view of the non-3D rendered depth buffer
+  [[nodiscard]] StridedView<const int> GetDepthBuffer() const;
 
   /// Get a pointer to the 3D rendered image buffer
   [[nodiscard]] int *GetRenderedDepthBuffer() const;
 
+  /// Get a view of the ID buffer (linear index of the voxel seen in each pixel, -1 for background)
+  [[nodiscard]] StridedView<const int> GetIdBuffer() const;
+
+  /// Enable or disable writing the ID buffer alongside the depth buffer
+  void SetIdBufferEnabled(bool enabled);
+
+  /// Enable or disable rejecting whole clusters of surface points when splatting the region
+  void SetClusterCullingEnabled(bool enabled);
+
+  /// Look up the voxel that is visible at a pixel of the last depth buffer
+  Status PickVoxel(int const x, int const y, Eigen::Vector3i &voxel) const;
+
   /// Get a pointer to the region growing buffer
   [[nodiscard]] int *GetRegionGrowingBuffer() const;
 
+  /// Set the voxel spacing (in mm) along x, y and z
+  void SetVoxelSpacing(Eigen::Vector3d const &spacing);
+
+  /// Get the voxel spacing (in mm) along x, y and z
+  [[nodiscard]] Eigen::Vector3d const &GetVoxelSpacing() const;
+
+  /// Compute the distance (in mm) of every voxel to the region growing result
+  Status ComputeRegionDistanceField();
+
+  /// Get the distance field of the region growing result
+  [[nodiscard]] DistanceField const &GetRegionDistanceField() const;
+
+  /// Grid with cubic voxels of the given edge length (in mm) over the extent of the volume
+  [[nodiscard]] ResampleGrid IsotropicGrid(double const spacing) const;
+
+  /// Grid with cubic voxels of the given edge length (in mm), aligned with another frame, that covers the volume
+  [[nodiscard]] ResampleGrid FrameGrid(Eigen::Isometry3d const &frame_from_volume, double const spacing) const;
+
+  /// Resample the volume the processing kernels read onto another grid, slab by slab
+  Status ResampleVolume(ResampleGrid const &grid, InterpolationMode const mode,
+						Resampler::SlabCallback const &callback) const;
+
+  /// Resample the region growing result onto another grid as a 0/1 mask, slab by slab
+  Status ResampleRegion(ResampleGrid const &grid, InterpolationMode const mode,
+						Resampler::MaskSlabCallback const &callback) const;
+
   /// Calculates all rendered points and saves them in a member vector
   void CalculateAllRenderedPoints();
 
   /// Normalize pixel values to a pre-defined grey-value range
   static StatusOr<int> WindowInputValue(const int input_value, const int center, const int window_size);
 
+  /// Precompute the windowed grey value of every valid HU value
+  static Status CreateWindowingLUT(int const center, int const window_size, std::vector<uint8_t> &lut);
+
+  /// Window a buffer of HU values through a lookup table created by CreateWindowingLUT
+  static void ApplyWindowingLUT(const int16_t *input, int const count, std::vector<uint8_t> const &lut,
+								uint8_t *output);
+
+  /// Number of slices available in the given orientation
+  [[nodiscard]] int GetSliceCount(SliceOrientation const orientation) const;
+
+  /// Geometry of a slice in the given orientation
+  [[nodiscard]] SlicePlane GetSlicePlane(SliceOrientation const orientation, int const index,
+										 Eigen::Matrix3d const &rotation_mat = Eigen::Matrix3d::Identity()) const;
+
+  /// Multiplanar reformat: sample the HU values of a plane through the volume
+  Status ExtractSlice(SlicePlane const &plane, std::vector<int16_t> &slice) const;
+
+  /// Multiplanar reformat that returns the sampled HU values by value
+  StatusOr<std::vector<int16_t>> ExtractSlice(SlicePlane const &plane) const;
+
+  /// Intensity projection of the whole volume perpendicular to an axis-aligned slice orientation
+  Status CalculateProjection(ProjectionMode const mode, SliceOrientation const orientation,
+							 std::vector<int16_t> &projection, int &width, int &height) const;
+
+  /// Intensity projection along the viewing direction of the rotated 3D view
+  Status CalculateRotatedProjection(ProjectionMode const mode, Eigen::Matrix3d const &rotation_mat,
+									std::vector<int16_t> &projection) const;
+
+  /// Intensity projection along the viewing direction of the rotated 3D view, returned by value
+  StatusOr<std::vector<int16_t>> CalculateRotatedProjection(ProjectionMode const mode,
+															Eigen::Matrix3d const &rotation_mat) const;
+
+  /// Sample a piecewise linear transfer function into a lookup table over all valid HU values
+  static Status CreateTransferFunctionLUT(std::vector<TransferFunctionPoint> const &points,
+										  std::vector<TransferFunctionEntry> &lut);
+
+  /// Transfer function preset with translucent soft tissue and opaque bone
+  static std::vector<TransferFunctionPoint> DefaultTransferFunction();
+
+  /// Direct volume rendering of the rotated volume through a transfer function lookup table
+  Status RenderVolume(std::vector<TransferFunctionEntry> const &transfer_lut, Eigen::Matrix3d const &rotation_mat,
+					  std::vector<uint32_t> &image) const;
+
+  /// Direct volume rendering that returns the image by value
+  StatusOr<std::vector<uint32_t>> RenderVolume(std::vector<TransferFunctionEntry> const &transfer_lut,
+											   Eigen::Matrix3d const &rotation_mat) const;
+
   /// Calculate the depth value for each pixel in the CT image
   Status CalculateDepthBuffer(int const threshold);
 
   /// Calculate the depth value for each pixel in the region determined by region growing
   Status CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d const &rotation_mat);
 
+  /// Update the region depth buffer for a slightly changed rotation by reprojecting the previous frame
+  Status UpdateDepthBufferFromRegionGrowing(Eigen::Matrix3d const &rotation_mat);
+
+  /// Get the work done for the last region depth buffer
+  [[nodiscard]] TemporalSplatStats const &GetTemporalSplatStats() const;
+
+  /// Rasterize the mesh of the region growing result into the depth buffer
+  Status CalculateDepthBufferFromMesh(Eigen::Matrix3d const &rotation_mat);
+
   /// Render a shaded 3D image from the depth buffer
   Status RenderDepthBuffer();
 
+  /// Compute the gradient normal of every voxel once per dataset, used for shading by lookup
+  Status ComputeNormalVolume();
+
+  /// Compute the gradient normals of the surface points of the region growing result only
+  Status ComputeSurfaceNormals();
+
+  /// Generate straight trajectories from the skin to a target and rank them by their cost
+  Status PlanTrajectories(Eigen::Vector3d const &target, PlanningSphere const &safe_zone,
+						  TrajectoryParameters const &params, std::vector<Trajectory> &trajectories) const;
+
+  /// Trajectory planning that returns the ranked trajectories by value
+  StatusOr<std::vector<Trajectory>> PlanTrajectories(Eigen::Vector3d const &target, PlanningSphere const &safe_zone,
+													 TrajectoryParameters const &params) const;
+
   /// Extract HU value from a 3D point specified as a vector
   [[nodiscard]] int GetGreyValue(Eigen::Vector3i const &pt) const;
 
   /// 3D region growing algorithm
   void RegionGrowing3D(Eigen::Vector3i &seed, int const threshold);
 
+  /// Select the neighbourhood region growing follows, e.g. Connectivity::CORNERS for thin vessels
+  void SetRegionConnectivity(Connectivity const connectivity);
+
+  /// Get the neighbourhood region growing follows
+  [[nodiscard]] Connectivity GetRegionConnectivity() const;
+
+  /// Clean up the region growing result with a morphological operation and update everything derived from it
+  Status ApplyRegionMorphology(MorphologyOperation const operation, int const radius);
+
+  /// Go back to the region growing result before the last region growing or morphology
+  Status UndoRegion();
+
+  /// Go forward to the region growing result that the last UndoRegion() went back from
+  Status RedoRegion();
+
+  /// @return True if UndoRegion() has a result to go back to
+  [[nodiscard]] bool CanUndoRegion() const;
+
+  /// @return True if RedoRegion() has a result to go forward to
+  [[nodiscard]] bool CanRedoRegion() const;
+
+  /// @return Bytes held by the undo history, counting bricks that entries share once
+  [[nodiscard]] size_t GetRegionHistoryBytes() const;
+
   /// Saves all points from the region growing algorithm in a member vector
   void AggregatePointsInRegion();
 
   /// Traverses all region growing points and determines the surface points
   Status FindSurfacePoints();
 
+  /// Collects all points of the region growing result and returns them by value
+  [[nodiscard]] StatusOr<std::vector<Eigen::Vector3i>> ExtractPointsInRegion() const;
+
+  /// Collects the surface points of the region growing result and returns them by value
+  [[nodiscard]] StatusOr<std::vector<Eigen::Vector3i>> ExtractSurfacePoints() const;
+
+  /// Extract the surface of the region growing result as an indexed triangle mesh
+  Status ExtractRegionMesh();
+
+  /// Get the surface mesh of the region growing result, empty until it is extracted or rendered
+  [[nodiscard]] TriangleMesh const &GetRegionMesh() const;
+
+  /// Get the clusters of the surface points of the region growing result
+  [[nodiscard]] SurfaceClusters const &GetSurfaceClusters() const;
+
+  /// Write the surface mesh of the region growing result as a binary PLY mesh with normals
+  Status ExportRegionMesh(QString const &path);
+
+  /// Write the surface points of the region growing result as a binary PLY point cloud
+  Status ExportSurfacePoints(QString const &path);
+
+  /// Write the region growing result as a run-length encoded mask file
+  Status ExportRegionMask(QString const &path) const;
+
   /// Traverses all points in the region and computes the average of their coordinates
   Status FindPointCloudCenter();
 
  private:
+  /// Recomputes the prefilter if it is outdated and derives the voxel layout from its result
+  Status UpdateVoxelLayout();
+
+  /// Reallocates all volume and image buffers for new dimensions, zero-initialized
+  void Allocate(int const width, int const height, int const layers);
+
+  /// Drops everything derived from the previous image data after new data has been loaded
+  Status ResetAfterLoad();
+
+  /// Recomputes surface points, normals and barycenter after the region growing buffer has changed
+  void UpdateRegionResults();
+
+  /// Recomputes surface points, normals and their clusters from the region growing buffer
+  void UpdateSurfaceResults();
+
+  /// Selects the kernel instantiations for the voxel type of the image data and the region connectivity
+  void SelectKernels();
+
+  /// Region growing kernel for m_regionConnectivity that reads the voxels from m_brickedVolume
+  void GrowRegionBricked(Eigen::Vector3i const &seed, int const threshold);
+
+  /// Region growing result, one entry of the undo history; everything else is derived from it again when needed
+  struct RegionState {
+	LabelSnapshot labels;
+	int threshold;
+	Eigen::Vector3d center;
+  };
+
+  /// Appends the current region growing result to the undo history and drops the results that could be redone
+  void PushRegionState();
+
+  /// Makes an entry of the undo history the current region growing result
+  void RestoreRegionState(int const index);
+
+  /// Splats one entry of m_surfacePoints as a cross of five pixels if it passes the depth test
+  void SplatSurfacePoint(Eigen::Matrix3d const &rotation_mat, uint32_t index);
+
+  /// Splats the points of one entry of m_surfaceClusters and returns their number
+  size_t SplatSurfaceCluster(Eigen::Matrix3d const &rotation_mat, int cluster);
+
+  /// Closes pinholes and cracks of the region depth buffer, counts covered and gap pixels per temporal tile
+  void FillPinholesAndCountTiles(std::vector<int> &covered, std::vector<int> &gaps);
+
+  /// Writes the ID and normal buffers for the points of m_pointBuffer and flags them in m_pointSeen
+  void ResolveSurfaceBuffers();
+
+  /// First-hit depth ray kernel, generic over the voxel layout
+  template<typename VoxelAccessor>
+  void CalculateDepthBufferImpl(VoxelAccessor const &voxel, int const threshold);
+
+  /// Rotated projection kernel, generic over the voxel layout
+  template<typename VoxelAccessor>
+  void CalculateRotatedProjectionImpl(VoxelAccessor const &voxel, ProjectionMode const mode,
+									  Eigen::Matrix3d const &rotation_mat, int16_t *projection) const;
+
+  /// Front-to-back compositing kernel, generic over the voxel layout
+  template<typename VoxelAccessor>
+  void RenderVolumeImpl(VoxelAccessor const &voxel, std::vector<TransferFunctionEntry> const &transfer_lut,
+						std::vector<uint8_t> const &brick_visible, Eigen::Matrix3d const &rotation_mat,
+						uint32_t *image) const;
+
+  /// Slice sampling kernel, generic over the voxel layout
+  template<typename VoxelAccessor>
+  void ExtractSliceImpl(VoxelAccessor const &voxel, SlicePlane const &plane, int16_t *slice) const;
+
   /// Height of the provided CT image (in pixels)
   int m_imgHeight;
 
@@ -85,21 +506,130 @@ class MYLIB_EXPORT CTDataset {
   /// Buffer for the raw image data
   int16_t *m_imgData;
 
-  /// Buffer for the calculated depth values
-  int *m_depthBuffer;
+  /// Parameters of the prefilter stage
+  PrefilterParameters m_prefilterParameters;
+
+  /// Prefiltered copy of m_imgData, empty without a prefilter
+  std::vector<int16_t> m_filteredData;
+
+  /// False if m_filteredData has to be recomputed
+  bool m_prefilterValid{false};
+
+  /// Volume read by all processing kernels: m_filteredData with a prefilter, m_imgData without
+  const int16_t *m_voxelData;
+
+  /// Voxel spacing along x, y and z in mm
+  Eigen::Vector3d m_voxelSpacing{kRawPixelSpacing, kRawPixelSpacing, kRawLayerSpacing};
+
+  /// Memory layout used by the processing kernels
+  VoxelLayout m_voxelLayout{VoxelLayout::LINEAR};
+
+  /// Bricked copy of m_imgData, only populated for VoxelLayout::BRICKED
+  BrickedVolume m_brickedVolume;
+
+  /// Minimum HU value of every brick, used for empty space skipping
+  std::vector<int16_t> m_brickMin;
+
+  /// Maximum HU value of every brick, used for empty space skipping
+  std::vector<int16_t> m_brickMax;
+
+  /// Buffer for the calculated depth values, background depth in the guard band
+  GuardedBuffer<int> m_depthBuffer;
 
   /// Buffer for the rendered image
   int *m_renderedDepthBuffer;
 
+  /// Linear voxel index of the surface seen in each pixel of m_depthBuffer, -1 for background and in the guard band
+  GuardedBuffer<int> m_idBuffer;
+
+  /// Whether the depth buffer calculations also write m_idBuffer
+  bool m_idBufferEnabled{true};
+
+  /// Encoded normal of the surface seen in each pixel of m_depthBuffer
+  GuardedBuffer<uint16_t> m_normalBuffer;
+
+  /// Whether m_normalBuffer holds a normal for every foreground pixel of the last depth buffer
+  bool m_normalBufferValid{false};
+
+  /// Rotation of the view of the last depth buffer, applied to the normals when shading
+  Eigen::Matrix3d m_viewRotation{Eigen::Matrix3d::Identity()};
+
+  /// Gradient normals of all voxels, only populated by ComputeNormalVolume()
+  NormalVolume m_normalVolume;
+
+  /// Gradient normals of m_surfacePoints (same order)
+  std::vector<uint16_t> m_surfaceNormals;
+
   /// Buffer for the region growing image
   int *m_regionBuffer;
 
+  /// Neighbourhood region growing follows
+  Connectivity m_regionConnectivity{Connectivity::FACES};
+
+  /// Region growing kernel for the voxel type and m_regionConnectivity, chosen once per load by SelectKernels()
+  voxel_kernels::RegionGrowingKernel m_regionGrowingKernel{nullptr};
+
+  /// Distance of every voxel to the region growing result, only populated by ComputeRegionDistanceField()
+  DistanceField m_regionDistance;
+
   /// Buffer for visited points during RG
   int *m_visitedBuffer;
 
+  /// Undo history of the region growing result, oldest first, at most kRegionHistoryLevels + 1 entries
+  std::deque<RegionState> m_regionHistory;
+
+  /// Entry of m_regionHistory that the region growing buffer holds, -1 without history
+  int m_regionHistoryIndex{-1};
+
   /// Surface points of the region determined by RG
   std::vector<Eigen::Vector3i> m_surfacePoints;
 
+  /// Whether m_surfacePoints, m_surfaceNormals and m_surfaceClusters belong to the region growing buffer; undo and
+  /// redo drop them until the next splat render
+  bool m_surfaceResultsValid{true};
+
+  /// HU threshold of the last region growing
+  int m_regionThreshold{0};
+
+  /// Surface mesh of the region determined by RG
+  TriangleMesh m_regionMesh;
+
+  /// Whether m_regionMesh belongs to the region growing buffer; the mesh is extracted on first use
+  bool m_regionMeshValid{false};
+
+  /// Clusters of m_surfacePoints with bounding spheres and normal cones, for culling in the splat renderer
+  SurfaceClusters m_surfaceClusters;
+
+  /// Incremented whenever m_surfacePoints is replaced, so that clusters of older points are not used
+  uint64_t m_surfaceGeneration{0};
+
+  /// Value of m_surfaceGeneration for the points that m_surfaceClusters was built from
+  uint64_t m_clusterGeneration{0};
+
+  /// Whether CalculateDepthBufferFromRegionGrowing() culls m_surfaceClusters
+  bool m_clusterCullingEnabled{true};
+
+  /// Index into m_surfacePoints of the point seen in each pixel of m_depthBuffer, -1 for background
+  GuardedBuffer<int> m_pointBuffer;
+
+  /// Point buffer of the frame before, kept while UpdateDepthBufferFromRegionGrowing() reprojects it
+  GuardedBuffer<int> m_previousPointBuffer;
+
+  /// Whether m_pointBuffer belongs to the last depth buffer, so that the next frame can reproject its points
+  bool m_pointBufferValid{false};
+
+  /// Frames reprojected by UpdateDepthBufferFromRegionGrowing() since the last frame splatted from scratch
+  int m_framesSinceRefresh{0};
+
+  /// Flag per entry of m_surfacePoints, set if the point was seen in a pixel since the last frame splatted from scratch
+  std::vector<uint8_t> m_pointSeen;
+
+  /// Flag per tile of kTemporalTileSize pixels, row by row, set if its clusters have to be splatted again
+  std::vector<uint8_t> m_staleTiles;
+
+  /// Work done for the last region depth buffer
+  TemporalSplatStats m_temporalStats;
+
   /// All points fo the region growing region
   std::vector<Eigen::Vector3i> m_allPointsInRegion;
 
@@ -0,0 +1,469 @@
+#include "dicom_series.h"
+#include "parallel.h"
+#include "simd.h"
+#include "Eigen/Geometry"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+constexpr int DicomSeries::kHeaderChunkSize;
+
+namespace {
+constexpr uint32_t kTransferSyntaxUid = 0x00020010;
+constexpr uint32_t kSliceThickness = 0x00180050;
+constexpr uint32_t kSeriesInstanceUid = 0x0020000E;
+constexpr uint32_t kInstanceNumber = 0x00200013;
+constexpr uint32_t kImagePosition = 0x00200032;
+constexpr uint32_t kImageOrientation = 0x00200037;
+constexpr uint32_t kSamplesPerPixel = 0x00280002;
+constexpr uint32_t kRows = 0x00280010;
+constexpr uint32_t kColumns = 0x00280011;
+constexpr uint32_t kPixelSpacing = 0x00280030;
+constexpr uint32_t kBitsAllocated = 0x00280100;
+constexpr uint32_t kPixelRepresentation = 0x00280103;
+constexpr uint32_t kRescaleIntercept = 0x00281052;
+constexpr uint32_t kRescaleSlope = 0x00281053;
+constexpr uint32_t kPixelData = 0x7FE00010;
+constexpr uint32_t kItem = 0xFFFEE000;
+constexpr uint32_t kItemDelimiter = 0xFFFEE00D;
+constexpr uint32_t kSequenceDelimiter = 0xFFFEE0DD;
+constexpr uint32_t kUndefinedLength = 0xFFFFFFFF;
+
+constexpr char kImplicitVrLittleEndian[] = "1.2.840.10008.1.2";
+constexpr char kExplicitVrLittleEndian[] = "1.2.840.10008.1.2.1";
+
+/// Valid HU range of the windowing and transfer function tables, rescaled values are clamped to it
+constexpr int16_t kLowestHu = -1024;
+constexpr int16_t kHighestHu = 3071;
+
+/**
+ * @brief Position in a header that is held in memory, and the VR encoding of the elements at that position
+ */
+struct HeaderParser {
+  const char *data;
+  size_t size;
+  size_t position;
+  bool explicit_vr;
+
+  [[nodiscard]] bool Has(size_t count) const { return size - position >= count; }
+
+  uint16_t ReadU16() {
+	uint16_t value = 0;
+	std::memcpy(&value, data + position, sizeof(value));
+	position += sizeof(value);
+	return value;
+  }
+
+  uint32_t ReadU32() {
+	uint32_t value = 0;
+	std::memcpy(&value, data + position, sizeof(value));
+	position += sizeof(value);
+	return value;
+  }
+
+  bool Skip(size_t count) {
+	if (!Has(count)) {
+	  return false;
+	}
+	position += count;
+	return true;
+  }
+};
+
+struct ElementHeader {
+  uint32_t tag;
+  char vr[2];
+  uint32_t length;
+};
+
+/// VRs whose explicit encoding has two reserved bytes and a 32-bit length
+bool HasLongLength(char const vr[2]) {
+  static char const *const kLongVrs[] = {"OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV"};
+  return std::any_of(std::begin(kLongVrs), std::end(kLongVrs),
+					 [vr](char const *long_vr) { return vr[0] == long_vr[0] && vr[1] == long_vr[1]; });
+}
+
+/// Reads the tag, VR and length of the next element; items and delimiters never have a VR
+bool ReadElementHeader(HeaderParser &parser, ElementHeader &element) {
+  if (!parser.Has(8)) {
+	return false;
+  }
+  uint16_t const group = parser.ReadU16();
+  element.tag = (static_cast<uint32_t>(group) << 16) | parser.ReadU16();
+  element.vr[0] = element.vr[1] = ' ';
+  if (group == 0xFFFE || !parser.explicit_vr) {
+	element.length = parser.ReadU32();
+	return true;
+  }
+  element.vr[0] = parser.data[parser.position];
+  element.vr[1] = parser.data[parser.position + 1];
+  parser.position += 2;
+  if (!HasLongLength(element.vr)) {
+	element.length = parser.ReadU16();
+	return true;
+  }
+  if (!parser.Has(6)) {
+	return false;
+  }
+  parser.position += 2;
+  element.length = parser.ReadU32();
+  return true;
+}
+
+bool SkipItem(HeaderParser &parser);
+
+/// Skips the items of a sequence of undefined length, up to and including its delimiter
+bool SkipSequence(HeaderParser &parser) {
+  ElementHeader element;
+  while (ReadElementHeader(parser, element)) {
+	if (element.tag == kSequenceDelimiter) {
+	  return true;
+	}
+	if (element.tag != kItem) {
+	  return false;
+	}
+	if (!(element.length == kUndefinedLength ? SkipItem(parser) : parser.Skip(element.length))) {
+	  return false;
+	}
+  }
+  return false;
+}
+
+/// Skips the elements of an item of undefined length, up to and including its delimiter
+bool SkipItem(HeaderParser &parser) {
+  ElementHeader element;
+  while (ReadElementHeader(parser, element)) {
+	if (element.tag == kItemDelimiter) {
+	  return true;
+	}
+	if (!(element.length == kUndefinedLength ? SkipSequence(parser) : parser.Skip(element.length))) {
+	  return false;
+	}
+  }
+  return false;
+}
+
+/// Text value without the padding spaces and zeros
+std::string ParseText(const char *value, size_t length) {
+  std::string text(value, length);
+  size_t const first = text.find_first_not_of(" \0", 0, 2);
+  size_t const last = text.find_last_not_of(" \0", std::string::npos, 2);
+  return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+/// Backslash-separated decimal strings (DS) or integer strings (IS)
+std::vector<double> ParseNumbers(const char *value, size_t length) {
+  std::string const text = ParseText(value, length);
+  std::vector<double> numbers;
+  const char *begin = text.c_str();
+  while (*begin != '\0') {
+	char *end = nullptr;
+	double const number = std::strtod(begin, &end);
+	if (end == begin) {
+	  break;
+	}
+	numbers.push_back(number);
+	begin = end;
+	while (*begin == ' ' || *begin == '\\') {
+	  ++begin;
+	}
+  }
+  return numbers;
+}
+
+uint16_t ParseU16(const char *value) {
+  uint16_t number = 0;
+  std::memcpy(&number, value, sizeof(number));
+  return number;
+}
+
+/**
+ * @brief Parses a Part 10 header that is held in memory up to the pixel data
+ * @return StatusCode::OK, or StatusCode::FILE_FORMAT_ERROR if the header is not supported or ends before the pixel data
+ */
+Status ParseHeader(const char *data, size_t size, DicomSliceInfo &info) {
+  if (size < 132 || std::memcmp(data + 128, "DICM", 4) != 0) {
+	return Status(StatusCode::FILE_FORMAT_ERROR);
+  }
+  HeaderParser parser{data, size, 132, true};
+  ElementHeader element;
+
+  // File meta information, always explicit VR little endian
+  std::string transfer_syntax;
+  while (parser.Has(2) && ParseU16(data + parser.position) == 0x0002) {
+	if (!ReadElementHeader(parser, element) || !parser.Has(element.length)) {
+	  return Status(StatusCode::FILE_FORMAT_ERROR);
+	}
+	if (element.tag == kTransferSyntaxUid) {
+	  transfer_syntax = ParseText(data + parser.position, element.length);
+	}
+	parser.position += element.length;
+  }
+  if (transfer_syntax == kImplicitVrLittleEndian) {
+	parser.explicit_vr = false;
+  } else if (transfer_syntax != kExplicitVrLittleEndian) {
+	return Status(StatusCode::FILE_FORMAT_ERROR);
+  }
+
+  while (ReadElementHeader(parser, element)) {
+	if (element.tag == kPixelData) {
+	  // Undefined length means encapsulated, i.e. compressed pixel data
+	  if (element.length == kUndefinedLength) {
+		return Status(StatusCode::FILE_FORMAT_ERROR);
+	  }
+	  info.pixel_offset = static_cast<int64_t>(parser.position);
+	  info.pixel_length = element.length;
+	  return Status(StatusCode::OK);
+	}
+	if (element.length == kUndefinedLength) {
+	  // Sequence; the content of UN elements of undefined length is always implicit VR
+	  bool const explicit_vr = parser.explicit_vr;
+	  parser.explicit_vr = explicit_vr && !(element.vr[0] == 'U' && element.vr[1] == 'N');
+	  bool const skipped = SkipSequence(parser);
+	  parser.explicit_vr = explicit_vr;
+	  if (!skipped) {
+		return Status(StatusCode::FILE_FORMAT_ERROR);
+	  }
+	  continue;
+	}
+	if (!parser.Has(element.length)) {
+	  return Status(StatusCode::FILE_FORMAT_ERROR);
+	}
+
+	const char *value = data + parser.position;
+	std::vector<double> numbers;
+	switch (element.tag) {
+	  case kSliceThickness:
+		numbers = ParseNumbers(value, element.length);
+		info.slice_thickness = numbers.empty() ? 0.0 : numbers[0];
+		break;
+	  case kSeriesInstanceUid:
+		info.series_uid = ParseText(value, element.length);
+		break;
+	  case kInstanceNumber:
+		numbers = ParseNumbers(value, element.length);
+		info.instance_number = numbers.empty() ? 0 : static_cast<int>(numbers[0]);
+		break;
+	  case kImagePosition:
+		numbers = ParseNumbers(value, element.length);
+		if (numbers.size() == 3) {
+		  info.position = Eigen::Vector3d(numbers[0], numbers[1], numbers[2]);
+		  info.has_position = true;
+		}
+		break;
+	  case kImageOrientation:
+		numbers = ParseNumbers(value, element.length);
+		if (numbers.size() == 6) {
+		  info.row_direction = Eigen::Vector3d(numbers[0], numbers[1], numbers[2]);
+		  info.column_direction = Eigen::Vector3d(numbers[3], numbers[4], numbers[5]);
+		}
+		break;
+	  case kPixelSpacing:
+		numbers = ParseNumbers(value, element.length);
+		if (numbers.size() == 2) {
+		  info.pixel_spacing = Eigen::Vector2d(numbers[0], numbers[1]);
+		}
+		break;
+	  case kRescaleIntercept:
+		numbers = ParseNumbers(value, element.length);
+		info.rescale_intercept = numbers.empty() ? 0.0 : numbers[0];
+		break;
+	  case kRescaleSlope:
+		numbers = ParseNumbers(value, element.length);
+		info.rescale_slope = numbers.empty() ? 1.0 : numbers[0];
+		break;
+	  case kSamplesPerPixel:
+	  case kRows:
+	  case kColumns:
+	  case kBitsAllocated:
+	  case kPixelRepresentation:
+		if (element.length >= 2) {
+		  int const number = ParseU16(value);
+		  if (element.tag == kSamplesPerPixel) {
+			info.samples_per_pixel = number;
+		  } else if (element.tag == kRows) {
+			info.rows = number;
+		  } else if (element.tag == kColumns) {
+			info.columns = number;
+		  } else if (element.tag == kBitsAllocated) {
+			info.bits_allocated = number;
+		  } else {
+			info.is_signed = number == 1;
+		  }
+		}
+		break;
+	  default:
+		break;
+	}
+	parser.position += element.length;
+  }
+  return Status(StatusCode::FILE_FORMAT_ERROR);
+}
+} // namespace
+
+/**
+ * @details Only the first kHeaderChunkSize bytes are read, which hold the whole header of almost every image; if the
+ * pixel data does not start within them, the whole file is read and parsed again.
+ * @param path Path of the DICOM file
+ * @param info Output: the header fields of the image
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR if the file cannot be read, or StatusCode::FILE_FORMAT_ERROR if it
+ * is no Part 10 file, uses an unsupported transfer syntax, has no native 16-bit single-sample pixel data or is
+ * truncated
+ */
+Status DicomSeries::ReadSliceInfo(QString const &path, DicomSliceInfo &info) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+	return Status(StatusCode::FOPEN_ERROR);
+  }
+  auto const file_size = static_cast<int64_t>(file.size());
+  std::vector<char> header(static_cast<size_t>(std::min<int64_t>(file_size, kHeaderChunkSize)));
+  if (file.read(header.data(), static_cast<qint64>(header.size())) != static_cast<qint64>(header.size())) {
+	return Status(StatusCode::FOPEN_ERROR);
+  }
+  info = DicomSliceInfo();
+  Status status = ParseHeader(header.data(), header.size(), info);
+  if (!status.Ok() && static_cast<int64_t>(header.size()) < file_size) {
+	size_t const chunk_size = header.size();
+	header.resize(static_cast<size_t>(file_size));
+	qint64 const rest = static_cast<qint64>(header.size() - chunk_size);
+	if (file.read(header.data() + chunk_size, rest) != rest) {
+	  return Status(StatusCode::FOPEN_ERROR);
+	}
+	info = DicomSliceInfo();
+	status = ParseHeader(header.data(), header.size(), info);
+  }
+  file.close();
+  info.path = path;
+  if (!status.Ok()) {
+	return status;
+  }
+
+  int64_t const pixel_bytes = static_cast<int64_t>(info.rows) * info.columns * sizeof(int16_t);
+  if (info.rows <= 0 || info.columns <= 0 || info.samples_per_pixel != 1 || info.bits_allocated != 16
+	|| info.pixel_length < pixel_bytes || info.pixel_offset + pixel_bytes > file_size) {
+	return Status(StatusCode::FILE_FORMAT_ERROR);
+  }
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The headers of all files are parsed in parallel; files that are no supported DICOM images (e.g. DICOMDIR
+ * or notes) are ignored. If the directory holds several series, the one with the most images is taken. Its slices
+ * are sorted by their position along the normal of the image plane, or by instance number if a slice has no position.
+ * The slice spacing is the average distance between neighbouring positions; without positions it is the slice
+ * thickness.
+ * @param directory Directory that contains the DICOM files (subdirectories are not searched)
+ * @param slices Output: header fields of the slices of the series, sorted from first to last layer
+ * @param spacing Output: voxel spacing along x (columns), y (rows) and z (slices) in mm
+ * @return StatusCode::OK, StatusCode::FOPEN_ERROR if the directory does not exist, or StatusCode::FILE_FORMAT_ERROR
+ * if it holds no supported image or the images of the series differ in size
+ */
+Status DicomSeries::ScanDirectory(QString const &directory, std::vector<DicomSliceInfo> &slices,
+								  Eigen::Vector3d &spacing) {
+  QDir const dir(directory);
+  if (!dir.exists()) {
+	return Status(StatusCode::FOPEN_ERROR);
+  }
+  QStringList const names = dir.entryList(QDir::Files, QDir::Name);
+  std::vector<QString> paths;
+  for (QString const &name : names) {
+	paths.push_back(dir.filePath(name));
+  }
+
+  std::vector<DicomSliceInfo> infos(paths.size());
+  std::vector<uint8_t> valid(paths.size(), 0);
+  utils::ParallelFor(0, static_cast<int>(paths.size()), [&](int i) {
+	valid[i] = ReadSliceInfo(paths[i], infos[i]).Ok() ? 1 : 0;
+  });
+
+  // The largest series, the first one in file name order on a tie
+  std::map<std::string, int> series_sizes;
+  std::string series_uid;
+  int series_size = 0;
+  for (size_t i = 0; i < infos.size(); ++i) {
+	if (valid[i] && ++series_sizes[infos[i].series_uid] > series_size) {
+	  series_size = series_sizes[infos[i].series_uid];
+	  series_uid = infos[i].series_uid;
+	}
+  }
+  slices.clear();
+  for (size_t i = 0; i < infos.size(); ++i) {
+	if (valid[i] && infos[i].series_uid == series_uid) {
+	  slices.push_back(std::move(infos[i]));
+	}
+  }
+  if (slices.empty()) {
+	return Status(StatusCode::FILE_FORMAT_ERROR);
+  }
+  DicomSliceInfo const &first = slices.front();
+  for (auto const &slice : slices) {
+	if (slice.rows != first.rows || slice.columns != first.columns) {
+	  return Status(StatusCode::FILE_FORMAT_ERROR);
+	}
+  }
+
+  Eigen::Vector3d const normal = first.row_direction.cross(first.column_direction);
+  bool const positioned = std::all_of(slices.begin(), slices.end(),
+									  [](DicomSliceInfo const &slice) { return slice.has_position; });
+  auto const key = [&](DicomSliceInfo const &slice) {
+	return positioned ? slice.position.dot(normal) : static_cast<double>(slice.instance_number);
+  };
+  std::stable_sort(slices.begin(), slices.end(),
+				   [&](DicomSliceInfo const &a, DicomSliceInfo const &b) { return key(a) < key(b); });
+
+  double slice_spacing = 0.0;
+  if (positioned && slices.size() > 1) {
+	slice_spacing = (key(slices.back()) - key(slices.front())) / static_cast<double>(slices.size() - 1);
+  }
+  if (slice_spacing <= 0.0) {
+	slice_spacing = first.slice_thickness > 0.0 ? first.slice_thickness : 1.0;
+  }
+  spacing = Eigen::Vector3d(first.pixel_spacing.y(), first.pixel_spacing.x(), slice_spacing);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The slices are spread over the thread pool. Every slice is read from its file straight into its layer of
+ * the volume and then rescaled in place with its own slope and intercept, clamped to the valid HU range (-1024 to
+ * 3071). Pixel data is assumed to be in host byte order, i.e. little endian.
+ * @param slices Sorted slices of one series, see ScanDirectory()
+ * @param volume Output: rows x columns x slices HU values, x (columns) fastest
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY without slices or volume, StatusCode::FOPEN_ERROR if a file cannot
+ * be read, or StatusCode::FILE_FORMAT_ERROR if a slice has a different size than the first one
+ */
+Status DicomSeries::ReadPixelData(std::vector<DicomSliceInfo> const &slices, int16_t *volume) {
+  if (slices.empty() || volume == nullptr) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  int const slice_voxels = slices.front().rows * slices.front().columns;
+  auto const slice_bytes = static_cast<qint64>(slice_voxels * sizeof(int16_t));
+  std::vector<Status> statuses(slices.size());
+  utils::ParallelFor(0, static_cast<int>(slices.size()), [&](int z) {
+	DicomSliceInfo const &slice = slices[z];
+	if (slice.rows * slice.columns != slice_voxels) {
+	  statuses[z] = Status(StatusCode::FILE_FORMAT_ERROR);
+	  return;
+	}
+	int16_t *layer = volume + static_cast<size_t>(z) * slice_voxels;
+	QFile file(slice.path);
+	if (!file.open(QIODevice::ReadOnly) || !file.seek(slice.pixel_offset)
+	  || file.read(reinterpret_cast<char *>(layer), slice_bytes) != slice_bytes) {
+	  statuses[z] = Status(StatusCode::FOPEN_ERROR);
+	  return;
+	}
+	simd::RescaleRow(layer, slice.is_signed, static_cast<float>(slice.rescale_slope),
+					 static_cast<float>(slice.rescale_intercept), kLowestHu, kHighestHu, slice_voxels);
+  });
+  for (Status const &status : statuses) {
+	if (!status.Ok()) {
+	  return status;
+	}
+  }
+  return Status(StatusCode::OK);
+}
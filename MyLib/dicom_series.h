@@ -0,0 +1,74 @@
+#ifndef DICOM_SERIES_H
+#define DICOM_SERIES_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "Eigen/Core"
+
+#include <QString>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The header fields of one DICOM image that the importer needs
+ */
+struct DicomSliceInfo {
+  /// File the slice was read from
+  QString path;
+  /// Series Instance UID (0020,000E)
+  std::string series_uid;
+  /// Rows (0028,0010) and Columns (0028,0011)
+  int rows{0};
+  int columns{0};
+  /// Samples per Pixel (0028,0002)
+  int samples_per_pixel{1};
+  /// Bits Allocated (0028,0100)
+  int bits_allocated{0};
+  /// Pixel Representation (0028,0103): true for two's complement pixel values
+  bool is_signed{false};
+  /// Rescale Slope (0028,1053) and Rescale Intercept (0028,1052), mapping stored values to HU
+  double rescale_slope{1.0};
+  double rescale_intercept{0.0};
+  /// Pixel Spacing (0028,0030) in mm: distance between rows, then between columns
+  Eigen::Vector2d pixel_spacing{1.0, 1.0};
+  /// Slice Thickness (0018,0050) in mm, 0 if missing
+  double slice_thickness{0.0};
+  /// Image Position (Patient) (0020,0032) in mm, only valid if has_position is set
+  Eigen::Vector3d position{0.0, 0.0, 0.0};
+  bool has_position{false};
+  /// Image Orientation (Patient) (0020,0037): direction of the rows and of the columns
+  Eigen::Vector3d row_direction{1.0, 0.0, 0.0};
+  Eigen::Vector3d column_direction{0.0, 1.0, 0.0};
+  /// Instance Number (0020,0013), used for sorting if there is no position
+  int instance_number{0};
+  /// Byte offset and length of the native Pixel Data (7FE0,0010) in the file
+  int64_t pixel_offset{-1};
+  int64_t pixel_length{0};
+};
+
+/**
+ * @brief Dependency-free reader for uncompressed CT series in DICOM Part 10 files
+ * @details Only the implicit and explicit VR little endian transfer syntaxes are supported, with one 16-bit sample
+ * per pixel. Headers are parsed up to the pixel data, decoding only the tags of DicomSliceInfo and skipping the value
+ * of every other element (including sequences of undefined length) without interpreting it. Pixel data is read
+ * straight into the destination volume and rescaled to HU in place.
+ */
+class MYLIB_EXPORT DicomSeries {
+ public:
+  /// Number of bytes read at first when parsing a header; longer headers are read completely
+  static constexpr int kHeaderChunkSize = 64 * 1024;
+
+  /// Parses the header of one DICOM file
+  static Status ReadSliceInfo(QString const &path, DicomSliceInfo &info);
+
+  /// Finds the DICOM series with the most slices in a directory and sorts its slices along the slice normal
+  static Status ScanDirectory(QString const &directory, std::vector<DicomSliceInfo> &slices,
+							  Eigen::Vector3d &spacing);
+
+  /// Reads the pixel data of sorted slices into a volume, one layer per slice, rescaled to HU
+  static Status ReadPixelData(std::vector<DicomSliceInfo> const &slices, int16_t *volume);
+};
+
+#endif  // DICOM_SERIES_H
@@ -0,0 +1,215 @@
+#include "distance_field.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @details Three passes over the volume:
+ * - x: two scans per row find the index distance to the nearest feature voxel on either side, one layer per thread
+ * - y: the columns of a layer are gathered into a transposed buffer, so that reads and writes stay row-wise, and the
+ *   lower envelope is taken per column, one layer per thread
+ * - z: the same for the xz-plane of every row index y, one plane per thread. The square root is taken on the way out.
+ *
+ * Voxels of lines without any feature carry infinity until a later pass finds one. The result is exact for the
+ * Euclidean distance between voxel centers.
+ * @param labels Flat x-fastest label volume, e.g. the region growing buffer
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param feature_label Label of the voxels the distances are measured to
+ * @param spacing Voxel spacing along x, y and z in mm
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the volume is empty or has no voxel with the feature label
+ */
+Status DistanceField::Build(const int *labels, int width, int height, int layers, int feature_label,
+							Eigen::Vector3d const &spacing) {
+  if (labels == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	Clear();
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  size_t const voxel_count = slice_size * layers;
+  if (std::find(labels, labels + voxel_count, feature_label) == labels + voxel_count) {
+	Clear();
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  m_width = width;
+  m_height = height;
+  m_layers = layers;
+  m_spacing = spacing;
+  m_distances.resize(voxel_count);
+  float const infinity = std::numeric_limits<float>::infinity();
+
+  // Pass along x: squared distance to the nearest feature voxel of the same row
+  double const weight_x = spacing.x() * spacing.x();
+  utils::ParallelFor(0, layers, [&](int z) {
+	for (int y = 0; y < height; ++y) {
+	  const int *row = labels + z * slice_size + static_cast<size_t>(y) * width;
+	  float *out = m_distances.data() + z * slice_size + static_cast<size_t>(y) * width;
+	  int last_feature = -1;
+	  for (int x = 0; x < width; ++x) {
+		if (row[x] == feature_label) {
+		  last_feature = x;
+		}
+		out[x] = (last_feature < 0) ? infinity
+									: static_cast<float>(weight_x * (x - last_feature) * (x - last_feature));
+	  }
+	  last_feature = -1;
+	  for (int x = width - 1; x >= 0; --x) {
+		if (row[x] == feature_label) {
+		  last_feature = x;
+		}
+		if (last_feature >= 0) {
+		  out[x] = std::min(out[x], static_cast<float>(weight_x * (last_feature - x) * (last_feature - x)));
+		}
+	  }
+	}
+  });
+
+  // Pass along y, on the transposed layer
+  double const weight_y = spacing.y() * spacing.y();
+  utils::ParallelFor(0, layers, [&](int z) {
+	float *layer = m_distances.data() + z * slice_size;
+	std::vector<float> transposed(slice_size);
+	std::vector<float> line(height);
+	std::vector<int> apexes(height);
+	std::vector<float> boundaries(2 * height + 1);
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		transposed[static_cast<size_t>(x) * height + y] = layer[static_cast<size_t>(y) * width + x];
+	  }
+	}
+	for (int x = 0; x < width; ++x) {
+	  float *column = transposed.data() + static_cast<size_t>(x) * height;
+	  EnvelopePass(column, height, weight_y, line.data(), apexes.data(), boundaries.data());
+	  std::copy(line.begin(), line.end(), column);
+	}
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		layer[static_cast<size_t>(y) * width + x] = transposed[static_cast<size_t>(x) * height + y];
+	  }
+	}
+  });
+
+  // Pass along z, on the transposed xz-plane of every row index
+  double const weight_z = spacing.z() * spacing.z();
+  utils::ParallelFor(0, height, [&](int y) {
+	float *plane = m_distances.data() + static_cast<size_t>(y) * width;
+	std::vector<float> transposed(static_cast<size_t>(width) * layers);
+	std::vector<float> line(layers);
+	std::vector<int> apexes(layers);
+	std::vector<float> boundaries(2 * layers + 1);
+	for (int z = 0; z < layers; ++z) {
+	  for (int x = 0; x < width; ++x) {
+		transposed[static_cast<size_t>(x) * layers + z] = plane[z * slice_size + x];
+	  }
+	}
+	for (int x = 0; x < width; ++x) {
+	  float *column = transposed.data() + static_cast<size_t>(x) * layers;
+	  EnvelopePass(column, layers, weight_z, line.data(), apexes.data(), boundaries.data());
+	  std::copy(line.begin(), line.end(), column);
+	}
+	for (int z = 0; z < layers; ++z) {
+	  for (int x = 0; x < width; ++x) {
+		plane[z * slice_size + x] = std::sqrt(transposed[static_cast<size_t>(x) * layers + z]);
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+void DistanceField::Clear() {
+  m_distances.clear();
+  m_distances.shrink_to_fit();
+  m_width = m_height = m_layers = 0;
+}
+
+/**
+ * @details The field is interpolated trilinearly between the voxel centers, where it is exact. A point outside the
+ * volume is clamped to the volume and the distance to the clamped point is added, which bounds the true distance
+ * from above.
+ * @param point Point in voxel coordinates
+ * @return Distance in mm, or infinity if no field has been computed
+ */
+double DistanceField::DistanceAt(Eigen::Vector3d const &point) const {
+  if (m_distances.empty()) {
+	return std::numeric_limits<double>::infinity();
+  }
+  Eigen::Vector3d const clamped(std::min(std::max(point.x(), 0.0), static_cast<double>(m_width - 1)),
+								std::min(std::max(point.y(), 0.0), static_cast<double>(m_height - 1)),
+								std::min(std::max(point.z(), 0.0), static_cast<double>(m_layers - 1)));
+  int const x0 = std::min(static_cast<int>(clamped.x()), std::max(m_width - 2, 0));
+  int const y0 = std::min(static_cast<int>(clamped.y()), std::max(m_height - 2, 0));
+  int const z0 = std::min(static_cast<int>(clamped.z()), std::max(m_layers - 2, 0));
+  int const x1 = std::min(x0 + 1, m_width - 1);
+  int const y1 = std::min(y0 + 1, m_height - 1);
+  int const z1 = std::min(z0 + 1, m_layers - 1);
+  double const fx = clamped.x() - x0;
+  double const fy = clamped.y() - y0;
+  double const fz = clamped.z() - z0;
+
+  auto lerp = [](double a, double b, double t) { return a + (b - a) * t; };
+  double const c00 = lerp(At(x0, y0, z0), At(x1, y0, z0), fx);
+  double const c10 = lerp(At(x0, y1, z0), At(x1, y1, z0), fx);
+  double const c01 = lerp(At(x0, y0, z1), At(x1, y0, z1), fx);
+  double const c11 = lerp(At(x0, y1, z1), At(x1, y1, z1), fx);
+  double const inside = lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+  return inside + (point - clamped).cwiseProduct(m_spacing).norm();
+}
+
+/**
+ * @details Builds the lower envelope of the parabolas rooted at all finite samples from left to right. A new parabola
+ * removes every parabola from the right end of the envelope whose segment starts behind its intersection with the
+ * new one. The envelope is then sampled at every index.
+ * The parabolas are scaled by 1 / weight, so that an intersection only needs one subtraction and one division of
+ * the precomputed values f(p) / weight + p^2.
+ * @param input Squared distances of the line, infinity for samples without a feature so far
+ * @param count Number of samples of the line
+ * @param weight Squared voxel spacing along the line
+ * @param output Output: squared distances after the pass, infinity if the line has no finite sample
+ * @param apexes Scratch space for count indices
+ * @param boundaries Scratch space for 2 * count + 1 values: the segment boundaries of the envelope, followed by the
+ * scaled values of its parabolas
+ */
+void DistanceField::EnvelopePass(const float *input, int count, double weight, float *output, int *apexes,
+								 float *boundaries) {
+  float const infinity = std::numeric_limits<float>::infinity();
+  float const inverse_weight = static_cast<float>(1.0 / weight);
+  float *scaled_values = boundaries + count + 1;
+  int k = -1;
+  for (int q = 0; q < count; ++q) {
+	if (input[q] == infinity) {
+	  continue;
+	}
+	float const value_q = input[q] * inverse_weight + static_cast<float>(q) * static_cast<float>(q);
+	float intersection = -infinity;
+	while (k >= 0) {
+	  intersection = (value_q - scaled_values[k]) / static_cast<float>(2 * (q - apexes[k]));
+	  if (intersection > boundaries[k]) {
+		break;
+	  }
+	  --k;
+	}
+	++k;
+	apexes[k] = q;
+	scaled_values[k] = value_q;
+	boundaries[k] = (k == 0) ? -infinity : intersection;
+	boundaries[k + 1] = infinity;
+  }
+
+  if (k < 0) {
+	std::fill_n(output, count, infinity);
+	return;
+  }
+  float const line_weight = static_cast<float>(weight);
+  int j = 0;
+  for (int q = 0; q < count; ++q) {
+	while (boundaries[j + 1] < static_cast<float>(q)) {
+	  ++j;
+	}
+	int const p = apexes[j];
+	output[q] = line_weight * static_cast<float>((q - p) * (q - p)) + input[p];
+  }
+}
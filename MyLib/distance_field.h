@@ -0,0 +1,63 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Exact Euclidean distance transform of a labelled volume with anisotropic voxel spacing
+ * @details Every voxel stores the distance in millimetres from its center to the center of the nearest voxel that
+ * carries the feature label. The transform is separable: a scan along x finds the nearest feature in each row, and
+ * the passes along y and z take the lower envelope of the parabolas d(q) = s^2 (q - p)^2 + f(p) of each line
+ * (Felzenszwalb & Huttenlocher). Each pass is linear in the number of voxels and its lines are spread over all
+ * hardware threads.
+ */
+class MYLIB_EXPORT DistanceField {
+ public:
+  DistanceField() = default;
+
+  /// Computes the distance of every voxel of a linear x-fastest label volume to the voxels with the feature label
+  Status Build(const int *labels, int width, int height, int layers, int feature_label,
+			   Eigen::Vector3d const &spacing);
+
+  /// Releases the field
+  void Clear();
+
+  /// @return True if no field has been computed yet
+  [[nodiscard]] bool Empty() const { return m_distances.empty(); }
+
+  /// Distance (in mm) of voxel (x, y, z) to the nearest feature voxel
+  [[nodiscard]] inline float At(int x, int y, int z) const {
+	return m_distances[x + static_cast<size_t>(y) * m_width + static_cast<size_t>(z) * m_width * m_height];
+  }
+
+  /// Distance (in mm) of an arbitrary point, given in voxel coordinates, to the nearest feature voxel
+  [[nodiscard]] double DistanceAt(Eigen::Vector3d const &point) const;
+
+  /// The whole field in x-fastest order, in mm
+  [[nodiscard]] std::vector<float> const &Field() const { return m_distances; }
+
+  /// Voxel spacing (in mm) the field was computed with
+  [[nodiscard]] Eigen::Vector3d const &Spacing() const { return m_spacing; }
+
+ private:
+  /// Lower envelope of the parabolas of one line of squared distances, see the class description
+  static void EnvelopePass(const float *input, int count, double weight, float *output, int *apexes,
+						   float *boundaries);
+
+  int m_width{0};
+  int m_height{0};
+  int m_layers{0};
+
+  /// Voxel spacing along x, y and z in mm
+  Eigen::Vector3d m_spacing{Eigen::Vector3d::Ones()};
+
+  /// Distances in x-fastest order
+  std::vector<float> m_distances;
+};
+
+#endif  // DISTANCE_FIELD_H
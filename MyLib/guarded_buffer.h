@@ -0,0 +1,150 @@
+#ifndef GUARDED_BUFFER_H
+#define GUARDED_BUFFER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Non-owning view of a 2D or 3D buffer with explicit row and slice strides
+ * @details Element (x, y, z) lives at origin[x + y * row_stride + z * slice_stride]. A view of a GuardedBuffer is
+ * also valid up to guard elements outside of its extent, so stencils may read and write the neighbours of any element
+ * inside without bounds checks.
+ */
+template<typename T>
+struct StridedView {
+  /// Element (0, 0, 0)
+  T *origin{nullptr};
+  int width{0};
+  int height{0};
+  int layers{0};
+  /// Number of valid elements outside of the extent on each side; 0 in z for 2D buffers
+  int guard{0};
+  int64_t row_stride{0};
+  int64_t slice_stride{0};
+
+  /// Offset of (x, y, z) from the origin
+  [[nodiscard]] int64_t Offset(int const x, int const y, int const z = 0) const {
+	return x + y * row_stride + z * slice_stride;
+  }
+
+  /// Element (x, y, z)
+  T &operator()(int const x, int const y, int const z = 0) const { return origin[Offset(x, y, z)]; }
+
+  /// First element of row y of slice z
+  [[nodiscard]] T *Row(int const y, int const z = 0) const { return origin + Offset(0, y, z); }
+
+  /// True if (x, y, z) lies inside the extent; one unsigned compare per axis
+  [[nodiscard]] bool Contains(int const x, int const y, int const z = 0) const {
+	return static_cast<unsigned>(x) < static_cast<unsigned>(width)
+	  && static_cast<unsigned>(y) < static_cast<unsigned>(height)
+	  && static_cast<unsigned>(z) < static_cast<unsigned>(layers);
+  }
+
+  /// Copies the extent without the guard into a dense buffer with strides width and width * height
+  void CopyTo(typename std::remove_const<T>::type *dense) const {
+	for (int z = 0; z < layers; ++z) {
+	  for (int y = 0; y < height; ++y) {
+		std::copy(Row(y, z), Row(y, z) + width, dense + (static_cast<int64_t>(z) * height + y) * width);
+	  }
+	}
+  }
+
+  /// Read-only view of the same elements
+  operator StridedView<const T>() const {
+	return StridedView<const T>{origin, width, height, layers, guard, row_stride, slice_stride};
+  }
+};
+
+/**
+ * @brief Owning buffer with a guard band of sentinel elements around its extent
+ * @details Rows and slices are padded by the guard on both sides (2D buffers with one layer only in x and y), so a
+ * stencil of radius up to the guard never leaves the allocation and sees the sentinel outside of the image instead of
+ * the neighbouring row. The guard is part of the allocation, so the address sanitizer still catches accesses beyond
+ * it.
+ */
+template<typename T>
+class GuardedBuffer {
+ public:
+  GuardedBuffer() = default;
+
+  GuardedBuffer(GuardedBuffer const &) = delete;
+  GuardedBuffer &operator=(GuardedBuffer const &) = delete;
+
+  /// Allocates the extent plus the guard, fills the extent with a value and the guard with the sentinel
+  void Allocate(int const width, int const height, int const layers, int const guard, T const value, T const sentinel) {
+	int const guard_z = layers > 1 ? guard : 0;
+	int64_t const row_stride = width + 2 * guard;
+	int64_t const slice_stride = row_stride * (height + 2 * guard);
+	m_storage.assign(static_cast<size_t>(slice_stride * (layers + 2 * guard_z)), sentinel);
+	m_view = StridedView<T>{m_storage.data() + guard + guard * row_stride + guard_z * slice_stride, width, height,
+							layers, guard, row_stride, slice_stride};
+	m_sentinel = sentinel;
+	Fill(value);
+  }
+
+  /// Exchanges the allocations of two buffers without copying
+  void Swap(GuardedBuffer &other) {
+	m_storage.swap(other.m_storage);
+	std::swap(m_view, other.m_view);
+	std::swap(m_sentinel, other.m_sentinel);
+  }
+
+  /// Fills the extent with a value and leaves the guard unchanged
+  void Fill(T const value) {
+	for (int z = 0; z < m_view.layers; ++z) {
+	  for (int y = 0; y < m_view.height; ++y) {
+		std::fill_n(m_view.Row(y, z), m_view.width, value);
+	  }
+	}
+  }
+
+  /// Fills the extent with a value and the guard with the sentinel in one pass over the allocation
+  void Reset(T const value) {
+	if (value == m_sentinel) {
+	  std::fill(m_storage.begin(), m_storage.end(), value);
+	  return;
+	}
+	std::fill(m_storage.begin(), m_storage.end(), m_sentinel);
+	Fill(value);
+  }
+
+  /// Copies the outermost elements of the extent into the guard, so that stencils read clamped neighbours
+  void ReplicateEdges() {
+	StridedView<T> const &v = m_view;
+	int const guard_z = v.layers > 1 ? v.guard : 0;
+	for (int z = 0; z < v.layers; ++z) {
+	  for (int y = 0; y < v.height; ++y) {
+		T *row = v.Row(y, z);
+		std::fill(row - v.guard, row, row[0]);
+		std::fill(row + v.width, row + v.width + v.guard, row[v.width - 1]);
+	  }
+	  for (int g = 1; g <= v.guard; ++g) {
+		std::copy_n(v.Row(0, z) - v.guard, v.row_stride, v.Row(-g, z) - v.guard);
+		std::copy_n(v.Row(v.height - 1, z) - v.guard, v.row_stride, v.Row(v.height - 1 + g, z) - v.guard);
+	  }
+	}
+	for (int g = 1; g <= guard_z; ++g) {
+	  std::copy_n(v.Row(-v.guard, 0) - v.guard, v.slice_stride, v.Row(-v.guard, -g) - v.guard);
+	  std::copy_n(v.Row(-v.guard, v.layers - 1) - v.guard, v.slice_stride, v.Row(-v.guard, v.layers - 1 + g) - v.guard);
+	}
+  }
+
+  /// @return True before the first Allocate()
+  [[nodiscard]] bool Empty() const { return m_storage.empty(); }
+
+  /// @return Mutable view of the extent
+  [[nodiscard]] StridedView<T> const &View() { return m_view; }
+
+  /// @return Read-only view of the extent
+  [[nodiscard]] StridedView<const T> View() const { return m_view; }
+
+ private:
+  std::vector<T> m_storage;
+  StridedView<T> m_view;
+  T m_sentinel{};
+};
+
+#endif  // GUARDED_BUFFER_H
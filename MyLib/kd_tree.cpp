@@ -0,0 +1,277 @@
+#include "kd_tree.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * @details The node at level l with position i in that level covers the points [n * i / 2^l, n * (i + 1) / 2^l) of
+ * the tree order, so the point range of every node follows from its index. All nodes of a level are independent and
+ * are split in parallel: each node picks the axis of largest extent of its points and partitions them at the median
+ * with std::nth_element. The depth is chosen so that no leaf holds more than kLeafSize points.
+ * @param points The point cloud, at most 2^31 - 1 points
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if there are no points
+ */
+Status KdTree::Build(std::vector<Eigen::Vector3d> const &points) {
+  if (points.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  int64_t const count = static_cast<int64_t>(points.size());
+
+  int depth = 0;
+  while (((count + (int64_t{1} << depth) - 1) >> depth) > kLeafSize) {
+	++depth;
+  }
+  m_depth = depth;
+  m_internalNodes = (1 << depth) - 1;
+  m_splitAxis.assign(m_internalNodes, 0);
+  m_splitValue.assign(m_internalNodes, 0.0f);
+
+  // Partition packed copies instead of indices, so that nth_element streams through memory
+  struct PackedPoint {
+	float coordinates[3];
+	int index;
+  };
+  std::vector<PackedPoint> packed(points.size());
+  int const block = 4096;
+  int const block_count = static_cast<int>((count + block - 1) / block);
+  utils::ParallelFor(0, block_count, [&](int b) {
+	int const end = static_cast<int>(std::min<int64_t>(count, static_cast<int64_t>(b + 1) * block));
+	for (int k = b * block; k < end; ++k) {
+	  packed[k] = PackedPoint{{static_cast<float>(points[k].x()), static_cast<float>(points[k].y()),
+							   static_cast<float>(points[k].z())}, k};
+	}
+  });
+
+  for (int level = 0; level < depth; ++level) {
+	int const first_node = (1 << level) - 1;
+	utils::ParallelFor(0, 1 << level, [&](int i) {
+	  int const lo = static_cast<int>((count * i) >> level);
+	  int const hi = static_cast<int>((count * (i + 1)) >> level);
+	  int const mid = static_cast<int>((count * (2 * i + 1)) >> (level + 1));
+
+	  float lower[3] = {packed[lo].coordinates[0], packed[lo].coordinates[1], packed[lo].coordinates[2]};
+	  float upper[3] = {lower[0], lower[1], lower[2]};
+	  for (int k = lo + 1; k < hi; ++k) {
+		for (int axis = 0; axis < 3; ++axis) {
+		  lower[axis] = std::min(lower[axis], packed[k].coordinates[axis]);
+		  upper[axis] = std::max(upper[axis], packed[k].coordinates[axis]);
+		}
+	  }
+	  int axis = 0;
+	  for (int a = 1; a < 3; ++a) {
+		if (upper[a] - lower[a] > upper[axis] - lower[axis]) {
+		  axis = a;
+		}
+	  }
+
+	  std::nth_element(packed.begin() + lo, packed.begin() + mid, packed.begin() + hi,
+					   [axis](PackedPoint const &a, PackedPoint const &b) {
+						 return a.coordinates[axis] < b.coordinates[axis];
+					   });
+	  m_splitAxis[first_node + i] = static_cast<uint8_t>(axis);
+	  m_splitValue[first_node + i] = packed[mid].coordinates[axis];
+	});
+  }
+
+  // The cell of a node is the cell of its parent, clipped at the split plane of the parent
+  float const infinity = std::numeric_limits<float>::infinity();
+  m_cells.resize(6 * ((size_t{2} << depth) - 1));
+  std::fill_n(m_cells.begin(), 3, -infinity);
+  std::fill_n(m_cells.begin() + 3, 3, infinity);
+  for (int level = 1; level <= depth; ++level) {
+	int const first_node = (1 << level) - 1;
+	int const nodes = 1 << level;
+	utils::ParallelFor(0, (nodes + block - 1) / block, [&](int b) {
+	  int const end = first_node + std::min(nodes, (b + 1) * block);
+	  for (int node = first_node + b * block; node < end; ++node) {
+		int const parent = (node - 1) / 2;
+		int const axis = m_splitAxis[parent];
+		float *const cell = m_cells.data() + 6 * static_cast<size_t>(node);
+		std::copy_n(m_cells.data() + 6 * static_cast<size_t>(parent), 6, cell);
+		if (node == 2 * parent + 1) {
+		  cell[3 + axis] = m_splitValue[parent];
+		} else {
+		  cell[axis] = m_splitValue[parent];
+		}
+	  }
+	});
+  }
+
+  m_points.resize(3 * points.size());
+  m_indices.resize(points.size());
+  m_positions.resize(points.size());
+  utils::ParallelFor(0, block_count, [&](int b) {
+	int const end = static_cast<int>(std::min<int64_t>(count, static_cast<int64_t>(b + 1) * block));
+	for (int k = b * block; k < end; ++k) {
+	  std::copy(packed[k].coordinates, packed[k].coordinates + 3, m_points.begin() + 3 * k);
+	  m_indices[k] = packed[k].index;
+	  m_positions[packed[k].index] = k;
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @param leaf Index of the leaf among all leaves
+ * @param query The query point
+ * @param best Input: squared distance to beat, Output: squared distance to the nearest point found so far
+ * @param best_position Output: tree order position of the nearest point found so far, unchanged if none is closer
+ */
+void KdTree::ScanLeaf(int const leaf, const float *query, float &best, int &best_position) const {
+  int64_t const count = static_cast<int64_t>(m_indices.size());
+  int const lo = static_cast<int>((count * leaf) >> m_depth);
+  int const hi = static_cast<int>((count * (leaf + 1)) >> m_depth);
+  for (int k = lo; k < hi; ++k) {
+	float const dx = m_points[3 * k] - query[0];
+	float const dy = m_points[3 * k + 1] - query[1];
+	float const dz = m_points[3 * k + 2] - query[2];
+	float const d = dx * dx + dy * dy + dz * dz;
+	if (d < best) {
+	  best = d;
+	  best_position = k;
+	}
+  }
+}
+
+/**
+ * @param node Index of the node
+ * @param query The query point
+ * @param squared_radius Squared radius of the sphere around the query
+ * @return True if the sphere lies inside of the cell of the node
+ */
+bool KdTree::CellContains(int const node, const float *query, float const squared_radius) const {
+  const float *const cell = m_cells.data() + 6 * static_cast<size_t>(node);
+  bool inside = true;
+  for (int axis = 0; axis < 3; ++axis) {
+	float const below = query[axis] - cell[axis];
+	float const above = cell[3 + axis] - query[axis];
+	inside &= below >= 0.0f && above >= 0.0f && below * below >= squared_radius && above * above >= squared_radius;
+  }
+  return inside;
+}
+
+/**
+ * @details A hint (e.g. the nearest neighbour of the same point in the previous ICP iteration) starts the search in
+ * its leaf. From there the search climbs to the lowest node whose cell contains the sphere around the query through
+ * the nearest point of that leaf; no point outside of that cell can be closer, so only the subtree of that node is
+ * searched. Without a hint the whole tree is searched.
+ * The subtree is searched depth-first with an explicit stack. The nearer child is always visited first, and a
+ * subtree is skipped if the distance from the query to its cell already exceeds the best distance found so far.
+ * @param query The query point
+ * @param squared_distance Output: squared distance to the nearest neighbour
+ * @param hint Index of a point that is probably close to the query, or -1
+ * @return Index of the nearest neighbour, or -1 if the tree is empty
+ */
+int KdTree::FindNearest(Eigen::Vector3d const &query, double &squared_distance, int const hint) const {
+  squared_distance = std::numeric_limits<double>::max();
+  if (m_indices.empty()) {
+	return -1;
+  }
+
+  float const q[3] = {static_cast<float>(query.x()), static_cast<float>(query.y()), static_cast<float>(query.z())};
+  float best = std::numeric_limits<float>::max();
+  int best_position = -1;
+  int start = 0;
+  if (hint >= 0 && hint < Size()) {
+	int const leaf = LeafOf(m_positions[hint]);
+	ScanLeaf(leaf, q, best, best_position);
+	start = m_internalNodes + leaf;
+	while (start > 0 && !CellContains(start, q, best)) {
+	  start = (start - 1) / 2;
+	}
+  }
+
+  // The bound of a subtree is the squared distance from the query to the cell of the subtree, which is updated
+  // incrementally from the per-axis offsets to the split planes on the way down. The query lies inside of the cell
+  // of the start node, so all offsets start at zero.
+  struct PendingNode {
+	int node;
+	float bound;
+	float offset[3];
+  };
+  // Every visited node pushes at most two children, so the stack never exceeds depth + 1 entries
+  PendingNode stack[64];
+  int top = 0;
+  stack[top++] = PendingNode{start, 0.0f, {0.0f, 0.0f, 0.0f}};
+
+  while (top > 0) {
+	PendingNode const pending = stack[--top];
+	if (pending.bound >= best) {
+	  continue;
+	}
+	int const node = pending.node;
+
+	if (node >= m_internalNodes) {
+	  ScanLeaf(node - m_internalNodes, q, best, best_position);
+	  continue;
+	}
+
+	int const axis = m_splitAxis[node];
+	float const diff = q[axis] - m_splitValue[node];
+	int const near_child = 2 * node + (diff < 0.0f ? 1 : 2);
+	int const far_child = 2 * node + (diff < 0.0f ? 2 : 1);
+	PendingNode far_node = pending;
+	far_node.node = far_child;
+	far_node.bound = pending.bound - pending.offset[axis] * pending.offset[axis] + diff * diff;
+	far_node.offset[axis] = diff;
+	if (far_node.bound < best) {
+	  stack[top++] = far_node;
+	}
+	stack[top] = pending;
+	stack[top++].node = near_child;
+  }
+
+  Eigen::Vector3d const nearest(m_points[3 * best_position], m_points[3 * best_position + 1],
+								m_points[3 * best_position + 2]);
+  squared_distance = (nearest - query).squaredNorm();
+  return m_indices[best_position];
+}
+
+/**
+ * @details The queries are processed in blocks of consecutive points. Consecutive queries are usually close to each
+ * other (e.g. surface points in scan order), so a block mostly visits the same leaves and keeps them in cache.
+ * @param queries The query points
+ * @param indices Input: hints if use_hints is set (see above), Output: index of the nearest neighbour of every query
+ * @param squared_distances Output: squared distance to the nearest neighbour of every query
+ * @param use_hints Use the incoming content of indices as hints, it must have one entry per query
+ */
+void KdTree::FindNearest(std::vector<Eigen::Vector3d> const &queries, std::vector<int> &indices,
+						 std::vector<double> &squared_distances, bool const use_hints) const {
+  int const count = static_cast<int>(queries.size());
+  if (!use_hints || indices.size() != queries.size()) {
+	indices.assign(queries.size(), -1);
+  }
+  squared_distances.resize(queries.size());
+  int const block = 1024;
+  int const block_count = (count + block - 1) / block;
+
+  // Sort the queries by the leaf they fall into, or by the leaf of their hint, so that consecutive queries visit the
+  // same part of the tree
+  std::vector<std::pair<int, int>> order(queries.size());
+  utils::ParallelFor(0, block_count, [&](int b) {
+	int const end = std::min(count, (b + 1) * block);
+	for (int i = b * block; i < end; ++i) {
+	  int leaf = 0;
+	  if (indices[i] >= 0 && indices[i] < Size()) {
+		leaf = LeafOf(m_positions[indices[i]]);
+	  } else {
+		int node = 0;
+		while (node < m_internalNodes) {
+		  node = 2 * node + (queries[i][m_splitAxis[node]] < m_splitValue[node] ? 1 : 2);
+		}
+		leaf = node - m_internalNodes;
+	  }
+	  order[i] = std::make_pair(leaf, i);
+	}
+  });
+  std::sort(order.begin(), order.end());
+
+  utils::ParallelFor(0, block_count, [&](int b) {
+	int const end = std::min(count, (b + 1) * block);
+	for (int k = b * block; k < end; ++k) {
+	  int const i = order[k].second;
+	  indices[i] = FindNearest(queries[i], squared_distances[i], indices[i]);
+	}
+  });
+}
@@ -0,0 +1,79 @@
+#ifndef KD_TREE_H
+#define KD_TREE_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Static 3D k-d tree for nearest neighbour queries on large point clouds
+ * @details The tree is an implicit, balanced binary tree: node i has the children 2i + 1 and 2i + 2 and every node
+ * splits its point range at the median, so no child pointers or point ranges are stored. Each node only keeps its
+ * split axis and split value. After building, the points are stored in tree order as packed floats, so every leaf
+ * bucket is one contiguous run of at most kLeafSize points. The cell of every node is kept as well, so that a query
+ * with a good hint only searches the smallest subtree around the hint that can hold its nearest neighbour.
+ */
+class MYLIB_EXPORT KdTree {
+ public:
+  /// Maximum number of points in a leaf bucket
+  static constexpr int kLeafSize = 8;
+
+  KdTree() = default;
+
+  /// Builds the tree over the given points, level by level on all hardware threads
+  Status Build(std::vector<Eigen::Vector3d> const &points);
+
+  /// Index (into the points passed to Build()) of the nearest neighbour of a query point
+  int FindNearest(Eigen::Vector3d const &query, double &squared_distance, int const hint = -1) const;
+
+  /// Nearest neighbours of a batch of query points, spread over all hardware threads
+  void FindNearest(std::vector<Eigen::Vector3d> const &queries, std::vector<int> &indices,
+				   std::vector<double> &squared_distances, bool const use_hints = false) const;
+
+  /// @return True if no tree has been built yet
+  [[nodiscard]] bool Empty() const { return m_indices.empty(); }
+
+  /// @return Number of points in the tree
+  [[nodiscard]] int Size() const { return static_cast<int>(m_indices.size()); }
+
+ private:
+  /// Leaf that holds the point at a tree order position
+  [[nodiscard]] int LeafOf(int const position) const {
+	return static_cast<int>((((static_cast<int64_t>(position) + 1) << m_depth) - 1) / static_cast<int64_t>(Size()));
+  }
+
+  /// Scans the points of a leaf for a closer neighbour than best
+  void ScanLeaf(int const leaf, const float *query, float &best, int &best_position) const;
+
+  /// True if the cell of a node contains the sphere of the given squared radius around the query
+  [[nodiscard]] bool CellContains(int const node, const float *query, float const squared_radius) const;
+
+  /// Number of levels of internal nodes, all leaves are on level m_depth
+  int m_depth{0};
+
+  /// Number of internal (splitting) nodes
+  int m_internalNodes{0};
+
+  /// Split axis (0, 1, 2) of every internal node
+  std::vector<uint8_t> m_splitAxis;
+
+  /// Split value of every internal node
+  std::vector<float> m_splitValue;
+
+  /// Points in tree order, packed as x, y, z
+  std::vector<float> m_points;
+
+  /// Cell of every node, leaves included, packed as lower x, y, z and upper x, y, z; unbounded sides are infinite
+  std::vector<float> m_cells;
+
+  /// Original index of every point in tree order
+  std::vector<int> m_indices;
+
+  /// Tree order position of every original point, the inverse of m_indices
+  std::vector<int> m_positions;
+};
+
+#endif  // KD_TREE_H
@@ -0,0 +1,121 @@
+#include "label_snapshot.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+constexpr int LabelSnapshot::kBrickEdge;
+constexpr int LabelSnapshot::kBrickVoxels;
+
+/**
+ * @details Every brick is gathered into a scratch buffer and compared with the brick at the same position of the
+ * previous snapshot: equal bricks are shared, bricks without labels are dropped and only the others are copied. The
+ * bricks are processed in parallel, one row of bricks per task.
+ * @param labels Flat x-fastest label volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param previous Snapshot to share bricks with, ignored if it is empty or has a different size
+ * @param snapshot Output: the captured state, may be the same object as previous
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the volume is empty
+ */
+Status LabelSnapshot::Capture(const int *labels, int width, int height, int layers, LabelSnapshot const &previous,
+							  LabelSnapshot &snapshot) {
+  if (labels == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  LabelSnapshot result;
+  result.m_width = width;
+  result.m_height = height;
+  result.m_layers = layers;
+  result.m_bricksX = (width + kBrickEdge - 1) / kBrickEdge;
+  result.m_bricksY = (height + kBrickEdge - 1) / kBrickEdge;
+  int const bricks_z = (layers + kBrickEdge - 1) / kBrickEdge;
+  result.m_bricks.resize(static_cast<size_t>(result.m_bricksX) * result.m_bricksY * bricks_z);
+  bool const share = previous.m_width == width && previous.m_height == height && previous.m_layers == layers;
+
+  utils::ParallelFor(0, result.m_bricksY * bricks_z, [&](int brick_row) {
+	std::vector<int> brick(kBrickVoxels);
+	for (int bx = 0; bx < result.m_bricksX; ++bx) {
+	  int const index = brick_row * result.m_bricksX + bx;
+	  result.GatherBrick(index, labels, brick.data());
+	  if (std::all_of(brick.begin(), brick.end(), [](int label) { return label == 0; })) {
+		continue;
+	  }
+	  if (share && previous.m_bricks[index] && *previous.m_bricks[index] == brick) {
+		result.m_bricks[index] = previous.m_bricks[index];
+	  } else {
+		result.m_bricks[index] = std::make_shared<const std::vector<int>>(brick);
+	  }
+	}
+  });
+  snapshot = std::move(result);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Bricks that both snapshots share already hold the right labels and are skipped, so stepping between two
+ * neighbouring states of a history only costs the bricks that changed between them.
+ * @param labels Flat x-fastest label volume of the size of the snapshot, holding the labels of current
+ * @param current The snapshot whose labels the volume holds; restoring over an empty snapshot writes every brick
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the snapshot is empty
+ */
+Status LabelSnapshot::Restore(int *labels, LabelSnapshot const &current) const {
+  if (labels == nullptr || Empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  bool const incremental = current.m_width == m_width && current.m_height == m_height
+	&& current.m_layers == m_layers;
+  utils::ParallelFor(0, BrickCount() / m_bricksX, [&](int brick_row) {
+	for (int bx = 0; bx < m_bricksX; ++bx) {
+	  int const index = brick_row * m_bricksX + bx;
+	  if (!incremental || m_bricks[index] != current.m_bricks[index]) {
+		ScatterBrick(index, Brick(index), labels);
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @param labels Flat x-fastest label volume of the size of the snapshot
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the snapshot is empty
+ */
+Status LabelSnapshot::Restore(int *labels) const {
+  return Restore(labels, LabelSnapshot());
+}
+
+int LabelSnapshot::StoredBrickCount() const {
+  return static_cast<int>(std::count_if(m_bricks.begin(), m_bricks.end(),
+										[](std::shared_ptr<const std::vector<int>> const &brick) { return !!brick; }));
+}
+
+void LabelSnapshot::GatherBrick(int index, const int *labels, int *brick) const {
+  int const x0 = (index % m_bricksX) * kBrickEdge;
+  int const y0 = (index / m_bricksX % m_bricksY) * kBrickEdge;
+  int const z0 = (index / (m_bricksX * m_bricksY)) * kBrickEdge;
+  int const row_length = std::min(kBrickEdge, m_width - x0);
+  std::fill_n(brick, kBrickVoxels, 0);
+  for (int z = z0; z < std::min(z0 + kBrickEdge, m_layers); ++z) {
+	for (int y = y0; y < std::min(y0 + kBrickEdge, m_height); ++y) {
+	  const int *row = labels + x0 + (static_cast<size_t>(z) * m_height + y) * m_width;
+	  std::copy(row, row + row_length, brick + ((z - z0) * kBrickEdge + (y - y0)) * kBrickEdge);
+	}
+  }
+}
+
+void LabelSnapshot::ScatterBrick(int index, const int *brick, int *labels) const {
+  int const x0 = (index % m_bricksX) * kBrickEdge;
+  int const y0 = (index / m_bricksX % m_bricksY) * kBrickEdge;
+  int const z0 = (index / (m_bricksX * m_bricksY)) * kBrickEdge;
+  int const row_length = std::min(kBrickEdge, m_width - x0);
+  for (int z = z0; z < std::min(z0 + kBrickEdge, m_layers); ++z) {
+	for (int y = y0; y < std::min(y0 + kBrickEdge, m_height); ++y) {
+	  int *row = labels + x0 + (static_cast<size_t>(z) * m_height + y) * m_width;
+	  if (brick == nullptr) {
+		std::fill_n(row, row_length, 0);
+	  } else {
+		std::copy_n(brick + ((z - z0) * kBrickEdge + (y - y0)) * kBrickEdge, row_length, row);
+	  }
+	}
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef LABEL_SNAPSHOT_H
+#define LABEL_SNAPSHOT_H
+
+#include "MyLib_global.h"
+#include "status.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Immutable copy of a label volume made of copy-on-write bricks, one state of an undo history
+ * @details The volume is split into cubic bricks of kBrickEdge voxels. Bricks without any label are not stored at all,
+ * and a snapshot that is captured relative to a previous one shares every brick that did not change with it, so a
+ * new snapshot only costs the bricks an operation has modified. Restoring a snapshot over the volume of another one
+ * only writes the bricks in which the two differ.
+ * Snapshots are cheap to copy, as copies share all bricks.
+ */
+class MYLIB_EXPORT LabelSnapshot {
+ public:
+  /// Edge length of a brick in voxels
+  static constexpr int kBrickEdge = 16;
+
+  /// Number of voxels in one brick
+  static constexpr int kBrickVoxels = kBrickEdge * kBrickEdge * kBrickEdge;
+
+  LabelSnapshot() = default;
+
+  /// Captures a linear x-fastest label volume, sharing the unchanged bricks of a previous snapshot of the same size
+  static Status Capture(const int *labels, int width, int height, int layers, LabelSnapshot const &previous,
+						LabelSnapshot &snapshot);
+
+  /// Writes the snapshot into a label volume that currently holds the state of another snapshot of the same size
+  Status Restore(int *labels, LabelSnapshot const &current) const;
+
+  /// Writes the snapshot into a label volume of the same size
+  Status Restore(int *labels) const;
+
+  /// @return True if nothing has been captured yet
+  [[nodiscard]] bool Empty() const { return m_bricks.empty(); }
+
+  /// Total number of bricks, including the ones without labels
+  [[nodiscard]] int BrickCount() const { return static_cast<int>(m_bricks.size()); }
+
+  /// Labels of a brick in x-fastest order, nullptr if the brick has no label
+  [[nodiscard]] const int *Brick(int index) const { return m_bricks[index] ? m_bricks[index]->data() : nullptr; }
+
+  /// Number of bricks that are stored, i.e. that contain a label
+  [[nodiscard]] int StoredBrickCount() const;
+
+ private:
+  /// Copies the voxels of a brick out of a linear volume, voxels beyond the volume become 0
+  void GatherBrick(int index, const int *labels, int *brick) const;
+
+  /// Copies the voxels of a brick into a linear volume, nullptr writes 0
+  void ScatterBrick(int index, const int *brick, int *labels) const;
+
+  int m_width{0};
+  int m_height{0};
+  int m_layers{0};
+  int m_bricksX{0};
+  int m_bricksY{0};
+
+  /// Bricks in x-fastest order of their brick coordinates, nullptr for bricks without labels
+  std::vector<std::shared_ptr<const std::vector<int>>> m_bricks;
+};
+
+#endif  // LABEL_SNAPSHOT_H
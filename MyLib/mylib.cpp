@@ -1,22 +1,44 @@
 #include "mylib.h"
+#include "kd_tree.h"
+#include "parallel.h"
+#include "voxel_kernels.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @details The face neighbours in the order of voxel_kernels::kNeighborSteps, the table the region growing kernels
+ * are compiled from.
+ * @param pt Voxel
+ * @param neighbors Output: the 6 face neighbours, which may lie outside of the volume
+ */
 void MyLib::FindNeighbors3D(const Eigen::Vector3i &pt, std::vector<Eigen::Vector3i> &neighbors) {
   neighbors.clear();
-  neighbors.emplace_back(pt.x() - 1, pt.y(), pt.z());
-  neighbors.emplace_back(pt.x() + 1, pt.y(), pt.z());
-  neighbors.emplace_back(pt.x(), pt.y() - 1, pt.z());
-  neighbors.emplace_back(pt.x(), pt.y() + 1, pt.z());
-  neighbors.emplace_back(pt.x(), pt.y(), pt.z() - 1);
-  neighbors.emplace_back(pt.x(), pt.y(), pt.z() + 1);
+  for (int i = 0; i < static_cast<int>(Connectivity::FACES); ++i) {
+	voxel_kernels::NeighborStep const &step = voxel_kernels::kNeighborSteps[i];
+	neighbors.emplace_back(pt.x() + step.dx, pt.y() + step.dy, pt.z() + step.dz);
+  }
 }
 
+/**
+ * @details Reads the face neighbours through voxel_kernels::LinearOffsets(), like the surface extraction of
+ * CTDataset; unlike voxel_kernels::IsSurfaceVoxel() it has no border check, because the buffer has no layer count.
+ * @param buf Flat x-fastest region labels, 1 marks the region
+ * @param point Voxel of the region
+ * @param width Width of the buffer in voxels
+ * @param height Height of the buffer in voxels
+ * @return True if one of the 6 neighbours does not belong to the region
+ */
 bool MyLib::IsSurfacePoint(const int *buf, Eigen::Vector3i const &point, int width, int height) {
-  return (!(buf[(point.x() - 1) + point.y() * width + (height * width * point.z())] == 1
-	&& buf[(point.x() + 1) + point.y() * width + (height * width * point.z())] == 1
-	&& buf[point.x() + (point.y() - 1) * width + (height * width * point.z())] == 1
-	&& buf[point.x() + (point.y() + 1) * width + (height * width * point.z())] == 1
-	&& buf[point.x() + point.y() * width + (height * width * (point.z() - 1))] == 1
-	&& buf[point.x() + point.y() * width + (height * width * (point.z() + 1))] == 1));
+  auto const offsets = voxel_kernels::LinearOffsets<6>(width, height);
+  int64_t const index = point.x() + point.y() * static_cast<int64_t>(width)
+	+ point.z() * static_cast<int64_t>(width) * height;
+  bool inside = true;
+  for (int64_t const offset : offsets) {
+	inside &= buf[index + offset] == voxel_kernels::kRegion;
+  }
+  return !inside;
 }
 
 Eigen::Isometry3d MyLib::EstimateRigidTransformation3D(std::vector<Eigen::Vector3d> const &source_points,
@@ -41,8 +63,24 @@ Eigen::Isometry3d MyLib::EstimateRigidTransformation3D(std::vector<Eigen::Vector
   X.colwise() -= mean_X;
   Y.colwise() -= mean_Y;
 
+  return RigidTransformationFromCovariance(mean_X, mean_Y, X * Y.adjoint());
+}
+
+/**
+ * @details Closed-form least-squares solution via the singular value decomposition of the cross-covariance matrix
+ * (Arun et al.), shared by the paired estimation and every ICP iteration.
+ * @param mean_source Centroid of the source points
+ * @param mean_target Centroid of the target points
+ * @param cross_covariance Sum of (source - mean_source) * (target - mean_target)^T over all pairs
+ * @return Rigid transformation that maps the source onto the target points
+ */
+Eigen::Isometry3d MyLib::RigidTransformationFromCovariance(Eigen::Vector3d const &mean_source,
+														   Eigen::Vector3d const &mean_target,
+														   Eigen::Matrix3d const &cross_covariance) {
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> MatrixXd;
+
   // Compute SVD (singular value decomposition) of cross-covariance matrix
-  MatrixXd R_XY = X * Y.adjoint();
+  MatrixXd R_XY = cross_covariance;
   Eigen::JacobiSVD<MatrixXd> svd(R_XY, Eigen::ComputeThinU | Eigen::ComputeThinV);
 
   // Compute estimate of the rotation matrix:
@@ -56,10 +94,151 @@ Eigen::Isometry3d MyLib::EstimateRigidTransformation3D(std::vector<Eigen::Vector
   // Construct homogeneous transformation matrix.
   Eigen::Matrix4d transformation_mat;
   transformation_mat.block(0, 0, 3, 3) = R;
-  transformation_mat.block(0, 3, 3, 1) = mean_Y - R * mean_X;
+  transformation_mat.block(0, 3, 3, 1) = mean_target - R * mean_source;
   transformation_mat.block(3, 0, 1, 3) = Eigen::RowVector3d::Zero();
   transformation_mat(3, 3) = 1.0;
 
   // Return as Isometry3d
   return Eigen::Isometry3d(transformation_mat);
-}
\ No newline at end of file
+}
+
+/**
+ * @details Every iteration transforms the (strided) source points with the current estimate, looks up their nearest
+ * target points in a k-d tree in one parallel batch (seeded with the previous correspondences), rejects
+ * correspondences beyond the maximum distance and then keeps only the overlap_ratio fraction with the smallest
+ * distances (trimmed ICP), which makes the estimate robust against outliers and partial overlap. The centroids and the
+ * cross-covariance of the remaining pairs are reduced in parallel with a fixed partitioning, so the result does not
+ * depend on the thread count, and the update is solved in closed form by RigidTransformationFromCovariance().
+ * Nearest neighbour queries far away from the target surface are expensive, so the registration first runs against
+ * every coarse_target_stride-th target point until the RMS error changes by less than 0.1 %, and only then refines
+ * against the full target cloud.
+ * @param source_points The points that are moved
+ * @param target_points The fixed points
+ * @param parameters Iteration, rejection and convergence parameters
+ * @param transformation Input: initial guess, Output: transformation that maps the source onto the target points
+ * @param rms_error Output: RMS distance of the used correspondences after the last iteration
+ * @return StatusCode::OK, or StatusCode::REGISTRATION_ERROR if there are fewer than three points or correspondences
+ */
+Status MyLib::EstimateRigidTransformationICP(std::vector<Eigen::Vector3d> const &source_points,
+											 std::vector<Eigen::Vector3d> const &target_points,
+											 IcpParameters const &parameters, Eigen::Isometry3d &transformation,
+											 double &rms_error) {
+  int const stride = std::max(1, parameters.source_stride);
+  std::vector<Eigen::Vector3d> source;
+  source.reserve(source_points.size() / stride + 1);
+  for (size_t i = 0; i < source_points.size(); i += stride) {
+	source.push_back(source_points[i]);
+  }
+  if (source.size() < 3 || target_points.size() < 3) {
+	return Status(StatusCode::REGISTRATION_ERROR);
+  }
+
+  // The coarse stage is only worth it if the subsampled target is still reasonably dense
+  std::vector<Eigen::Vector3d> coarse_target;
+  int const coarse_stride = std::max(1, parameters.coarse_target_stride);
+  if (coarse_stride > 1 && target_points.size() / coarse_stride >= 1000) {
+	coarse_target.reserve(target_points.size() / coarse_stride + 1);
+	for (size_t i = 0; i < target_points.size(); i += coarse_stride) {
+	  coarse_target.push_back(target_points[i]);
+	}
+  }
+
+  int const count = static_cast<int>(source.size());
+  int const block = 4096;
+  int const block_count = (count + block - 1) / block;
+  double const max_distance_sq = parameters.max_correspondence_distance > 0.0
+	? parameters.max_correspondence_distance * parameters.max_correspondence_distance
+	: std::numeric_limits<double>::max();
+
+  std::vector<Eigen::Vector3d> moved(source.size());
+  std::vector<int> nearest;
+  std::vector<double> distances;
+  std::vector<double> sorted_distances;
+  std::vector<Eigen::Matrix3d> block_products(block_count);
+  std::vector<Eigen::Vector3d> block_source_sums(block_count);
+  std::vector<Eigen::Vector3d> block_target_sums(block_count);
+  std::vector<double> block_errors(block_count);
+  std::vector<int> block_pairs(block_count);
+  rms_error = std::numeric_limits<double>::max();
+
+  for (int stage = coarse_target.empty() ? 1 : 0; stage < 2; ++stage) {
+	std::vector<Eigen::Vector3d> const &target = (stage == 0) ? coarse_target : target_points;
+	double const convergence_threshold = (stage == 0) ? 1e-3 : parameters.convergence_threshold;
+	KdTree tree;
+	if (!tree.Build(target).Ok()) {
+	  return Status(StatusCode::REGISTRATION_ERROR);
+	}
+
+	double previous_rms = std::numeric_limits<double>::max();
+	for (int iteration = 0; iteration < parameters.max_iterations; ++iteration) {
+	  utils::ParallelFor(0, count, [&](int i) { moved[i] = transformation * source[i]; });
+	  // The correspondences of the previous iteration are close, which makes them good search hints
+	  tree.FindNearest(moved, nearest, distances, iteration > 0);
+
+	  // The trimming threshold is the distance of the worst correspondence that is still kept
+	  sorted_distances.clear();
+	  for (double d : distances) {
+		if (d <= max_distance_sq) {
+		  sorted_distances.push_back(d);
+		}
+	  }
+	  int const kept = static_cast<int>(std::ceil(std::min(1.0, std::max(0.0, parameters.overlap_ratio))
+		  * static_cast<double>(sorted_distances.size())));
+	  if (kept < 3) {
+		return Status(StatusCode::REGISTRATION_ERROR);
+	  }
+	  std::nth_element(sorted_distances.begin(), sorted_distances.begin() + (kept - 1), sorted_distances.end());
+	  double const threshold = sorted_distances[kept - 1];
+
+	  // Sums of the kept pairs, one partial sum per block so that the reduction order is fixed
+	  utils::ParallelFor(0, block_count, [&](int b) {
+		Eigen::Matrix3d product = Eigen::Matrix3d::Zero();
+		Eigen::Vector3d source_sum = Eigen::Vector3d::Zero();
+		Eigen::Vector3d target_sum = Eigen::Vector3d::Zero();
+		double error = 0.0;
+		int pairs = 0;
+		int const end = std::min(count, (b + 1) * block);
+		for (int i = b * block; i < end; ++i) {
+		  if (distances[i] > threshold) {
+			continue;
+		  }
+		  Eigen::Vector3d const &match = target[nearest[i]];
+		  product += moved[i] * match.transpose();
+		  source_sum += moved[i];
+		  target_sum += match;
+		  error += distances[i];
+		  ++pairs;
+		}
+		block_products[b] = product;
+		block_source_sums[b] = source_sum;
+		block_target_sums[b] = target_sum;
+		block_errors[b] = error;
+		block_pairs[b] = pairs;
+	  });
+
+	  Eigen::Matrix3d product = Eigen::Matrix3d::Zero();
+	  Eigen::Vector3d mean_source = Eigen::Vector3d::Zero();
+	  Eigen::Vector3d mean_target = Eigen::Vector3d::Zero();
+	  double error = 0.0;
+	  int pairs = 0;
+	  for (int b = 0; b < block_count; ++b) {
+		product += block_products[b];
+		mean_source += block_source_sums[b];
+		mean_target += block_target_sums[b];
+		error += block_errors[b];
+		pairs += block_pairs[b];
+	  }
+	  mean_source /= pairs;
+	  mean_target /= pairs;
+	  Eigen::Matrix3d const cross_covariance = product - pairs * mean_source * mean_target.transpose();
+
+	  transformation = RigidTransformationFromCovariance(mean_source, mean_target, cross_covariance) * transformation;
+	  rms_error = std::sqrt(error / pairs);
+	  if (std::abs(previous_rms - rms_error) <= convergence_threshold * std::max(rms_error, 1e-12)) {
+		break;
+	  }
+	  previous_rms = rms_error;
+	}
+  }
+  return Status(StatusCode::OK);
+}
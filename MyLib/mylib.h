@@ -13,6 +13,24 @@
 // Global Eigen::IOFormat definition for debugging purposes
 Eigen::IOFormat const CleanFmt(4, 0, ", ", "\n", "[", "]");
 
+/**
+ * @brief Parameters of the iterative closest point registration
+ */
+struct IcpParameters {
+  /// Maximum number of iterations
+  int max_iterations{50};
+  /// Fraction of the correspondences with the smallest distances that is used in every iteration (trimmed ICP)
+  double overlap_ratio{0.9};
+  /// Correspondences that are farther apart are rejected, in the unit of the point coordinates (<= 0 disables this)
+  double max_correspondence_distance{0.0};
+  /// Stop as soon as the RMS error changes by less than this fraction between two iterations
+  double convergence_threshold{1e-6};
+  /// Only every n-th source point is used
+  int source_stride{1};
+  /// The coarse stage registers against every n-th target point before the full target is used (1 disables it)
+  int coarse_target_stride{16};
+};
+
 class MYLIB_EXPORT MyLib {
  public:
   MyLib() = default;
@@ -20,12 +38,23 @@ class MYLIB_EXPORT MyLib {
   /// Computes maximum of 6 neighbors for a given point
   static void FindNeighbors3D(Eigen::Vector3i const &pt, std::vector<Eigen::Vector3i> &neighbors);
 
-  /// Finds surface points of a point cloud region
+  /// Finds surface points of a point cloud region; all 6 neighbours of the point must lie inside the buffer
   static bool IsSurfacePoint(const int *buf, Eigen::Vector3i const &point, int width, int height);
 
   /// Computes rigid transformation matrix for transformation from source to target
   static Eigen::Isometry3d EstimateRigidTransformation3D(std::vector<Eigen::Vector3d> const &source_points,
 														 std::vector<Eigen::Vector3d> const &target_points);
+
+  /// Computes rigid transformation matrix from the means and the cross-covariance matrix of paired points
+  static Eigen::Isometry3d RigidTransformationFromCovariance(Eigen::Vector3d const &mean_source,
+															 Eigen::Vector3d const &mean_target,
+															 Eigen::Matrix3d const &cross_covariance);
+
+  /// Registers two unpaired surface point clouds with the iterative closest point algorithm
+  static Status EstimateRigidTransformationICP(std::vector<Eigen::Vector3d> const &source_points,
+											   std::vector<Eigen::Vector3d> const &target_points,
+											   IcpParameters const &parameters, Eigen::Isometry3d &transformation,
+											   double &rms_error);
 };
 
 namespace utils {
@@ -0,0 +1,150 @@
+#include "normal_volume.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr float NormalVolume::kSobelWeights[3];
+
+/**
+ * @details Every layer is processed by one thread. The 3x3x3 Sobel operator is separable, so each row is computed
+ * from three row buffers: the neighbourhood smoothed across y and z (differenced along x afterwards), and the
+ * differences along y and z smoothed across the other off-axis direction (smoothed along x afterwards).
+ * This needs 18 instead of 54 reads per voxel and gives the same result as ComputeNormal().
+ * @param linear_data Flat x-fastest source volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @return StatusCode::OK on success, StatusCode::BUFFER_EMPTY if the source is null or has no voxels
+ */
+Status NormalVolume::Build(const int16_t *linear_data, int width, int height, int layers) {
+  if (linear_data == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  m_width = width;
+  m_height = height;
+  m_layers = layers;
+  m_codes.resize(static_cast<size_t>(width) * height * layers);
+  size_t const slice_size = static_cast<size_t>(width) * height;
+
+  utils::ParallelFor(0, layers, [&](int z) {
+	std::vector<float> smoothed(width);
+	std::vector<float> diff_y(width);
+	std::vector<float> diff_z(width);
+	int const zs[3] = {std::max(z - 1, 0), z, std::min(z + 1, layers - 1)};
+	for (int y = 0; y < height; ++y) {
+	  int const ys[3] = {std::max(y - 1, 0), y, std::min(y + 1, height - 1)};
+	  const int16_t *rows[3][3];
+	  for (int j = 0; j < 3; ++j) {
+		for (int k = 0; k < 3; ++k) {
+		  rows[j][k] = linear_data + static_cast<size_t>(ys[j]) * width + zs[k] * slice_size;
+		}
+	  }
+	  for (int x = 0; x < width; ++x) {
+		float s = 0.0f;
+		float dy = 0.0f;
+		float dz = 0.0f;
+		for (int i = 0; i < 3; ++i) {
+		  float const w = kSobelWeights[i];
+		  dy += w * static_cast<float>(rows[2][i][x] - rows[0][i][x]);
+		  dz += w * static_cast<float>(rows[i][2][x] - rows[i][0][x]);
+		  s += w * static_cast<float>(rows[i][0][x] + 2 * rows[i][1][x] + rows[i][2][x]);
+		}
+		smoothed[x] = s;
+		diff_y[x] = dy;
+		diff_z[x] = dz;
+	  }
+	  uint16_t *codes = m_codes.data() + z * slice_size + static_cast<size_t>(y) * width;
+	  for (int x = 0; x < width; ++x) {
+		int const x0 = std::max(x - 1, 0);
+		int const x1 = std::min(x + 1, width - 1);
+		codes[x] = EncodeNormal(smoothed[x1] - smoothed[x0], diff_y[x0] + 2.0f * diff_y[x] + diff_y[x1],
+								diff_z[x0] + 2.0f * diff_z[x] + diff_z[x1]);
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Applies the 3x3x3 Sobel operator directly. Coordinates outside the volume are clamped to its border.
+ * @param linear_data Flat x-fastest source volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param x Voxel column
+ * @param y Voxel row
+ * @param z Voxel layer
+ * @return Octahedral code of the normalized HU gradient at the voxel
+ */
+uint16_t NormalVolume::ComputeNormal(const int16_t *linear_data, int width, int height, int layers, int x, int y,
+									 int z) {
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  int const xs[3] = {std::max(x - 1, 0), x, std::min(x + 1, width - 1)};
+  int const ys[3] = {std::max(y - 1, 0), y, std::min(y + 1, height - 1)};
+  int const zs[3] = {std::max(z - 1, 0), z, std::min(z + 1, layers - 1)};
+  auto value = [&](int i, int j, int k) {
+	return static_cast<float>(linear_data[xs[i] + static_cast<size_t>(ys[j]) * width + zs[k] * slice_size]);
+  };
+  float gx = 0.0f;
+  float gy = 0.0f;
+  float gz = 0.0f;
+  for (int a = 0; a < 3; ++a) {
+	for (int b = 0; b < 3; ++b) {
+	  float const w = kSobelWeights[a] * kSobelWeights[b];
+	  gx += w * (value(2, a, b) - value(0, a, b));
+	  gy += w * (value(a, 2, b) - value(a, 0, b));
+	  gz += w * (value(a, b, 2) - value(a, b, 0));
+	}
+  }
+  return EncodeNormal(gx, gy, gz);
+}
+
+/**
+ * @details The direction is projected onto the octahedron |x| + |y| + |z| = 1. The lower half (z < 0) is folded over
+ * the diagonals into the corners of the unit square, and both square coordinates are quantized to 8 bits.
+ * @return Code with the quantized x coordinate in the low and the quantized y coordinate in the high byte
+ */
+uint16_t NormalVolume::EncodeNormal(float x, float y, float z) {
+  float const norm = std::abs(x) + std::abs(y) + std::abs(z);
+  if (norm <= 0.0f) {
+	x = 0.0f;
+	y = 0.0f;
+	z = 1.0f;
+  } else {
+	x /= norm;
+	y /= norm;
+	z /= norm;
+  }
+  if (z < 0.0f) {
+	float const folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+	float const folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+	x = folded_x;
+	y = folded_y;
+  }
+  auto const u = static_cast<uint16_t>(std::lround((x * 0.5f + 0.5f) * 255.0f));
+  auto const v = static_cast<uint16_t>(std::lround((y * 0.5f + 0.5f) * 255.0f));
+  return static_cast<uint16_t>(u | (v << 8));
+}
+
+void NormalVolume::DecodeNormal(uint16_t code, float &x, float &y, float &z) {
+  x = static_cast<float>(code & 0xff) / 255.0f * 2.0f - 1.0f;
+  y = static_cast<float>(code >> 8) / 255.0f * 2.0f - 1.0f;
+  z = 1.0f - std::abs(x) - std::abs(y);
+  if (z < 0.0f) {
+	float const unfolded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+	float const unfolded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+	x = unfolded_x;
+	y = unfolded_y;
+  }
+  float const length = std::sqrt(x * x + y * y + z * z);
+  x /= length;
+  y /= length;
+  z /= length;
+}
+
+void NormalVolume::Clear() {
+  m_codes.clear();
+  m_codes.shrink_to_fit();
+  m_width = m_height = m_layers = 0;
+}
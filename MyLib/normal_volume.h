@@ -0,0 +1,58 @@
+#ifndef NORMAL_VOLUME_H
+#define NORMAL_VOLUME_H
+
+#include "MyLib_global.h"
+#include "status.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Stores the normalized HU gradient of every voxel as a 16-bit octahedral code
+ * @details The gradient is computed with the 3x3x3 Sobel operator, which gives much smoother normals than central
+ * differences on the staircase surfaces of thresholded bone. It is mapped onto an octahedron, which is unfolded into
+ * the unit square and quantized with 8 bits per axis. This keeps the angular error below two degrees at 2 bytes per
+ * voxel. Shading then only needs one lookup per pixel, see CTDataset::RenderDepthBuffer().
+ * The gradient points towards increasing HU values, i.e. into dense material. Voxels without a gradient get the code
+ * of +z.
+ */
+class MYLIB_EXPORT NormalVolume {
+ public:
+  NormalVolume() = default;
+
+  /// Smoothing weights of the separable Sobel operator
+  static constexpr float kSobelWeights[3] = {1.0f, 2.0f, 1.0f};
+
+  /// Computes the normal of every voxel of a linear x-fastest volume, one layer per thread
+  Status Build(const int16_t *linear_data, int width, int height, int layers);
+
+  /// Computes the encoded normal of a single voxel of a linear x-fastest volume
+  static uint16_t ComputeNormal(const int16_t *linear_data, int width, int height, int layers, int x, int y, int z);
+
+  /// Octahedral encoding of a direction, which does not need to be normalized
+  static uint16_t EncodeNormal(float x, float y, float z);
+
+  /// Decodes an octahedral code into a unit vector
+  static void DecodeNormal(uint16_t code, float &x, float &y, float &z);
+
+  /// Releases the normals
+  void Clear();
+
+  /// @return True if no normals have been computed yet
+  [[nodiscard]] bool Empty() const { return m_codes.empty(); }
+
+  /// Encoded normal of voxel (x, y, z)
+  [[nodiscard]] inline uint16_t At(int x, int y, int z) const {
+	return m_codes[x + static_cast<size_t>(y) * m_width + static_cast<size_t>(z) * m_width * m_height];
+  }
+
+ private:
+  int m_width{0};
+  int m_height{0};
+  int m_layers{0};
+
+  /// Encoded normals in x-fastest order
+  std::vector<uint16_t> m_codes;
+};
+
+#endif  // NORMAL_VOLUME_H
@@ -0,0 +1,232 @@
+#include "parallel.h"
+
+namespace utils {
+constexpr int ThreadPool::kChunksPerWorker;
+constexpr int ThreadPool::kDeterministicChunks;
+
+namespace {
+/// Packs the chunk range [begin, end) of a slot into one word, so that it can be updated with a single CAS
+inline uint64_t PackRange(uint32_t begin, uint32_t end) {
+  return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+inline uint32_t RangeBegin(uint64_t range) {
+  return static_cast<uint32_t>(range >> 32);
+}
+
+inline uint32_t RangeEnd(uint64_t range) {
+  return static_cast<uint32_t>(range);
+}
+} // namespace
+
+/**
+ * @brief A parallel loop in progress
+ * @details Slot 0 belongs to the calling thread, the other slots to the workers that join the job. Chunks are only
+ * ever removed from a slot: the owner takes them from the front, thieves shrink the range from the back. A thief
+ * only refills its own slot while it is empty, and no chunk is handed out twice, so a slot never returns to a range
+ * it had before and the CAS updates cannot suffer from ABA.
+ */
+struct ThreadPool::Job {
+  Job(int chunk_count, int slot_count, std::function<void(int)> const &task) :
+	task(task), slots(new std::atomic<uint64_t>[slot_count]), slot_count(slot_count), remaining(chunk_count) {
+	for (int slot = 0; slot < slot_count; ++slot) {
+	  slots[slot].store(PackRange(ChunkBegin(0, chunk_count, slot, slot_count),
+								  ChunkBegin(0, chunk_count, slot + 1, slot_count)));
+	}
+  }
+
+  /// Takes the first chunk of a slot
+  bool PopFront(int slot, int &chunk) {
+	uint64_t range = slots[slot].load();
+	while (RangeBegin(range) < RangeEnd(range)) {
+	  if (slots[slot].compare_exchange_weak(range, PackRange(RangeBegin(range) + 1, RangeEnd(range)))) {
+		chunk = static_cast<int>(RangeBegin(range));
+		return true;
+	  }
+	}
+	return false;
+  }
+
+  /// Takes the back half of the range of another slot, runs its first chunk and keeps the rest in the own slot
+  bool Steal(int thief, int &chunk) {
+	for (int offset = 1; offset < slot_count; ++offset) {
+	  std::atomic<uint64_t> &victim = slots[(thief + offset) % slot_count];
+	  uint64_t range = victim.load();
+	  while (RangeBegin(range) < RangeEnd(range)) {
+		uint32_t const middle = RangeBegin(range) + (RangeEnd(range) - RangeBegin(range)) / 2;
+		if (victim.compare_exchange_weak(range, PackRange(RangeBegin(range), middle))) {
+		  chunk = static_cast<int>(middle);
+		  slots[thief].store(PackRange(middle + 1, RangeEnd(range)));
+		  return true;
+		}
+	  }
+	}
+	return false;
+  }
+
+  std::function<void(int)> const &task;
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  int const slot_count;
+
+  /// Next slot for a joining worker
+  std::atomic<int> joined{1};
+
+  /// Number of chunks that have not finished yet
+  std::atomic<int> remaining;
+
+  std::mutex mutex;
+  std::condition_variable done;
+};
+
+ThreadPool &ThreadPool::Instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool() {
+  Start(0);
+}
+
+ThreadPool::~ThreadPool() {
+  Stop();
+}
+
+/**
+ * @details Restarts the worker threads. Must not be called while a parallel loop is running.
+ * @param count Number of threads including the calling thread, 0 for one per hardware thread
+ */
+void ThreadPool::SetWorkerCount(int count) {
+  std::lock_guard<std::mutex> config_lock(m_configMutex);
+  Stop();
+  Start(count);
+}
+
+int ThreadPool::WorkerCount() const {
+  return m_workerCount.load();
+}
+
+void ThreadPool::SetDeterministic(bool deterministic) {
+  m_deterministic.store(deterministic);
+}
+
+bool ThreadPool::Deterministic() const {
+  return m_deterministic.load();
+}
+
+/**
+ * @details Without deterministic mode a loop gets kChunksPerWorker chunks per worker, and a single chunk if there is
+ * only one worker. In deterministic mode it gets kDeterministicChunks chunks independent of the worker count.
+ * @param count Number of indices of the range
+ * @param grain Minimum number of indices per chunk
+ * @return Number of chunks, at least 1
+ */
+int ThreadPool::ChunkCount(int count, int grain) const {
+  int const max_chunks = std::max(1, count / std::max(1, grain));
+  if (Deterministic()) {
+	return std::min(max_chunks, kDeterministicChunks);
+  }
+  int const workers = WorkerCount();
+  return workers == 1 ? 1 : std::min(max_chunks, workers * kChunksPerWorker);
+}
+
+/**
+ * @details The chunks are distributed over up to WorkerCount() slots. The calling thread works on slot 0 and then
+ * steals until no chunk is left; idle workers join the job and do the same with the other slots. Chunks of slots
+ * that no worker joined in time are stolen, so the loop never waits for a busy worker. Finally the calling thread
+ * waits for the chunks that are still running on other threads.
+ * @param chunk_count Number of chunks
+ * @param task Callable taking the chunk index, must be safe to call concurrently for different chunks
+ */
+void ThreadPool::Run(int chunk_count, std::function<void(int)> const &task) {
+  if (chunk_count <= 0) {
+	return;
+  }
+  int const slot_count = std::min(chunk_count, WorkerCount());
+  if (slot_count == 1) {
+	for (int chunk = 0; chunk < chunk_count; ++chunk) {
+	  task(chunk);
+	}
+	return;
+  }
+
+  auto job = std::make_shared<Job>(chunk_count, slot_count, task);
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_jobs.push_back(job);
+  }
+  m_wakeUp.notify_all();
+
+  Participate(*job, 0);
+  {
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->done.wait(lock, [&job] { return job->remaining.load() == 0; });
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto const position = std::find(m_jobs.begin(), m_jobs.end(), job);
+  if (position != m_jobs.end()) {
+	m_jobs.erase(position);
+  }
+}
+
+void ThreadPool::Participate(Job &job, int slot) {
+  int chunk = 0;
+  while (job.PopFront(slot, chunk) || job.Steal(slot, chunk)) {
+	job.task(chunk);
+	if (job.remaining.fetch_sub(1) == 1) {
+	  std::lock_guard<std::mutex> lock(job.mutex);
+	  job.done.notify_all();
+	}
+  }
+}
+
+void ThreadPool::Start(int count) {
+  int const workers = count > 0 ? count : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  m_workerCount.store(workers);
+  m_stop = false;
+  m_workers.reserve(workers - 1);
+  for (int i = 1; i < workers; ++i) {
+	m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+void ThreadPool::Stop() {
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stop = true;
+  }
+  m_wakeUp.notify_all();
+  for (auto &worker : m_workers) {
+	worker.join();
+  }
+  m_workers.clear();
+  m_workerCount.store(1);
+}
+
+/**
+ * @details Joins the oldest job that still has a free slot. The job stays referenced while the worker takes part,
+ * so it outlives Run() if the worker joins after the last chunk has finished; it then finds no chunk and leaves.
+ */
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+	std::shared_ptr<Job> job;
+	int slot = 0;
+	{
+	  std::unique_lock<std::mutex> lock(m_mutex);
+	  m_wakeUp.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+	  if (m_stop) {
+		return;
+	  }
+	  job = m_jobs.front();
+	  slot = job->joined.fetch_add(1);
+	  if (slot >= job->slot_count - 1) {
+		m_jobs.pop_front();
+	  }
+	  if (slot >= job->slot_count) {
+		continue;
+	  }
+	}
+	Participate(*job, slot);
+  }
+}
+} // namespace utils
@@ -0,0 +1,258 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "MyLib_global.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+/**
+ * @brief Library-wide pool of worker threads that all parallel loops of MyLib share
+ * @details A parallel loop is split into chunks of neighbouring indices (rows, layers, slabs). Every participating
+ * thread starts with one contiguous range of chunks, so neighbouring data stays on the same core, and takes the
+ * chunks of its range from the front. A thread whose range is empty steals the back half of the range of another
+ * thread, so uneven chunks (e.g. empty and full layers of a volume) are balanced without any central queue.
+ * The calling thread always takes part in its own loop and never waits for a worker to become free, so parallel
+ * loops can be nested and run from several threads at once without oversubscribing the machine or deadlocking.
+ * In deterministic mode the chunk boundaries only depend on the size of the range, not on the number of workers, so
+ * reductions that combine the results of the chunks in chunk order (see ParallelReduce()) give bitwise identical
+ * results on every machine and for every worker count.
+ */
+class MYLIB_EXPORT ThreadPool {
+ public:
+  /// Number of chunks per worker a loop is split into, so that stealing can balance uneven chunks
+  static constexpr int kChunksPerWorker = 4;
+
+  /// Number of chunks a loop is split into in deterministic mode (fewer if there are fewer indices)
+  static constexpr int kDeterministicChunks = 64;
+
+  /// The pool shared by all parallel loops, started with one thread per hardware thread
+  static ThreadPool &Instance();
+
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  /// Sets the number of threads that run a loop (including the calling thread), 0 for one per hardware thread
+  void SetWorkerCount(int count);
+
+  /// Number of threads that run a loop, including the calling thread
+  [[nodiscard]] int WorkerCount() const;
+
+  /// Enables chunking that does not depend on the worker count, see the class description
+  void SetDeterministic(bool deterministic);
+
+  /// @return True if the chunking does not depend on the worker count
+  [[nodiscard]] bool Deterministic() const;
+
+  /// Number of chunks a range of count indices is split into, with at least grain indices per chunk
+  [[nodiscard]] int ChunkCount(int count, int grain) const;
+
+  /// Calls task(chunk) for every chunk in [0, chunk_count) on the pool and the calling thread, waits for all
+  void Run(int chunk_count, std::function<void(int)> const &task);
+
+ private:
+  struct Job;
+
+  ThreadPool();
+
+  /// Starts count - 1 worker threads
+  void Start(int count);
+
+  /// Stops and joins all worker threads
+  void Stop();
+
+  /// Main loop of a worker thread
+  void WorkerLoop();
+
+  /// Runs chunks of a job from the given slot and steals from the other slots until no chunk is left
+  static void Participate(Job &job, int slot);
+
+  /// Serializes SetWorkerCount() calls
+  std::mutex m_configMutex;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+
+  /// Jobs that still have slots for workers to join, oldest first
+  std::deque<std::shared_ptr<Job>> m_jobs;
+  bool m_stop{false};
+
+  std::vector<std::thread> m_workers;
+  std::atomic<int> m_workerCount{1};
+  std::atomic<bool> m_deterministic{false};
+};
+
+/// First index of a chunk when [begin, begin + count) is split evenly into chunk_count chunks
+inline int ChunkBegin(int begin, int count, int chunk, int chunk_count) {
+  return begin + static_cast<int>(static_cast<int64_t>(count) * chunk / chunk_count);
+}
+
+/**
+ * @brief Calls fn(chunk_begin, chunk_end) for consecutive chunks that cover [begin, end), spread over the thread pool
+ * @param begin First index of the range
+ * @param end One past the last index of the range
+ * @param grain Minimum number of indices per chunk
+ * @param fn Callable taking the int bounds of a chunk, must be safe to call concurrently for different chunks
+ */
+template<typename Function>
+inline void ParallelForChunks(int begin, int end, int grain, Function const &fn) {
+  int const count = end - begin;
+  if (count <= 0) {
+	return;
+  }
+  ThreadPool &pool = ThreadPool::Instance();
+  int const chunk_count = pool.ChunkCount(count, grain);
+  if (chunk_count == 1) {
+	fn(begin, end);
+	return;
+  }
+  pool.Run(chunk_count, [&](int chunk) {
+	fn(ChunkBegin(begin, count, chunk, chunk_count), ChunkBegin(begin, count, chunk + 1, chunk_count));
+  });
+}
+
+/**
+ * @brief Calls fn(i) for every i in [begin, end), spread over the thread pool
+ * @details The range is split into chunks of neighbouring indices (e.g. neighbouring image rows or volume slabs),
+ * see ThreadPool. fn must be safe to call concurrently for different indices.
+ * @param begin First index of the range
+ * @param end One past the last index of the range
+ * @param fn Callable taking an int index
+ */
+template<typename Function>
+inline void ParallelFor(int begin, int end, Function const &fn) {
+  ParallelForChunks(begin, end, 1, [&fn](int chunk_begin, int chunk_end) {
+	for (int i = chunk_begin; i < chunk_end; ++i) {
+	  fn(i);
+	}
+  });
+}
+
+/**
+ * @brief Calls fn(x, y) for every pixel of a width x height image, whole rows per chunk
+ */
+template<typename Function>
+inline void ParallelFor2D(int width, int height, Function const &fn) {
+  if (width <= 0) {
+	return;
+  }
+  ParallelForChunks(0, height, 1, [&](int y_begin, int y_end) {
+	for (int y = y_begin; y < y_end; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		fn(x, y);
+	  }
+	}
+  });
+}
+
+/**
+ * @brief Calls fn(x, y, z) for every voxel of a width x height x layers volume in x-fastest order within a chunk
+ * @details The chunks are slabs of whole layers if there are enough layers for all chunks, so every thread streams
+ * through contiguous memory; thin volumes are split into rows instead.
+ */
+template<typename Function>
+inline void ParallelFor3D(int width, int height, int layers, Function const &fn) {
+  if (width <= 0 || height <= 0 || layers <= 0) {
+	return;
+  }
+  int const rows = height * layers;
+  if (layers >= ThreadPool::Instance().ChunkCount(rows, 1)) {
+	ParallelForChunks(0, layers, 1, [&](int z_begin, int z_end) {
+	  for (int z = z_begin; z < z_end; ++z) {
+		for (int y = 0; y < height; ++y) {
+		  for (int x = 0; x < width; ++x) {
+			fn(x, y, z);
+		  }
+		}
+	  }
+	});
+	return;
+  }
+  ParallelForChunks(0, rows, 1, [&](int row_begin, int row_end) {
+	for (int row = row_begin; row < row_end; ++row) {
+	  for (int x = 0; x < width; ++x) {
+		fn(x, row % height, row / height);
+	  }
+	}
+  });
+}
+
+/**
+ * @brief Reduces [begin, end) in parallel: map(chunk_begin, chunk_end) per chunk, combined in chunk order
+ * @details The partial results are combined from left to right in the calling thread, so the result only depends on
+ * the chunking; in deterministic mode it is the same for every worker count (see ThreadPool).
+ * @param begin First index of the range
+ * @param end One past the last index of the range
+ * @param grain Minimum number of indices per chunk
+ * @param identity Result of an empty range
+ * @param map Callable taking the int bounds of a chunk and returning its partial result
+ * @param combine Callable taking two partial results and returning their combination
+ */
+template<typename T, typename Map, typename Combine>
+inline T ParallelReduce(int begin, int end, int grain, T const &identity, Map const &map, Combine const &combine) {
+  int const count = end - begin;
+  if (count <= 0) {
+	return identity;
+  }
+  ThreadPool &pool = ThreadPool::Instance();
+  int const chunk_count = pool.ChunkCount(count, grain);
+  std::vector<T> partial(chunk_count, identity);
+  pool.Run(chunk_count, [&](int chunk) {
+	int const chunk_begin = ChunkBegin(begin, count, chunk, chunk_count);
+	partial[chunk] = map(chunk_begin, ChunkBegin(begin, count, chunk + 1, chunk_count));
+  });
+  T result = identity;
+  for (T const &value : partial) {
+	result = combine(result, value);
+  }
+  return result;
+}
+
+/**
+ * @brief Calls fn(i, output) for every i in [begin, end) in parallel and concatenates what the calls append to output
+ * @details Every chunk appends to its own vector, and the vectors are concatenated in chunk order, so the result is
+ * in the same order as a sequential loop over the range.
+ */
+template<typename T, typename Function>
+inline std::vector<T> ParallelCollect(int begin, int end, Function const &fn) {
+  int const count = end - begin;
+  if (count <= 0) {
+	return {};
+  }
+  ThreadPool &pool = ThreadPool::Instance();
+  int const chunk_count = pool.ChunkCount(count, 1);
+  std::vector<std::vector<T>> parts(chunk_count);
+  pool.Run(chunk_count, [&](int chunk) {
+	int const chunk_end = ChunkBegin(begin, count, chunk + 1, chunk_count);
+	for (int i = ChunkBegin(begin, count, chunk, chunk_count); i < chunk_end; ++i) {
+	  fn(i, parts[chunk]);
+	}
+  });
+  if (chunk_count == 1) {
+	return std::move(parts[0]);
+  }
+  size_t total = 0;
+  for (auto const &part : parts) {
+	total += part.size();
+  }
+  std::vector<T> result;
+  result.reserve(total);
+  for (auto const &part : parts) {
+	result.insert(result.end(), part.begin(), part.end());
+  }
+  return result;
+}
+} // namespace utils
+
+#endif  // PARALLEL_H
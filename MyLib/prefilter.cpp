@@ -0,0 +1,270 @@
+#include "prefilter.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+constexpr int Prefilter::kWeightShift;
+constexpr double Prefilter::kMaxSigma;
+
+namespace {
+/// Median of the 27 voxels at x - 1, x, x + 1 of nine padded rows, see Prefilter::Median()
+int16_t MedianAt(std::vector<int16_t> const (&rows)[9], int x) {
+  int16_t values[27];
+  for (int r = 0; r < 9; ++r) {
+	for (int dx = 0; dx < 3; ++dx) {
+	  values[r * 3 + dx] = rows[r][x + dx];
+	}
+  }
+  std::nth_element(values, values + 13, values + 27);
+  return values[13];
+}
+
+/// Sorts the elements of three rows so that a[i] <= b[i] <= c[i]
+void SortRows(int16_t *a, int16_t *b, int16_t *c, int const count) {
+  simd::MinMaxRows(a, b, count);
+  simd::MinMaxRows(b, c, count);
+  simd::MinMaxRows(a, b, count);
+}
+
+#ifdef MYLIB_SSE2
+/// Sorts the pair so that a holds the minimum and b the maximum of every lane
+inline void CompareExchange(__m128i &a, __m128i &b) {
+  __m128i const minimum = _mm_min_epi16(a, b);
+  b = _mm_max_epi16(a, b);
+  a = minimum;
+}
+
+/**
+ * One step of the forgetful selection: moves the minimum of the kSize values to window[0] and the maximum to
+ * window[kSize - 1], then replaces the minimum with the next value and drops the maximum. The sizes are template
+ * parameters, so that the compiler can unroll every loop and keep the window in registers.
+ */
+template<int kSize>
+struct ForgetfulSelection {
+  static inline void Run(__m128i *window, const __m128i *next) {
+	for (int i = 1; i < kSize; ++i) {
+	  CompareExchange(window[0], window[i]);
+	}
+	for (int i = 1; i < kSize - 1; ++i) {
+	  CompareExchange(window[i], window[kSize - 1]);
+	}
+	window[0] = *next;
+	ForgetfulSelection<kSize - 1>::Run(window, next + 1);
+  }
+};
+
+/// Three values are left once all values have entered the window, their median is the result in window[1]
+template<>
+struct ForgetfulSelection<3> {
+  static inline void Run(__m128i *window, const __m128i *) {
+	CompareExchange(window[0], window[1]);
+	CompareExchange(window[1], window[2]);
+	CompareExchange(window[0], window[1]);
+  }
+};
+#endif
+} // namespace
+
+/**
+ * @param input Flat x-fastest volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param params Filter and its parameters
+ * @param output Output: filtered volume of the same size, must not overlap input
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if the volume is empty, or StatusCode::PREFILTER_ERROR if the
+ * parameters are out of range
+ */
+Status Prefilter::Apply(const int16_t *input, int width, int height, int layers, PrefilterParameters const &params,
+						int16_t *output) {
+  switch (params.type) {
+	case PrefilterType::GAUSSIAN:
+	  return Gaussian(input, width, height, layers, params.sigma, output);
+	case PrefilterType::MEDIAN:
+	  return Median(input, width, height, layers, output);
+	case PrefilterType::NONE:
+	  break;
+  }
+  if (input == nullptr || output == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  std::copy(input, input + static_cast<size_t>(width) * height * layers, output);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The kernel is sampled at the integer offsets up to ceil(3 sigma) and quantized to 14-bit weights whose sum
+ * is exactly 2^kWeightShift, so flat regions keep their HU value. Every pass accumulates weighted rows in 32 bit and
+ * rounds back to int16_t:
+ * - x: one row at a time from a copy with replicated border voxels, one layer per thread
+ * - y: whole rows of the layer, one layer per thread
+ * - z: whole rows of the neighbouring layers, one row index y per thread. The rows of a y index are copied first, so
+ *   the pass can write its result in place.
+ * @param input Flat x-fastest volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param sigma Standard deviation in voxels, greater than 0 and at most kMaxSigma
+ * @param output Output: smoothed volume of the same size, must not overlap input
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if the volume is empty, or StatusCode::PREFILTER_ERROR if sigma is
+ * out of range
+ */
+Status Prefilter::Gaussian(const int16_t *input, int width, int height, int layers, double sigma, int16_t *output) {
+  if (input == nullptr || output == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  if (!(sigma > 0.0) || sigma > kMaxSigma) {
+	return Status(StatusCode::PREFILTER_ERROR);
+  }
+
+  int const radius = static_cast<int>(std::ceil(3.0 * sigma));
+  std::vector<double> kernel(2 * radius + 1);
+  double kernel_sum = 0.0;
+  for (int k = -radius; k <= radius; ++k) {
+	kernel[k + radius] = std::exp(-0.5 * k * k / (sigma * sigma));
+	kernel_sum += kernel[k + radius];
+  }
+  std::vector<int16_t> weights(2 * radius + 1);
+  int weight_sum = 0;
+  for (int k = 0; k <= 2 * radius; ++k) {
+	weights[k] = static_cast<int16_t>(std::lround(kernel[k] / kernel_sum * (1 << kWeightShift)));
+	weight_sum += weights[k];
+  }
+  weights[radius] = static_cast<int16_t>(weights[radius] + (1 << kWeightShift) - weight_sum);
+
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  utils::ParallelFor(0, layers, [&](int z) {
+	std::vector<int16_t> padded(width + 2 * radius);
+	std::vector<int32_t> acc(width);
+	for (int y = 0; y < height; ++y) {
+	  const int16_t *row = input + z * slice_size + static_cast<size_t>(y) * width;
+	  std::fill_n(padded.begin(), radius, row[0]);
+	  std::copy(row, row + width, padded.begin() + radius);
+	  std::fill_n(padded.begin() + radius + width, radius, row[width - 1]);
+	  std::fill(acc.begin(), acc.end(), 0);
+	  for (int k = 0; k <= 2 * radius; ++k) {
+		simd::AddWeightedRow(acc.data(), padded.data() + k, weights[k], width);
+	  }
+	  simd::NarrowRow(output + z * slice_size + static_cast<size_t>(y) * width, acc.data(), kWeightShift, width);
+	}
+  });
+
+  utils::ParallelFor(0, layers, [&](int z) {
+	int16_t *layer = output + z * slice_size;
+	std::vector<int16_t> source(layer, layer + slice_size);
+	std::vector<int32_t> acc(width);
+	for (int y = 0; y < height; ++y) {
+	  std::fill(acc.begin(), acc.end(), 0);
+	  for (int k = -radius; k <= radius; ++k) {
+		int const source_y = std::min(std::max(y + k, 0), height - 1);
+		simd::AddWeightedRow(acc.data(), source.data() + static_cast<size_t>(source_y) * width, weights[k + radius],
+							 width);
+	  }
+	  simd::NarrowRow(layer + static_cast<size_t>(y) * width, acc.data(), kWeightShift, width);
+	}
+  });
+
+  utils::ParallelFor(0, height, [&](int y) {
+	std::vector<int16_t> source(static_cast<size_t>(layers) * width);
+	for (int z = 0; z < layers; ++z) {
+	  const int16_t *row = output + z * slice_size + static_cast<size_t>(y) * width;
+	  std::copy(row, row + width, source.begin() + static_cast<size_t>(z) * width);
+	}
+	std::vector<int32_t> acc(width);
+	for (int z = 0; z < layers; ++z) {
+	  std::fill(acc.begin(), acc.end(), 0);
+	  for (int k = -radius; k <= radius; ++k) {
+		int const source_z = std::min(std::max(z + k, 0), layers - 1);
+		simd::AddWeightedRow(acc.data(), source.data() + static_cast<size_t>(source_z) * width, weights[k + radius],
+							 width);
+	  }
+	  simd::NarrowRow(output + z * slice_size + static_cast<size_t>(y) * width, acc.data(), kWeightShift, width);
+	}
+  });
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Every output row copies the nine rows of its 3x3 neighbourhood in y and z (clamped at the border) into
+ * buffers padded by one replicated voxel at both ends, and sorts them element-wise, first along z and then along y.
+ * Eight voxels at a time then sort the three x-neighbours of each buffer, so the 27 values form a cube V[a][b][c] that
+ * is sorted along all three axes. V[a][b][c] is then greater than or equal to (a + 1)(b + 1)(c + 1) - 1 values and
+ * less than or equal to (3 - a)(3 - b)(3 - c) - 1 values, which rules out the four values with a + b + c < 2 as too
+ * small and the four with a + b + c > 4 as too large. The median is the median of the remaining 19 values, found by a
+ * forgetful selection network: of the first 11 values, the minimum and maximum cannot be the median and are dropped,
+ * the next value takes their place, and so on until three values are left. All comparisons are min/max instructions
+ * on eight int16_t lanes, about 145 per eight voxels. The last voxels of a row, and all voxels without SSE2, use
+ * nth_element. One layer per thread.
+ * @param input Flat x-fastest volume
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param output Output: filtered volume of the same size, must not overlap input
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the volume is empty
+ */
+Status Prefilter::Median(const int16_t *input, int width, int height, int layers, int16_t *output) {
+  if (input == nullptr || output == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  size_t const slice_size = static_cast<size_t>(width) * height;
+  utils::ParallelFor(0, layers, [&](int z) {
+	// rows[a * 3 + b]: rank a along z and rank b along y after sorting
+	std::vector<int16_t> rows[9];
+	for (auto &row : rows) {
+	  row.resize(width + 2);
+	}
+	for (int y = 0; y < height; ++y) {
+	  for (int dz = -1; dz <= 1; ++dz) {
+		for (int dy = -1; dy <= 1; ++dy) {
+		  int const source_y = std::min(std::max(y + dy, 0), height - 1);
+		  int const source_z = std::min(std::max(z + dz, 0), layers - 1);
+		  const int16_t *source = input + source_z * slice_size + static_cast<size_t>(source_y) * width;
+		  std::vector<int16_t> &row = rows[(dz + 1) * 3 + dy + 1];
+		  row[0] = source[0];
+		  std::copy(source, source + width, row.begin() + 1);
+		  row[width + 1] = source[width - 1];
+		}
+	  }
+	  for (int b = 0; b < 3; ++b) {
+		SortRows(rows[b].data(), rows[3 + b].data(), rows[6 + b].data(), width + 2);
+	  }
+	  for (int a = 0; a < 3; ++a) {
+		SortRows(rows[3 * a].data(), rows[3 * a + 1].data(), rows[3 * a + 2].data(), width + 2);
+	  }
+
+	  int16_t *out = output + z * slice_size + static_cast<size_t>(y) * width;
+	  int x = 0;
+#ifdef MYLIB_SSE2
+	  for (; x + 8 <= width; x += 8) {
+		__m128i candidates[19];
+		int count = 0;
+		for (int a = 0; a < 3; ++a) {
+		  for (int b = 0; b < 3; ++b) {
+			const int16_t *row = rows[3 * a + b].data() + x;
+			__m128i v[3] = {_mm_loadu_si128(reinterpret_cast<const __m128i *>(row)),
+							_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 1)),
+							_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 2))};
+			CompareExchange(v[0], v[1]);
+			CompareExchange(v[1], v[2]);
+			CompareExchange(v[0], v[1]);
+			for (int c = 0; c < 3; ++c) {
+			  if (a + b + c >= 2 && a + b + c <= 4) {
+				candidates[count++] = v[c];
+			  }
+			}
+		  }
+		}
+		ForgetfulSelection<11>::Run(candidates, candidates + 11);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), candidates[1]);
+	  }
+#endif
+	  for (; x < width; ++x) {
+		out[x] = MedianAt(rows, x);
+	  }
+	}
+  });
+  return Status(StatusCode::OK);
+}
@@ -0,0 +1,61 @@
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include "MyLib_global.h"
+#include "status.h"
+
+#include <cstdint>
+
+/**
+ * @brief Denoising filter applied to the image data before thresholding
+ */
+enum class PrefilterType {
+  /// The kernels read the raw image data
+  NONE,
+  /// Separable Gaussian smoothing
+  GAUSSIAN,
+  /// Median of the 3x3x3 neighbourhood, removes impulse noise and keeps edges sharp
+  MEDIAN
+};
+
+/**
+ * @brief Parameters of the prefilter stage of CTDataset
+ */
+struct PrefilterParameters {
+  /// Filter to apply
+  PrefilterType type{PrefilterType::NONE};
+  /// Standard deviation of the Gaussian in voxels, the kernel is truncated at three standard deviations
+  double sigma{1.0};
+
+  bool operator==(PrefilterParameters const &other) const {
+	return type == other.type && (type != PrefilterType::GAUSSIAN || sigma == other.sigma);
+  }
+  bool operator!=(PrefilterParameters const &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Denoising filters for int16_t volumes
+ * @details Both filters read a linear x-fastest volume and write a volume of the same size, replicating the border
+ * voxels outside the volume. The work is spread over all hardware threads and the inner loops process eight voxels per
+ * SSE2 instruction (see simd.h).
+ */
+class MYLIB_EXPORT Prefilter {
+ public:
+  /// Fixed-point precision of the Gaussian weights, which sum to 2^kWeightShift
+  static constexpr int kWeightShift = 14;
+
+  /// Largest supported standard deviation of the Gaussian in voxels
+  static constexpr double kMaxSigma = 8.0;
+
+  /// Applies the filter of the parameters; PrefilterType::NONE copies the volume
+  static Status Apply(const int16_t *input, int width, int height, int layers, PrefilterParameters const &params,
+					  int16_t *output);
+
+  /// Separable Gaussian smoothing with the same standard deviation (in voxels) along all axes
+  static Status Gaussian(const int16_t *input, int width, int height, int layers, double sigma, int16_t *output);
+
+  /// 3x3x3 median filter
+  static Status Median(const int16_t *input, int width, int height, int layers, int16_t *output);
+};
+
+#endif  // PREFILTER_H
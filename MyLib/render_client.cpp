@@ -0,0 +1,150 @@
+#include "render_client.h"
+
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <cstring>
+
+constexpr int RenderClient::kReplyTimeout;
+
+RenderClient::RenderClient() = default;
+
+RenderClient::~RenderClient() {
+  Disconnect();
+}
+
+/**
+ * @details The server replies to a new connection with the id of the client, which names its framebuffer.
+ * @param server_name Name the server listens under
+ * @return StatusCode::OK, or StatusCode::SERVER_ERROR if the server cannot be reached or its framebuffer not attached
+ */
+Status RenderClient::Connect(QString const &server_name) {
+  Disconnect();
+  m_socket.reset(new QLocalSocket());
+  m_socket->connectToServer(server_name);
+  RenderReply welcome;
+  if (!m_socket->waitForConnected(kReplyTimeout)
+	|| !ReadRenderMessage(*m_socket, &welcome, sizeof(welcome), kReplyTimeout)
+	|| welcome.status != static_cast<int32_t>(StatusCode::OK)) {
+	Disconnect();
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  m_framebuffer.reset(new QSharedMemory(RenderFramebufferKey(server_name, welcome.client)));
+  if (!m_framebuffer->attach(QSharedMemory::ReadOnly)) {
+	Disconnect();
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  m_lastReply = welcome;
+  return Status(StatusCode::OK);
+}
+
+void RenderClient::Disconnect() {
+  if (m_socket) {
+	m_socket->disconnectFromServer();
+	m_socket.reset();
+  }
+  m_framebuffer.reset();
+  m_lastReply = RenderReply();
+}
+
+bool RenderClient::IsConnected() const {
+  return m_socket && m_framebuffer && m_socket->state() == QLocalSocket::ConnectedState;
+}
+
+/**
+ * @param path Raw volume file (.raw) or DICOM series directory, as seen by the server
+ * @param dataset Output: id of the dataset on the server
+ * @return StatusCode::OK, StatusCode::SERVER_ERROR if the path is too long or the server is unreachable, or the error
+ * of loading the dataset
+ */
+Status RenderClient::OpenDataset(QString const &path, int &dataset) {
+  RenderRequest request;
+  request.type = RenderRequestType::OPEN_DATASET;
+  QByteArray const utf8 = path.toUtf8();
+  if (utf8.size() >= RenderRequest::kMaxPathBytes) {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  std::memcpy(request.path, utf8.constData(), utf8.size());
+  RenderReply reply;
+  Status const status = Request(request, reply);
+  dataset = reply.dataset;
+  return status;
+}
+
+/**
+ * @param dataset Id of the dataset
+ * @param threshold HU threshold of the surface
+ * @return StatusCode::OK, or the error of the request
+ */
+Status RenderClient::RenderSurface(int const dataset, int const threshold) {
+  RenderRequest request;
+  request.type = RenderRequestType::RENDER_SURFACE;
+  request.dataset = dataset;
+  request.threshold = threshold;
+  RenderReply reply;
+  return Request(request, reply);
+}
+
+/**
+ * @param dataset Id of the dataset
+ * @param seed Seed voxel of the region growing
+ * @param threshold HU threshold of the region growing
+ * @param rotation View rotation of the render
+ * @return StatusCode::OK, or the error of the request
+ */
+Status RenderClient::SegmentRegion(int const dataset, Eigen::Vector3i const &seed, int const threshold,
+								   Eigen::Matrix3d const &rotation) {
+  RenderRequest request;
+  request.type = RenderRequestType::SEGMENT_REGION;
+  request.dataset = dataset;
+  request.threshold = threshold;
+  request.seed[0] = seed.x();
+  request.seed[1] = seed.y();
+  request.seed[2] = seed.z();
+  SetRotation(rotation, request);
+  RenderReply reply;
+  return Request(request, reply);
+}
+
+/**
+ * @param dataset Id of the dataset
+ * @param rotation View rotation of the render
+ * @return StatusCode::OK, or the error of the request
+ */
+Status RenderClient::RenderRegion(int const dataset, Eigen::Matrix3d const &rotation) {
+  RenderRequest request;
+  request.type = RenderRequestType::RENDER_REGION;
+  request.dataset = dataset;
+  SetRotation(rotation, request);
+  RenderReply reply;
+  return Request(request, reply);
+}
+
+/**
+ * @param request The request
+ * @param reply Output: the reply of the server
+ * @return The status of the reply, or StatusCode::SERVER_ERROR if the connection fails; the client is disconnected
+ * then
+ */
+Status RenderClient::Request(RenderRequest const &request, RenderReply &reply) {
+  reply = RenderReply();
+  if (!IsConnected()) {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  if (!WriteRenderMessage(*m_socket, &request, sizeof(request), kReplyTimeout)
+	|| !ReadRenderMessage(*m_socket, &reply, sizeof(reply), kReplyTimeout)) {
+	Disconnect();
+	reply.status = static_cast<int32_t>(StatusCode::SERVER_ERROR);
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  m_lastReply = reply;
+  return Status(static_cast<StatusCode>(reply.status));
+}
+
+const uint32_t *RenderClient::Frame() const {
+  return m_framebuffer ? static_cast<const uint32_t *>(m_framebuffer->constData()) : nullptr;
+}
+
+void RenderClient::SetRotation(Eigen::Matrix3d const &rotation, RenderRequest &request) {
+  Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(request.rotation) = rotation;
+}
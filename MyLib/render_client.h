@@ -0,0 +1,69 @@
+#ifndef RENDER_CLIENT_H
+#define RENDER_CLIENT_H
+
+#include "render_protocol.h"
+#include "status.h"
+#include "Eigen/Core"
+
+#include <memory>
+
+class QSharedMemory;
+
+/**
+ * @brief Connection of a viewer to a RenderServer on the same machine
+ * @details Every call blocks until the server has replied. Frames are not copied out of the shared-memory
+ * framebuffer: Frame() points into it and stays valid until the next request of this client.
+ * A client must be used from one thread only.
+ */
+class MYLIB_EXPORT RenderClient {
+ public:
+  /// Maximum time in ms to wait for a reply; opening a dataset that is not resident yet loads it first
+  static constexpr int kReplyTimeout = 120000;
+
+  RenderClient();
+  ~RenderClient();
+
+  RenderClient(RenderClient const &) = delete;
+  RenderClient &operator=(RenderClient const &) = delete;
+
+  /// Connect to the server listening under a local socket name and attach its framebuffer for this client
+  Status Connect(QString const &server_name);
+
+  /// Close the connection
+  void Disconnect();
+
+  /// @return True if connected to a server
+  [[nodiscard]] bool IsConnected() const;
+
+  /// Make a dataset resident on the server, or find it if another viewer has opened it already
+  Status OpenDataset(QString const &path, int &dataset);
+
+  /// Render the threshold surface of a dataset into the framebuffer
+  Status RenderSurface(int const dataset, int const threshold);
+
+  /// Run region growing on a dataset and render the region into the framebuffer
+  Status SegmentRegion(int const dataset, Eigen::Vector3i const &seed, int const threshold,
+					   Eigen::Matrix3d const &rotation);
+
+  /// Render the current region growing result of a dataset into the framebuffer
+  Status RenderRegion(int const dataset, Eigen::Matrix3d const &rotation);
+
+  /// Send any request and wait for its reply
+  Status Request(RenderRequest const &request, RenderReply &reply);
+
+  /// Reply to the last request
+  [[nodiscard]] RenderReply const &LastReply() const { return m_lastReply; }
+
+  /// Pixels of the last frame as 0xffRRGGBB, LastReply().width x LastReply().height, nullptr if not connected
+  [[nodiscard]] const uint32_t *Frame() const;
+
+ private:
+  /// Fills the rotation of a request
+  static void SetRotation(Eigen::Matrix3d const &rotation, RenderRequest &request);
+
+  std::unique_ptr<QLocalSocket> m_socket;
+  std::unique_ptr<QSharedMemory> m_framebuffer;
+  RenderReply m_lastReply;
+};
+
+#endif  // RENDER_CLIENT_H
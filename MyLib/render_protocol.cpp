@@ -0,0 +1,55 @@
+#include "render_protocol.h"
+
+#include <QLocalSocket>
+
+constexpr int RenderRequest::kMaxPathBytes;
+
+/**
+ * @details Messages may arrive in several chunks; the read only gives up on a timeout if stop is nullptr, so a server
+ * thread can wait for the next request of an idle client indefinitely and still notice a shutdown within wait_ms.
+ * @param socket Connected socket
+ * @param message Output: the message
+ * @param size Size of the message in bytes
+ * @param wait_ms Maximum time to wait for more data at once
+ * @param stop Flag that aborts waiting for more data, nullptr to give up after the first timeout
+ * @return True if the complete message has been read
+ */
+bool ReadRenderMessage(QLocalSocket &socket, void *message, int const size, int const wait_ms,
+					   std::atomic<bool> const *stop) {
+  auto *bytes = static_cast<char *>(message);
+  qint64 received = 0;
+  while (received < size) {
+	if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(wait_ms)) {
+	  if (socket.state() != QLocalSocket::ConnectedState || stop == nullptr || *stop) {
+		return false;
+	  }
+	  continue;
+	}
+	qint64 const count = socket.read(bytes + received, size - received);
+	if (count < 0) {
+	  return false;
+	}
+	received += count;
+  }
+  return true;
+}
+
+/**
+ * @param socket Connected socket
+ * @param message The message
+ * @param size Size of the message in bytes
+ * @param wait_ms Maximum time to wait until the message is written
+ * @return True if the complete message has been written
+ */
+bool WriteRenderMessage(QLocalSocket &socket, const void *message, int const size, int const wait_ms) {
+  if (socket.write(static_cast<const char *>(message), size) != size) {
+	return false;
+  }
+  // Without an event loop the data is only sent while waiting for it
+  while (socket.bytesToWrite() > 0) {
+	if (!socket.waitForBytesWritten(wait_ms)) {
+	  return false;
+	}
+  }
+  return true;
+}
@@ -0,0 +1,81 @@
+#ifndef RENDER_PROTOCOL_H
+#define RENDER_PROTOCOL_H
+
+#include "MyLib_global.h"
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+class QLocalSocket;
+
+/**
+ * @brief Operations of the render server
+ */
+enum class RenderRequestType : int32_t {
+  /// Make a raw volume file or a DICOM series directory resident, or find it among the resident datasets
+  OPEN_DATASET,
+  /// Shaded threshold surface, viewed along the z axis
+  RENDER_SURFACE,
+  /// Region growing from a seed, followed by a render of the region
+  SEGMENT_REGION,
+  /// Render of the current region growing result
+  RENDER_REGION
+};
+
+/**
+ * @brief Fixed-size message a client sends for every request
+ * @details Client and server run on the same machine, so the message is sent in the native byte order and layout.
+ */
+struct RenderRequest {
+  /// Size of the zero-terminated UTF-8 path of OPEN_DATASET, including the terminator
+  static constexpr int kMaxPathBytes = 1024;
+
+  RenderRequestType type{RenderRequestType::RENDER_SURFACE};
+  /// Dataset id returned by OPEN_DATASET
+  int32_t dataset{-1};
+  /// HU threshold of RENDER_SURFACE and SEGMENT_REGION
+  int32_t threshold{0};
+  /// Seed voxel of SEGMENT_REGION
+  int32_t seed[3]{0, 0, 0};
+  /// View rotation of SEGMENT_REGION and RENDER_REGION, row-major
+  double rotation[9]{1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  /// Path of OPEN_DATASET
+  char path[kMaxPathBytes]{};
+};
+
+/**
+ * @brief Fixed-size message the server sends once after accepting a connection and then for every request
+ */
+struct RenderReply {
+  /// StatusCode of the request
+  int32_t status{0};
+  /// Id of the connection, which names the framebuffer of the client
+  int32_t client{-1};
+  /// Dataset the request worked on
+  int32_t dataset{-1};
+  /// Size of the frame in the framebuffer, 0 without frame; OPEN_DATASET returns the size of the volume instead
+  int32_t width{0};
+  int32_t height{0};
+  int32_t layers{0};
+  /// Number of requests of the batch that were answered by the same computation, including this one
+  int32_t batch_size{0};
+};
+
+/// Size of the shared-memory framebuffer of every client, enough for 1024 x 1024 pixels
+constexpr int kRenderFramebufferBytes = 1024 * 1024 * 4;
+
+/// Shared-memory key of the framebuffer of a client; frames are stored as 32-bit 0xffRRGGBB pixels, row by row
+inline QString RenderFramebufferKey(QString const &server_name, int const client) {
+  return server_name + ".frame." + QString::number(client);
+}
+
+/// Reads one fixed-size message, waiting for data in slices of wait_ms
+MYLIB_EXPORT bool ReadRenderMessage(QLocalSocket &socket, void *message, int const size, int const wait_ms,
+									std::atomic<bool> const *stop = nullptr);
+
+/// Writes one fixed-size message and waits until it is handed to the connection
+MYLIB_EXPORT bool WriteRenderMessage(QLocalSocket &socket, const void *message, int const size, int const wait_ms);
+
+#endif  // RENDER_PROTOCOL_H
@@ -0,0 +1,412 @@
+#include "render_server.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <cstring>
+#include <functional>
+
+constexpr int RenderServer::kPollInterval;
+
+namespace {
+/// Local server that hands every accepted connection to a callback instead of queuing a QLocalSocket for it, so the
+/// connection can be served by a socket created in its own thread
+class DescriptorServer : public QLocalServer {
+ public:
+  explicit DescriptorServer(std::function<void(quintptr)> on_connection)
+	: m_onConnection(std::move(on_connection)) {}
+
+ protected:
+  void incomingConnection(quintptr socket_descriptor) override { m_onConnection(socket_descriptor); }
+
+ private:
+  std::function<void(quintptr)> m_onConnection;
+};
+}  // namespace
+
+RenderServer::~RenderServer() {
+  Stop();
+}
+
+/**
+ * @details A stale socket of a server that has not shut down cleanly is removed first.
+ * @param name Name of the local socket, also the prefix of the framebuffer keys
+ * @return StatusCode::OK, or StatusCode::SERVER_ERROR if the server is already running or cannot listen
+ */
+Status RenderServer::Start(QString const &name) {
+  if (m_acceptThread) {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  m_name = name;
+  m_stop = false;
+  m_renderThread.reset(QThread::create([this] { BatchLoop(); }));
+  m_renderThread->start();
+
+  // Shared with the accept thread, which may still be inside set_value() when this function returns
+  auto listening = std::make_shared<std::promise<Status>>();
+  std::future<Status> listen_status = listening->get_future();
+  m_acceptThread.reset(QThread::create([this, listening] { AcceptLoop(*listening); }));
+  m_acceptThread->start();
+  Status const status = listen_status.get();
+  if (!status.Ok()) {
+	Stop();
+  }
+  return status;
+}
+
+/**
+ * @details Requests that are queued or waiting for a client are answered with StatusCode::SERVER_ERROR.
+ */
+void RenderServer::Stop() {
+  if (!m_acceptThread) {
+	return;
+  }
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stop = true;
+  }
+  m_requestQueued.notify_all();
+  // The accept thread joins the client threads before it ends
+  m_acceptThread->wait();
+  m_renderThread->wait();
+  m_acceptThread.reset();
+  m_renderThread.reset();
+}
+
+int RenderServer::ClientCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_clientCount;
+}
+
+int RenderServer::DatasetCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<int>(m_datasets.size());
+}
+
+int64_t RenderServer::ServedRequests() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_servedRequests;
+}
+
+int64_t RenderServer::ComputedRequests() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_computedRequests;
+}
+
+/**
+ * @details The local server lives in the accept thread; every connection gets a thread of its own, which blocks on
+ * its socket. Finished client threads are joined while waiting for new connections.
+ * @param listening Output: the result of listening, set once
+ */
+void RenderServer::AcceptLoop(std::promise<Status> &listening) {
+  DescriptorServer server([this](quintptr socket_descriptor) {
+	int client = 0;
+	{
+	  std::lock_guard<std::mutex> lock(m_mutex);
+	  client = m_nextClient++;
+	}
+	m_clientThreads.emplace_back(QThread::create([this, socket_descriptor, client] {
+	  ServeClient(socket_descriptor, client);
+	}));
+	m_clientThreads.back()->start();
+  });
+  QLocalServer::removeServer(m_name);
+  if (!server.listen(m_name)) {
+	listening.set_value(Status(StatusCode::SERVER_ERROR));
+	return;
+  }
+  listening.set_value(Status(StatusCode::OK));
+
+  while (!m_stop) {
+	server.waitForNewConnection(kPollInterval);
+	m_clientThreads.erase(std::remove_if(m_clientThreads.begin(), m_clientThreads.end(),
+										 [](std::unique_ptr<QThread> const &thread) {
+										   return thread->isFinished() && thread->wait();
+										 }),
+						  m_clientThreads.end());
+  }
+  server.close();
+  for (auto &thread : m_clientThreads) {
+	thread->wait();
+  }
+  m_clientThreads.clear();
+}
+
+/**
+ * @details Creates the framebuffer of the client and tells the client its id, then answers requests until the client
+ * disconnects or the server stops.
+ * @param socket_descriptor Native handle of the accepted connection
+ * @param client Id of the connection
+ */
+void RenderServer::ServeClient(quintptr const socket_descriptor, int const client) {
+  QLocalSocket socket;
+  if (!socket.setSocketDescriptor(socket_descriptor)) {
+	return;
+  }
+  QSharedMemory framebuffer(RenderFramebufferKey(m_name, client));
+  if (!framebuffer.create(kRenderFramebufferBytes)) {
+	// A segment left behind by a server that crashed is released by the last detach
+	framebuffer.attach();
+	framebuffer.detach();
+  }
+  RenderReply welcome;
+  welcome.client = client;
+  if (!framebuffer.isAttached() && !framebuffer.create(kRenderFramebufferBytes)) {
+	welcome.status = static_cast<int32_t>(StatusCode::SERVER_ERROR);
+  }
+  if (welcome.status != static_cast<int32_t>(StatusCode::OK)) {
+	WriteRenderMessage(socket, &welcome, sizeof(welcome), kPollInterval * 20);
+	return;
+  }
+
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_clientCount;
+  }
+  RenderRequest request;
+  bool connected = WriteRenderMessage(socket, &welcome, sizeof(welcome), kPollInterval * 20);
+  while (connected && ReadRenderMessage(socket, &request, sizeof(request), kPollInterval, &m_stop)) {
+	RenderReply reply = Submit(request, static_cast<uint32_t *>(framebuffer.data()));
+	reply.client = client;
+	connected = WriteRenderMessage(socket, &reply, sizeof(reply), kPollInterval * 20);
+  }
+  socket.disconnectFromServer();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  --m_clientCount;
+}
+
+/**
+ * @param request The request
+ * @param framebuffer Framebuffer of the client, receives the frame of the request
+ * @return The reply, with StatusCode::SERVER_ERROR if the server stops first
+ */
+RenderReply RenderServer::Submit(RenderRequest const &request, uint32_t *framebuffer) {
+  std::future<RenderReply> reply;
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stop) {
+	  RenderReply stopped;
+	  stopped.status = static_cast<int32_t>(StatusCode::SERVER_ERROR);
+	  return stopped;
+	}
+	m_queue.push_back(PendingRequest{request, framebuffer, std::promise<RenderReply>()});
+	reply = m_queue.back().reply.get_future();
+  }
+  m_requestQueued.notify_one();
+  return reply.get();
+}
+
+/**
+ * @details Takes every request that has been queued while the previous batch was processed, so requests are batched
+ * exactly when the render thread is the bottleneck and an idle server answers a single request without delay.
+ */
+void RenderServer::BatchLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+	m_requestQueued.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+	if (m_stop) {
+	  break;
+	}
+	std::vector<PendingRequest> batch;
+	batch.swap(m_queue);
+	lock.unlock();
+	ProcessBatch(batch);
+	lock.lock();
+  }
+  for (auto &pending : m_queue) {
+	RenderReply stopped;
+	stopped.status = static_cast<int32_t>(StatusCode::SERVER_ERROR);
+	pending.reply.set_value(stopped);
+  }
+  m_queue.clear();
+}
+
+/**
+ * @details Each request that is not answered yet is computed and its result is handed to every later request of the
+ * batch that does the same work, up to the next region growing request that does other work. The frame is converted
+ * from the rendered depth buffer straight into the framebuffer of every client it answers, without a staging copy.
+ * @param batch Requests in their order of arrival
+ */
+void RenderServer::ProcessBatch(std::vector<PendingRequest> &batch) {
+  std::vector<bool> answered(batch.size(), false);
+  for (size_t i = 0; i < batch.size(); ++i) {
+	if (answered[i]) {
+	  continue;
+	}
+	m_frameSource = nullptr;
+	RenderReply reply;
+	reply.status = static_cast<int32_t>(Execute(batch[i].request, reply).code());
+
+	std::vector<size_t> members{i};
+	for (size_t j = i + 1; j < batch.size(); ++j) {
+	  if (answered[j]) {
+		continue;
+	  }
+	  if (SameWork(batch[i].request, batch[j].request)) {
+		members.push_back(j);
+	  } else if (batch[j].request.type == RenderRequestType::SEGMENT_REGION) {
+		break;
+	  }
+	}
+	reply.batch_size = static_cast<int32_t>(members.size());
+	{
+	  // Counted before the replies, so a client sees its own request in the statistics
+	  std::lock_guard<std::mutex> lock(m_mutex);
+	  m_servedRequests += static_cast<int64_t>(members.size());
+	  ++m_computedRequests;
+	}
+	for (size_t const member : members) {
+	  if (m_frameSource != nullptr) {
+		WriteFrame(*m_frameSource, batch[member].framebuffer);
+	  }
+	  batch[member].reply.set_value(reply);
+	  answered[member] = true;
+	}
+  }
+}
+
+/**
+ * @param request The request
+ * @param reply Output: dataset and frame size of the reply
+ * @return StatusCode::OK, StatusCode::SERVER_ERROR if the request type or dataset id is invalid or the frame does not
+ * fit the framebuffer, StatusCode::BAD_SEED_ERROR if the seed lies outside the volume, or the error of the operation
+ */
+Status RenderServer::Execute(RenderRequest const &request, RenderReply &reply) {
+  reply.dataset = request.dataset;
+  if (request.type == RenderRequestType::OPEN_DATASET) {
+	char path[RenderRequest::kMaxPathBytes];
+	std::memcpy(path, request.path, sizeof(path));
+	path[sizeof(path) - 1] = '\0';
+	Status const status = OpenDataset(QString::fromUtf8(path), reply.dataset);
+	if (status.Ok()) {
+	  CTDataset const &dataset = *m_datasets[reply.dataset];
+	  reply.width = dataset.GetSliceCount(SliceOrientation::SAGITTAL);
+	  reply.height = dataset.GetSliceCount(SliceOrientation::CORONAL);
+	  reply.layers = dataset.GetSliceCount(SliceOrientation::AXIAL);
+	}
+	return status;
+  }
+
+  if (request.dataset < 0 || request.dataset >= static_cast<int>(m_datasets.size())) {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  CTDataset &dataset = *m_datasets[request.dataset];
+  if (request.type == RenderRequestType::SEGMENT_REGION) {
+	Eigen::Vector3i seed(request.seed[0], request.seed[1], request.seed[2]);
+	if ((seed.array() < 0).any() || seed.x() >= dataset.GetSliceCount(SliceOrientation::SAGITTAL)
+	  || seed.y() >= dataset.GetSliceCount(SliceOrientation::CORONAL)
+	  || seed.z() >= dataset.GetSliceCount(SliceOrientation::AXIAL)) {
+	  return Status(StatusCode::BAD_SEED_ERROR);
+	}
+	dataset.RegionGrowing3D(seed, request.threshold);
+  }
+
+  Status status(StatusCode::OK);
+  if (request.type == RenderRequestType::RENDER_SURFACE) {
+	status = dataset.CalculateDepthBuffer(request.threshold);
+  } else if (request.type == RenderRequestType::SEGMENT_REGION || request.type == RenderRequestType::RENDER_REGION) {
+	// The mesh renders without gaps at any rotation; it is extracted by the first render of a new region
+	Eigen::Matrix3d const rotation = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(request.rotation);
+	status = dataset.CalculateDepthBufferFromMesh(rotation);
+  } else {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  if (status.Ok()) {
+	status = dataset.RenderDepthBuffer();
+  }
+  if (!status.Ok()) {
+	return status;
+  }
+  return SelectFrame(dataset, reply);
+}
+
+/**
+ * @details A raw file is recognized by its .raw suffix, anything else is imported as a DICOM series directory.
+ * @param path Path the dataset is loaded from, which identifies it among the resident datasets
+ * @param dataset Output: id of the dataset
+ * @return StatusCode::OK, or the error of loading the dataset
+ */
+Status RenderServer::OpenDataset(QString const &path, int &dataset) {
+  for (size_t i = 0; i < m_datasetPaths.size(); ++i) {
+	if (m_datasetPaths[i] == path) {
+	  dataset = static_cast<int>(i);
+	  return Status(StatusCode::OK);
+	}
+  }
+  std::unique_ptr<CTDataset> loaded(new CTDataset());
+  QString raw_path = path;
+  Status const status = path.endsWith(".raw", Qt::CaseInsensitive) ? loaded->load(raw_path)
+																	: loaded->ImportDicomSeries(path);
+  if (!status.Ok()) {
+	return status;
+  }
+  // Normals for lit rendering are computed once per dataset
+  if (!loaded->ComputeNormalVolume().Ok()) {
+	qDebug() << "Normal volume could not be computed!" << "\n";
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  dataset = static_cast<int>(m_datasets.size());
+  m_datasets.push_back(std::move(loaded));
+  m_datasetPaths.push_back(path);
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @param dataset Dataset whose depth buffer has been rendered
+ * @param reply Output: frame size of the reply
+ * @return StatusCode::OK, or StatusCode::SERVER_ERROR if the frame does not fit the framebuffer
+ */
+Status RenderServer::SelectFrame(CTDataset const &dataset, RenderReply &reply) {
+  // The depth buffer covers the axial plane
+  int const width = dataset.GetSliceCount(SliceOrientation::SAGITTAL);
+  int const height = dataset.GetSliceCount(SliceOrientation::CORONAL);
+  if (static_cast<int64_t>(width) * height * static_cast<int64_t>(sizeof(uint32_t)) > kRenderFramebufferBytes) {
+	return Status(StatusCode::SERVER_ERROR);
+  }
+  m_frameSource = &dataset;
+  reply.width = width;
+  reply.height = height;
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details The client only reads the framebuffer after the reply, so the render thread writes it without locking.
+ * @param dataset Dataset whose depth buffer has been rendered, with a frame that fits the framebuffer
+ * @param framebuffer Shared memory of the client, receives the frame as opaque grey RGBA pixels
+ */
+void RenderServer::WriteFrame(CTDataset const &dataset, uint32_t *framebuffer) {
+  size_t const size = static_cast<size_t>(dataset.GetSliceCount(SliceOrientation::SAGITTAL))
+	* dataset.GetSliceCount(SliceOrientation::CORONAL);
+  const int *shade = dataset.GetRenderedDepthBuffer();
+  for (size_t i = 0; i < size; ++i) {
+	auto const grey = static_cast<uint32_t>(shade[i]) & 0xffu;
+	framebuffer[i] = 0xff000000u | (grey << 16) | (grey << 8) | grey;
+  }
+}
+
+/**
+ * @param a A request
+ * @param b Another request
+ * @return True if both requests do the same work, comparing only the fields their type uses
+ */
+bool RenderServer::SameWork(RenderRequest const &a, RenderRequest const &b) {
+  if (a.type != b.type) {
+	return false;
+  }
+  if (a.type == RenderRequestType::OPEN_DATASET) {
+	return std::strncmp(a.path, b.path, RenderRequest::kMaxPathBytes) == 0;
+  }
+  bool const same_rotation = std::equal(a.rotation, a.rotation + 9, b.rotation);
+  switch (a.type) {
+	case RenderRequestType::RENDER_SURFACE:
+	  return a.dataset == b.dataset && a.threshold == b.threshold;
+	case RenderRequestType::SEGMENT_REGION:
+	  return a.dataset == b.dataset && a.threshold == b.threshold && std::equal(a.seed, a.seed + 3, b.seed)
+		&& same_rotation;
+	case RenderRequestType::RENDER_REGION:
+	  return a.dataset == b.dataset && same_rotation;
+	default:
+	  return false;
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "ct_dataset.h"
+#include "render_protocol.h"
+
+#include <QThread>
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Headless server that keeps datasets resident and renders and segments them for several viewers
+ * @details Viewers on the same machine connect through a local socket (QLocalSocket) and send fixed-size
+ * RenderRequest messages. Every dataset is loaded once, no matter how many viewers open it, and all work on datasets
+ * runs on a single render thread, whose kernels use the shared thread pool.
+ * Requests that arrive while the render thread is busy are collected and answered as one batch: identical view
+ * requests of a batch (same operation, dataset and parameters) are computed only once. A region growing request
+ * changes the dataset, so requests are never merged across one.
+ * Frames do not travel through the socket: each client has a shared-memory framebuffer (see RenderFramebufferKey())
+ * that the server renders into before it replies. A client owns its framebuffer between a reply and its next request.
+ */
+class MYLIB_EXPORT RenderServer {
+ public:
+  /// Interval in ms at which the blocking waits of the server threads check for Stop()
+  static constexpr int kPollInterval = 50;
+
+  RenderServer() = default;
+  ~RenderServer();
+
+  RenderServer(RenderServer const &) = delete;
+  RenderServer &operator=(RenderServer const &) = delete;
+
+  /// Start listening for clients under a local socket name
+  Status Start(QString const &name);
+
+  /// Disconnect all clients and stop the server threads; the resident datasets are kept for a restart
+  void Stop();
+
+  /// Number of connected clients
+  [[nodiscard]] int ClientCount() const;
+
+  /// Number of resident datasets
+  [[nodiscard]] int DatasetCount() const;
+
+  /// Number of requests that have been answered since the server was constructed
+  [[nodiscard]] int64_t ServedRequests() const;
+
+  /// Number of computations that answered them; smaller than ServedRequests() if requests have been batched
+  [[nodiscard]] int64_t ComputedRequests() const;
+
+ private:
+  struct PendingRequest {
+	RenderRequest request;
+	/// Framebuffer of the client that sent the request
+	uint32_t *framebuffer;
+	std::promise<RenderReply> reply;
+  };
+
+  /// Main loop of the accept thread
+  void AcceptLoop(std::promise<Status> &listening);
+
+  /// Main loop of the thread of one client connection
+  void ServeClient(quintptr const socket_descriptor, int const client);
+
+  /// Hands a request to the render thread and waits for the reply
+  RenderReply Submit(RenderRequest const &request, uint32_t *framebuffer);
+
+  /// Main loop of the render thread
+  void BatchLoop();
+
+  /// Answers a batch of requests in their order of arrival
+  void ProcessBatch(std::vector<PendingRequest> &batch);
+
+  /// Performs one request on the render thread
+  Status Execute(RenderRequest const &request, RenderReply &reply);
+
+  /// Makes a dataset resident, unless it already is
+  Status OpenDataset(QString const &path, int &dataset);
+
+  /// Makes the rendered depth buffer of a dataset the frame of the current computation
+  Status SelectFrame(CTDataset const &dataset, RenderReply &reply);
+
+  /// Converts the rendered depth buffer of a dataset straight into the framebuffer of a client
+  static void WriteFrame(CTDataset const &dataset, uint32_t *framebuffer);
+
+  /// @return True if two requests are answered by the same computation
+  [[nodiscard]] static bool SameWork(RenderRequest const &a, RenderRequest const &b);
+
+  QString m_name;
+  std::atomic<bool> m_stop{false};
+  std::unique_ptr<QThread> m_acceptThread;
+  std::unique_ptr<QThread> m_renderThread;
+  /// Threads of the client connections, only used by the accept thread while it runs
+  std::vector<std::unique_ptr<QThread>> m_clientThreads;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_requestQueued;
+  std::vector<PendingRequest> m_queue;
+  int m_clientCount{0};
+  int m_nextClient{0};
+  int64_t m_servedRequests{0};
+  int64_t m_computedRequests{0};
+
+  /// Resident datasets and the paths they were loaded from, only changed by the render thread
+  std::vector<std::unique_ptr<CTDataset>> m_datasets;
+  std::vector<QString> m_datasetPaths;
+
+  /// Dataset whose rendered depth buffer is the frame of the current computation, nullptr if it has none
+  const CTDataset *m_frameSource{nullptr};
+};
+
+#endif  // RENDER_SERVER_H
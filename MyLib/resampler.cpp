@@ -0,0 +1,360 @@
+#include "resampler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr int Resampler::kSlabLayers;
+constexpr int Resampler::kTileSize;
+
+namespace {
+/// Source voxel coordinates of output voxel (0, 0, 0) and their change per output voxel along x, y and z
+struct GridMapping {
+  Eigen::Vector3d origin;
+  Eigen::Vector3d step_x;
+  Eigen::Vector3d step_y;
+  Eigen::Vector3d step_z;
+};
+
+/// Reads the HU values of the source volume
+struct HuSource {
+  const int16_t *data;
+
+  inline int16_t Nearest(size_t index) const { return data[index]; }
+  inline float Value(size_t index) const { return data[index]; }
+  static inline int16_t FromValue(float value) { return static_cast<int16_t>(value + (value < 0.0f ? -0.5f : 0.5f)); }
+};
+
+/// Reads the voxels of one label of a label volume as a 0/1 mask, the interpolated mask is thresholded at one half
+struct MaskSource {
+  const int *labels;
+  int label;
+
+  inline uint8_t Nearest(size_t index) const { return labels[index] == label ? 1 : 0; }
+  inline float Value(size_t index) const { return labels[index] == label ? 1.0f : 0.0f; }
+  static inline uint8_t FromValue(float value) { return value >= 0.5f ? 1 : 0; }
+};
+
+GridMapping MapGrid(Eigen::Vector3d const &spacing, ResampleGrid const &grid) {
+  Eigen::Vector3d const inverse_spacing = spacing.cwiseInverse();
+  Eigen::Matrix3d const linear = grid.source_from_output.linear();
+  GridMapping mapping;
+  mapping.origin = grid.source_from_output.translation().cwiseProduct(inverse_spacing);
+  mapping.step_x = (linear.col(0) * grid.spacing.x()).cwiseProduct(inverse_spacing);
+  mapping.step_y = (linear.col(1) * grid.spacing.y()).cwiseProduct(inverse_spacing);
+  mapping.step_z = (linear.col(2) * grid.spacing.z()).cwiseProduct(inverse_spacing);
+  return mapping;
+}
+
+/**
+ * Clips the samples start + t * step, t in [0, count), of a row to those with lower <= position <= upper on all axes.
+ * The result is the range [first, last), which is empty if first == last.
+ */
+void ClipRow(Eigen::Vector3d const &start, Eigen::Vector3d const &step, Eigen::Vector3d const &lower,
+			 Eigen::Vector3d const &upper, int const count, int &first, int &last) {
+  double t_min = 0.0;
+  double t_max = count - 1.0;
+  for (int axis = 0; axis < 3; ++axis) {
+	if (step[axis] == 0.0) {
+	  if (start[axis] < lower[axis] || start[axis] > upper[axis]) {
+		t_max = -1.0;
+	  }
+	  continue;
+	}
+	double t_lower = (lower[axis] - start[axis]) / step[axis];
+	double t_upper = (upper[axis] - start[axis]) / step[axis];
+	if (t_lower > t_upper) {
+	  std::swap(t_lower, t_upper);
+	}
+	t_min = std::max(t_min, t_lower);
+	t_max = std::min(t_max, t_upper);
+  }
+  if (t_max < t_min) {
+	first = last = 0;
+	return;
+  }
+  first = static_cast<int>(std::ceil(t_min));
+  last = std::max(first, static_cast<int>(std::floor(t_max)) + 1);
+}
+
+/**
+ * Samples one output row. Only the clipped part of the row reads the source; the indices are clamped nevertheless,
+ * because a position on the clipping boundary may be off by a rounding error.
+ */
+template<typename Source, typename Output>
+void SampleRow(Source const &source, Eigen::Vector3i const &size, InterpolationMode const mode,
+			   Eigen::Vector3d const &start, Eigen::Vector3d const &step, int const count, Output const outside_value,
+			   Output *row) {
+  size_t const stride_y = static_cast<size_t>(size.x());
+  size_t const stride_z = stride_y * size.y();
+  bool const nearest = mode == InterpolationMode::NEAREST;
+
+  // The nearest voxel exists for positions up to half a voxel beyond the centers, trilinear interpolation needs
+  // the centers on both sides (with a tolerance, so that the outermost centers of an aligned grid are kept)
+  Eigen::Vector3d const lower = Eigen::Vector3d::Constant(nearest ? -0.5 : -1e-6);
+  Eigen::Vector3d const upper = size.cast<double>() - Eigen::Vector3d::Constant(nearest ? 0.5 + 1e-9 : 1.0 - 1e-6);
+  int first;
+  int last;
+  ClipRow(start, step, lower, upper, count, first, last);
+  std::fill(row, row + first, outside_value);
+  std::fill(row + last, row + count, outside_value);
+
+  if (nearest) {
+	for (int t = first; t < last; ++t) {
+	  int const x = std::min(static_cast<int>(start.x() + t * step.x() + 0.5), size.x() - 1);
+	  int const y = std::min(static_cast<int>(start.y() + t * step.y() + 0.5), size.y() - 1);
+	  int const z = std::min(static_cast<int>(start.z() + t * step.z() + 0.5), size.z() - 1);
+	  row[t] = source.Nearest(x + y * stride_y + z * stride_z);
+	}
+	return;
+  }
+
+  // A single voxel along an axis is its own neighbour
+  size_t const next_x = size.x() > 1 ? 1 : 0;
+  size_t const next_y = size.y() > 1 ? stride_y : 0;
+  size_t const next_z = size.z() > 1 ? stride_z : 0;
+  int const max_x = std::max(size.x() - 2, 0);
+  int const max_y = std::max(size.y() - 2, 0);
+  int const max_z = std::max(size.z() - 2, 0);
+
+  if (step.y() == 0.0 && step.z() == 0.0 && first < last) {
+	// Row along the x-axis of the source (e.g. isotropic resampling): the four source rows and their weights are the
+	// same for the whole row
+	int const y = std::min(std::max(static_cast<int>(start.y()), 0), max_y);
+	int const z = std::min(std::max(static_cast<int>(start.z()), 0), max_z);
+	float const fy = static_cast<float>(start.y() - y);
+	float const fz = static_cast<float>(start.z() - z);
+	float const w00 = (1.0f - fy) * (1.0f - fz);
+	float const w10 = fy * (1.0f - fz);
+	float const w01 = (1.0f - fy) * fz;
+	float const w11 = fy * fz;
+	size_t const row_base = y * stride_y + z * stride_z;
+	for (int t = first; t < last; ++t) {
+	  double const px = start.x() + t * step.x();
+	  int const x = std::min(std::max(static_cast<int>(px), 0), max_x);
+	  float const fx = static_cast<float>(px - x);
+	  size_t const base = row_base + x;
+	  float const v0 = w00 * source.Value(base) + w10 * source.Value(base + next_y) + w01 * source.Value(base + next_z)
+		  + w11 * source.Value(base + next_y + next_z);
+	  float const v1 = w00 * source.Value(base + next_x) + w10 * source.Value(base + next_x + next_y)
+		  + w01 * source.Value(base + next_x + next_z) + w11 * source.Value(base + next_x + next_y + next_z);
+	  row[t] = Source::FromValue(v0 + fx * (v1 - v0));
+	}
+	return;
+  }
+
+  for (int t = first; t < last; ++t) {
+	double const px = start.x() + t * step.x();
+	double const py = start.y() + t * step.y();
+	double const pz = start.z() + t * step.z();
+	int const x = std::min(std::max(static_cast<int>(px), 0), max_x);
+	int const y = std::min(std::max(static_cast<int>(py), 0), max_y);
+	int const z = std::min(std::max(static_cast<int>(pz), 0), max_z);
+	float const fx = static_cast<float>(px - x);
+	float const fy = static_cast<float>(py - y);
+	float const fz = static_cast<float>(pz - z);
+
+	size_t const base = x + y * stride_y + z * stride_z;
+	float const v00 = source.Value(base) + fx * (source.Value(base + next_x) - source.Value(base));
+	float const v10 = source.Value(base + next_y)
+		+ fx * (source.Value(base + next_y + next_x) - source.Value(base + next_y));
+	float const v01 = source.Value(base + next_z)
+		+ fx * (source.Value(base + next_z + next_x) - source.Value(base + next_z));
+	float const v11 = source.Value(base + next_z + next_y)
+		+ fx * (source.Value(base + next_z + next_y + next_x) - source.Value(base + next_z + next_y));
+	float const v0 = v00 + fy * (v10 - v00);
+	float const v1 = v01 + fy * (v11 - v01);
+	row[t] = Source::FromValue(v0 + fz * (v1 - v0));
+  }
+}
+
+/// Shared slab and tile loop of all resampling functions, see the description of Resampler
+template<typename Source, typename Output>
+Status ResampleSlabs(Source const &source, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+					 ResampleGrid const &grid, InterpolationMode const mode, Output const outside_value,
+					 std::function<Status(int, int, const Output *)> const &callback) {
+  if ((size.array() <= 0).any()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  if ((grid.size.array() <= 0).any() || !(spacing.array() > 0.0).all() || !(grid.spacing.array() > 0.0).all()
+	|| !callback) {
+	return Status(StatusCode::RESAMPLE_ERROR);
+  }
+
+  GridMapping const mapping = MapGrid(spacing, grid);
+  int const width = grid.size.x();
+  int const height = grid.size.y();
+  int const layers = grid.size.z();
+  int const tiles_x = (width + Resampler::kTileSize - 1) / Resampler::kTileSize;
+  int const tiles_y = (height + Resampler::kTileSize - 1) / Resampler::kTileSize;
+  std::vector<Output> slab(static_cast<size_t>(width) * height * std::min(layers, Resampler::kSlabLayers));
+
+  for (int first_layer = 0; first_layer < layers; first_layer += Resampler::kSlabLayers) {
+	int const layer_count = std::min(Resampler::kSlabLayers, layers - first_layer);
+	utils::ParallelFor(0, layer_count * tiles_y * tiles_x, [&](int tile) {
+	  int const layer = tile / (tiles_y * tiles_x);
+	  int const x_begin = (tile % tiles_x) * Resampler::kTileSize;
+	  int const y_begin = (tile / tiles_x % tiles_y) * Resampler::kTileSize;
+	  int const x_end = std::min(width, x_begin + Resampler::kTileSize);
+	  int const y_end = std::min(height, y_begin + Resampler::kTileSize);
+	  Eigen::Vector3d const layer_start =
+		  mapping.origin + (first_layer + layer) * mapping.step_z + x_begin * mapping.step_x;
+	  for (int y = y_begin; y < y_end; ++y) {
+		Output *row = slab.data() + (static_cast<size_t>(layer) * height + y) * width + x_begin;
+		SampleRow(source, size, mode, Eigen::Vector3d(layer_start + y * mapping.step_y), mapping.step_x,
+				  x_end - x_begin, outside_value, row);
+	  }
+	});
+
+	Status const status = callback(first_layer, layer_count, slab.data());
+	if (!status.Ok()) {
+	  return status;
+	}
+  }
+  return Status(StatusCode::OK);
+}
+
+/// Number of voxels of the grid, zero if it is empty
+size_t VoxelCount(ResampleGrid const &grid) {
+  Eigen::Vector3i const size = grid.size.cwiseMax(0);
+  return static_cast<size_t>(size.x()) * size.y() * size.z();
+}
+
+/// Callback that copies every slab into one output volume of the grid
+template<typename Output>
+std::function<Status(int, int, const Output *)> CollectSlabs(ResampleGrid const &grid, std::vector<Output> &output) {
+  size_t const layer_size = static_cast<size_t>(grid.size.x()) * grid.size.y();
+  return [&output, layer_size](int first_layer, int layer_count, const Output *slab) {
+	std::copy(slab, slab + layer_size * layer_count, output.begin() + layer_size * first_layer);
+	return Status(StatusCode::OK);
+  };
+}
+} // namespace
+
+/**
+ * @details The output voxels keep the corners of the volume: the first voxel is at the first voxel center of the
+ * source, and the last voxel of every axis is the last one that does not lie beyond the source volume.
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param output_spacing Edge length of the output voxels in mm
+ * @return Axis-aligned grid with cubic voxels of the given size
+ */
+ResampleGrid Resampler::IsotropicGrid(Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+									  double output_spacing) {
+  ResampleGrid grid;
+  grid.spacing = Eigen::Vector3d::Constant(output_spacing);
+  for (int axis = 0; axis < 3; ++axis) {
+	double const extent = std::max(size[axis] - 1, 0) * spacing[axis];
+	grid.size[axis] = static_cast<int>(std::floor(extent / output_spacing + 1e-6)) + 1;
+  }
+  return grid;
+}
+
+/**
+ * @details The grid is the axis-aligned bounding box of the eight corner voxel centers of the source, expressed in the
+ * other frame, so every source voxel center lies inside the grid. Its output axes are the axes of that frame; the
+ * parts of the grid outside the source volume are filled with the outside value when resampling.
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param frame_from_source Rigid transformation from the mm frame of the source volume into the other frame, e.g. the
+ * result of a registration with the source points in mm
+ * @param output_spacing Edge length of the output voxels in mm
+ * @return Grid with cubic voxels aligned with the other frame
+ */
+ResampleGrid Resampler::FrameGrid(Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+								  Eigen::Isometry3d const &frame_from_source, double output_spacing) {
+  Eigen::Vector3d const extent = (size - Eigen::Vector3i::Ones()).cwiseMax(0).cast<double>().cwiseProduct(spacing);
+  Eigen::Vector3d lower = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+  Eigen::Vector3d upper = Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+  for (int corner = 0; corner < 8; ++corner) {
+	Eigen::Vector3d const point = frame_from_source * Eigen::Vector3d(
+		(corner & 1) ? extent.x() : 0.0, (corner & 2) ? extent.y() : 0.0, (corner & 4) ? extent.z() : 0.0);
+	lower = lower.cwiseMin(point);
+	upper = upper.cwiseMax(point);
+  }
+
+  ResampleGrid grid;
+  grid.spacing = Eigen::Vector3d::Constant(output_spacing);
+  for (int axis = 0; axis < 3; ++axis) {
+	grid.size[axis] = static_cast<int>(std::ceil((upper[axis] - lower[axis]) / output_spacing - 1e-6)) + 1;
+  }
+  grid.source_from_output = frame_from_source.inverse() * Eigen::Translation3d(lower);
+  return grid;
+}
+
+/**
+ * @param input Flat x-fastest source volume
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param grid Output grid
+ * @param mode Interpolation between the source voxels
+ * @param outside_value Value of the output voxels that lie outside of the source volume, e.g. air (-1024 HU)
+ * @param callback Called once per slab in ascending layer order, the slab is only valid during the call. An error
+ * status stops the resampling and is returned.
+ * @return StatusCode::OK, StatusCode::BUFFER_EMPTY if the source is empty, StatusCode::RESAMPLE_ERROR if the grid is
+ * empty or a spacing is not positive, or the first error returned by the callback
+ */
+Status Resampler::Resample(const int16_t *input, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+						   ResampleGrid const &grid, InterpolationMode mode, int16_t outside_value,
+						   SlabCallback const &callback) {
+  if (input == nullptr) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return ResampleSlabs(HuSource{input}, size, spacing, grid, mode, outside_value, callback);
+}
+
+/**
+ * @param input Flat x-fastest source volume
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param grid Output grid
+ * @param mode Interpolation between the source voxels
+ * @param outside_value Value of the output voxels that lie outside of the source volume
+ * @param output Output: resampled volume in x-fastest order, grid.size voxels
+ * @return See the streaming overload
+ */
+Status Resampler::Resample(const int16_t *input, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+						   ResampleGrid const &grid, InterpolationMode mode, int16_t outside_value,
+						   std::vector<int16_t> &output) {
+  output.assign(VoxelCount(grid), outside_value);
+  return Resample(input, size, spacing, grid, mode, outside_value, CollectSlabs(grid, output));
+}
+
+/**
+ * @details Nearest neighbour sampling keeps the mask voxel by voxel. Trilinear sampling interpolates the 0/1 mask and
+ * keeps the output voxels of at least one half, which gives smoother boundaries when the output voxels are smaller.
+ * @param labels Flat x-fastest label volume
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param label Label of the voxels that belong to the mask
+ * @param grid Output grid
+ * @param mode Interpolation between the source voxels
+ * @param callback Called once per slab in ascending layer order with 1 for mask voxels and 0 for all others
+ * @return See Resample()
+ */
+Status Resampler::ResampleMask(const int *labels, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+							   int label, ResampleGrid const &grid, InterpolationMode mode,
+							   MaskSlabCallback const &callback) {
+  if (labels == nullptr) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  return ResampleSlabs(MaskSource{labels, label}, size, spacing, grid, mode, uint8_t{0}, callback);
+}
+
+/**
+ * @param labels Flat x-fastest label volume
+ * @param size Number of source voxels along x, y and z
+ * @param spacing Source voxel spacing in mm
+ * @param label Label of the voxels that belong to the mask
+ * @param grid Output grid
+ * @param mode Interpolation between the source voxels
+ * @param output Output: 0/1 mask in x-fastest order, grid.size voxels
+ * @return See Resample()
+ */
+Status Resampler::ResampleMask(const int *labels, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+							   int label, ResampleGrid const &grid, InterpolationMode mode,
+							   std::vector<uint8_t> &output) {
+  output.assign(VoxelCount(grid), 0);
+  return ResampleMask(labels, size, spacing, label, grid, mode, CollectSlabs(grid, output));
+}
@@ -0,0 +1,88 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Interpolation used to sample a volume between voxel centers
+ */
+enum class InterpolationMode {
+  /// Value of the nearest voxel, keeps labels and HU values unchanged
+  NEAREST,
+  /// Trilinear interpolation of the eight surrounding voxels
+  TRILINEAR
+};
+
+/**
+ * @brief Output grid of a resampling: size, spacing and pose relative to the source volume
+ * @details Voxel (i, j, k) of the output lies at the point (i, j, k) * spacing (in mm) of the output frame, which
+ * source_from_output maps into the mm frame of the source volume, whose voxel (0, 0, 0) is at the origin.
+ */
+struct ResampleGrid {
+  /// Number of output voxels along x, y and z
+  Eigen::Vector3i size{Eigen::Vector3i::Zero()};
+  /// Output voxel spacing along x, y and z in mm
+  Eigen::Vector3d spacing{Eigen::Vector3d::Ones()};
+  /// Rigid transformation from the output frame into the frame of the source volume (both in mm)
+  Eigen::Isometry3d source_from_output{Eigen::Isometry3d::Identity()};
+};
+
+/**
+ * @brief Resamples a volume onto an arbitrary rigidly transformed grid, e.g. isotropic voxels or a device frame
+ * @details The output is produced in slabs of kSlabLayers layers, each handed to a callback before the next slab is
+ * computed, so the memory needed besides the source volume is a single slab however large the output grid is.
+ * A slab is split into kTileSize x kTileSize tiles of rows that are processed by all hardware threads; the rows of a
+ * tile map onto a small, compact region of the source, which stays in the cache while the tile is sampled. Along a
+ * row the source position advances by a constant step, and the part of the row inside the source volume is clipped
+ * analytically, so the inner loop needs no bounds checks. Every output voxel is computed independently, so the result
+ * does not depend on the thread count.
+ */
+class MYLIB_EXPORT Resampler {
+ public:
+  /// Number of output layers per slab
+  static constexpr int kSlabLayers = 8;
+
+  /// Edge length of the square tiles a slab is split into, in output voxels
+  static constexpr int kTileSize = 32;
+
+  /// Receives the output layers [first_layer, first_layer + layer_count) in x-fastest order
+  using SlabCallback = std::function<Status(int first_layer, int layer_count, const int16_t *slab)>;
+
+  /// Receives the mask of the output layers [first_layer, first_layer + layer_count) in x-fastest order
+  using MaskSlabCallback = std::function<Status(int first_layer, int layer_count, const uint8_t *slab)>;
+
+  /// Axis-aligned grid with cubic voxels that covers the same extent as the source volume
+  static ResampleGrid IsotropicGrid(Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+									double output_spacing);
+
+  /// Grid aligned with another frame (e.g. the calibrated device frame) that covers the whole source volume
+  static ResampleGrid FrameGrid(Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+								Eigen::Isometry3d const &frame_from_source, double output_spacing);
+
+  /// Resamples a linear x-fastest HU volume slab by slab, samples outside of the source get outside_value
+  static Status Resample(const int16_t *input, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+						 ResampleGrid const &grid, InterpolationMode mode, int16_t outside_value,
+						 SlabCallback const &callback);
+
+  /// Resamples a linear x-fastest HU volume into one output volume
+  static Status Resample(const int16_t *input, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing,
+						 ResampleGrid const &grid, InterpolationMode mode, int16_t outside_value,
+						 std::vector<int16_t> &output);
+
+  /// Resamples the voxels of a label volume that carry the given label as a 0/1 mask, slab by slab
+  static Status ResampleMask(const int *labels, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing, int label,
+							 ResampleGrid const &grid, InterpolationMode mode, MaskSlabCallback const &callback);
+
+  /// Resamples the voxels of a label volume that carry the given label into one 0/1 mask
+  static Status ResampleMask(const int *labels, Eigen::Vector3i const &size, Eigen::Vector3d const &spacing, int label,
+							 ResampleGrid const &grid, InterpolationMode mode, std::vector<uint8_t> &output);
+};
+
+#endif  // RESAMPLER_H
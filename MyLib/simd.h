@@ -0,0 +1,222 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MYLIB_SSE2
+#endif
+
+/**
+ * @brief Row-wise SIMD helpers for int16_t voxel data
+ * @details Every helper processes eight voxels per SSE2 instruction and finishes the remainder of the row with scalar
+ * code. Without SSE2 only the scalar code is compiled, which the compiler may still auto-vectorize.
+ */
+namespace simd {
+/// acc[i] = max(acc[i], row[i])
+inline void MaxRow(int16_t *acc, const int16_t *row, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  for (; i + 8 <= count; i += 8) {
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i));
+	__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i), _mm_max_epi16(a, r));
+  }
+#endif
+  for (; i < count; ++i) {
+	acc[i] = std::max(acc[i], row[i]);
+  }
+}
+
+/// acc[i] = min(acc[i], row[i])
+inline void MinRow(int16_t *acc, const int16_t *row, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  for (; i + 8 <= count; i += 8) {
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i));
+	__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i), _mm_min_epi16(a, r));
+  }
+#endif
+  for (; i < count; ++i) {
+	acc[i] = std::min(acc[i], row[i]);
+  }
+}
+
+/// (lower[i], upper[i]) = (min(lower[i], upper[i]), max(lower[i], upper[i]))
+inline void MinMaxRows(int16_t *lower, int16_t *upper, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  for (; i + 8 <= count; i += 8) {
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lower + i));
+	__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(upper + i));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lower + i), _mm_min_epi16(a, b));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(upper + i), _mm_max_epi16(a, b));
+  }
+#endif
+  for (; i < count; ++i) {
+	int16_t const a = lower[i];
+	lower[i] = std::min(a, upper[i]);
+	upper[i] = std::max(a, upper[i]);
+  }
+}
+
+/// acc[i] += row[i], widening to 32 bit
+inline void SumRow(int32_t *acc, const int16_t *row, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  for (; i + 8 <= count; i += 8) {
+	__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+	// Sign-extend the eight int16 values to two vectors of four int32 values
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(r, r), 16);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(r, r), 16);
+	__m128i *a = reinterpret_cast<__m128i *>(acc + i);
+	_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), lo));
+	_mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), hi));
+  }
+#endif
+  for (; i < count; ++i) {
+	acc[i] += row[i];
+  }
+}
+
+/// acc[i] += weight * row[i], widening to 32 bit
+inline void AddWeightedRow(int32_t *acc, const int16_t *row, int16_t const weight, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  __m128i const w = _mm_set1_epi16(weight);
+  for (; i + 8 <= count; i += 8) {
+	__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+	// Low and high halves of the eight 32-bit products, interleaved back into two vectors of four int32 values
+	__m128i product_lo = _mm_mullo_epi16(r, w);
+	__m128i product_hi = _mm_mulhi_epi16(r, w);
+	__m128i *a = reinterpret_cast<__m128i *>(acc + i);
+	_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_unpacklo_epi16(product_lo, product_hi)));
+	_mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_unpackhi_epi16(product_lo, product_hi)));
+  }
+#endif
+  for (; i < count; ++i) {
+	acc[i] += static_cast<int32_t>(weight) * row[i];
+  }
+}
+
+/// row[i] = acc[i] / 2^shift, rounded to nearest and saturated to int16_t (shift > 0)
+inline void NarrowRow(int16_t *row, const int32_t *acc, int const shift, int const count) {
+  int32_t const half = 1 << (shift - 1);
+  int i = 0;
+#ifdef MYLIB_SSE2
+  __m128i const h = _mm_set1_epi32(half);
+  for (; i + 8 <= count; i += 8) {
+	__m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i)), h), shift);
+	__m128i hi =
+	  _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i + 4)), h), shift);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+	row[i] = static_cast<int16_t>(std::min(std::max((acc[i] + half) >> shift, INT16_MIN), INT16_MAX));
+  }
+}
+
+/// row[i] = round(clamp(value[i] * slope + intercept, lower, upper)) in place, value[i] being row[i] read as a signed
+/// or unsigned 16-bit integer; rounds half to even in both the SSE2 and the scalar code
+inline void RescaleRow(int16_t *row, bool const is_signed, float const slope, float const intercept,
+					   int16_t const lower, int16_t const upper, int const count) {
+  int i = 0;
+#ifdef MYLIB_SSE2
+  __m128 const s = _mm_set1_ps(slope);
+  __m128 const b = _mm_set1_ps(intercept);
+  __m128 const lo_bound = _mm_set1_ps(lower);
+  __m128 const hi_bound = _mm_set1_ps(upper);
+  __m128i const zero = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+	__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+	// Sign- or zero-extend the eight 16-bit values to two vectors of four int32 values
+	__m128i lo = is_signed ? _mm_srai_epi32(_mm_unpacklo_epi16(r, r), 16) : _mm_unpacklo_epi16(r, zero);
+	__m128i hi = is_signed ? _mm_srai_epi32(_mm_unpackhi_epi16(r, r), 16) : _mm_unpackhi_epi16(r, zero);
+	__m128 f_lo = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), s), b);
+	__m128 f_hi = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), s), b);
+	f_lo = _mm_min_ps(_mm_max_ps(f_lo, lo_bound), hi_bound);
+	f_hi = _mm_min_ps(_mm_max_ps(f_hi, lo_bound), hi_bound);
+	__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(f_lo), _mm_cvtps_epi32(f_hi));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), packed);
+  }
+#endif
+  for (; i < count; ++i) {
+	float const value = is_signed ? static_cast<float>(row[i]) : static_cast<float>(static_cast<uint16_t>(row[i]));
+	float const rescaled = std::min(std::max(value * slope + intercept, static_cast<float>(lower)),
+									static_cast<float>(upper));
+	row[i] = static_cast<int16_t>(std::nearbyint(rescaled));
+  }
+}
+
+/// @return max(row[0], ..., row[count - 1]), or INT16_MIN for an empty row
+inline int16_t ReduceMax(const int16_t *row, int const count) {
+  int16_t result = INT16_MIN;
+  int i = 0;
+#ifdef MYLIB_SSE2
+  if (count >= 8) {
+	__m128i m = _mm_set1_epi16(INT16_MIN);
+	for (; i + 8 <= count; i += 8) {
+	  m = _mm_max_epi16(m, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)));
+	}
+	alignas(16) int16_t lanes[8];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), m);
+	result = *std::max_element(lanes, lanes + 8);
+  }
+#endif
+  for (; i < count; ++i) {
+	result = std::max(result, row[i]);
+  }
+  return result;
+}
+
+/// @return min(row[0], ..., row[count - 1]), or INT16_MAX for an empty row
+inline int16_t ReduceMin(const int16_t *row, int const count) {
+  int16_t result = INT16_MAX;
+  int i = 0;
+#ifdef MYLIB_SSE2
+  if (count >= 8) {
+	__m128i m = _mm_set1_epi16(INT16_MAX);
+	for (; i + 8 <= count; i += 8) {
+	  m = _mm_min_epi16(m, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)));
+	}
+	alignas(16) int16_t lanes[8];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), m);
+	result = *std::min_element(lanes, lanes + 8);
+  }
+#endif
+  for (; i < count; ++i) {
+	result = std::min(result, row[i]);
+  }
+  return result;
+}
+
+/// @return row[0] + ... + row[count - 1]
+inline int64_t ReduceSum(const int16_t *row, int const count) {
+  int64_t result = 0;
+  int i = 0;
+#ifdef MYLIB_SSE2
+  if (count >= 8) {
+	// _mm_madd_epi16 with ones adds neighbouring pairs into int32 lanes, which cannot overflow for rows < 65536 voxels
+	__m128i const ones = _mm_set1_epi16(1);
+	__m128i s = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+	  s = _mm_add_epi32(s, _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)), ones));
+	}
+	alignas(16) int32_t lanes[4];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), s);
+	result = static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  }
+#endif
+  for (; i < count; ++i) {
+	result += row[i];
+  }
+  return result;
+}
+} // namespace simd
+
+#endif  // SIMD_H
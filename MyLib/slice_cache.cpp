@@ -0,0 +1,213 @@
+#include "slice_cache.h"
+
+/**
+ * @param dataset The dataset to take the slices from
+ * @param capacity Maximum number of cached slices
+ * @param prefetch_depth Number of slices that are prefetched ahead of the current one
+ */
+SliceCache::SliceCache(CTDataset const &dataset, int const capacity, int const prefetch_depth)
+  : m_dataset(dataset),
+	m_capacity(std::max(1, capacity)),
+	m_prefetchDepth(std::max(0, prefetch_depth)),
+	m_worker(&SliceCache::PrefetchLoop, this) {
+}
+
+SliceCache::~SliceCache() {
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stop = true;
+	m_pending.clear();
+  }
+  m_wakeUp.notify_all();
+  m_worker.join();
+}
+
+uint64_t SliceCache::MakeKey(SliceOrientation const orientation, int const index, int const center,
+							 int const window_size) {
+  return (static_cast<uint64_t>(orientation) << 48) | (static_cast<uint64_t>(index) << 24)
+	| (static_cast<uint64_t>(center + 1024) << 12) | static_cast<uint64_t>(window_size);
+}
+
+/**
+ * @details A cache hit hands out the shared, immutable slice without copying it. A miss samples and windows the slice
+ * on the calling thread. In both cases the prefetch queue is replaced by the neighbours of the requested slice, so
+ * the prefetch thread always works on the slices that are most likely to be requested next. The direction of travel
+ * is taken from the previous request of the same orientation.
+ * @param orientation Orientation of the slice, SliceOrientation::OBLIQUE is not supported
+ * @param index Index of the slice, see CTDataset::GetSliceCount()
+ * @param center The center of the range window
+ * @param window_size The size of the range window
+ * @param slice Output: the windowed slice
+ * @return StatusCode::OK, StatusCode::SLICE_OUT_OF_RANGE for an invalid orientation or index, or the windowing error
+ * of CTDataset::CreateWindowingLUT
+ */
+Status SliceCache::GetSlice(SliceOrientation const orientation, int const index, int const center,
+							int const window_size, std::shared_ptr<const WindowedSlice> &slice) {
+  if (orientation == SliceOrientation::OBLIQUE || index < 0 || index >= m_dataset.GetSliceCount(orientation)) {
+	return Status(StatusCode::SLICE_OUT_OF_RANGE);
+  }
+
+  uint64_t const key = MakeKey(orientation, index, center, window_size);
+  std::shared_ptr<const std::vector<uint8_t>> lut;
+  uint64_t generation = 0;
+  bool hit = false;
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// A new window setting invalidates every cached slice
+	if (!m_lut || center != m_center || window_size != m_windowSize) {
+	  auto new_lut = std::make_shared<std::vector<uint8_t>>();
+	  Status stat = CTDataset::CreateWindowingLUT(center, window_size, *new_lut);
+	  if (!stat.Ok()) {
+		return stat;
+	  }
+	  m_entries.clear();
+	  m_lru.clear();
+	  m_pending.clear();
+	  ++m_generation;
+	  m_center = center;
+	  m_windowSize = window_size;
+	  m_lut = new_lut;
+	}
+	lut = m_lut;
+	generation = m_generation;
+
+	if (orientation == m_lastOrientation && m_lastIndex >= 0 && index != m_lastIndex) {
+	  m_direction = (index > m_lastIndex) ? 1 : -1;
+	}
+	m_lastOrientation = orientation;
+	m_lastIndex = index;
+
+	// Mostly ahead, a few behind in case the user turns around
+	m_pending.clear();
+	int const slice_count = m_dataset.GetSliceCount(orientation);
+	for (int step = 1; step <= m_prefetchDepth; ++step) {
+	  int const ahead = index + step * m_direction;
+	  if (ahead >= 0 && ahead < slice_count) {
+		m_pending.push_back(PrefetchRequest{orientation, ahead});
+	  }
+	}
+	for (int step = 1; step <= m_prefetchDepth / 4; ++step) {
+	  int const behind = index - step * m_direction;
+	  if (behind >= 0 && behind < slice_count) {
+		m_pending.push_back(PrefetchRequest{orientation, behind});
+	  }
+	}
+
+	auto it = m_entries.find(key);
+	if (it != m_entries.end()) {
+	  m_lru.splice(m_lru.begin(), m_lru, it->second.lru_position);
+	  slice = it->second.slice;
+	  hit = true;
+	  ++m_hits;
+	}
+  }
+  m_wakeUp.notify_one();
+
+  if (hit) {
+	return Status(StatusCode::OK);
+  }
+
+  auto computed = ComputeSlice(orientation, index, *lut);
+  {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_misses;
+	if (generation == m_generation) {
+	  InsertLocked(key, computed);
+	}
+  }
+  slice = computed;
+  return Status(StatusCode::OK);
+}
+
+/**
+ * @details Blocks until a slice that is currently being prefetched is done, so that the dataset can safely be modified
+ * afterwards.
+ */
+void SliceCache::Invalidate() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  ++m_generation;
+  m_pending.clear();
+  m_entries.clear();
+  m_lru.clear();
+  m_lut.reset();
+  m_lastIndex = -1;
+  m_idle.wait(lock, [this] { return !m_prefetchBusy; });
+}
+
+void SliceCache::WaitForPrefetch() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this] { return m_pending.empty() && !m_prefetchBusy; });
+}
+
+int64_t SliceCache::Hits() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hits;
+}
+
+int64_t SliceCache::Misses() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_misses;
+}
+
+std::shared_ptr<WindowedSlice> SliceCache::ComputeSlice(SliceOrientation const orientation, int const index,
+														std::vector<uint8_t> const &lut) const {
+  auto slice = std::make_shared<WindowedSlice>();
+  slice->plane = m_dataset.GetSlicePlane(orientation, index);
+  auto hu_values = m_dataset.ExtractSlice(slice->plane);
+  if (!hu_values.Ok()) {
+	slice->plane.width = slice->plane.height = 0;
+	return slice;
+  }
+  slice->hu_values = std::move(hu_values).value();
+  slice->grey_values.resize(slice->hu_values.size());
+  CTDataset::ApplyWindowingLUT(slice->hu_values.data(), static_cast<int>(slice->hu_values.size()), lut,
+							   slice->grey_values.data());
+  return slice;
+}
+
+void SliceCache::InsertLocked(uint64_t const key, std::shared_ptr<const WindowedSlice> const &slice) {
+  auto it = m_entries.find(key);
+  if (it != m_entries.end()) {
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru_position);
+	return;
+  }
+  while (static_cast<int>(m_entries.size()) >= m_capacity) {
+	m_entries.erase(m_lru.back());
+	m_lru.pop_back();
+  }
+  m_lru.push_front(key);
+  m_entries[key] = Entry{slice, m_lru.begin()};
+}
+
+void SliceCache::PrefetchLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+	m_wakeUp.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+	if (m_stop) {
+	  return;
+	}
+
+	PrefetchRequest request = m_pending.front();
+	m_pending.pop_front();
+	uint64_t const key = MakeKey(request.orientation, request.index, m_center, m_windowSize);
+	if (!m_lut || m_entries.count(key) != 0) {
+	  m_idle.notify_all();
+	  continue;
+	}
+
+	auto lut = m_lut;
+	uint64_t const generation = m_generation;
+	m_prefetchBusy = true;
+	lock.unlock();
+
+	auto computed = ComputeSlice(request.orientation, request.index, *lut);
+
+	lock.lock();
+	m_prefetchBusy = false;
+	if (generation == m_generation) {
+	  InsertLocked(key, computed);
+	}
+	m_idle.notify_all();
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef SLICE_CACHE_H
+#define SLICE_CACHE_H
+
+#include "ct_dataset.h"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @brief A reformatted slice that is ready for display
+ */
+struct WindowedSlice {
+  /// Geometry of the slice
+  SlicePlane plane;
+  /// HU values of the slice (needed for overlays such as the threshold highlighting)
+  std::vector<int16_t> hu_values;
+  /// Grey values after windowing
+  std::vector<uint8_t> grey_values;
+};
+
+/**
+ * @brief LRU cache of windowed slices with a background thread that prefetches along the direction of scrolling
+ * @details Slices are keyed by (orientation, index, center, window size). All cached slices share one window setting:
+ * requesting a slice with a different center or window size drops the cache. Every request schedules the next slices
+ * in the direction of travel (and a few behind) on the prefetch thread, so scrolling through a stack mostly hits the
+ * cache and costs no more than copying the cached slice.
+ * Oblique slices depend on the rotation of the 3D view and are therefore never cached.
+ * @attention The dataset must not be modified while the cache is in use. Call Invalidate() before loading new data.
+ */
+class MYLIB_EXPORT SliceCache {
+ public:
+  explicit SliceCache(CTDataset const &dataset, int const capacity = 64, int const prefetch_depth = 8);
+  ~SliceCache();
+
+  SliceCache(SliceCache const &) = delete;
+  SliceCache &operator=(SliceCache const &) = delete;
+
+  /// Get a windowed slice from the cache, computing it if needed, and prefetch its neighbours
+  Status GetSlice(SliceOrientation const orientation, int const index, int const center, int const window_size,
+				  std::shared_ptr<const WindowedSlice> &slice);
+
+  /// Drop all cached slices and pending prefetches and wait until the prefetch thread is idle
+  void Invalidate();
+
+  /// Block until all pending prefetches are done
+  void WaitForPrefetch();
+
+  /// Number of requests that were served from the cache
+  [[nodiscard]] int64_t Hits() const;
+
+  /// Number of requests that had to be computed synchronously
+  [[nodiscard]] int64_t Misses() const;
+
+ private:
+  /// Combines orientation, index, center and window size into one key
+  static uint64_t MakeKey(SliceOrientation const orientation, int const index, int const center,
+						  int const window_size);
+
+  /// Samples and windows a slice with the current lookup table
+  std::shared_ptr<WindowedSlice> ComputeSlice(SliceOrientation const orientation, int const index,
+											  std::vector<uint8_t> const &lut) const;
+
+  /// Inserts a slice as most recently used and evicts the least recently used one if the cache is full
+  void InsertLocked(uint64_t const key, std::shared_ptr<const WindowedSlice> const &slice);
+
+  /// Main loop of the prefetch thread
+  void PrefetchLoop();
+
+  struct Entry {
+	std::shared_ptr<const WindowedSlice> slice;
+	std::list<uint64_t>::iterator lru_position;
+  };
+
+  struct PrefetchRequest {
+	SliceOrientation orientation;
+	int index;
+  };
+
+  CTDataset const &m_dataset;
+  int const m_capacity;
+  int const m_prefetchDepth;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+  std::condition_variable m_idle;
+
+  /// Most recently used key at the front
+  std::list<uint64_t> m_lru;
+  std::unordered_map<uint64_t, Entry> m_entries;
+
+  /// Window setting of all cached slices
+  int m_center{0};
+  int m_windowSize{0};
+  std::shared_ptr<const std::vector<uint8_t>> m_lut;
+
+  /// Incremented whenever cached slices become invalid, so that stale prefetch results are discarded
+  uint64_t m_generation{0};
+
+  /// Last requested slice, used to determine the direction of travel
+  SliceOrientation m_lastOrientation{SliceOrientation::AXIAL};
+  int m_lastIndex{-1};
+  int m_direction{1};
+
+  std::deque<PrefetchRequest> m_pending;
+  bool m_prefetchBusy{false};
+  bool m_stop{false};
+
+  int64_t m_hits{0};
+  int64_t m_misses{0};
+
+  std::thread m_worker;
+};
+
+#endif  // SLICE_CACHE_H
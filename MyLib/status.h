@@ -1,6 +1,11 @@
 #ifndef STATUS_H
 #define STATUS_H
 
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 // FIXME: Wrap this whole thing in a namespace. Couldn't think of a witty name
 // yet.
 
@@ -21,10 +26,34 @@ enum class StatusCode {
   BUFFER_EMPTY,
   /// Files: Could not open file
   FOPEN_ERROR,
+  /// Files: Could not write the whole file
+  FWRITE_ERROR,
+  /// Files: The file is truncated or not in the expected format
+  FILE_FORMAT_ERROR,
   /// Eigen: Vector3i doesn't have three elements
   EIGEN_VEC_SIZE_ERROR,
   /// Seed with no neighbours above the threshold value was chosen
-  BAD_SEED_ERROR
+  BAD_SEED_ERROR,
+  /// Slices: The slice index or orientation is not available
+  SLICE_OUT_OF_RANGE,
+  /// Rendering: The transfer function has no control points or they are not sorted by HU value
+  TRANSFER_FUNCTION_ERROR,
+  /// Registration: Too few points or correspondences to estimate a rigid transformation
+  REGISTRATION_ERROR,
+  /// Planning: The target lies outside the volume or the planning parameters are invalid
+  PLANNING_ERROR,
+  /// Morphology: The radius of the structuring element is out of range or the masks do not match
+  MORPHOLOGY_ERROR,
+  /// Prefilter: The filter parameters are out of range
+  PREFILTER_ERROR,
+  /// Resampling: The output grid is empty or a voxel spacing is not positive
+  RESAMPLE_ERROR,
+  /// History: There is no region growing result to undo or redo
+  HISTORY_ERROR,
+  /// Cine: No series is open, or the phase or the render parameters are out of range
+  CINE_ERROR,
+  /// Render server: The server is unreachable, or a request is malformed or its frame exceeds the framebuffer
+  SERVER_ERROR
 };
 
 /**
@@ -56,6 +85,10 @@ class [[nodiscard]] Status final {
  * @details It is constructed either with a return value of
  * generic type T OR with a Status and holds either of the two, never both at
  * once.
+ * The value lives in raw storage inside the object and is only constructed on
+ * success, so T needs neither a default constructor nor a copy constructor:
+ * move-only payloads and large buffers (e.g. std::vector) are moved in and can
+ * be moved out again with std::move(result).value(), without any copy.
  * The whole class is [[nodiscard]], so either the return value or the error
  * must be used by the caller.
  */
@@ -63,17 +96,76 @@ template<typename T>
 class [[nodiscard]] StatusOr {
  public:
   /// Holds a return value (generic over T) in case of success.
-  explicit StatusOr(T value) : m_value(value), m_status(StatusCode::OK) {}
+  explicit StatusOr(T const &value) : m_status(StatusCode::OK), m_hasValue(true) {
+	new (&m_storage) T(value);
+  }
+
+  /// Holds a moved-in return value (generic over T) in case of success.
+  explicit StatusOr(T &&value) : m_status(StatusCode::OK), m_hasValue(true) {
+	new (&m_storage) T(std::move(value));
+  }
+
   /// Holds a Status in case of failure.
-  explicit StatusOr(Status stat)
-	: m_status(stat) {}  // FIXME: Initialize the value as empty (or as some
-  // type that signifies empty)
+  explicit StatusOr(Status stat) : m_status(stat) {
+	assert(!stat.Ok() && "StatusOr needs a value on success");
+  }
+
+  StatusOr(StatusOr const &other) : m_status(other.m_status), m_hasValue(other.m_hasValue) {
+	if (m_hasValue) {
+	  new (&m_storage) T(other.Value());
+	}
+  }
+
+  StatusOr(StatusOr &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+	: m_status(other.m_status), m_hasValue(other.m_hasValue) {
+	if (m_hasValue) {
+	  new (&m_storage) T(std::move(other.Value()));
+	}
+  }
+
+  StatusOr &operator=(StatusOr const &other) {
+	if (this != &other) {
+	  Reset();
+	  m_status = other.m_status;
+	  if (other.m_hasValue) {
+		new (&m_storage) T(other.Value());
+		m_hasValue = true;
+	  }
+	}
+	return *this;
+  }
+
+  StatusOr &operator=(StatusOr &&other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+	if (this != &other) {
+	  Reset();
+	  m_status = other.m_status;
+	  if (other.m_hasValue) {
+		new (&m_storage) T(std::move(other.Value()));
+		m_hasValue = true;
+	  }
+	}
+	return *this;
+  }
+
+  ~StatusOr() { Reset(); }
 
   /// @returns Reference to a value if no error is present.
-  T &value() { return m_value; }
+  T &value() & {
+	assert(m_hasValue && "StatusOr holds an error");
+	return Value();
+  }
 
   /// @returns Constant reference to a value if no error is present.
-  T const &value() const { return m_value; }  // FIXME: Check if value exists before returning
+  T const &value() const & {
+	assert(m_hasValue && "StatusOr holds an error");
+	return Value();
+  }
+
+  /// @returns Rvalue reference to a value if no error is present, so that it can be moved out.
+  T &&value() && {
+	assert(m_hasValue && "StatusOr holds an error");
+	return std::move(Value());
+  }
 
   /// @returns Reference to an error.
   Status &status() { return m_status; }
@@ -82,14 +174,25 @@ class [[nodiscard]] StatusOr {
   Status const &status() const { return m_status; }
 
   /// @returns True if StatusCode::OK, false otherwise.
-  bool Ok() { return (m_status.code() == StatusCode::OK); }
+  bool Ok() const { return (m_status.code() == StatusCode::OK); }
 
-  // NOTE: std::variant<T, Error> would be nicer here, but that's only in C++ 17
-  // and up. Unions (tagged or otherwise) are evil (not type-safe), that's why
-  // it's just two member variables for now.
+  // NOTE: std::optional / std::variant would do the bookkeeping here, but those
+  // are only in C++ 17 and up. The raw storage is only ever accessed through
+  // Value() after checking m_hasValue.
  private:
-  T m_value{0};
+  T &Value() { return *reinterpret_cast<T *>(&m_storage); }
+  T const &Value() const { return *reinterpret_cast<T const *>(&m_storage); }
+
+  void Reset() {
+	if (m_hasValue) {
+	  Value().~T();
+	  m_hasValue = false;
+	}
+  }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
   Status m_status;
+  bool m_hasValue{false};
 };
 
 #endif  // STATUS_H
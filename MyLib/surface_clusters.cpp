@@ -0,0 +1,124 @@
+#include "surface_clusters.h"
+#include "normal_volume.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+constexpr int SurfaceClusters::kCellEdge;
+constexpr float SurfaceClusters::kBackfaceMargin;
+
+/**
+ * @details Every point gets a key from its cell and the octant of its normal, and the points are sorted by key, so
+ * every cluster is one run of Order() and the clusters are ordered by z, y and x of their cell. The bounding sphere is
+ * centered on the bounding box of the points. The cone axis is the normalized sum of the normals, its half angle the
+ * largest angle between the axis and a normal. A cone that opens to more than a hemisphere, including the margin,
+ * is never culled.
+ * @param points Surface points with non-negative coordinates below 2^23
+ * @param normals Octahedral normal code of every point (see NormalVolume), or empty
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if there are no points
+ */
+Status SurfaceClusters::Build(std::vector<Eigen::Vector3i> const &points, std::vector<uint16_t> const &normals) {
+  Clear();
+  if (points.empty()) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  bool const cones = normals.size() == points.size();
+  int const count = static_cast<int>(points.size());
+  std::vector<Eigen::Vector3f> directions(cones ? points.size() : 0);
+  std::vector<uint64_t> keys(points.size());
+  int const block = 4096;
+  utils::ParallelFor(0, (count + block - 1) / block, [&](int b) {
+	int const end = std::min(count, (b + 1) * block);
+	for (int i = b * block; i < end; ++i) {
+	  uint64_t octant = 0;
+	  if (cones) {
+		Eigen::Vector3f &direction = directions[i];
+		NormalVolume::DecodeNormal(normals[i], direction.x(), direction.y(), direction.z());
+		octant = (direction.x() < 0.0f ? 1 : 0) | (direction.y() < 0.0f ? 2 : 0) | (direction.z() < 0.0f ? 4 : 0);
+	  }
+	  uint64_t const cell_x = static_cast<uint64_t>(points[i].x() / kCellEdge);
+	  uint64_t const cell_y = static_cast<uint64_t>(points[i].y() / kCellEdge);
+	  uint64_t const cell_z = static_cast<uint64_t>(points[i].z() / kCellEdge);
+	  keys[i] = (((cell_z << 20 | cell_y) << 20 | cell_x) << 3) | octant;
+	}
+  });
+  m_order.resize(points.size());
+  std::iota(m_order.begin(), m_order.end(), 0u);
+  std::sort(m_order.begin(), m_order.end(), [&keys](uint32_t a, uint32_t b) {
+	return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+  });
+
+  for (uint32_t begin = 0; begin < m_order.size();) {
+	uint32_t end = begin + 1;
+	while (end < m_order.size() && keys[m_order[end]] == keys[m_order[begin]]) {
+	  ++end;
+	}
+	Eigen::Vector3i lower = points[m_order[begin]];
+	Eigen::Vector3i upper = lower;
+	Eigen::Vector3f normal_sum = Eigen::Vector3f::Zero();
+	for (uint32_t k = begin; k < end; ++k) {
+	  lower = lower.cwiseMin(points[m_order[k]]);
+	  upper = upper.cwiseMax(points[m_order[k]]);
+	  if (cones) {
+		normal_sum += directions[m_order[k]];
+	  }
+	}
+	SurfaceCluster cluster;
+	cluster.center = 0.5f * (lower + upper).cast<float>();
+	float squared_radius = 0.0f;
+	for (uint32_t k = begin; k < end; ++k) {
+	  squared_radius = std::max(squared_radius, (points[m_order[k]].cast<float>() - cluster.center).squaredNorm());
+	}
+	cluster.radius = std::sqrt(squared_radius) + 1.0f;
+	cluster.axis = Eigen::Vector3f::UnitZ();
+	cluster.cone_cutoff = -2.0f;
+	if (cones && normal_sum.norm() > 1e-3f) {
+	  cluster.axis = normal_sum.normalized();
+	  float min_cosine = 1.0f;
+	  for (uint32_t k = begin; k < end; ++k) {
+		min_cosine = std::min(min_cosine, cluster.axis.dot(directions[m_order[k]]));
+	  }
+	  float const half_angle = std::acos(std::max(-1.0f, std::min(1.0f, min_cosine))) + kBackfaceMargin;
+	  if (half_angle < 0.5f * static_cast<float>(M_PI)) {
+		cluster.cone_cutoff = -std::sin(half_angle);
+	  }
+	}
+	cluster.begin = begin;
+	cluster.end = end;
+	m_clusters.push_back(cluster);
+	begin = end;
+  }
+  return Status(StatusCode::OK);
+}
+
+void SurfaceClusters::Clear() {
+  m_clusters.clear();
+  m_order.clear();
+}
+
+/**
+ * @details The view looks along +z and gradient normals point into the region, so a point faces the viewer if its
+ * rotated normal has a positive z component. The cone test needs one dot product: a cone with half angle a around
+ * the axis faces away completely if the rotated axis is more than 90 + a degrees away from +z. The sphere is rejected
+ * if it projects completely outside of the image or lies completely behind the far plane.
+ * @param cluster The cluster
+ * @param rotation Rotation of the view
+ * @param rotation_center Point the view rotates about
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param layers Number of depth values; points at depth layers or beyond are not drawn
+ * @return False if no point of the cluster can be drawn
+ */
+bool SurfaceClusters::MayBeVisible(SurfaceCluster const &cluster, Eigen::Matrix3f const &rotation,
+								   Eigen::Vector3f const &rotation_center, int width, int height, int layers) {
+  if (rotation.row(2).dot(cluster.axis) < cluster.cone_cutoff) {
+	return false;
+  }
+  Eigen::Vector3f const center = rotation * (cluster.center - rotation_center) + rotation_center;
+  float const radius = cluster.radius;
+  return center.x() + radius > -1.0f && center.x() - radius < static_cast<float>(width)
+	&& center.y() + radius > -1.0f && center.y() - radius < static_cast<float>(height)
+	&& center.z() - radius < static_cast<float>(layers);
+}
@@ -0,0 +1,75 @@
+#ifndef SURFACE_CLUSTERS_H
+#define SURFACE_CLUSTERS_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Group of nearby surface points with similar normals
+ */
+struct SurfaceCluster {
+  /// Center of the bounding sphere in voxel coordinates
+  Eigen::Vector3f center;
+  /// Radius of the bounding sphere, including a margin of one pixel for rounding
+  float radius;
+  /// Unit axis of the normal cone, the mean gradient direction of the points
+  Eigen::Vector3f axis;
+  /// The whole cluster faces away from the viewer if the view z-axis dotted with the cone axis is below this value
+  float cone_cutoff;
+  /// First position of the cluster in SurfaceClusters::Order()
+  uint32_t begin;
+  /// Position after the last point of the cluster in SurfaceClusters::Order()
+  uint32_t end;
+};
+
+/**
+ * @brief Spatially coherent clusters of surface points, each with a bounding sphere and a normal cone
+ * @details The points are binned into cells of kCellEdge voxels and, within a cell, by the octant of their normal,
+ * so the opposite walls of a thin structure end up in different clusters. Built once per region, the clusters let
+ * a splat renderer reject whole groups of points that face away from the viewer or project outside of the image
+ * before any per-point work. Normals are gradient directions (see NormalVolume), i.e. they point into the region.
+ * Only the order of the points is kept, the points and normals themselves stay with the caller.
+ */
+class MYLIB_EXPORT SurfaceClusters {
+ public:
+  /// Edge length of the cells the points are binned into, in voxels
+  static constexpr int kCellEdge = 8;
+
+  /// Angle in radians that a cone has to face away beyond perpendicular before it is culled, which keeps the
+  /// silhouette intact despite the angular error of gradient normals
+  static constexpr float kBackfaceMargin = 0.17f;
+
+  SurfaceClusters() = default;
+
+  /// Clusters the points; without one normal code per point the cones are disabled and only view culling remains
+  Status Build(std::vector<Eigen::Vector3i> const &points, std::vector<uint16_t> const &normals);
+
+  /// Releases the clusters
+  void Clear();
+
+  /// True if a cluster may contain a point that faces the viewer and projects into the image
+  [[nodiscard]] static bool MayBeVisible(SurfaceCluster const &cluster, Eigen::Matrix3f const &rotation,
+										 Eigen::Vector3f const &rotation_center, int width, int height, int layers);
+
+  /// @return True if no clusters have been built
+  [[nodiscard]] bool Empty() const { return m_order.empty(); }
+
+  /// @return Number of points the clusters were built from
+  [[nodiscard]] size_t PointCount() const { return m_order.size(); }
+
+  /// @return The clusters
+  [[nodiscard]] std::vector<SurfaceCluster> const &Clusters() const { return m_clusters; }
+
+  /// @return Indices of the points passed to Build(), grouped by cluster, so every cluster is one contiguous run
+  [[nodiscard]] std::vector<uint32_t> const &Order() const { return m_order; }
+
+ private:
+  std::vector<SurfaceCluster> m_clusters;
+  std::vector<uint32_t> m_order;
+};
+
+#endif  // SURFACE_CLUSTERS_H
@@ -0,0 +1,256 @@
+#include "surface_nets.h"
+#include "parallel.h"
+#include "Eigen/Geometry"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @details Three passes:
+ * - the corner masks of every cell layer are computed once from the two voxel layers it spans and kept, and its
+ *   vertices are counted; a prefix sum gives the index of the first vertex of each layer
+ * - every layer places its vertices and emits the quads of the voxel edges whose surrounding cells end in this layer;
+ *   the vertex indices of the previous layer are re-derived from its masks instead of being shared between threads
+ * - the area-weighted face normals are accumulated into unit vertex normals
+ *
+ * With HU values, a crossing is placed where the HU values along the edge pass the threshold, which removes most of
+ * the staircase of the voxel boundary. Edges whose HU values do not pass the threshold use the edge midpoint.
+ * @param labels Flat x-fastest label volume, e.g. the region growing buffer
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param layers Number of layers of the volume
+ * @param label Label of the voxels inside the region
+ * @param hu_values Flat x-fastest HU values of the same volume for sub-voxel vertex positions, or nullptr
+ * @param threshold HU threshold the region was segmented with, ignored without HU values
+ * @param mesh Output: the mesh in voxel coordinates
+ * @return StatusCode::OK, or StatusCode::BUFFER_EMPTY if the volume is empty or has no voxel with the label
+ */
+Status SurfaceNets::Extract(const int *labels, int width, int height, int layers, int label,
+							const int16_t *hu_values, int threshold, TriangleMesh &mesh) {
+  mesh.vertices.clear();
+  mesh.normals.clear();
+  mesh.indices.clear();
+  if (labels == nullptr || width <= 0 || height <= 0 || layers <= 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+  size_t const slice_size = static_cast<size_t>(width) * height;
+
+  // Bounding box of the region, one layer per thread
+  std::vector<Eigen::Vector4i> layer_boxes(layers, Eigen::Vector4i(width, height, -1, -1));
+  utils::ParallelFor(0, layers, [&](int z) {
+	Eigen::Vector4i &box = layer_boxes[z];
+	for (int y = 0; y < height; ++y) {
+	  const int *row = labels + z * slice_size + static_cast<size_t>(y) * width;
+	  for (int x = 0; x < width; ++x) {
+		if (row[x] == label) {
+		  box = Eigen::Vector4i(std::min(box[0], x), std::min(box[1], y), std::max(box[2], x), std::max(box[3], y));
+		}
+	  }
+	}
+  });
+  int x0 = width;
+  int y0 = height;
+  int z0 = layers;
+  int x1 = -1;
+  int y1 = -1;
+  int z1 = -1;
+  for (int z = 0; z < layers; ++z) {
+	if (layer_boxes[z][2] >= 0) {
+	  x0 = std::min(x0, layer_boxes[z][0]);
+	  y0 = std::min(y0, layer_boxes[z][1]);
+	  x1 = std::max(x1, layer_boxes[z][2]);
+	  y1 = std::max(y1, layer_boxes[z][3]);
+	  z0 = std::min(z0, z);
+	  z1 = std::max(z1, z);
+	}
+  }
+  if (z1 < 0) {
+	return Status(StatusCode::BUFFER_EMPTY);
+  }
+
+  // Cell (i, j, k) has the voxel centers (i..i+1, j..j+1, k..k+1) as corners. One cell more on every side of the
+  // bounding box closes the surface.
+  int const cells_x = x1 - x0 + 2;
+  int const cells_y = y1 - y0 + 2;
+  int const first_layer = z0 - 1;
+  int const cell_layers = z1 - z0 + 2;
+  size_t const layer_cells = static_cast<size_t>(cells_x) * cells_y;
+  auto cell_index = [&](int i, int j) { return (i - x0 + 1) + static_cast<size_t>(j - y0 + 1) * cells_x; };
+
+  // Inside flags of the corner voxels (x0 - 1..x1 + 1, y0 - 1..y1 + 1) of the cells in voxel layer z. Voxels outside
+  // of the volume are outside, all others are read row by row without bounds checks.
+  int const plane_width = cells_x + 1;
+  auto read_plane = [&](int z, std::vector<uint8_t> &plane) {
+	plane.assign(static_cast<size_t>(plane_width) * (cells_y + 1), 0);
+	if (z < 0 || z >= layers) {
+	  return;
+	}
+	int const x_begin = std::max(x0 - 1, 0);
+	int const x_end = std::min(x1 + 1, width - 1);
+	for (int y = std::max(y0 - 1, 0); y <= std::min(y1 + 1, height - 1); ++y) {
+	  const int *const row = labels + z * slice_size + static_cast<size_t>(y) * width;
+	  uint8_t *const flags = plane.data() + (x_begin - x0 + 1) + static_cast<size_t>(y - y0 + 1) * plane_width;
+	  for (int x = x_begin; x <= x_end; ++x) {
+		flags[x - x_begin] = row[x] == label ? 1 : 0;
+	  }
+	}
+  };
+
+  // Corner c of a cell is offset by (c & 1, (c >> 1) & 1, (c >> 2) & 1) and sets bit c of its mask if it is inside.
+  // The masks of all cells are computed once; the later passes and the quads of every layer only read them.
+  std::vector<uint8_t> masks(layer_cells * cell_layers);
+  auto active = [](int mask) { return mask != 0 && mask != 0xff; };
+  std::vector<uint32_t> layer_offsets(cell_layers + 1, 0);
+  utils::ParallelFor(0, cell_layers, [&](int layer) {
+	std::vector<uint8_t> lower;
+	std::vector<uint8_t> upper;
+	read_plane(first_layer + layer, lower);
+	read_plane(first_layer + layer + 1, upper);
+	uint8_t *const layer_masks = masks.data() + layer * layer_cells;
+	uint32_t count = 0;
+	for (int j = 0; j < cells_y; ++j) {
+	  const uint8_t *const lower_0 = lower.data() + static_cast<size_t>(j) * plane_width;
+	  const uint8_t *const lower_1 = lower_0 + plane_width;
+	  const uint8_t *const upper_0 = upper.data() + static_cast<size_t>(j) * plane_width;
+	  const uint8_t *const upper_1 = upper_0 + plane_width;
+	  for (int i = 0; i < cells_x; ++i) {
+		int const mask = lower_0[i] | lower_0[i + 1] << 1 | lower_1[i] << 2 | lower_1[i + 1] << 3 | upper_0[i] << 4
+		  | upper_0[i + 1] << 5 | upper_1[i] << 6 | upper_1[i + 1] << 7;
+		layer_masks[i + static_cast<size_t>(j) * cells_x] = static_cast<uint8_t>(mask);
+		count += active(mask) ? 1 : 0;
+	  }
+	}
+	layer_offsets[layer + 1] = count;
+  });
+  for (int layer = 0; layer < cell_layers; ++layer) {
+	layer_offsets[layer + 1] += layer_offsets[layer];
+  }
+  mesh.vertices.resize(layer_offsets[cell_layers]);
+
+  std::vector<std::vector<uint32_t>> layer_indices(cell_layers);
+  utils::ParallelFor(0, cell_layers, [&](int layer) {
+	int const k = first_layer + layer;
+	const uint8_t *const current_masks = masks.data() + layer * layer_cells;
+	std::vector<uint32_t> current(layer_cells, 0);
+	std::vector<uint32_t> previous(layer > 0 ? layer_cells : 0, 0);
+
+	uint32_t next = layer_offsets[layer];
+	for (int j = y0 - 1; j <= y1; ++j) {
+	  for (int i = x0 - 1; i <= x1; ++i) {
+		int const mask = current_masks[cell_index(i, j)];
+		if (!active(mask)) {
+		  continue;
+		}
+		Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+		int crossings = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+		  for (int a = 0; a < 8; ++a) {
+			int const b = a | (1 << axis);
+			if (a == b || ((mask >> a) & 1) == ((mask >> b) & 1)) {
+			  continue;
+			}
+			Eigen::Vector3f const corner_a(static_cast<float>(i + (a & 1)), static_cast<float>(j + ((a >> 1) & 1)),
+										   static_cast<float>(k + ((a >> 2) & 1)));
+			float t = 0.5f;
+			if (hu_values != nullptr) {
+			  Eigen::Vector3i const va = corner_a.cast<int>();
+			  Eigen::Vector3i const vb = va + Eigen::Vector3i::Unit(axis);
+			  // Corners outside the volume count as air
+			  auto hu = [&](Eigen::Vector3i const &v) {
+				bool const in_volume = (v.array() >= 0).all() && v.x() < width && v.y() < height && v.z() < layers;
+				return in_volume ? static_cast<float>(hu_values[v.x() + static_cast<size_t>(v.y()) * width
+					+ v.z() * slice_size])
+								 : -1000.0f;
+			  };
+			  float const hu_a = hu(va);
+			  float const hu_b = hu(vb);
+			  if ((hu_a >= threshold) != (hu_b >= threshold)) {
+				t = (threshold - hu_a) / (hu_b - hu_a);
+			  }
+			}
+			sum += corner_a;
+			sum[axis] += t;
+			++crossings;
+		  }
+		}
+		mesh.vertices[next] = sum / static_cast<float>(crossings);
+		current[cell_index(i, j)] = next++;
+	  }
+	}
+	if (layer > 0) {
+	  const uint8_t *const previous_masks = current_masks - layer_cells;
+	  uint32_t previous_next = layer_offsets[layer - 1];
+	  for (size_t c = 0; c < layer_cells; ++c) {
+		if (active(previous_masks[c])) {
+		  previous[c] = previous_next++;
+		}
+	  }
+	}
+
+	// Quad q0..q3 is counter-clockwise seen from the positive axis direction
+	std::vector<uint32_t> &indices = layer_indices[layer];
+	auto emit = [&indices](bool outwards, uint32_t q0, uint32_t q1, uint32_t q2, uint32_t q3) {
+	  if (outwards) {
+		indices.insert(indices.end(), {q0, q1, q2, q0, q2, q3});
+	  } else {
+		indices.insert(indices.end(), {q0, q2, q1, q0, q3, q2});
+	  }
+	};
+	auto cell = [&](std::vector<uint32_t> const &grid, int i, int j) { return grid[cell_index(i, j)]; };
+	// Edges along z between the voxel layers k and k + 1, i.e. corners 0 and 4 of cell (x, y, k)
+	for (int y = y0; y <= y1; ++y) {
+	  for (int x = x0; x <= x1; ++x) {
+		int const mask = current_masks[cell_index(x, y)];
+		bool const a = mask & 1;
+		if (a != static_cast<bool>(mask & 16)) {
+		  emit(a, cell(current, x - 1, y - 1), cell(current, x, y - 1), cell(current, x, y), cell(current, x - 1, y));
+		}
+	  }
+	}
+	if (k < z0 || k > z1) {
+	  return;
+	}
+	// Edges along x and y in voxel layer k, i.e. corners 0 and 1 or 0 and 2 of cell (x, y, k)
+	for (int y = y0 - 1; y <= y1; ++y) {
+	  for (int x = x0 - 1; x <= x1; ++x) {
+		int const mask = current_masks[cell_index(x, y)];
+		bool const a = mask & 1;
+		if (y >= y0 && a != static_cast<bool>(mask & 2)) {
+		  emit(a, cell(previous, x, y - 1), cell(previous, x, y), cell(current, x, y), cell(current, x, y - 1));
+		}
+		if (x >= x0 && a != static_cast<bool>(mask & 4)) {
+		  emit(a, cell(previous, x - 1, y), cell(current, x - 1, y), cell(current, x, y), cell(previous, x, y));
+		}
+	  }
+	}
+  });
+
+  size_t index_count = 0;
+  for (auto const &indices : layer_indices) {
+	index_count += indices.size();
+  }
+  mesh.indices.reserve(index_count);
+  for (auto const &indices : layer_indices) {
+	mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+  }
+
+  // Triangles of neighbouring layers share vertices, so the normals are accumulated sequentially
+  mesh.normals.assign(mesh.vertices.size(), Eigen::Vector3f::Zero());
+  for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+	uint32_t const a = mesh.indices[3 * t];
+	uint32_t const b = mesh.indices[3 * t + 1];
+	uint32_t const c = mesh.indices[3 * t + 2];
+	Eigen::Vector3f const face = (mesh.vertices[b] - mesh.vertices[a]).cross(mesh.vertices[c] - mesh.vertices[a]);
+	mesh.normals[a] += face;
+	mesh.normals[b] += face;
+	mesh.normals[c] += face;
+  }
+  int const block = 4096;
+  utils::ParallelFor(0, static_cast<int>((mesh.normals.size() + block - 1) / block), [&](int b) {
+	size_t const end = std::min(mesh.normals.size(), static_cast<size_t>(b + 1) * block);
+	for (size_t v = static_cast<size_t>(b) * block; v < end; ++v) {
+	  mesh.normals[v].normalize();
+	}
+  });
+  return Status(StatusCode::OK);
+}
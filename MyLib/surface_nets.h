@@ -0,0 +1,26 @@
+#ifndef SURFACE_NETS_H
+#define SURFACE_NETS_H
+
+#include "MyLib_global.h"
+#include "status.h"
+#include "triangle_mesh.h"
+
+#include <cstdint>
+
+/**
+ * @brief Extracts the boundary of a labelled region as a closed, indexed triangle mesh (surface nets)
+ * @details The cells of the dual grid connect eight neighbouring voxel centers. Every cell whose corners are partly
+ * inside the region gets exactly one vertex, placed at the mean of the crossings on its edges, so vertices are shared
+ * by construction and never need to be merged. Every voxel edge that leaves the region produces a quad of the four
+ * cells around it, split into two triangles wound counter-clockwise seen from outside.
+ * The extraction is restricted to the bounding box of the region and runs one cell layer per thread. The vertices of
+ * a layer are numbered after all vertices of the previous layers, so the result does not depend on the thread count.
+ */
+class MYLIB_EXPORT SurfaceNets {
+ public:
+  /// Extracts the surface of the voxels with the given label from a linear x-fastest label volume
+  static Status Extract(const int *labels, int width, int height, int layers, int label, const int16_t *hu_values,
+						int threshold, TriangleMesh &mesh);
+};
+
+#endif  // SURFACE_NETS_H
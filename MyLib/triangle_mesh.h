@@ -0,0 +1,27 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Indexed triangle mesh
+ * @details Every vertex is stored once and referenced by the triangles through its index. Vertex positions are in
+ * voxel coordinates. Eigen's fixed-size float vectors of three elements are not padded, so the vertex and normal
+ * arrays are tightly packed and can be written out as they are.
+ */
+struct TriangleMesh {
+  /// Vertex positions
+  std::vector<Eigen::Vector3f> vertices;
+  /// Unit vertex normals, either empty or one per vertex
+  std::vector<Eigen::Vector3f> normals;
+  /// Three vertex indices per triangle, counter-clockwise seen from outside
+  std::vector<uint32_t> indices;
+
+  /// @return Number of triangles
+  [[nodiscard]] size_t TriangleCount() const { return indices.size() / 3; }
+};
+
+#endif  // TRIANGLE_MESH_H
@@ -0,0 +1,43 @@
+#include "voxel_kernels.h"
+
+namespace voxel_kernels {
+namespace {
+template<typename VoxelT, int N>
+void GrowRegionErased(const void *voxels, int width, int height, int layers, Eigen::Vector3i const &seed,
+					  double threshold, int *labels) {
+  GrowRegion<VoxelT, N>(static_cast<const VoxelT *>(voxels), width, height, layers, seed, threshold, labels);
+}
+
+template<typename VoxelT>
+RegionGrowingKernel SelectConnectivity(Connectivity const connectivity) {
+  switch (connectivity) {
+	case Connectivity::EDGES:
+	  return &GrowRegionErased<VoxelT, 18>;
+	case Connectivity::CORNERS:
+	  return &GrowRegionErased<VoxelT, 26>;
+	default:
+	  return &GrowRegionErased<VoxelT, 6>;
+  }
+}
+}  // namespace
+
+/**
+ * @details All twelve instantiations are compiled here, so the choice costs one switch per call of this function and
+ * nothing per voxel.
+ * @param type Voxel type of the volume
+ * @param connectivity Neighbourhood the region grows over
+ * @return The kernel, which takes the voxels as a pointer to the given type
+ */
+RegionGrowingKernel SelectRegionGrowing(VoxelType const type, Connectivity const connectivity) {
+  switch (type) {
+	case VoxelType::UINT8:
+	  return SelectConnectivity<uint8_t>(connectivity);
+	case VoxelType::UINT16:
+	  return SelectConnectivity<uint16_t>(connectivity);
+	case VoxelType::FLOAT:
+	  return SelectConnectivity<float>(connectivity);
+	default:
+	  return SelectConnectivity<int16_t>(connectivity);
+  }
+}
+}  // namespace voxel_kernels
@@ -0,0 +1,184 @@
+#ifndef VOXEL_KERNELS_H
+#define VOXEL_KERNELS_H
+
+#include "MyLib_global.h"
+#include "Eigen/Core"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Neighbourhood of a voxel that region growing follows
+ */
+enum class Connectivity {
+  /// The 6 voxels that share a face
+  FACES = 6,
+  /// Also the 12 voxels that share an edge, so diagonal structures in a plane stay connected
+  EDGES = 18,
+  /// Also the 8 voxels that share a corner, so thin vessels running in any direction stay connected
+  CORNERS = 26
+};
+
+/**
+ * @brief Voxel types the kernels are compiled for
+ */
+enum class VoxelType {
+  UINT8,
+  INT16,
+  UINT16,
+  FLOAT
+};
+
+/**
+ * @brief Voxel kernels that are compiled once per voxel type and connectivity
+ * @details The neighbourhoods are compile-time tables, so the neighbour loops of a kernel have a constant trip count
+ * that the compiler unrolls, and interior voxels reach their neighbours through linear offsets without any bounds
+ * checks. Only voxels on the border of the volume take a checked path. Callers that know their voxel type call the
+ * templates directly; callers that only know it at runtime select an instantiation once with SelectRegionGrowing().
+ */
+namespace voxel_kernels {
+/// Step from a voxel to one of its neighbours
+struct NeighborStep {
+  int dx;
+  int dy;
+  int dz;
+};
+
+/// All 26 neighbours, the 6 face neighbours first, then the 12 edge and the 8 corner neighbours, so the first
+/// N entries are the N-neighbourhood
+constexpr NeighborStep kNeighborSteps[26] = {
+	{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1},
+	{-1, -1, 0}, {1, -1, 0}, {-1, 1, 0}, {1, 1, 0}, {-1, 0, -1}, {1, 0, -1},
+	{-1, 0, 1}, {1, 0, 1}, {0, -1, -1}, {0, 1, -1}, {0, -1, 1}, {0, 1, 1},
+	{-1, -1, -1}, {1, -1, -1}, {-1, 1, -1}, {1, 1, -1}, {-1, -1, 1}, {1, -1, 1}, {-1, 1, 1}, {1, 1, 1}};
+
+/// Label of a voxel that has not been visited
+constexpr int kUnvisited = 0;
+/// Label of a voxel that belongs to the region
+constexpr int kRegion = 1;
+/// Label of a voxel that has been visited but lies below the threshold
+constexpr int kVisited = 2;
+
+/// Linear offsets of the N-neighbourhood in a volume of the given width and height
+template<int N>
+std::array<int64_t, N> LinearOffsets(int const width, int const height) {
+  static_assert(N == 6 || N == 18 || N == 26, "Neighbourhoods have 6, 18 or 26 voxels");
+  std::array<int64_t, N> offsets{};
+  for (int i = 0; i < N; ++i) {
+	offsets[i] = kNeighborSteps[i].dx + static_cast<int64_t>(kNeighborSteps[i].dy) * width
+	  + static_cast<int64_t>(kNeighborSteps[i].dz) * width * height;
+  }
+  return offsets;
+}
+
+/// Lowest voxel value that reaches a threshold; false if no value of the voxel type reaches it
+template<typename VoxelT>
+bool ThresholdLevel(double const threshold, VoxelT &level) {
+  if (std::is_floating_point<VoxelT>::value) {
+	level = static_cast<VoxelT>(threshold);
+	return true;
+  }
+  double const lowest = std::ceil(threshold);
+  if (lowest > static_cast<double>(std::numeric_limits<VoxelT>::max())) {
+	return false;
+  }
+  level = lowest < static_cast<double>(std::numeric_limits<VoxelT>::lowest())
+		  ? std::numeric_limits<VoxelT>::lowest() : static_cast<VoxelT>(lowest);
+  return true;
+}
+
+/**
+ * GrowRegion() for voxels in any layout. read(index, x, y, z) returns the value of voxel (x, y, z), whose linear
+ * index in the labels is index; a flat volume reads it by the index, a bricked one by the coordinates.
+ */
+template<typename VoxelT, int N, typename VoxelRead>
+void GrowRegionWith(VoxelRead const &read, int const width, int const height, int const layers,
+					Eigen::Vector3i const &seed, double const threshold, int *labels) {
+  if ((seed.array() < 0).any() || seed.x() >= width || seed.y() >= height || seed.z() >= layers) {
+	return;
+  }
+  int64_t const slice = static_cast<int64_t>(width) * height;
+  std::array<int64_t, N> const offsets = LinearOffsets<N>(width, height);
+  VoxelT level{};
+  bool const reachable = ThresholdLevel(threshold, level);
+
+  std::vector<Eigen::Vector3i> stack{seed};
+  labels[seed.x() + seed.y() * width + seed.z() * slice] = kRegion;
+  auto visit = [&](int64_t const neighbor, int const x, int const y, int const z) {
+	if (labels[neighbor] != kUnvisited) {
+	  return;
+	}
+	if (reachable && read(neighbor, x, y, z) >= level) {
+	  labels[neighbor] = kRegion;
+	  stack.emplace_back(x, y, z);
+	} else {
+	  labels[neighbor] = kVisited;
+	}
+  };
+  while (!stack.empty()) {
+	Eigen::Vector3i const voxel = stack.back();
+	stack.pop_back();
+	int64_t const index = voxel.x() + voxel.y() * width + voxel.z() * slice;
+	bool const interior = voxel.x() > 0 && voxel.x() < width - 1 && voxel.y() > 0 && voxel.y() < height - 1
+	  && voxel.z() > 0 && voxel.z() < layers - 1;
+	if (interior) {
+	  for (int i = 0; i < N; ++i) {
+		visit(index + offsets[i], voxel.x() + kNeighborSteps[i].dx, voxel.y() + kNeighborSteps[i].dy,
+			  voxel.z() + kNeighborSteps[i].dz);
+	  }
+	} else {
+	  for (int i = 0; i < N; ++i) {
+		int const x = voxel.x() + kNeighborSteps[i].dx;
+		int const y = voxel.y() + kNeighborSteps[i].dy;
+		int const z = voxel.z() + kNeighborSteps[i].dz;
+		if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers) {
+		  visit(index + offsets[i], x, y, z);
+		}
+	  }
+	}
+  }
+}
+
+/**
+ * Grows a region from a seed over all N-connected voxels whose value is at least the threshold.
+ * The seed always belongs to the region. Labels must be kUnvisited on entry and are kRegion for the region and
+ * kVisited for its neighbours below the threshold afterwards; a seed outside the volume leaves them unchanged.
+ */
+template<typename VoxelT, int N>
+void GrowRegion(const VoxelT *voxels, int const width, int const height, int const layers,
+				Eigen::Vector3i const &seed, double const threshold, int *labels) {
+  GrowRegionWith<VoxelT, N>([voxels](int64_t const index, int, int, int) { return voxels[index]; }, width, height,
+							layers, seed, threshold, labels);
+}
+
+/**
+ * True if a region voxel has an N-neighbour outside the region. Voxels on the border of the volume are always
+ * surface voxels. The offsets come from LinearOffsets<N>() of the same volume.
+ */
+template<int N>
+bool IsSurfaceVoxel(const int *labels, int const width, int const height, int const layers, int const x, int const y,
+					int const z, std::array<int64_t, N> const &offsets) {
+  if (x == 0 || x == width - 1 || y == 0 || y == height - 1 || z == 0 || z == layers - 1) {
+	return true;
+  }
+  int64_t const index = x + y * static_cast<int64_t>(width) + z * static_cast<int64_t>(width) * height;
+  bool inside = true;
+  for (int i = 0; i < N; ++i) {
+	inside &= labels[index + offsets[i]] == kRegion;
+  }
+  return !inside;
+}
+
+/// GrowRegion() with the voxel type and connectivity chosen at runtime, see SelectRegionGrowing()
+using RegionGrowingKernel = void (*)(const void *voxels, int width, int height, int layers,
+									 Eigen::Vector3i const &seed, double threshold, int *labels);
+
+/// Selects the instantiation of GrowRegion() for a voxel type and a connectivity
+MYLIB_EXPORT RegionGrowingKernel SelectRegionGrowing(VoxelType type, Connectivity connectivity);
+}  // namespace voxel_kernels
+
+#endif  // VOXEL_KERNELS_H
@@ -1,10 +1,35 @@
+#include <QDir>
 #include <QString>
 #include <QtTest>
 #include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <tuple>
 
 #include "mylib.h"
+#include "binary_export.h"
+#include "bit_mask.h"
+#include "cine_series.h"
 #include "ct_dataset.h"
+#include "dicom_series.h"
+#include "distance_field.h"
+#include "kd_tree.h"
+#include "label_snapshot.h"
+#include "normal_volume.h"
+#include "parallel.h"
+#include "prefilter.h"
+#include "render_client.h"
+#include "render_server.h"
+#include "resampler.h"
+#include "slice_cache.h"
+#include "surface_clusters.h"
+#include "surface_nets.h"
+#include "voxel_kernels.h"
 
 class MyLibUnitTest : public QObject {
  Q_OBJECT
@@ -16,13 +41,298 @@ class MyLibUnitTest : public QObject {
   static void WindowingTest();
   static void FindNeighbours3DTest();
   static void EstimateRigidTransformationTest();
+  static void BrickedVolumeTest();
+  static void DepthRayLinearBenchmark();
+  static void DepthRayBrickedBenchmark();
+  static void RegionGrowingLinearBenchmark();
+  static void RegionGrowingBrickedBenchmark();
+  static void RotatedSamplingLinearBenchmark();
+  static void RotatedSamplingBrickedBenchmark();
+  static void WindowingLUTTest();
+  static void MultiplanarReformatTest();
+  static void SagittalSliceBenchmark();
+  static void ObliqueSliceBenchmark();
+  static void SliceCacheTest();
+  static void IntensityProjectionTest();
+  static void AxialProjectionBenchmark();
+  static void RotatedProjectionBenchmark();
+  static void VolumeRenderingTest();
+  static void VolumeRenderingBenchmark();
+  static void KdTreeTest();
+  static void IcpRegistrationTest();
+  static void IcpRegistrationBenchmark();
+  static void IdBufferPickingTest();
+  static void StatusOrTest();
+  static void NormalVolumeTest();
+  static void NormalVolumeBenchmark();
+  static void DistanceFieldTest();
+  static void DistanceFieldBenchmark();
+  static void TrajectoryPlanningTest();
+  static void TrajectoryPlanningBenchmark();
+  static void BinaryExportTest();
+  static void BinaryExportBenchmark();
+  static void SurfaceMeshTest();
+  static void SurfaceMeshBenchmark();
+  static void MorphologyTest();
+  static void MorphologyBenchmark();
+  static void PrefilterTest();
+  static void PrefilterBenchmark();
+  static void ResampleTest();
+  static void ResampleBenchmark();
+  static void ThreadPoolTest();
+  static void ThreadPoolBenchmark();
+  static void RegionHistoryTest();
+  static void RegionHistoryBenchmark();
+  static void CineSeriesTest();
+  static void CineSeriesBenchmark();
+  static void DicomImportTest();
+  static void DicomImportBenchmark();
+  static void RenderServerTest();
+  static void RenderServerBenchmark();
+  static void RegionConnectivityTest();
+  static void RegionConnectivityBenchmark();
+  static void GuardedBufferTest();
+  static void SurfaceClustersTest();
+  static void SurfaceClustersBenchmark();
+  static void TemporalReprojectionTest();
+  static void TemporalReprojectionBenchmark();
 };
 
+/**
+ Fills a volume with a synthetic phantom: air everywhere, a soft-tissue ellipsoid and a bony shell inside of it.
+ */
+static void FillPhantom(int16_t *data, int width, int height, int layers) {
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		double dx = (x - width / 2) / (0.4 * width);
+		double dy = (y - height / 2) / (0.4 * height);
+		double dz = (z - layers / 2) / (0.4 * layers);
+		double r = std::sqrt(dx * dx + dy * dy + dz * dz);
+		int16_t value = -1000;
+		if (r < 1.0) {
+		  value = (r > 0.8) ? 1200 : 40;
+		}
+		data[x + y * width + z * width * height] = value;
+	  }
+	}
+  }
+}
+
+/**
+ Fills the volume of a dataset with the phantom and grows the region above 0 HU from its center, i.e. the whole
+ ellipsoid up to the outside of its bony shell, a closed surface of about 300k points.
+ */
+static void GrowPhantomRegion(CTDataset &dataset) {
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  Eigen::Vector3i seed(256, 256, 128);
+  dataset.RegionGrowing3D(seed, 0);
+}
+
+/**
+ Fills the volume of a dataset with air and an 80 x 60 x 30 box of 500 HU at (220, 200, 100) and grows the region
+ above 300 HU from inside of the box. Returns the status of rebuilding the voxel layout; no region is grown if it fails.
+ */
+static Status GrowBoxRegion(CTDataset &dataset) {
+  int16_t *data = dataset.Data();
+  std::fill_n(data, 512 * 512 * 256, static_cast<int16_t>(-1000));
+  for (int z = 100; z < 130; ++z) {
+	for (int y = 200; y < 260; ++y) {
+	  std::fill_n(data + 220 + y * 512 + z * 512 * 512, 80, static_cast<int16_t>(500));
+	}
+  }
+  Status const status = dataset.RebuildVoxelLayout();
+  if (!status.Ok()) {
+	return status;
+  }
+  Eigen::Vector3i seed(250, 230, 115);
+  dataset.RegionGrowing3D(seed, 300);
+  return status;
+}
+
+/**
+ Grows a region from one end of a one voxel thin vessel that runs diagonally through a cube of the given voxel type,
+ along (1, 1, 0) or along (1, 1, 1). Returns the number of region voxels.
+ */
+template<typename VoxelT, int N>
+static int GrowAlongVessel(bool through_corners, double background) {
+  int const size = 12;
+  std::vector<VoxelT> voxels(size * size * size, static_cast<VoxelT>(background));
+  for (int i = 0; i < size; ++i) {
+	voxels[i + i * size + (through_corners ? i : 5) * size * size] = static_cast<VoxelT>(200);
+  }
+  std::vector<int> labels(voxels.size(), voxel_kernels::kUnvisited);
+  voxel_kernels::GrowRegion<VoxelT, N>(voxels.data(), size, size, size,
+									   Eigen::Vector3i(0, 0, through_corners ? 0 : 5), 100.0, labels.data());
+  return static_cast<int>(std::count(labels.begin(), labels.end(), voxel_kernels::kRegion));
+}
+
+/**
+ Samples points on the surface of an ellipsoid with three different semi-axes and a bump, so that the cloud has no
+ rotational symmetry near the identity.
+ */
+static std::vector<Eigen::Vector3d> SampleSurfacePoints(int count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<Eigen::Vector3d> points;
+  points.reserve(count);
+  for (int i = 0; i < count; ++i) {
+	Eigen::Vector3d direction(normal(rng), normal(rng), normal(rng));
+	direction.normalize();
+	double bump = 1.0 + 0.3 * std::exp(-20.0 * (direction - Eigen::Vector3d(0.6, 0.6, 0.5).normalized()).squaredNorm());
+	points.emplace_back(256.0 + 150.0 * bump * direction.x(), 256.0 + 100.0 * bump * direction.y(),
+						128.0 + 60.0 * bump * direction.z());
+  }
+  return points;
+}
+
+/**
+ Samples the volume along the rays of a view that is rotated by 30 degrees around x and y, which is the access
+ pattern of oblique reformats and rotated rendering. Such rays step along x and y as well, so the bricked layout saves
+ fewer slice jumps than it costs in offset table lookups and is not faster for them.
+ */
+template<typename VoxelAccessor>
+static int64_t SampleRotatedRays(VoxelAccessor const &voxel, int width, int height, int layers) {
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(M_PI / 6, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(M_PI / 6, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  Eigen::Vector3d center(width / 2, height / 2, layers / 2);
+  int64_t sum = 0;
+  for (int v = 0; v < height; v += 2) {
+	for (int u = 0; u < width; u += 2) {
+	  for (int w = 0; w < layers; ++w) {
+		Eigen::Vector3d p = rot * (Eigen::Vector3d(u, v, w) - center) + center;
+		int x = static_cast<int>(p.x());
+		int y = static_cast<int>(p.y());
+		int z = static_cast<int>(p.z());
+		if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers) {
+		  sum += voxel(x, y, z);
+		}
+	  }
+	}
+  }
+  return sum;
+}
+
 /**
  Test cases for CTDataset::windowing(...)
  HIER OBEN kurze Beschreibung des Testfalls in eigenen Worten einfügen, z.B. die
  erlaubten Grenzen einmal nennen
  */
+/**
+ Writes the phases of a synthetic 4D series: air with a dense box that moves along x from phase to phase.
+ */
+static std::vector<QString> WriteCinePhases(int phase_count) {
+  std::vector<QString> paths;
+  std::vector<int16_t> volume(512 * 512 * 256);
+  for (int phase = 0; phase < phase_count; ++phase) {
+	std::fill(volume.begin(), volume.end(), static_cast<int16_t>(-1000));
+	for (int z = 100; z < 130; ++z) {
+	  for (int y = 200; y < 260; ++y) {
+		std::fill_n(volume.begin() + 100 + 20 * phase + y * 512 + z * 512 * 512, 60, static_cast<int16_t>(800));
+	  }
+	}
+	paths.emplace_back(QString("cine_phase_") + QString::number(phase) + ".raw");
+	QFile file(paths.back());
+	if (!file.open(QIODevice::WriteOnly)) {
+	  return {};
+	}
+	file.write(reinterpret_cast<char const *>(volume.data()), static_cast<qint64>(volume.size() * sizeof(int16_t)));
+	file.close();
+  }
+  return paths;
+}
+
+/**
+ Appends one DICOM element in explicit or implicit VR little endian, padding the value to an even length.
+ */
+static void AppendDicomElement(std::string &bytes, uint32_t tag, char const *vr, std::string value, bool explicit_vr) {
+  auto append = [&bytes](uint32_t number, size_t size) { bytes.append(reinterpret_cast<char const *>(&number), size); };
+  if (value.size() % 2 != 0) {
+	value += (std::string(vr) == "UI") ? '\0' : ' ';
+  }
+  append(tag >> 16, 2);
+  append(tag & 0xFFFF, 2);
+  if (!explicit_vr) {
+	append(static_cast<uint32_t>(value.size()), 4);
+  } else if (std::string("OB OW SQ UN UT").find(vr) != std::string::npos) {
+	bytes.append(vr, 2);
+	append(0, 2);
+	append(static_cast<uint32_t>(value.size()), 4);
+  } else {
+	bytes.append(vr, 2);
+	append(static_cast<uint32_t>(value.size()), 2);
+  }
+  bytes += value;
+}
+
+/**
+ Writes an axial CT image as a DICOM Part 10 file with an undefined-length sequence and a private tag in its header.
+ */
+static bool WriteDicomSlice(QString const &path, bool explicit_vr, std::string const &series_uid, int instance,
+							double z_position, int columns, int rows, std::vector<uint16_t> const &pixels,
+							double intercept) {
+  auto u16 = [](uint16_t number) { return std::string(reinterpret_cast<char const *>(&number), 2); };
+  std::string bytes(128, '\0');
+  bytes += "DICM";
+  AppendDicomElement(bytes, 0x00020010, "UI", explicit_vr ? "1.2.840.10008.1.2.1" : "1.2.840.10008.1.2", true);
+  AppendDicomElement(bytes, 0x00080060, "CS", "CT", explicit_vr);
+  // Referenced image sequence of undefined length with one item of undefined length
+  std::string const sequence_start = explicit_vr ? std::string("\x08\x00\x40\x11SQ\0\0\xFF\xFF\xFF\xFF", 12)
+												 : std::string("\x08\x00\x40\x11\xFF\xFF\xFF\xFF", 8);
+  bytes += sequence_start;
+  bytes += std::string("\xFE\xFF\x00\xE0\xFF\xFF\xFF\xFF", 8);
+  AppendDicomElement(bytes, 0x00081150, "UI", "1.2.840.10008.5.1.4.1.1.2", explicit_vr);
+  bytes += std::string("\xFE\xFF\x0D\xE0\0\0\0\0", 8);
+  bytes += std::string("\xFE\xFF\xDD\xE0\0\0\0\0", 8);
+  AppendDicomElement(bytes, 0x00090010, "LO", "PRIVATE CREATOR", explicit_vr);
+  AppendDicomElement(bytes, 0x00180050, "DS", "2.5", explicit_vr);
+  AppendDicomElement(bytes, 0x0020000E, "UI", series_uid, explicit_vr);
+  AppendDicomElement(bytes, 0x00200013, "IS", std::to_string(instance), explicit_vr);
+  AppendDicomElement(bytes, 0x00200032, "DS", "-120.5\\-80\\" + std::to_string(z_position), explicit_vr);
+  AppendDicomElement(bytes, 0x00200037, "DS", "1\\0\\0\\0\\1\\0", explicit_vr);
+  AppendDicomElement(bytes, 0x00280002, "US", u16(1), explicit_vr);
+  AppendDicomElement(bytes, 0x00280010, "US", u16(static_cast<uint16_t>(rows)), explicit_vr);
+  AppendDicomElement(bytes, 0x00280011, "US", u16(static_cast<uint16_t>(columns)), explicit_vr);
+  AppendDicomElement(bytes, 0x00280030, "DS", "0.7\\0.6", explicit_vr);
+  AppendDicomElement(bytes, 0x00280100, "US", u16(16), explicit_vr);
+  AppendDicomElement(bytes, 0x00280103, "US", u16(0), explicit_vr);
+  AppendDicomElement(bytes, 0x00281052, "DS", std::to_string(intercept), explicit_vr);
+  AppendDicomElement(bytes, 0x00281053, "DS", "1", explicit_vr);
+  AppendDicomElement(bytes, 0x7FE00010, "OW",
+					 std::string(reinterpret_cast<char const *>(pixels.data()), pixels.size() * sizeof(uint16_t)),
+					 explicit_vr);
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+	return false;
+  }
+  bool const written = file.write(bytes.data(), static_cast<qint64>(bytes.size())) == static_cast<qint64>(bytes.size());
+  file.close();
+  return written;
+}
+
+/**
+ Writes a DICOM series of a ball of bone (1000 HU) in air (-1000 HU) around the center of the volume.
+ */
+static bool WriteDicomBall(QString const &directory, int size, int slices) {
+  if (!QDir().mkpath(directory)) {
+	return false;
+  }
+  std::vector<uint16_t> pixels(size * size);
+  for (int z = 0; z < slices; ++z) {
+	for (int y = 0; y < size; ++y) {
+	  for (int x = 0; x < size; ++x) {
+		Eigen::Vector3d const offset(x - size / 2, y - size / 2, z - slices / 2);
+		pixels[x + y * size] = offset.norm() < size / 4 ? 2024 : 24;
+	  }
+	}
+	if (!WriteDicomSlice(directory + "/slice_" + QString::number(z) + ".dcm", true, "1.2.3.7", z, z, size, size,
+						 pixels, -1024)) {
+	  return false;
+	}
+  }
+  return true;
+}
+
 void MyLibUnitTest::WindowingTest() {
   StatusCode retCode = StatusCode::OK;
 
@@ -113,6 +423,2322 @@ void MyLibUnitTest::EstimateRigidTransformationTest() {
   QVERIFY2(transformed_2 == target.at(2), "Source not translated correctly");
 }
 
+/**
+ Test cases for BrickedVolume: every voxel of a volume whose dimensions are not multiples of the brick edge must be
+ read back unchanged, and the bricked depth rays must produce the same depth buffer as the linear ones.
+ */
+void MyLibUnitTest::BrickedVolumeTest() {
+  int const width = 37;
+  int const height = 21;
+  int const layers = 13;
+  std::vector<int16_t> linear(width * height * layers);
+  for (size_t i = 0; i < linear.size(); ++i) {
+	linear[i] = static_cast<int16_t>((i * 7919) % 4096 - 1024);
+  }
+
+  BrickedVolume bricked;
+  QVERIFY2(bricked.Build(linear.data(), width, height, layers).Ok(), "Bricked volume could not be built");
+  QVERIFY2(bricked.BrickCount() >= 5 * 3 * 2, "Too few bricks allocated");
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		QVERIFY2(bricked.At(x, y, z) == linear[x + y * width + z * width * height],
+				 qPrintable(QString("Voxel (%1, %2, %3) differs").arg(x).arg(y).arg(z)));
+	  }
+	}
+  }
+
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  std::vector<int> linear_depth(512 * 512);
+  dataset.GetDepthBuffer().CopyTo(linear_depth.data());
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  std::vector<int> bricked_depth(512 * 512);
+  dataset.GetDepthBuffer().CopyTo(bricked_depth.data());
+  QVERIFY2(linear_depth == bricked_depth, "Bricked depth buffer differs from the linear one");
+
+  // Region growing reads the bricked copy as well and finds the same region
+  Eigen::Vector3i seed(256, 256, 128);
+  for (auto connectivity : {Connectivity::FACES, Connectivity::CORNERS}) {
+	dataset.SetRegionConnectivity(connectivity);
+	QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+	dataset.RegionGrowing3D(seed, 0);
+	std::vector<Eigen::Vector3i> const bricked_surface = dataset.ExtractSurfacePoints().value();
+	QVERIFY(dataset.SetVoxelLayout(VoxelLayout::LINEAR).Ok());
+	dataset.RegionGrowing3D(seed, 0);
+	QVERIFY2(!bricked_surface.empty() && dataset.ExtractSurfacePoints().value() == bricked_surface,
+			 "Bricked region growing differs from the linear one");
+  }
+}
+
+/**
+ Benchmarks for the voxel layouts. Run with "-perf -perfcounter cache-misses" (Linux) to compare the cache misses
+ instead of the wall time.
+ Depth rays walk along z, i.e. one slice (512 KiB) per step in the linear layout.
+ */
+void MyLibUnitTest::DepthRayLinearBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QBENCHMARK {
+	QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  }
+}
+
+void MyLibUnitTest::DepthRayBrickedBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  QBENCHMARK {
+	QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  }
+}
+
+/**
+ Region growing visits the neighbours along z of every region voxel, which are one slice apart in the linear layout.
+ Its labels are linear in both layouts, so the bricked layout only changes the voxel reads and takes about as long.
+ */
+void MyLibUnitTest::RegionGrowingLinearBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  Eigen::Vector3i seed(256, 256, 128);
+  QBENCHMARK {
+	dataset.RegionGrowing3D(seed, 0);
+  }
+}
+
+void MyLibUnitTest::RegionGrowingBrickedBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  Eigen::Vector3i seed(256, 256, 128);
+  QBENCHMARK {
+	dataset.RegionGrowing3D(seed, 0);
+  }
+}
+
+void MyLibUnitTest::RotatedSamplingLinearBenchmark() {
+  std::vector<int16_t> linear(512 * 512 * 256);
+  FillPhantom(linear.data(), 512, 512, 256);
+  LinearVoxelAccessor voxel{linear.data(), 512, 512 * 512};
+  int64_t sum = 0;
+  QBENCHMARK {
+	sum = SampleRotatedRays(voxel, 512, 512, 256);
+  }
+  QVERIFY(sum != 0);
+}
+
+void MyLibUnitTest::RotatedSamplingBrickedBenchmark() {
+  std::vector<int16_t> linear(512 * 512 * 256);
+  FillPhantom(linear.data(), 512, 512, 256);
+  BrickedVolume bricked;
+  QVERIFY(bricked.Build(linear.data(), 512, 512, 256).Ok());
+  BrickedVoxelAccessor voxel{&bricked};
+  int64_t sum = 0;
+  QBENCHMARK {
+	sum = SampleRotatedRays(voxel, 512, 512, 256);
+  }
+  QVERIFY(sum != 0);
+}
+
+void MyLibUnitTest::WindowingLUTTest() {
+  std::vector<uint8_t> lut;
+  QVERIFY2(CTDataset::CreateWindowingLUT(40, 400, lut).Ok(), "returns an error although input is valid");
+  for (int hu = -1024; hu <= 3071; ++hu) {
+	QVERIFY2(lut[hu + 1024] == CTDataset::WindowInputValue(hu, 40, 400).value(),
+			 qPrintable(QString("LUT differs from WindowInputValue at %1 HU").arg(hu)));
+  }
+
+  std::vector<int16_t> input = {-2000, -1024, 40, 3071, 4000};
+  std::vector<uint8_t> output(input.size());
+  CTDataset::ApplyWindowingLUT(input.data(), static_cast<int>(input.size()), lut, output.data());
+  QVERIFY2(output[0] == 0 && output[1] == 0 && output[3] == 255 && output[4] == 255,
+		   "Out-of-range HU values are not clamped");
+  QVERIFY2(output[2] == 128, "windowing function medium value");
+
+  QVERIFY2(CTDataset::CreateWindowingLUT(4000, 400, lut).code() == StatusCode::CENTER_OUT_OF_RANGE,
+		   "No error code returned although center value was > 3071");
+}
+
+/**
+ Test cases for the multiplanar reformat: axis-aligned slices are exact copies of the volume, oblique slices of a
+ linear ramp are exact up to rounding because trilinear interpolation reproduces linear functions.
+ */
+void MyLibUnitTest::MultiplanarReformatTest() {
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  for (int z = 0; z < 256; ++z) {
+	for (int y = 0; y < 512; ++y) {
+	  for (int x = 0; x < 512; ++x) {
+		data[x + y * 512 + z * 512 * 512] = static_cast<int16_t>(x + 2 * y + 3 * z - 1024);
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+
+  for (auto layout : {VoxelLayout::LINEAR, VoxelLayout::BRICKED}) {
+	QVERIFY(dataset.SetVoxelLayout(layout).Ok());
+	std::vector<int16_t> slice;
+
+	SlicePlane coronal = dataset.GetSlicePlane(SliceOrientation::CORONAL, 100);
+	QVERIFY(dataset.ExtractSlice(coronal, slice).Ok());
+	QVERIFY2(coronal.width == 512 && coronal.height == 256, "Wrong coronal slice size");
+	QVERIFY2(slice[7 + 200 * 512] == data[7 + 100 * 512 + 200 * 512 * 512], "Coronal slice differs");
+
+	SlicePlane sagittal = dataset.GetSlicePlane(SliceOrientation::SAGITTAL, 300);
+	QVERIFY(dataset.ExtractSlice(sagittal, slice).Ok());
+	QVERIFY2(sagittal.width == 512 && sagittal.height == 256, "Wrong sagittal slice size");
+	QVERIFY2(slice[50 + 60 * 512] == data[300 + 50 * 512 + 60 * 512 * 512], "Sagittal slice differs");
+
+	int center_index = dataset.GetSliceCount(SliceOrientation::OBLIQUE) / 2;
+	SlicePlane axial_like = dataset.GetSlicePlane(SliceOrientation::OBLIQUE, center_index);
+	QVERIFY(dataset.ExtractSlice(axial_like, slice).Ok());
+	QVERIFY2(std::equal(slice.begin(), slice.end(), data + 128 * 512 * 512),
+			 "Unrotated oblique slice differs from the axial slice through the center");
+
+	Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitX())
+	  * Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitY())).toRotationMatrix();
+	SlicePlane oblique = dataset.GetSlicePlane(SliceOrientation::OBLIQUE, center_index, rot);
+	QVERIFY(dataset.ExtractSlice(oblique, slice).Ok());
+	for (int v = 0; v < oblique.height; v += 17) {
+	  for (int u = 0; u < oblique.width; u += 13) {
+		Eigen::Vector3d p = oblique.origin + oblique.axis_u * u + oblique.axis_v * v;
+		if ((p.array() < 0).any() || p.x() > 511 || p.y() > 511 || p.z() > 255) {
+		  QVERIFY2(slice[u + v * oblique.width] == -1024, "Samples outside of the volume must be air");
+		  continue;
+		}
+		double expected = p.x() + 2 * p.y() + 3 * p.z() - 1024;
+		QVERIFY2(std::abs(slice[u + v * oblique.width] - expected) <= 1.0,
+				 qPrintable(QString("Oblique sample (%1, %2) is off").arg(u).arg(v)));
+	  }
+	}
+  }
+}
+
+void MyLibUnitTest::SagittalSliceBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  std::vector<int16_t> slice;
+  QBENCHMARK {
+	for (int x = 0; x < 512; x += 32) {
+	  QVERIFY(dataset.ExtractSlice(dataset.GetSlicePlane(SliceOrientation::SAGITTAL, x), slice).Ok());
+	}
+  }
+}
+
+void MyLibUnitTest::ObliqueSliceBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  std::vector<int16_t> slice;
+  int count = dataset.GetSliceCount(SliceOrientation::OBLIQUE);
+  QBENCHMARK {
+	for (int i = count / 4; i < 3 * count / 4; i += count / 32) {
+	  QVERIFY(dataset.ExtractSlice(dataset.GetSlicePlane(SliceOrientation::OBLIQUE, i, rot), slice).Ok());
+	}
+  }
+}
+
+/**
+ Test cases for SliceCache: cached slices must match freshly windowed ones, scrolling must be served by the prefetch
+ thread and a new window setting must drop the cached slices.
+ */
+void MyLibUnitTest::SliceCacheTest() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  SliceCache cache(dataset, 16, 4);
+  std::shared_ptr<const WindowedSlice> slice;
+
+  QVERIFY(cache.GetSlice(SliceOrientation::AXIAL, 100, 40, 400, slice).Ok());
+  QVERIFY2(cache.Misses() == 1, "First slice cannot be cached");
+  cache.WaitForPrefetch();
+
+  for (int index = 101; index <= 105; ++index) {
+	QVERIFY(cache.GetSlice(SliceOrientation::AXIAL, index, 40, 400, slice).Ok());
+	cache.WaitForPrefetch();
+  }
+  QVERIFY2(cache.Hits() == 5 && cache.Misses() == 1, "Slices ahead of the current one were not prefetched");
+
+  std::vector<uint8_t> lut;
+  QVERIFY(CTDataset::CreateWindowingLUT(40, 400, lut).Ok());
+  std::vector<uint8_t> expected(512 * 512);
+  CTDataset::ApplyWindowingLUT(dataset.Data() + 105 * 512 * 512, 512 * 512, lut, expected.data());
+  QVERIFY2(slice->grey_values == expected, "Cached slice differs from the windowed slice");
+
+  QVERIFY(cache.GetSlice(SliceOrientation::AXIAL, 105, 50, 400, slice).Ok());
+  QVERIFY2(cache.Misses() == 2, "Changing the window did not invalidate the cache");
+
+  QVERIFY2(cache.GetSlice(SliceOrientation::CORONAL, 512, 50, 400, slice).code() == StatusCode::SLICE_OUT_OF_RANGE,
+		   "No error code returned although the slice index was out of range");
+  QVERIFY2(cache.GetSlice(SliceOrientation::AXIAL, 0, 50, 0, slice).code() == StatusCode::WIDTH_OUT_OF_RANGE,
+		   "No error code returned although window size was < 1");
+}
+
+/**
+ Test cases for the intensity projections: compare against brute-force reductions along the rays and check that a
+ (numerically) unrotated ray-cast projection matches the streaming axial projection.
+ */
+void MyLibUnitTest::IntensityProjectionTest() {
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  for (int i = 0; i < 512 * 512 * 256; ++i) {
+	data[i] = static_cast<int16_t>((i * 2654435761u) % 4096 - 1024);
+  }
+
+  std::vector<int16_t> projection;
+  int width = 0;
+  int height = 0;
+  auto brute_force = [&](ProjectionMode mode, int x0, int y0, int z0, int dx, int dy, int dz, int length) {
+	int64_t sum = 0;
+	int result = (mode == ProjectionMode::MINIMUM) ? INT16_MAX : INT16_MIN;
+	for (int i = 0; i < length; ++i) {
+	  int value = data[(x0 + i * dx) + (y0 + i * dy) * 512 + (z0 + i * dz) * 512 * 512];
+	  result = (mode == ProjectionMode::MINIMUM) ? std::min(result, value) : std::max(result, value);
+	  sum += value;
+	}
+	return (mode == ProjectionMode::AVERAGE) ? static_cast<int>(sum / length) : result;
+  };
+
+  for (auto mode : {ProjectionMode::MAXIMUM, ProjectionMode::MINIMUM, ProjectionMode::AVERAGE}) {
+	QVERIFY(dataset.CalculateProjection(mode, SliceOrientation::AXIAL, projection, width, height).Ok());
+	QVERIFY2(width == 512 && height == 512, "Wrong axial projection size");
+	QVERIFY2(projection[17 + 33 * 512] == brute_force(mode, 17, 33, 0, 0, 0, 1, 256), "Axial projection differs");
+
+	QVERIFY(dataset.CalculateProjection(mode, SliceOrientation::CORONAL, projection, width, height).Ok());
+	QVERIFY2(width == 512 && height == 256, "Wrong coronal projection size");
+	QVERIFY2(projection[300 + 100 * 512] == brute_force(mode, 300, 0, 100, 0, 1, 0, 512),
+			 "Coronal projection differs");
+
+	QVERIFY(dataset.CalculateProjection(mode, SliceOrientation::SAGITTAL, projection, width, height).Ok());
+	QVERIFY2(width == 512 && height == 256, "Wrong sagittal projection size");
+	QVERIFY2(projection[211 + 5 * 512] == brute_force(mode, 0, 211, 5, 1, 0, 0, 512),
+			 "Sagittal projection differs");
+  }
+
+  std::vector<int16_t> axial;
+  QVERIFY(dataset.CalculateProjection(ProjectionMode::MAXIMUM, SliceOrientation::AXIAL, axial, width, height).Ok());
+  Eigen::Matrix3d almost_identity = Eigen::AngleAxisd(1e-9, Eigen::Vector3d::UnitX()).toRotationMatrix();
+  QVERIFY(dataset.CalculateRotatedProjection(ProjectionMode::MAXIMUM, almost_identity, projection).Ok());
+  QVERIFY2(projection == axial, "Ray-cast projection differs from the streaming axial projection");
+
+  QVERIFY2(dataset.CalculateProjection(ProjectionMode::MAXIMUM, SliceOrientation::OBLIQUE, projection, width,
+									   height).code() == StatusCode::SLICE_OUT_OF_RANGE,
+		   "No error code returned although the orientation was oblique");
+}
+
+void MyLibUnitTest::AxialProjectionBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  std::vector<int16_t> projection;
+  int width = 0;
+  int height = 0;
+  QBENCHMARK {
+	QVERIFY(dataset.CalculateProjection(ProjectionMode::MAXIMUM, SliceOrientation::AXIAL, projection, width,
+										height).Ok());
+  }
+}
+
+void MyLibUnitTest::RotatedProjectionBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  std::vector<int16_t> projection;
+  QBENCHMARK {
+	QVERIFY(dataset.CalculateRotatedProjection(ProjectionMode::MAXIMUM, rot, projection).Ok());
+  }
+}
+
+void MyLibUnitTest::VolumeRenderingTest() {
+  std::vector<TransferFunctionEntry> lut;
+  QVERIFY2(CTDataset::CreateTransferFunctionLUT({}, lut).code() == StatusCode::TRANSFER_FUNCTION_ERROR,
+		   "No error code returned although the transfer function was empty");
+  QVERIFY2(CTDataset::CreateTransferFunctionLUT({TransferFunctionPoint{500, 1, 1, 1, 1},
+												 TransferFunctionPoint{100, 1, 1, 1, 1}}, lut).code()
+			 == StatusCode::TRANSFER_FUNCTION_ERROR,
+		   "No error code returned although the control points were not sorted");
+  QVERIFY(CTDataset::CreateTransferFunctionLUT({TransferFunctionPoint{0, 0, 0, 0, 0},
+												TransferFunctionPoint{100, 1, 0.5f, 0, 1}}, lut).Ok());
+  QVERIFY2(lut.size() == 4096 && lut[0].opacity == 0.0f && lut[3071 + 1024].red == 1.0f,
+		   "Transfer function not clamped outside of the control points");
+  QVERIFY2(std::abs(lut[50 + 1024].green - 0.25f) < 1e-6f, "Transfer function not interpolated linearly");
+
+  CTDataset dataset;
+  std::vector<uint32_t> image;
+  QVERIFY(CTDataset::CreateTransferFunctionLUT(CTDataset::DefaultTransferFunction(), lut).Ok());
+  QVERIFY2(dataset.RenderVolume(lut, Eigen::Matrix3d::Identity(), image).code() == StatusCode::BUFFER_EMPTY,
+		   "No error code returned although the brick value ranges were not computed");
+
+  // A tiny bright cluster in the air must survive the empty space skipping
+  int16_t *data = dataset.Data();
+  FillPhantom(data, 512, 512, 256);
+  for (int z = 100; z < 102; ++z) {
+	for (int y = 20; y < 22; ++y) {
+	  for (int x = 20; x < 22; ++x) {
+		data[x + y * 512 + z * 512 * 512] = 2000;
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+
+  QVERIFY(dataset.RenderVolume(lut, Eigen::Matrix3d::Identity(), image).Ok());
+  QVERIFY2(image.size() == 512 * 512, "Wrong image size");
+  QVERIFY2(image[0] == 0xff000000u, "Air is not transparent");
+  QVERIFY2((image[256 + 256 * 512] & 0xffu) > 200, "Bone shell not rendered opaque and bright");
+  QVERIFY2((image[20 + 20 * 512] & 0xffu) > 200, "Small structure in empty space skipped");
+
+  std::vector<TransferFunctionEntry> transparent;
+  QVERIFY(CTDataset::CreateTransferFunctionLUT({TransferFunctionPoint{0, 1, 1, 1, 0}}, transparent).Ok());
+  QVERIFY(dataset.RenderVolume(transparent, Eigen::Matrix3d::Identity(), image).Ok());
+  QVERIFY2(std::all_of(image.begin(), image.end(), [](uint32_t pixel) { return pixel == 0xff000000u; }),
+		   "Transparent transfer function did not render black");
+
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.7, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(-0.3, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  std::vector<uint32_t> linear_image;
+  QVERIFY(dataset.RenderVolume(lut, rot, linear_image).Ok());
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  QVERIFY(dataset.RenderVolume(lut, rot, image).Ok());
+  QVERIFY2(image == linear_image, "Volume rendering differs between the voxel layouts");
+}
+
+void MyLibUnitTest::VolumeRenderingBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.SetVoxelLayout(VoxelLayout::BRICKED).Ok());
+  std::vector<TransferFunctionEntry> lut;
+  QVERIFY(CTDataset::CreateTransferFunctionLUT(CTDataset::DefaultTransferFunction(), lut).Ok());
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  std::vector<uint32_t> image;
+  QBENCHMARK {
+	QVERIFY(dataset.RenderVolume(lut, rot, image).Ok());
+  }
+}
+
+void MyLibUnitTest::KdTreeTest() {
+  KdTree tree;
+  QVERIFY2(tree.Build({}).code() == StatusCode::BUFFER_EMPTY, "No error code returned although the cloud was empty");
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> coordinate(0.0, 100.0);
+  for (int count : {1, 9, 1000, 20000}) {
+	std::vector<Eigen::Vector3d> points(count);
+	for (auto &p : points) {
+	  p = Eigen::Vector3d(coordinate(rng), coordinate(rng), std::floor(coordinate(rng) / 10.0));
+	}
+	QVERIFY(tree.Build(points).Ok());
+	QVERIFY2(tree.Size() == count, "Wrong tree size");
+
+	std::vector<Eigen::Vector3d> queries(500);
+	for (auto &q : queries) {
+	  q = Eigen::Vector3d(coordinate(rng) * 1.2 - 10.0, coordinate(rng) * 1.2 - 10.0, coordinate(rng) / 10.0);
+	}
+	std::vector<int> indices;
+	std::vector<double> distances;
+	tree.FindNearest(queries, indices, distances);
+	for (size_t i = 0; i < queries.size(); ++i) {
+	  double best = std::numeric_limits<double>::max();
+	  for (auto const &p : points) {
+		best = std::min(best, (p - queries[i]).squaredNorm());
+	  }
+	  QVERIFY2(std::abs(distances[i] - best) < 1e-3 * (1.0 + best), "Nearest neighbour differs from brute force");
+	  QVERIFY2(std::abs((points[indices[i]] - queries[i]).squaredNorm() - distances[i]) < 1e-3 * (1.0 + best),
+			   "Returned index does not belong to the returned distance");
+	}
+
+	// A hint only changes where the search starts, whether it is the answer itself or any other point
+	std::uniform_int_distribution<int> any_point(0, count - 1);
+	for (bool exact : {true, false}) {
+	  std::vector<int> hinted = indices;
+	  if (!exact) {
+		for (auto &hint : hinted) {
+		  hint = any_point(rng);
+		}
+	  }
+	  std::vector<double> hinted_distances;
+	  tree.FindNearest(queries, hinted, hinted_distances, true);
+	  for (size_t i = 0; i < queries.size(); ++i) {
+		QVERIFY2(std::abs(hinted_distances[i] - distances[i]) < 1e-3 * (1.0 + distances[i]),
+				 "Hinted nearest neighbour differs from the unhinted one");
+	  }
+	}
+  }
+}
+
+void MyLibUnitTest::IcpRegistrationTest() {
+  std::vector<Eigen::Vector3d> target = SampleSurfacePoints(50000, 1);
+  Eigen::Isometry3d ground_truth = Eigen::Isometry3d::Identity();
+  ground_truth.rotate(Eigen::AngleAxisd(0.15, Eigen::Vector3d(1, 2, 3).normalized()));
+  ground_truth.pretranslate(Eigen::Vector3d(6, -4, 3));
+
+  // Different samples of the same surface, moved by the inverse transformation, plus 5 % outliers
+  std::vector<Eigen::Vector3d> source = SampleSurfacePoints(40000, 2);
+  for (auto &p : source) {
+	p = ground_truth.inverse() * p;
+  }
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> coordinate(0.0, 512.0);
+  for (int i = 0; i < 2000; ++i) {
+	source.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng) / 2.0);
+  }
+
+  IcpParameters parameters;
+  parameters.max_iterations = 100;
+  Eigen::Isometry3d transformation = Eigen::Isometry3d::Identity();
+  double rms_error = 0.0;
+  QVERIFY(MyLib::EstimateRigidTransformationICP(source, target, parameters, transformation, rms_error).Ok());
+  QVERIFY2((transformation.linear() - ground_truth.linear()).norm() < 5e-3, "Rotation not recovered");
+  QVERIFY2((transformation.translation() - ground_truth.translation()).norm() < 0.5, "Translation not recovered");
+  QVERIFY2(rms_error < 2.0, "RMS error too large after registration");
+
+  std::vector<Eigen::Vector3d> too_small = {Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(1, 0, 0)};
+  QVERIFY2(MyLib::EstimateRigidTransformationICP(too_small, target, parameters, transformation, rms_error).code()
+			 == StatusCode::REGISTRATION_ERROR,
+		   "No error code returned although the source cloud was too small");
+}
+
+void MyLibUnitTest::IcpRegistrationBenchmark() {
+  std::vector<Eigen::Vector3d> target = SampleSurfacePoints(2000000, 1);
+  std::vector<Eigen::Vector3d> source = SampleSurfacePoints(1000000, 2);
+  Eigen::Isometry3d offset = Eigen::Isometry3d::Identity();
+  offset.rotate(Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitZ()));
+  offset.pretranslate(Eigen::Vector3d(2, 1, -1));
+  for (auto &p : source) {
+	p = offset * p;
+  }
+  IcpParameters parameters;
+  QBENCHMARK {
+	Eigen::Isometry3d transformation = Eigen::Isometry3d::Identity();
+	double rms_error = 0.0;
+	QVERIFY(MyLib::EstimateRigidTransformationICP(source, target, parameters, transformation, rms_error).Ok());
+  }
+}
+
+void MyLibUnitTest::IdBufferPickingTest() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+
+  Eigen::Vector3i voxel;
+  QVERIFY(dataset.PickVoxel(256, 256, voxel).Ok());
+  QVERIFY2(voxel.x() == 256 && voxel.y() == 256 && voxel.z() == dataset.GetDepthBuffer()(256, 256),
+		   "Picked voxel does not match the depth buffer");
+  QVERIFY2(dataset.GetGreyValue(voxel) >= 300, "Picked voxel is not on the surface");
+  QVERIFY2(dataset.PickVoxel(0, 0, voxel).code() == StatusCode::BUFFER_EMPTY,
+		   "No error code returned although the pixel shows background");
+  QVERIFY2(dataset.PickVoxel(-1, 600, voxel).code() == StatusCode::BUFFER_EMPTY,
+		   "No error code returned although the pixel is outside of the image");
+
+  // Rotated splat rendering of a region: every picked voxel must project onto the pixel it was picked from
+  QVERIFY(GrowBoxRegion(dataset).Ok());
+  Eigen::Matrix3d rot = (Eigen::AngleAxisd(0.6, Eigen::Vector3d::UnitX())
+	* Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitY())).toRotationMatrix();
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rot).Ok());
+
+  // The rotation center is the barycenter of the region
+  Eigen::Vector3d center(259.5, 229.5, 114.5);
+  int picked = 0;
+  for (int y = 0; y < 512; y += 3) {
+	for (int x = 0; x < 512; x += 3) {
+	  if (!dataset.PickVoxel(x, y, voxel).Ok()) {
+		continue;
+	  }
+	  ++picked;
+	  QVERIFY2(dataset.GetGreyValue(voxel) == 500, "Picked voxel is not part of the region");
+	  Eigen::Vector3i projected = ((rot * (voxel.cast<double>() - center)) + center).cast<int>();
+	  QVERIFY2(std::abs(projected.x() - x) + std::abs(projected.y() - y) <= 1,
+			   "Picked voxel does not project onto the picked pixel");
+	}
+  }
+  QVERIFY2(picked > 100, "Too few pixels of the region were picked");
+
+  dataset.SetIdBufferEnabled(false);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rot).Ok());
+  std::vector<int> ids(512 * 512);
+  dataset.GetIdBuffer().CopyTo(ids.data());
+  QVERIFY2(std::all_of(ids.begin(), ids.end(), [](int id) { return id == -1; }),
+		   "ID buffer written although it was disabled");
+}
+
+void MyLibUnitTest::StatusOrTest() {
+  // Move-only payload
+  StatusOr<std::unique_ptr<int>> owned(std::unique_ptr<int>(new int(42)));
+  QVERIFY(owned.Ok());
+  std::unique_ptr<int> taken = std::move(owned).value();
+  QVERIFY2(taken && *taken == 42, "Move-only value not moved out");
+
+  // Payload without a default constructor
+  struct NoDefault {
+	explicit NoDefault(int v) : value(v) {}
+	int value;
+  };
+  StatusOr<NoDefault> error((Status(StatusCode::BUFFER_EMPTY)));
+  QVERIFY2(!error.Ok() && error.status().code() == StatusCode::BUFFER_EMPTY, "Error not held");
+  StatusOr<NoDefault> copied(NoDefault(7));
+  StatusOr<NoDefault> assigned = error;
+  assigned = copied;
+  QVERIFY2(assigned.Ok() && assigned.value().value == 7, "Copy assignment lost the value");
+
+  // Bulk results are moved, the buffer of the result is the buffer that was filled
+  StatusOr<std::vector<int>> bulk(std::vector<int>(1000, 3));
+  const int *buffer = bulk.value().data();
+  std::vector<int> moved = std::move(bulk).value();
+  QVERIFY2(moved.data() == buffer, "Bulk result was copied instead of moved");
+
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  SlicePlane plane = dataset.GetSlicePlane(SliceOrientation::CORONAL, 200);
+  std::vector<int16_t> expected;
+  QVERIFY(dataset.ExtractSlice(plane, expected).Ok());
+  auto slice = dataset.ExtractSlice(plane);
+  QVERIFY(slice.Ok());
+  QVERIFY2(slice.value() == expected, "By-value slice differs from the output parameter version");
+  plane.width = 0;
+  QVERIFY2(dataset.ExtractSlice(plane).status().code() == StatusCode::BUFFER_EMPTY,
+		   "No error code returned although the plane was empty");
+
+  Eigen::Matrix3d rot = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  std::vector<int16_t> expected_projection;
+  QVERIFY(dataset.CalculateRotatedProjection(ProjectionMode::MAXIMUM, rot, expected_projection).Ok());
+  auto projection = dataset.CalculateRotatedProjection(ProjectionMode::MAXIMUM, rot);
+  QVERIFY2(projection.Ok() && projection.value() == expected_projection,
+		   "By-value projection differs from the output parameter version");
+}
+
+void MyLibUnitTest::NormalVolumeTest() {
+  std::mt19937 rng(11);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  float max_error = 0.0f;
+  for (int i = 0; i < 100000; ++i) {
+	Eigen::Vector3f direction(normal(rng), normal(rng), normal(rng));
+	direction.normalize();
+	Eigen::Vector3f decoded;
+	NormalVolume::DecodeNormal(NormalVolume::EncodeNormal(direction.x(), direction.y(), direction.z()), decoded.x(),
+							   decoded.y(), decoded.z());
+	max_error = std::max(max_error, std::acos(std::min(1.0f, direction.dot(decoded))));
+  }
+  QVERIFY2(max_error < 2.0f * static_cast<float>(M_PI) / 180.0f, "Octahedral encoding error above two degrees");
+
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  QVERIFY(dataset.ComputeNormalVolume().Ok());
+  NormalVolume normals;
+  QVERIFY(normals.Build(dataset.Data(), 512, 512, 256).Ok());
+  for (int i = 0; i < 1000; ++i) {
+	int const x = (i * 37) % 512;
+	int const y = (i * 101) % 512;
+	int const z = (i * 13) % 256;
+	QVERIFY2(normals.At(x, y, z) == NormalVolume::ComputeNormal(dataset.Data(), 512, 512, 256, x, y, z),
+			 "Separable and direct gradient differ");
+  }
+
+  // Lit threshold rendering: the pole of the shell faces the viewer, the rim is seen at a grazing angle
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  QVERIFY(dataset.RenderDepthBuffer().Ok());
+  QVERIFY2(dataset.GetRenderedDepthBuffer()[256 + 256 * 512] > 245, "Surface facing the viewer is not bright");
+  QVERIFY2(dataset.GetRenderedDepthBuffer()[256 + 440 * 512] < dataset.GetRenderedDepthBuffer()[256 + 300 * 512],
+		   "Shading does not fall off towards the rim");
+
+  // Lit splat rendering of a region with normals of its surface points only
+  QVERIFY(GrowBoxRegion(dataset).Ok());
+  double const angle = 0.5;
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(
+	Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitY()).toRotationMatrix()).Ok());
+  QVERIFY(dataset.RenderDepthBuffer().Ok());
+  int const shade = dataset.GetRenderedDepthBuffer()[260 + 230 * 512];
+  QVERIFY2(std::abs(shade - 255.0 * std::cos(angle)) < 8.0, "Front face of the rotated region shaded incorrectly");
+}
+
+void MyLibUnitTest::NormalVolumeBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QBENCHMARK {
+	QVERIFY(dataset.ComputeNormalVolume().Ok());
+  }
+}
+
+void MyLibUnitTest::DistanceFieldTest() {
+  // Exactness against brute force on a small anisotropic volume with scattered features
+  int const width = 37;
+  int const height = 29;
+  int const layers = 23;
+  Eigen::Vector3d const spacing(0.523, 0.6, 0.7);
+  std::vector<int> labels(width * height * layers, 0);
+  DistanceField field;
+  QVERIFY2(field.Build(labels.data(), width, height, layers, 1, spacing).code() == StatusCode::BUFFER_EMPTY,
+		   "Volume without features accepted");
+
+  std::mt19937 rng(5);
+  std::vector<Eigen::Vector3d> features;
+  for (int i = 0; i < 40; ++i) {
+	int const x = static_cast<int>(rng() % width);
+	int const y = static_cast<int>(rng() % height);
+	int const z = static_cast<int>(rng() % layers);
+	labels[x + y * width + z * width * height] = 1;
+	features.emplace_back(x, y, z);
+  }
+  QVERIFY(field.Build(labels.data(), width, height, layers, 1, spacing).Ok());
+  double max_error = 0.0;
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		double expected = std::numeric_limits<double>::max();
+		for (auto const &feature : features) {
+		  expected = std::min(expected, (feature - Eigen::Vector3d(x, y, z)).cwiseProduct(spacing).norm());
+		}
+		max_error = std::max(max_error, std::abs(expected - field.At(x, y, z)));
+	  }
+	}
+  }
+  QVERIFY2(max_error < 1e-3, "Distance transform is not exact");
+  QVERIFY2(std::abs(field.DistanceAt(Eigen::Vector3d(3, 4, 5)) - field.At(3, 4, 5)) < 1e-6,
+		   "Point query at a voxel center differs from the field");
+  double const midpoint = field.DistanceAt(Eigen::Vector3d(3.5, 4, 5));
+  QVERIFY2(std::abs(midpoint - 0.5 * (field.At(3, 4, 5) + field.At(4, 4, 5))) < 1e-6, "Point query not interpolated");
+
+  // Margin of a point in front of a grown region, using the spacing of the dataset
+  CTDataset dataset;
+  QVERIFY(GrowBoxRegion(dataset).Ok());
+  QVERIFY(dataset.ComputeRegionDistanceField().Ok());
+  DistanceField const &region_distance = dataset.GetRegionDistanceField();
+  QVERIFY2(std::abs(region_distance.DistanceAt(Eigen::Vector3d(309, 230, 115)) - 10 * 0.523) < 1e-4,
+		   "Distance along x ignores the voxel spacing");
+  QVERIFY2(std::abs(region_distance.DistanceAt(Eigen::Vector3d(250, 230, 90)) - 10 * 0.7) < 1e-4,
+		   "Distance along z ignores the voxel spacing");
+  QVERIFY2(region_distance.At(250, 230, 115) == 0.0f, "Region voxel has a non-zero distance");
+}
+
+void MyLibUnitTest::DistanceFieldBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  std::vector<int> labels(512 * 512 * 256);
+  std::transform(dataset.Data(), dataset.Data() + labels.size(), labels.begin(),
+				 [](int16_t value) { return value > 300 ? 1 : 0; });
+  DistanceField field;
+  QBENCHMARK {
+	QVERIFY(field.Build(labels.data(), 512, 512, 256, 1, dataset.GetVoxelSpacing()).Ok());
+  }
+}
+
+void MyLibUnitTest::TrajectoryPlanningTest() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  TrajectoryParameters params;
+  Eigen::Vector3d const target(256, 256, 128);
+  QVERIFY2(dataset.PlanTrajectories(Eigen::Vector3d(-1, 0, 0), PlanningSphere{target, -1.0}, params).status().code()
+			 == StatusCode::PLANNING_ERROR, "Target outside the volume accepted");
+
+  // Without a safe zone, the shortest way out of the phantom is along z, through one bone layer
+  auto planned = dataset.PlanTrajectories(target, PlanningSphere{target, -1.0}, params);
+  QVERIFY(planned.Ok());
+  std::vector<Trajectory> trajectories = std::move(planned).value();
+  QVERIFY2(trajectories.size() > static_cast<size_t>(params.direction_count) / 2, "Too few valid trajectories");
+  for (auto const &trajectory : trajectories) {
+	QVERIFY2(trajectory.bone_crossings == 1, "Path does not cross the bone shell exactly once");
+	QVERIFY2(dataset.GetGreyValue((trajectory.entry.array() + 0.5).floor().cast<int>().matrix()) == -1000,
+			 "Entry point is not outside the body");
+  }
+  Trajectory const &best = trajectories.front();
+  QVERIFY2(std::abs(best.direction.z()) > 0.95, "Best path does not leave along z");
+  QVERIFY2(std::abs(best.length - 0.4 * 256 * 0.7) < 1.5, "Path length is wrong");
+
+  // A safe zone on the path towards +z leaves only the way towards -z
+  PlanningSphere const safe_zone{Eigen::Vector3d(256, 256, 190), 10.0};
+  QVERIFY(dataset.PlanTrajectories(target, safe_zone, params, trajectories).Ok());
+  QVERIFY2(!trajectories.empty() && trajectories.front().direction.z() < -0.95, "Best path enters the safe zone");
+  for (auto const &trajectory : trajectories) {
+	QVERIFY2(trajectory.clearance >= params.min_clearance, "Path too close to the safe zone");
+  }
+}
+
+void MyLibUnitTest::TrajectoryPlanningBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  PlanningSphere const safe_zone{Eigen::Vector3d(256, 256, 190), 10.0};
+  std::vector<Trajectory> trajectories;
+  QBENCHMARK {
+	QVERIFY(dataset.PlanTrajectories(Eigen::Vector3d(256, 256, 128), safe_zone, TrajectoryParameters(), trajectories)
+			  .Ok());
+  }
+}
+
+/// Reads a whole file into memory
+static std::string ReadFileBytes(char const *path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void MyLibUnitTest::BinaryExportTest() {
+  // Run-length encoded mask round trip, including runs at both ends of the volume
+  int const width = 61;
+  int const height = 47;
+  int const layers = 33;
+  std::vector<int> labels(width * height * layers, 0);
+  std::mt19937 rng(3);
+  for (int block = 0; block < 50; ++block) {
+	int const start = static_cast<int>(rng() % labels.size());
+	std::fill(labels.begin() + start, labels.begin() + std::min(labels.size(), start + rng() % 5000), 1);
+	labels[rng() % labels.size()] = 2;
+  }
+  labels.back() = 1;
+  QVERIFY(BinaryExport::WriteMaskRLE("export_test.rle", labels.data(), width, height, layers, 1).Ok());
+  int read_width = 0;
+  int read_height = 0;
+  int read_layers = 0;
+  std::vector<uint8_t> mask;
+  QVERIFY(BinaryExport::ReadMaskRLE("export_test.rle", read_width, read_height, read_layers, mask).Ok());
+  QVERIFY2(read_width == width && read_height == height && read_layers == layers, "Mask dimensions differ");
+  for (size_t i = 0; i < labels.size(); ++i) {
+	QVERIFY2(mask[i] == (labels[i] == 1 ? 1 : 0), "Mask differs after the round trip");
+  }
+  QVERIFY2(BinaryExport::ReadMaskRLE("export_test.ply", read_width, read_height, read_layers, mask).code()
+			 != StatusCode::OK, "Missing file accepted as a mask");
+
+  // Point cloud: the payload is the packed int32 coordinates
+  std::vector<Eigen::Vector3i> points;
+  for (int i = 0; i < 100000; ++i) {
+	points.emplace_back(i % 512, (i / 512) % 512, i / (512 * 512));
+  }
+  QVERIFY(BinaryExport::WritePointCloudPLY("export_test.ply", points, Eigen::Vector3d(0.523, 0.523, 0.7)).Ok());
+  std::string const point_file = ReadFileBytes("export_test.ply");
+  size_t const point_header_end = point_file.find("end_header\n") + std::string("end_header\n").size();
+  QVERIFY2(point_file.find("element vertex 100000\n") != std::string::npos, "Vertex count missing in the header");
+  QVERIFY2(point_file.size() - point_header_end == points.size() * 12
+			 && std::memcmp(point_file.data() + point_header_end, points.data(), points.size() * 12) == 0,
+		   "Point payload differs");
+
+  // Tetrahedron as PLY with normals and as STL
+  TriangleMesh mesh;
+  mesh.vertices = {Eigen::Vector3f(0, 0, 0), Eigen::Vector3f(1, 0, 0), Eigen::Vector3f(0, 1, 0),
+				   Eigen::Vector3f(0, 0, 1)};
+  for (auto const &vertex : mesh.vertices) {
+	mesh.normals.push_back((vertex - Eigen::Vector3f::Constant(0.25f)).normalized());
+  }
+  mesh.indices = {0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3};
+  QVERIFY(BinaryExport::WriteMeshPLY("export_test_mesh.ply", mesh, Eigen::Vector3d::Ones()).Ok());
+  std::string const mesh_file = ReadFileBytes("export_test_mesh.ply");
+  size_t const mesh_header_end = mesh_file.find("end_header\n") + std::string("end_header\n").size();
+  QVERIFY2(mesh_file.find("property float nx") != std::string::npos, "Normals missing in the header");
+  QVERIFY2(mesh_file.size() - mesh_header_end == 4 * 6 * sizeof(float) + 4 * 13, "Mesh payload has the wrong size");
+  float second_normal_x = 0.0f;
+  std::memcpy(&second_normal_x, mesh_file.data() + mesh_header_end + 9 * sizeof(float), sizeof(float));
+  QVERIFY2(second_normal_x == mesh.normals[1].x(), "Vertex record is not interleaved");
+
+  QVERIFY(BinaryExport::WriteMeshSTL("export_test_mesh.stl", mesh).Ok());
+  std::string const stl_file = ReadFileBytes("export_test_mesh.stl");
+  QVERIFY2(stl_file.size() == 84 + 4 * 50, "STL has the wrong size");
+  float first_normal[3];
+  std::memcpy(first_normal, stl_file.data() + 84, sizeof(first_normal));
+  QVERIFY2(first_normal[2] == -1.0f, "Facet normal does not point outwards");
+
+  for (char const *path : {"export_test.rle", "export_test.ply", "export_test_mesh.ply", "export_test_mesh.stl"}) {
+	QFile::remove(path);
+  }
+}
+
+void MyLibUnitTest::BinaryExportBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  std::vector<Eigen::Vector3i> points(4000000);
+  for (size_t i = 0; i < points.size(); ++i) {
+	points[i] = Eigen::Vector3i(static_cast<int>(i % 512), static_cast<int>((i / 512) % 512),
+								static_cast<int>(i / (512 * 512)));
+  }
+  int *labels = dataset.GetRegionGrowingBuffer();
+  for (int i = 0; i < 512 * 512 * 256; ++i) {
+	labels[i] = (dataset.Data()[i] > 300) ? 1 : 0;
+  }
+  QBENCHMARK {
+	QVERIFY(BinaryExport::WritePointCloudPLY("export_benchmark.ply", points, dataset.GetVoxelSpacing()).Ok());
+	QVERIFY(dataset.ExportRegionMask("export_benchmark.rle").Ok());
+  }
+  QFile::remove("export_benchmark.ply");
+  QFile::remove("export_benchmark.rle");
+}
+
+void MyLibUnitTest::SurfaceMeshTest() {
+  // Voxelized ball: the mesh must be closed, consistently wound outwards and enclose the voxel volume
+  int const size = 64;
+  Eigen::Vector3f const ball_center(32.0f, 30.0f, 28.0f);
+  std::vector<int> labels(size * size * size, 0);
+  int voxel_count = 0;
+  for (int z = 0; z < size; ++z) {
+	for (int y = 0; y < size; ++y) {
+	  for (int x = 0; x < size; ++x) {
+		if ((Eigen::Vector3f(x, y, z) - ball_center).norm() <= 20.0f) {
+		  labels[x + y * size + z * size * size] = 1;
+		  ++voxel_count;
+		}
+	  }
+	}
+  }
+  TriangleMesh mesh;
+  QVERIFY(SurfaceNets::Extract(labels.data(), size, size, size, 1, nullptr, 0, mesh).Ok());
+  QVERIFY2(mesh.TriangleCount() > 0 && mesh.normals.size() == mesh.vertices.size(), "No mesh extracted");
+
+  std::map<std::pair<uint32_t, uint32_t>, int> directed_edges;
+  double volume = 0.0;
+  for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+	for (int e = 0; e < 3; ++e) {
+	  ++directed_edges[std::make_pair(mesh.indices[3 * t + e], mesh.indices[3 * t + (e + 1) % 3])];
+	}
+	Eigen::Vector3d const a = mesh.vertices[mesh.indices[3 * t]].cast<double>();
+	Eigen::Vector3d const b = mesh.vertices[mesh.indices[3 * t + 1]].cast<double>();
+	Eigen::Vector3d const c = mesh.vertices[mesh.indices[3 * t + 2]].cast<double>();
+	volume += a.dot(b.cross(c)) / 6.0;
+  }
+  for (auto const &edge : directed_edges) {
+	auto const reverse = directed_edges.find(std::make_pair(edge.first.second, edge.first.first));
+	QVERIFY2(edge.second == 1 && reverse != directed_edges.end() && reverse->second == 1,
+			 "Mesh is not closed or not consistently wound");
+  }
+  QVERIFY2(std::abs(volume - voxel_count) < 0.03 * voxel_count, "Enclosed volume differs from the voxel count");
+  for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+	QVERIFY2(mesh.normals[v].dot(mesh.vertices[v] - ball_center) > 0.0f, "Vertex normal points inwards");
+  }
+
+  // Rasterized region of a dataset: gap-free footprint and the depth of the front pole, also under rotation
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  for (int z = 0; z < 256; ++z) {
+	for (int y = 0; y < 512; ++y) {
+	  for (int x = 0; x < 512; ++x) {
+		bool const in_sphere = (Eigen::Vector3f(x, y, z) - Eigen::Vector3f(256, 256, 128)).norm() <= 40.0f;
+		data[x + y * 512 + z * 512 * 512] = in_sphere ? 500 : -1000;
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  Eigen::Vector3i seed(256, 256, 128);
+  dataset.RegionGrowing3D(seed, 300);
+  QVERIFY2(dataset.GetRegionMesh().indices.empty(), "Region growing extracted the mesh before it was needed");
+  Eigen::Matrix3d const rotations[2] = {
+	Eigen::Matrix3d::Identity(),
+	Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 1, 0).normalized()).toRotationMatrix()};
+  for (auto const &rotation : rotations) {
+	QVERIFY(dataset.CalculateDepthBufferFromMesh(rotation).Ok());
+	QVERIFY2(!dataset.GetRegionMesh().indices.empty(), "The mesh render did not extract the mesh");
+	for (int y = 200; y < 312; ++y) {
+	  for (int x = 200; x < 312; ++x) {
+		double const radius = std::hypot(x + 0.5 - 256.0, y + 0.5 - 256.0);
+		int const id = dataset.GetIdBuffer()(x, y);
+		QVERIFY2(radius > 39.0 || id >= 0, "Hole in the rasterized mesh");
+		QVERIFY2(radius < 41.5 || id < 0, "Rasterized mesh larger than the region");
+	  }
+	}
+	QVERIFY2(std::abs(dataset.GetDepthBuffer()(256, 256) - 88) <= 1, "Depth of the front pole is wrong");
+	QVERIFY(dataset.RenderDepthBuffer().Ok());
+	// Vertex normals still follow the voxel staircase by a few degrees
+	QVERIFY2(dataset.GetRenderedDepthBuffer()[256 + 256 * 512] > 230, "Front pole is not lit");
+  }
+  Eigen::Vector3i voxel;
+  QVERIFY(dataset.CalculateDepthBufferFromMesh(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY(dataset.PickVoxel(256, 256, voxel).Ok());
+  QVERIFY2((voxel - Eigen::Vector3i(256, 256, 88)).cwiseAbs().maxCoeff() <= 1, "Picked voxel is not the front pole");
+}
+
+void MyLibUnitTest::SurfaceMeshBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  Eigen::Vector3i seed(256, 256, 128 + 90);
+  dataset.RegionGrowing3D(seed, 300);
+  Eigen::Matrix3d const rotation = Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  QBENCHMARK {
+	QVERIFY(dataset.ExtractRegionMesh().Ok());
+	QVERIFY(dataset.CalculateDepthBufferFromMesh(rotation).Ok());
+  }
+}
+
+void MyLibUnitTest::MorphologyTest() {
+  // Random mask with a width that spans two words, compared against per-voxel ball operations
+  int const width = 70;
+  int const height = 33;
+  int const layers = 29;
+  std::mt19937 rng(7);
+  std::bernoulli_distribution coin(0.55);
+  std::vector<int> labels(width * height * layers);
+  for (int &label : labels) {
+	label = coin(rng) ? 1 : 0;
+  }
+  auto label_at = [&](std::vector<int> const &volume, int x, int y, int z, int outside) {
+	if (x < 0 || y < 0 || z < 0 || x >= width || y >= height || z >= layers) {
+	  return outside;
+	}
+	return volume[x + y * width + z * width * height];
+  };
+  BitMask mask;
+  QVERIFY(mask.Build(labels.data(), width, height, layers, 1).Ok());
+  QVERIFY(mask.Count() == static_cast<size_t>(std::count(labels.begin(), labels.end(), 1)));
+  int const radius = 2;
+  BitMask dilated;
+  BitMask eroded;
+  QVERIFY(BitMask::Dilate(mask, radius, dilated).Ok());
+  QVERIFY(BitMask::Erode(mask, radius, eroded).Ok());
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		bool any = false;
+		bool all = true;
+		for (int dz = -radius; dz <= radius; ++dz) {
+		  for (int dy = -radius; dy <= radius; ++dy) {
+			for (int dx = -radius; dx <= radius; ++dx) {
+			  if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+				any |= label_at(labels, x + dx, y + dy, z + dz, 0) == 1;
+				all &= label_at(labels, x + dx, y + dy, z + dz, 1) == 1;
+			  }
+			}
+		  }
+		}
+		QVERIFY2(dilated.Get(x, y, z) == any, "Dilation differs from the ball neighbourhood");
+		QVERIFY2(eroded.Get(x, y, z) == all, "Erosion differs from the ball neighbourhood");
+	  }
+	}
+  }
+  BitMask opened;
+  BitMask closed;
+  QVERIFY(BitMask::Apply(mask, MorphologyOperation::OPEN, radius, opened).Ok());
+  QVERIFY(BitMask::Apply(mask, MorphologyOperation::CLOSE, radius, closed).Ok());
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		QVERIFY2(!opened.Get(x, y, z) || mask.Get(x, y, z), "Opening added a voxel");
+		QVERIFY2(!mask.Get(x, y, z) || closed.Get(x, y, z), "Closing removed a voxel");
+	  }
+	}
+  }
+  QVERIFY(BitMask::Dilate(mask, BitMask::kMaxRadius + 1, dilated).code() == StatusCode::MORPHOLOGY_ERROR);
+
+  // Filling holes: background that is not 6-connected to the border, found by a flood fill
+  std::vector<int> outside(labels.size(), 0);
+  std::vector<int> queue;
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		bool const border = x == 0 || y == 0 || z == 0 || x == width - 1 || y == height - 1 || z == layers - 1;
+		int const index = x + y * width + z * width * height;
+		if (border && labels[index] == 0) {
+		  outside[index] = 1;
+		  queue.push_back(index);
+		}
+	  }
+	}
+  }
+  while (!queue.empty()) {
+	int const index = queue.back();
+	queue.pop_back();
+	int const x = index % width;
+	int const y = (index / width) % height;
+	int const z = index / (width * height);
+	int const neighbours[6][3] = {{x - 1, y, z}, {x + 1, y, z}, {x, y - 1, z}, {x, y + 1, z}, {x, y, z - 1},
+								  {x, y, z + 1}};
+	for (auto const &n : neighbours) {
+	  if (label_at(labels, n[0], n[1], n[2], 1) == 0) {
+		int const neighbour = n[0] + n[1] * width + n[2] * width * height;
+		if (outside[neighbour] == 0) {
+		  outside[neighbour] = 1;
+		  queue.push_back(neighbour);
+		}
+	  }
+	}
+  }
+  BitMask filled;
+  QVERIFY(BitMask::FillHoles(mask, filled).Ok());
+  size_t holes = 0;
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		int const index = x + y * width + z * width * height;
+		holes += (labels[index] == 0 && outside[index] == 0) ? 1 : 0;
+		QVERIFY2(filled.Get(x, y, z) == (outside[index] == 0), "Filled mask differs from the flood fill");
+	  }
+	}
+  }
+  QVERIFY2(holes > 0, "The random mask has no holes to fill");
+
+  // Region cleanup: opening cuts a thin leak out of the region growing result
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  for (int z = 0; z < 256; ++z) {
+	for (int y = 0; y < 512; ++y) {
+	  for (int x = 0; x < 512; ++x) {
+		bool const in_sphere = (Eigen::Vector3f(x, y, z) - Eigen::Vector3f(256, 256, 128)).norm() <= 30.0f;
+		bool const in_leak = y == 256 && z == 128 && x > 256 && x < 320;
+		data[x + y * 512 + z * 512 * 512] = (in_sphere || in_leak) ? 500 : -1000;
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  Eigen::Vector3i seed(256, 256, 128);
+  dataset.RegionGrowing3D(seed, 300);
+  int const *region = dataset.GetRegionGrowingBuffer();
+  QVERIFY(region[310 + 256 * 512 + 128 * 512 * 512] == 1);
+  QVERIFY(dataset.ApplyRegionMorphology(MorphologyOperation::OPEN, 1).Ok());
+  QVERIFY2(region[310 + 256 * 512 + 128 * 512 * 512] == 0, "Opening kept the leak");
+  QVERIFY2(region[256 + 256 * 512 + 128 * 512 * 512] == 1, "Opening removed the region");
+  QVERIFY(dataset.ExtractRegionMesh().Ok());
+  for (auto const &vertex : dataset.GetRegionMesh().vertices) {
+	QVERIFY2(vertex.x() < 290.0f, "Region mesh was not updated");
+  }
+}
+
+void MyLibUnitTest::MorphologyBenchmark() {
+  std::vector<int16_t> data(512 * 512 * 256);
+  FillPhantom(data.data(), 512, 512, 256);
+  std::vector<int> labels(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+	labels[i] = data[i] >= 0 ? 1 : 0;
+  }
+  BitMask mask;
+  QVERIFY(mask.Build(labels.data(), 512, 512, 256, 1).Ok());
+  BitMask opened;
+  QBENCHMARK {
+	QVERIFY(BitMask::Apply(mask, MorphologyOperation::OPEN, 3, opened).Ok());
+  }
+}
+
+void MyLibUnitTest::PrefilterTest() {
+  // Odd width, so that rows end with voxels outside of the SIMD loops
+  int const width = 37;
+  int const height = 23;
+  int const layers = 19;
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> noise(-1200, 1500);
+  std::vector<int16_t> volume(width * height * layers);
+  for (auto &value : volume) {
+	value = static_cast<int16_t>(noise(rng));
+  }
+  auto at = [&](std::vector<int16_t> const &data, int x, int y, int z) {
+	x = std::min(std::max(x, 0), width - 1);
+	y = std::min(std::max(y, 0), height - 1);
+	z = std::min(std::max(z, 0), layers - 1);
+	return data[x + y * width + z * width * height];
+  };
+
+  std::vector<int16_t> median(volume.size());
+  QVERIFY(Prefilter::Median(volume.data(), width, height, layers, median.data()).Ok());
+  for (int z = 0; z < layers; ++z) {
+	for (int y = 0; y < height; ++y) {
+	  for (int x = 0; x < width; ++x) {
+		std::vector<int16_t> neighbourhood;
+		for (int dz = -1; dz <= 1; ++dz) {
+		  for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+			  neighbourhood.push_back(at(volume, x + dx, y + dy, z + dz));
+			}
+		  }
+		}
+		std::sort(neighbourhood.begin(), neighbourhood.end());
+		QVERIFY2(median[x + y * width + z * width * height] == neighbourhood[13], "Median differs from sorting");
+	  }
+	}
+  }
+
+  // Gaussian against a floating point convolution; the fixed-point passes round three times
+  double const sigma = 1.3;
+  int const radius = static_cast<int>(std::ceil(3.0 * sigma));
+  std::vector<double> kernel(2 * radius + 1);
+  double kernel_sum = 0.0;
+  for (int k = -radius; k <= radius; ++k) {
+	kernel[k + radius] = std::exp(-0.5 * k * k / (sigma * sigma));
+	kernel_sum += kernel[k + radius];
+  }
+  std::vector<int16_t> smoothed(volume.size());
+  QVERIFY(Prefilter::Gaussian(volume.data(), width, height, layers, sigma, smoothed.data()).Ok());
+  for (int z = 0; z < layers; z += 3) {
+	for (int y = 0; y < height; y += 2) {
+	  for (int x = 0; x < width; ++x) {
+		double expected = 0.0;
+		for (int dz = -radius; dz <= radius; ++dz) {
+		  for (int dy = -radius; dy <= radius; ++dy) {
+			for (int dx = -radius; dx <= radius; ++dx) {
+			  expected += kernel[dx + radius] * kernel[dy + radius] * kernel[dz + radius]
+				* at(volume, x + dx, y + dy, z + dz);
+			}
+		  }
+		}
+		expected /= kernel_sum * kernel_sum * kernel_sum;
+		QVERIFY2(std::abs(smoothed[x + y * width + z * width * height] - expected) < 3.0,
+				 "Gaussian differs from the floating point convolution");
+	  }
+	}
+  }
+  std::vector<int16_t> flat(volume.size(), 1200);
+  QVERIFY(Prefilter::Gaussian(flat.data(), width, height, layers, sigma, smoothed.data()).Ok());
+  QVERIFY2(std::all_of(smoothed.begin(), smoothed.end(), [](int16_t v) { return v == 1200; }),
+		   "Gaussian changes a flat volume");
+  QVERIFY(Prefilter::Gaussian(volume.data(), width, height, layers, 0.0, smoothed.data()).code()
+			== StatusCode::PREFILTER_ERROR);
+
+  // Dataset: an impulse in the air in front of the phantom hides it until the median removes the impulse
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  int const spike = 256 + 256 * 512 + 5 * 512 * 512;
+  dataset.Data()[spike] = 3000;
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  QVERIFY(dataset.GetDepthBuffer()(256, 256) == 5);
+  PrefilterParameters params;
+  params.type = PrefilterType::MEDIAN;
+  QVERIFY(dataset.SetPrefilter(params).Ok());
+  QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+  int const phantom_depth = dataset.GetDepthBuffer()(256, 256);
+  QVERIFY2(phantom_depth > 5 && phantom_depth < 128, "Median did not remove the impulse");
+  QVERIFY2(dataset.Data()[spike] == 3000, "Prefilter modified the raw image data");
+
+  // The cached result is kept for unchanged parameters and recomputed when they change
+  for (int dz = -1; dz <= 1; ++dz) {
+	for (int dy = -1; dy <= 1; ++dy) {
+	  for (int dx = -1; dx <= 1; ++dx) {
+		dataset.Data()[spike + dx + dy * 512 + dz * 512 * 512] = 3000;
+	  }
+	}
+  }
+  QVERIFY(dataset.SetPrefilter(params).Ok());
+  QVERIFY2(dataset.FilteredData()[spike] < 300, "Unchanged parameters recomputed the prefilter");
+  params.type = PrefilterType::NONE;
+  QVERIFY(dataset.SetPrefilter(params).Ok());
+  QVERIFY(dataset.FilteredData() == dataset.Data());
+  params.type = PrefilterType::MEDIAN;
+  QVERIFY(dataset.SetPrefilter(params).Ok());
+  QVERIFY2(dataset.FilteredData()[spike] == 3000, "Changed parameters did not recompute the prefilter");
+}
+
+void MyLibUnitTest::PrefilterBenchmark() {
+  std::vector<int16_t> volume(512 * 512 * 256);
+  FillPhantom(volume.data(), 512, 512, 256);
+  std::vector<int16_t> filtered(volume.size());
+  QBENCHMARK {
+	QVERIFY(Prefilter::Gaussian(volume.data(), 512, 512, 256, 1.0, filtered.data()).Ok());
+	QVERIFY(Prefilter::Median(volume.data(), 512, 512, 256, filtered.data()).Ok());
+  }
+}
+
+void MyLibUnitTest::ResampleTest() {
+  Eigen::Vector3i const size(29, 17, 11);
+  Eigen::Vector3d const spacing(0.5, 0.6, 0.9);
+  int const count = size.prod();
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> noise(-1024, 3071);
+  std::vector<int16_t> volume(count);
+  for (auto &value : volume) {
+	value = static_cast<int16_t>(noise(rng));
+  }
+
+  // The grid of the volume itself reproduces every voxel with both interpolations
+  ResampleGrid grid;
+  grid.size = size;
+  grid.spacing = spacing;
+  std::vector<int16_t> output;
+  QVERIFY(Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::NEAREST, -1024, output).Ok());
+  QVERIFY2(output == volume, "Nearest resampling onto the own grid changed the volume");
+  QVERIFY(Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::TRILINEAR, -1024, output).Ok());
+  QVERIFY2(output == volume, "Trilinear resampling onto the own grid changed the volume");
+
+  // Trilinear interpolation is exact for a linear ramp in mm, also under a rotation
+  auto ramp = [](Eigen::Vector3d const &mm) { return 40.0 * mm.x() - 25.0 * mm.y() + 30.0 * mm.z(); };
+  for (int z = 0; z < size.z(); ++z) {
+	for (int y = 0; y < size.y(); ++y) {
+	  for (int x = 0; x < size.x(); ++x) {
+		volume[x + y * size.x() + z * size.x() * size.y()] =
+			static_cast<int16_t>(std::lround(ramp(Eigen::Vector3d(x, y, z).cwiseProduct(spacing))));
+	  }
+	}
+  }
+  Eigen::Isometry3d frame_from_volume = Eigen::Translation3d(100.0, -20.0, 5.0)
+	  * Eigen::AngleAxisd(0.4, Eigen::Vector3d(1.0, 2.0, 3.0).normalized());
+  grid = Resampler::FrameGrid(size, spacing, frame_from_volume, 0.45);
+  Eigen::Vector3d const extent = (size - Eigen::Vector3i::Ones()).cast<double>().cwiseProduct(spacing);
+  for (int corner = 0; corner < 8; ++corner) {
+	Eigen::Vector3d const corner_mm((corner & 1) ? extent.x() : 0.0, (corner & 2) ? extent.y() : 0.0,
+									(corner & 4) ? extent.z() : 0.0);
+	Eigen::Vector3d const output_voxel =
+		(grid.source_from_output.inverse() * corner_mm).cwiseQuotient(grid.spacing);
+	QVERIFY2((output_voxel.array() > -1e-6).all()
+			   && (output_voxel.array() < grid.size.cast<double>().array() - 1.0 + 1e-6).all(),
+			 "Frame grid does not cover the volume");
+  }
+  QVERIFY(Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::TRILINEAR, -1024, output).Ok());
+  QVERIFY(output.size() == static_cast<size_t>(grid.size.prod()));
+  int inside = 0;
+  for (int k = 0; k < grid.size.z(); ++k) {
+	for (int j = 0; j < grid.size.y(); ++j) {
+	  for (int i = 0; i < grid.size.x(); ++i) {
+		Eigen::Vector3d const mm = grid.source_from_output * Eigen::Vector3d(i, j, k).cwiseProduct(grid.spacing);
+		Eigen::Vector3d const voxel = mm.cwiseQuotient(spacing);
+		int16_t const value = output[i + j * grid.size.x() + k * grid.size.x() * grid.size.y()];
+		if ((voxel.array() > 0.01).all() && (voxel.array() < size.cast<double>().array() - 1.01).all()) {
+		  QVERIFY2(std::abs(value - ramp(mm)) <= 1.5, "Trilinear resampling differs from the ramp");
+		  ++inside;
+		} else if ((voxel.array() < -0.01).any() || (voxel.array() > size.cast<double>().array() - 0.99).any()) {
+		  QVERIFY2(value == -1024, "Sample outside of the volume is not air");
+		}
+	  }
+	}
+  }
+  QVERIFY(inside > count / 2);
+
+  // Output is streamed in ascending slabs, and an error of the callback stops the resampling
+  grid = Resampler::IsotropicGrid(size, spacing, 0.25);
+  QVERIFY(grid.size == Eigen::Vector3i(57, 39, 37));
+  int next_layer = 0;
+  QVERIFY(Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::TRILINEAR, -1024,
+							  [&](int first_layer, int layer_count, const int16_t *) {
+								if (first_layer != next_layer || layer_count > Resampler::kSlabLayers) {
+								  return Status(StatusCode::BUFFER_EMPTY);
+								}
+								next_layer += layer_count;
+								return Status(StatusCode::OK);
+							  }).Ok());
+  QVERIFY(next_layer == grid.size.z());
+  int calls = 0;
+  Status const stopped = Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::NEAREST, -1024,
+											 [&](int, int, const int16_t *) {
+											   ++calls;
+											   return Status(StatusCode::FWRITE_ERROR);
+											 });
+  QVERIFY(stopped.code() == StatusCode::FWRITE_ERROR && calls == 1);
+  grid.size.y() = 0;
+  QVERIFY(Resampler::Resample(volume.data(), size, spacing, grid, InterpolationMode::NEAREST, -1024, output).code()
+			== StatusCode::RESAMPLE_ERROR);
+
+  // A ball mask keeps its volume in mm^3 on isotropic voxels
+  std::vector<int> labels(count, 0);
+  Eigen::Vector3d const center = extent / 2.0;
+  int ball_voxels = 0;
+  for (int z = 0; z < size.z(); ++z) {
+	for (int y = 0; y < size.y(); ++y) {
+	  for (int x = 0; x < size.x(); ++x) {
+		if ((Eigen::Vector3d(x, y, z).cwiseProduct(spacing) - center).norm() < 3.5) {
+		  labels[x + y * size.x() + z * size.x() * size.y()] = 1;
+		  ++ball_voxels;
+		}
+	  }
+	}
+  }
+  grid = Resampler::IsotropicGrid(size, spacing, 0.3);
+  std::vector<uint8_t> mask;
+  QVERIFY(Resampler::ResampleMask(labels.data(), size, spacing, 1, grid, InterpolationMode::TRILINEAR, mask).Ok());
+  double const source_volume = ball_voxels * spacing.prod();
+  double const mask_volume = std::count(mask.begin(), mask.end(), 1) * grid.spacing.prod();
+  QVERIFY2(std::abs(mask_volume - source_volume) < 0.1 * source_volume, "Resampled mask changed the volume");
+
+  // Dataset: the isotropic grid of the default spacing has cubic voxels over the whole volume
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  grid = dataset.IsotropicGrid(0.7);
+  QVERIFY(grid.size == Eigen::Vector3i(382, 382, 256));
+  int16_t center_value = 0;
+  QVERIFY(dataset.ResampleVolume(grid, InterpolationMode::NEAREST,
+								 [&](int first_layer, int layer_count, const int16_t *slab) {
+								   if (first_layer <= 128 && 128 < first_layer + layer_count) {
+									 center_value = slab[(128 - first_layer) * 382 * 382 + 191 * 382 + 191];
+								   }
+								   return Status(StatusCode::OK);
+								 }).Ok());
+  QVERIFY(center_value == 40);
+}
+
+void MyLibUnitTest::ResampleBenchmark() {
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  ResampleGrid const grid = dataset.IsotropicGrid(0.523);
+  int64_t sum = 0;
+  QBENCHMARK {
+	QVERIFY(dataset.ResampleVolume(grid, InterpolationMode::TRILINEAR,
+								   [&sum](int, int, const int16_t *slab) {
+									 sum += slab[0];
+									 return Status(StatusCode::OK);
+								   }).Ok());
+  }
+}
+
+void MyLibUnitTest::ThreadPoolTest() {
+  utils::ThreadPool &pool = utils::ThreadPool::Instance();
+  std::vector<double> sums;
+  for (int workers : {1, 3, 8}) {
+	pool.SetWorkerCount(workers);
+	QVERIFY(pool.WorkerCount() == workers);
+
+	// Every index is visited exactly once, also by nested loops
+	std::vector<int> visits(10007, 0);
+	utils::ParallelFor(0, 10007, [&](int i) { ++visits[i]; });
+	QVERIFY2(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }), "ParallelFor missed an index");
+	std::vector<int> nested(8 * 500, 0);
+	utils::ParallelFor(0, 8, [&](int outer) {
+	  utils::ParallelFor(0, 500, [&](int inner) { ++nested[outer * 500 + inner]; });
+	});
+	QVERIFY2(std::all_of(nested.begin(), nested.end(), [](int v) { return v == 1; }), "Nested loop missed an index");
+
+	// Thick volumes are chunked into slabs of layers, thin ones into rows
+	for (auto const &size : {Eigen::Vector3i(13, 7, 200), Eigen::Vector3i(37, 11, 2)}) {
+	  std::vector<int> voxels(size.prod(), 0);
+	  utils::ParallelFor3D(size.x(), size.y(), size.z(), [&](int x, int y, int z) {
+		++voxels[x + y * size.x() + z * size.x() * size.y()];
+	  });
+	  QVERIFY2(std::all_of(voxels.begin(), voxels.end(), [](int v) { return v == 1; }),
+			   "ParallelFor3D missed a voxel");
+	}
+
+	std::vector<int> const even = utils::ParallelCollect<int>(0, 1001, [](int i, std::vector<int> &out) {
+	  if (i % 2 == 0) {
+		out.push_back(i);
+	  }
+	});
+	QVERIFY(even.size() == 501 && std::is_sorted(even.begin(), even.end()));
+
+	// Floating point reductions only depend on the chunking, which is fixed in deterministic mode
+	pool.SetDeterministic(true);
+	sums.push_back(utils::ParallelReduce(0, 100000, 1, 0.0, [](int begin, int end) {
+	  double sum = 0.0;
+	  for (int i = begin; i < end; ++i) {
+		sum += 1.0 / (1.0 + i);
+	  }
+	  return sum;
+	}, [](double a, double b) { return a + b; }));
+	pool.SetDeterministic(false);
+  }
+  QVERIFY2(sums[0] == sums[1] && sums[1] == sums[2], "Deterministic reduction depends on the worker count");
+
+  // The ported kernels give the same result for every worker count
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  int *region = dataset.GetRegionGrowingBuffer();
+  for (int z = 0; z < 256; ++z) {
+	for (int y = 0; y < 512; ++y) {
+	  for (int x = 0; x < 512; ++x) {
+		region[x + y * 512 + z * 512 * 512] = (Eigen::Vector3d(x - 200, y - 300, 2 * (z - 120)).norm() < 40) ? 1 : 0;
+	  }
+	}
+  }
+  std::vector<int> depth[2];
+  std::vector<int> rendered[2];
+  std::vector<Eigen::Vector3i> surface[2];
+  std::vector<Eigen::Vector3i> points[2];
+  for (int run = 0; run < 2; ++run) {
+	pool.SetWorkerCount(run == 0 ? 1 : 4);
+	QVERIFY(dataset.CalculateDepthBuffer(300).Ok());
+	QVERIFY(dataset.RenderDepthBuffer().Ok());
+	depth[run].resize(512 * 512);
+	dataset.GetDepthBuffer().CopyTo(depth[run].data());
+	rendered[run].assign(dataset.GetRenderedDepthBuffer(), dataset.GetRenderedDepthBuffer() + 512 * 512);
+	surface[run] = dataset.ExtractSurfacePoints().value();
+	points[run] = dataset.ExtractPointsInRegion().value();
+  }
+  pool.SetWorkerCount(0);
+  QVERIFY(depth[0] == depth[1] && rendered[0] == rendered[1]);
+  QVERIFY(surface[0] == surface[1] && points[0] == points[1]);
+  QVERIFY(static_cast<int>(points[0].size()) == std::count(region, region + 512 * 512 * 256, 1));
+  auto yxz_order = [](Eigen::Vector3i const &a, Eigen::Vector3i const &b) {
+	return std::make_tuple(a.y(), a.x(), a.z()) < std::make_tuple(b.y(), b.x(), b.z());
+  };
+  QVERIFY2(std::is_sorted(points[0].begin(), points[0].end(), yxz_order), "Region points are not in y, x, z order");
+  QVERIFY(std::is_sorted(surface[0].begin(), surface[0].end(), yxz_order));
+  QVERIFY(!surface[0].empty() && surface[0].size() < points[0].size());
+}
+
+void MyLibUnitTest::ThreadPoolBenchmark() {
+  // Dispatch overhead of small loops, e.g. one per rendered frame
+  std::vector<int> rows(512, 0);
+  QBENCHMARK {
+	for (int i = 0; i < 1000; ++i) {
+	  utils::ParallelFor(0, 512, [&](int y) { rows[y] += y; });
+	}
+  }
+}
+
+void MyLibUnitTest::RegionHistoryTest() {
+  // Snapshots share the bricks that did not change; the size is no multiple of the brick edge
+  int const width = 70;
+  int const height = 45;
+  int const layers = 33;
+  std::vector<int> labels(width * height * layers, 0);
+  auto fill_box = [&](int x0, int y0, int z0, int edge, int label) {
+	for (int z = z0; z < z0 + edge; ++z) {
+	  for (int y = y0; y < y0 + edge; ++y) {
+		for (int x = x0; x < x0 + edge; ++x) {
+		  labels[x + y * width + z * width * height] = label;
+		}
+	  }
+	}
+  };
+  LabelSnapshot empty;
+  QVERIFY(LabelSnapshot::Capture(labels.data(), width, height, layers, LabelSnapshot(), empty).Ok());
+  QVERIFY(empty.BrickCount() == 5 * 3 * 3 && empty.StoredBrickCount() == 0);
+
+  fill_box(10, 5, 3, 30, 1);
+  std::vector<int> const first_labels = labels;
+  LabelSnapshot first;
+  QVERIFY(LabelSnapshot::Capture(labels.data(), width, height, layers, empty, first).Ok());
+  std::vector<LabelSnapshot> chain{first};
+  for (int step = 0; step < CTDataset::kRegionHistoryLevels; ++step) {
+	labels[66 + 40 * width + 30 * width * height] = step + 2;
+	LabelSnapshot next;
+	QVERIFY(LabelSnapshot::Capture(labels.data(), width, height, layers, chain.back(), next).Ok());
+	chain.push_back(next);
+  }
+  std::set<const int *> unique_bricks;
+  for (auto const &snapshot : chain) {
+	for (int i = 0; i < snapshot.BrickCount(); ++i) {
+	  if (snapshot.Brick(i) != nullptr) {
+		unique_bricks.insert(snapshot.Brick(i));
+	  }
+	}
+  }
+  QVERIFY2(static_cast<int>(unique_bricks.size()) == first.StoredBrickCount() + CTDataset::kRegionHistoryLevels,
+		   "Unchanged bricks are not shared between snapshots");
+  QVERIFY(first.Restore(labels.data(), chain.back()).Ok());
+  QVERIFY2(labels == first_labels, "Restoring over a later snapshot does not give the old labels");
+  std::fill(labels.begin(), labels.end(), 7);
+  QVERIFY(first.Restore(labels.data()).Ok());
+  QVERIFY(labels == first_labels);
+  QVERIFY(LabelSnapshot().Restore(labels.data()).code() == StatusCode::BUFFER_EMPTY);
+
+  // Dataset: two boxes of different density, grown one after the other
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  std::fill_n(data, 512 * 512 * 256, static_cast<int16_t>(-1000));
+  for (int z = 100; z < 130; ++z) {
+	for (int y = 200; y < 260; ++y) {
+	  for (int x = 100; x < 300; ++x) {
+		data[x + y * 512 + z * 512 * 512] = (x < 200) ? 500 : 900;
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  QVERIFY(!dataset.CanUndoRegion() && dataset.UndoRegion().code() == StatusCode::HISTORY_ERROR);
+  int const *region = dataset.GetRegionGrowingBuffer();
+  int const volume_size = 512 * 512 * 256;
+  Eigen::Vector3i seed(150, 230, 115);
+  dataset.RegionGrowing3D(seed, 300);
+  std::vector<int> const low_threshold(region, region + volume_size);
+  auto const low_surface = dataset.ExtractSurfacePoints().value();
+  QVERIFY(dataset.ExtractRegionMesh().Ok());
+  size_t const low_triangles = dataset.GetRegionMesh().indices.size();
+  seed = Eigen::Vector3i(250, 230, 115);
+  dataset.RegionGrowing3D(seed, 700);
+  std::vector<int> const high_threshold(region, region + volume_size);
+  QVERIFY(low_threshold != high_threshold);
+  QVERIFY(dataset.CanUndoRegion() && !dataset.CanRedoRegion());
+
+  QVERIFY(dataset.UndoRegion().Ok());
+  QVERIFY2(std::equal(region, region + volume_size, low_threshold.begin()), "Undo did not restore the region");
+  QVERIFY(dataset.CalculateDepthBufferFromMesh(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY2(dataset.GetRegionMesh().indices.size() == low_triangles, "Undo did not restore the mesh");
+  QVERIFY(dataset.ExtractSurfacePoints().value() == low_surface);
+  QVERIFY2(dataset.GetSurfaceClusters().Empty(), "Undo copied derived surface data into the history");
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY2(dataset.GetSurfaceClusters().PointCount() == low_surface.size(), "The render did not recompute the surface");
+  QVERIFY(dataset.UndoRegion().Ok());
+  QVERIFY2(std::all_of(region, region + volume_size, [](int label) { return label == 0; }),
+		   "Undo did not go back to the state before the first region growing");
+  QVERIFY(!dataset.CanUndoRegion());
+  QVERIFY(dataset.RedoRegion().Ok() && dataset.RedoRegion().Ok() && !dataset.CanRedoRegion());
+  QVERIFY2(std::equal(region, region + volume_size, high_threshold.begin()), "Redo did not restore the region");
+
+  // A new result drops the redo entries, and the history keeps kRegionHistoryLevels older results
+  QVERIFY(dataset.UndoRegion().Ok());
+  QVERIFY(dataset.ApplyRegionMorphology(MorphologyOperation::ERODE, 1).Ok());
+  QVERIFY(!dataset.CanRedoRegion());
+  for (int i = 0; i < CTDataset::kRegionHistoryLevels; ++i) {
+	QVERIFY(dataset.ApplyRegionMorphology(MorphologyOperation::DILATE, 1).Ok());
+  }
+  int undo_steps = 0;
+  while (dataset.UndoRegion().Ok()) {
+	++undo_steps;
+  }
+  QVERIFY(undo_steps == CTDataset::kRegionHistoryLevels);
+
+  // A box that grows one small bump per threshold step: the full history costs little more than one result
+  std::fill_n(data, 512 * 512 * 256, static_cast<int16_t>(-1000));
+  for (int z = 96; z < 160; ++z) {
+	for (int y = 192; y < 320; ++y) {
+	  std::fill_n(data + 128 + y * 512 + z * 512 * 512, 256, static_cast<int16_t>(500));
+	}
+  }
+  for (int bump = 1; bump <= CTDataset::kRegionHistoryLevels; ++bump) {
+	for (int z = 100; z < 104; ++z) {
+	  for (int y = 320; y < 324; ++y) {
+		std::fill_n(data + 132 + 16 * bump + y * 512 + z * 512 * 512, 4, static_cast<int16_t>(500 - 10 * bump));
+	  }
+	}
+  }
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  seed = Eigen::Vector3i(256, 256, 128);
+  for (int bump = 0; bump <= CTDataset::kRegionHistoryLevels; ++bump) {
+	dataset.RegionGrowing3D(seed, 495 - 10 * bump);
+  }
+  LabelSnapshot single;
+  QVERIFY(LabelSnapshot::Capture(region, 512, 512, 256, LabelSnapshot(), single).Ok());
+  size_t const single_bytes = single.StoredBrickCount() * LabelSnapshot::kBrickVoxels * sizeof(int)
+	+ single.BrickCount() * sizeof(std::shared_ptr<const std::vector<int>>);
+  QVERIFY2(dataset.GetRegionHistoryBytes() < single_bytes * 5 / 4, "The undo history costs much more than one result");
+}
+
+void MyLibUnitTest::RegionHistoryBenchmark() {
+  // Capturing a changed region and stepping back and forth between two results
+  CTDataset dataset;
+  FillPhantom(dataset.Data(), 512, 512, 256);
+  QVERIFY(dataset.RebuildVoxelLayout().Ok());
+  Eigen::Vector3i seed(256, 256, 38);
+  dataset.RegionGrowing3D(seed, 300);
+  QVERIFY(dataset.ApplyRegionMorphology(MorphologyOperation::DILATE, 1).Ok());
+  QBENCHMARK {
+	QVERIFY(dataset.UndoRegion().Ok());
+	QVERIFY(dataset.RedoRegion().Ok());
+  }
+}
+
+void MyLibUnitTest::CineSeriesTest() {
+  std::vector<QString> paths = WriteCinePhases(3);
+  QVERIFY(paths.size() == 3);
+  CineSeries cine(2);
+  QVERIFY(cine.Open({}, 300, 115).code() == StatusCode::CINE_ERROR);
+  QVERIFY(cine.Open(paths, 300, 115).Ok());
+  QVERIFY(cine.PhaseCount() == 3 && cine.RingSize() == 2);
+
+  // A frame equals the slice and render of the phase loaded into a dataset of its own
+  std::shared_ptr<const CineFrame> first;
+  QVERIFY(cine.GetFrame(0, first).Ok());
+  QVERIFY(first->phase == 0 && first->threshold == 300 && first->slice_layer == 115 && first->width == 512
+		  && first->height == 512);
+  CTDataset reference;
+  QVERIFY(reference.load(paths[0]).Ok());
+  QVERIFY(reference.ExtractSlice(reference.GetSlicePlane(SliceOrientation::AXIAL, 115)).value() == first->slice);
+  QVERIFY(reference.CalculateDepthBuffer(300).Ok() && reference.RenderDepthBuffer().Ok());
+  QVERIFY2(std::equal(first->rendered_image.begin(), first->rendered_image.end(),
+					  reference.GetRenderedDepthBuffer()) && first->rendered_image.size() == 512 * 512,
+		   "Frame differs from the render of the phase");
+
+  // The prefetch thread runs one ring ahead and no further
+  cine.WaitForPrefetch();
+  QVERIFY2(cine.LoadedPhases() == 2, "Prefetching does not stop at the size of the ring");
+  std::shared_ptr<const CineFrame> frame;
+  QVERIFY2(cine.TryGetFrame(1, frame).Ok(), "Next phase was not prefetched");
+  QVERIFY(frame->phase == 1 && frame->slice[110 + 230 * 512] == -1000 && frame->slice[170 + 230 * 512] == 800);
+
+  // Playback wraps around; frames in use stay valid when their slot is reused
+  QVERIFY(cine.GetFrame(2, frame).Ok() && frame->phase == 2);
+  cine.WaitForPrefetch();
+  QVERIFY2(cine.LoadedPhases() == 3, "Phase 0 is still in the ring and must not be loaded again");
+  QVERIFY(cine.TryGetFrame(0, frame).Ok() && frame->slice == first->slice);
+  QVERIFY(first->phase == 0 && first->slice[100 + 230 * 512] == 800);
+
+  // New render parameters replace all frames
+  QVERIFY(cine.SetRenderParameters(2000, 120).Ok());
+  QVERIFY(cine.GetFrame(0, frame).Ok() && frame->threshold == 2000 && frame->slice_layer == 120);
+  QVERIFY(std::all_of(frame->rendered_image.begin(), frame->rendered_image.end(),
+					  [&](int value) { return value == frame->rendered_image.front(); }));
+
+  // Errors
+  QVERIFY(cine.TryGetFrame(3, frame).code() == StatusCode::CINE_ERROR && !frame);
+  QVERIFY(cine.SetRenderParameters(300, 256).Ok());
+  QVERIFY(cine.GetFrame(0, frame).code() == StatusCode::SLICE_OUT_OF_RANGE);
+  QVERIFY(cine.Open({"cine_phase_missing.raw"}, 300, 115).Ok());
+  QVERIFY(cine.GetFrame(0, frame).code() == StatusCode::FOPEN_ERROR);
+  cine.Close();
+  QVERIFY(cine.PhaseCount() == 0 && cine.GetFrame(0, frame).code() == StatusCode::CINE_ERROR);
+  for (QString const &path : paths) {
+	QFile::remove(path);
+  }
+}
+
+void MyLibUnitTest::CineSeriesBenchmark() {
+  // Looped playback that waits for every frame, i.e. the rate at which phases are loaded and rendered
+  std::vector<QString> paths = WriteCinePhases(4);
+  QVERIFY(paths.size() == 4);
+  CineSeries cine(2);
+  QVERIFY(cine.Open(paths, 300, 115).Ok());
+  cine.WaitForPrefetch();
+  std::shared_ptr<const CineFrame> frame;
+  QBENCHMARK {
+	for (int phase = 0; phase < cine.PhaseCount(); ++phase) {
+	  QVERIFY(cine.GetFrame(phase, frame).Ok());
+	}
+  }
+  for (QString const &path : paths) {
+	QFile::remove(path);
+  }
+}
+
+void MyLibUnitTest::DicomImportTest() {
+  // The SSE2 rescale matches the scalar formula for signed and unsigned input, including the saturation
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> stored(0, 65535);
+  std::vector<int16_t> row(37);
+  for (bool is_signed : {true, false}) {
+	std::vector<int16_t> expected(row.size());
+	for (size_t i = 0; i < row.size(); ++i) {
+	  row[i] = static_cast<int16_t>(stored(rng));
+	  float const value = is_signed ? row[i] : static_cast<uint16_t>(row[i]);
+	  float const rescaled = std::min(std::max(value * 0.5f - 1024.25f, -1024.0f), 3071.0f);
+	  expected[i] = static_cast<int16_t>(std::nearbyint(rescaled));
+	}
+	simd::RescaleRow(row.data(), is_signed, 0.5f, -1024.25f, -1024, 3071, static_cast<int>(row.size()));
+	QVERIFY2(row == expected, "Rescaled row differs from the scalar reference");
+  }
+
+  // A series in shuffled file order, half explicit and half implicit VR, next to a smaller series and a text file
+  int const columns = 40;
+  int const rows = 30;
+  int const slices = 20;
+  QVERIFY(QDir().mkpath("dicom_test"));
+  auto stored_value = [](int x, int y, int z) { return static_cast<uint16_t>(1000 + x + 2 * y + 10 * z); };
+  for (int z = 0; z < slices; ++z) {
+	std::vector<uint16_t> pixels(columns * rows);
+	for (int y = 0; y < rows; ++y) {
+	  for (int x = 0; x < columns; ++x) {
+		pixels[x + y * columns] = stored_value(x, y, z);
+	  }
+	}
+	QString const path = QString("dicom_test/image_") + QString::number((z * 7) % slices) + ".dcm";
+	QVERIFY(WriteDicomSlice(path, z % 2 == 0, "1.2.3.4", slices - z, -100.0 + 2.5 * z, columns, rows, pixels, -1024));
+  }
+  for (int z = 0; z < 3; ++z) {
+	std::vector<uint16_t> pixels(16 * 16, 0);
+	QVERIFY(WriteDicomSlice(QString("dicom_test/scout_") + QString::number(z) + ".dcm", true, "1.2.3.5", z, z, 16,
+							16, pixels, -1024));
+  }
+  {
+	QFile notes("dicom_test/notes.txt");
+	QVERIFY(notes.open(QIODevice::WriteOnly));
+	QVERIFY(notes.write("no dicom", 8) == 8);
+  }
+
+  DicomSliceInfo info;
+  QVERIFY(DicomSeries::ReadSliceInfo("dicom_test/image_7.dcm", info).Ok());
+  QVERIFY(info.rows == rows && info.columns == columns && !info.is_signed && info.has_position);
+  QVERIFY(info.instance_number == slices - 1 && std::abs(info.position.z() + 97.5) < 1e-9);
+  QVERIFY(DicomSeries::ReadSliceInfo("dicom_test/notes.txt", info).code() == StatusCode::FILE_FORMAT_ERROR);
+
+  CTDataset dataset;
+  QVERIFY(dataset.ImportDicomSeries("dicom_test").Ok());
+  QVERIFY2(dataset.GetSliceCount(SliceOrientation::SAGITTAL) == columns
+			 && dataset.GetSliceCount(SliceOrientation::CORONAL) == rows
+			 && dataset.GetSliceCount(SliceOrientation::AXIAL) == slices,
+		   "Dataset did not take over the dimensions of the series");
+  QVERIFY((dataset.GetVoxelSpacing() - Eigen::Vector3d(0.6, 0.7, 2.5)).norm() < 1e-9);
+  bool values_match = true;
+  for (int z = 0; z < slices; ++z) {
+	for (int y = 0; y < rows; ++y) {
+	  for (int x = 0; x < columns; ++x) {
+		values_match &= dataset.Data()[x + y * columns + z * columns * rows] == stored_value(x, y, z) - 1024;
+	  }
+	}
+  }
+  QVERIFY2(values_match, "Slices are not sorted by position or not rescaled");
+  QVERIFY(dataset.CalculateDepthBuffer(100).Ok() && dataset.GetDepthBuffer()(0, 0) == 13);
+  QVERIFY(dataset.ExtractSlice(dataset.GetSlicePlane(SliceOrientation::AXIAL, 3)).value()[5] == 1000 + 5 + 30 - 1024);
+
+  QVERIFY(dataset.ImportDicomSeries("dicom_missing").code() == StatusCode::FOPEN_ERROR);
+  QVERIFY(QDir("dicom_test").removeRecursively());
+  QVERIFY(QDir().mkpath("dicom_test"));
+  QVERIFY(dataset.ImportDicomSeries("dicom_test").code() == StatusCode::FILE_FORMAT_ERROR);
+  QVERIFY(dataset.GetSliceCount(SliceOrientation::AXIAL) == slices);
+  QVERIFY(QDir("dicom_test").removeRecursively());
+
+  // A raw file loaded after the series gets the raw dimensions and spacing back
+  std::vector<QString> const raw_paths = WriteCinePhases(1);
+  QVERIFY(raw_paths.size() == 1);
+  QString raw_path = raw_paths[0];
+  QVERIFY(dataset.load(raw_path).Ok());
+  QVERIFY2(dataset.GetSliceCount(SliceOrientation::SAGITTAL) == CTDataset::kRawWidth
+			 && dataset.GetSliceCount(SliceOrientation::CORONAL) == CTDataset::kRawHeight
+			 && dataset.GetSliceCount(SliceOrientation::AXIAL) == CTDataset::kRawLayers,
+		   "Raw file was loaded with the dimensions of the series");
+  QVERIFY(dataset.GetVoxelSpacing()
+			== Eigen::Vector3d(CTDataset::kRawPixelSpacing, CTDataset::kRawPixelSpacing, CTDataset::kRawLayerSpacing));
+  QVERIFY(dataset.CalculateDepthBuffer(500).Ok() && dataset.GetDepthBuffer()(120, 230) == 100);
+  {
+	QFile raw_file(raw_path);
+	QVERIFY(raw_file.open(QIODevice::WriteOnly));
+	QVERIFY(raw_file.write(reinterpret_cast<char const *>(dataset.Data()), 1000) == 1000);
+  }
+  QVERIFY2(dataset.load(raw_path).code() == StatusCode::FOPEN_ERROR, "Truncated raw file was not reported");
+  QFile::remove(raw_path);
+}
+
+void MyLibUnitTest::DicomImportBenchmark() {
+  // 500 slices of 512 x 512 voxels, the size of a typical thorax-abdomen study
+  int const slices = 500;
+  QVERIFY(QDir().mkpath("dicom_benchmark"));
+  std::vector<uint16_t> pixels(512 * 512);
+  for (int z = 0; z < slices; ++z) {
+	for (size_t i = 0; i < pixels.size(); ++i) {
+	  pixels[i] = static_cast<uint16_t>((i * 7 + z) % 4096);
+	}
+	QVERIFY(WriteDicomSlice(QString("dicom_benchmark/slice_") + QString::number(z) + ".dcm", true, "1.2.3.6", z,
+							0.7 * z, 512, 512, pixels, -1024));
+  }
+  CTDataset dataset;
+  QBENCHMARK {
+	QVERIFY(dataset.ImportDicomSeries("dicom_benchmark").Ok());
+  }
+  QVERIFY(dataset.GetSliceCount(SliceOrientation::AXIAL) == slices);
+  QVERIFY(QDir("dicom_benchmark").removeRecursively());
+}
+
+void MyLibUnitTest::RenderServerTest() {
+  int const size = 64;
+  int const slices = 48;
+  QVERIFY(WriteDicomBall("render_server_test", size, slices));
+  Eigen::Matrix3d const rotation = Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  Eigen::Vector3i seed(size / 2, size / 2, slices / 2);
+
+  // What a viewer computes on its own
+  CTDataset reference;
+  QVERIFY(reference.ImportDicomSeries("render_server_test").Ok() && reference.ComputeNormalVolume().Ok());
+  auto read_frame = [&reference]() {
+	std::vector<uint32_t> frame(reference.GetRenderedDepthBuffer(), reference.GetRenderedDepthBuffer() + size * size);
+	for (uint32_t &pixel : frame) {
+	  pixel = 0xff000000u | (pixel << 16) | (pixel << 8) | pixel;
+	}
+	return frame;
+  };
+  QVERIFY(reference.CalculateDepthBuffer(500).Ok() && reference.RenderDepthBuffer().Ok());
+  std::vector<uint32_t> const surface_frame = read_frame();
+  Eigen::Vector3i reference_seed = seed;
+  reference.RegionGrowing3D(reference_seed, 500);
+  QVERIFY(reference.CalculateDepthBufferFromMesh(rotation).Ok() && reference.RenderDepthBuffer().Ok());
+  std::vector<uint32_t> const region_frame = read_frame();
+
+  RenderServer server;
+  QVERIFY(server.Start("mylib_render_test").Ok());
+  QVERIFY(server.Start("mylib_render_test").code() == StatusCode::SERVER_ERROR);
+
+  // Stand-in viewers that open the same study and render it concurrently; sockets belong in threads started by QThread
+  int const viewers = 4;
+  int const renders = 10;
+  struct ViewerResult {
+	bool connected{false};
+	int dataset{-1};
+	int frames_matching{0};
+	int largest_batch{0};
+  };
+  std::vector<ViewerResult> results(viewers);
+  std::vector<std::unique_ptr<QThread>> threads;
+  for (int viewer = 0; viewer < viewers; ++viewer) {
+	threads.emplace_back(QThread::create([&, viewer] {
+	  RenderClient client;
+	  ViewerResult &result = results[viewer];
+	  result.connected = client.Connect("mylib_render_test").Ok();
+	  if (!result.connected || !client.OpenDataset("render_server_test", result.dataset).Ok()) {
+		return;
+	  }
+	  for (int i = 0; i < renders; ++i) {
+		if (client.RenderSurface(result.dataset, 500).Ok() && client.LastReply().width == size
+		  && std::equal(surface_frame.begin(), surface_frame.end(), client.Frame())) {
+		  ++result.frames_matching;
+		}
+		result.largest_batch = std::max(result.largest_batch, client.LastReply().batch_size);
+	  }
+	}));
+	threads.back()->start();
+  }
+  for (auto &thread : threads) {
+	thread->wait();
+  }
+  for (ViewerResult const &result : results) {
+	QVERIFY(result.connected && result.dataset == 0);
+	QVERIFY2(result.frames_matching == renders, "Frame in the framebuffer differs from a local render");
+  }
+  QVERIFY2(server.DatasetCount() == 1, "Every viewer loaded its own copy of the study");
+  QVERIFY(server.ServedRequests() == viewers * (renders + 1));
+  // Viewers that send while the render thread is busy are answered by one computation
+  QVERIFY(server.ComputedRequests() < server.ServedRequests());
+  QVERIFY(std::any_of(results.begin(), results.end(), [](ViewerResult const &r) { return r.largest_batch > 1; }));
+
+  // A segmentation of one viewer is seen by another one
+  RenderClient surgeon;
+  RenderClient assistant;
+  int dataset = -1;
+  QVERIFY(surgeon.Connect("mylib_render_test").Ok() && assistant.Connect("mylib_render_test").Ok());
+  QVERIFY(surgeon.LastReply().client != assistant.LastReply().client);
+  QVERIFY(surgeon.OpenDataset("render_server_test", dataset).Ok() && dataset == 0);
+  QVERIFY(surgeon.SegmentRegion(dataset, seed, 500, rotation).Ok());
+  QVERIFY(std::equal(region_frame.begin(), region_frame.end(), surgeon.Frame()));
+  QVERIFY(assistant.RenderRegion(dataset, rotation).Ok());
+  QVERIFY(std::equal(region_frame.begin(), region_frame.end(), assistant.Frame()));
+  QVERIFY(server.ClientCount() == 2);
+
+  QVERIFY(assistant.RenderSurface(3, 500).code() == StatusCode::SERVER_ERROR);
+  QVERIFY(assistant.SegmentRegion(dataset, Eigen::Vector3i(0, 0, slices), 500, rotation).code()
+			== StatusCode::BAD_SEED_ERROR);
+  QVERIFY(assistant.OpenDataset("render_server_missing", dataset).code() == StatusCode::FOPEN_ERROR);
+  QVERIFY(assistant.IsConnected());
+  RenderClient stranger;
+  QVERIFY(stranger.Connect("mylib_render_missing").code() == StatusCode::SERVER_ERROR && !stranger.IsConnected());
+
+  server.Stop();
+  QVERIFY(surgeon.RenderSurface(0, 500).code() == StatusCode::SERVER_ERROR && !surgeon.IsConnected());
+  QVERIFY(server.ClientCount() == 0);
+  QVERIFY(QDir("render_server_test").removeRecursively());
+}
+
+void MyLibUnitTest::RenderServerBenchmark() {
+  // Four viewers of one 256 x 256 x 128 study that keep asking for the surface at the same threshold
+  QVERIFY(WriteDicomBall("render_server_benchmark", 256, 128));
+  RenderServer server;
+  QVERIFY(server.Start("mylib_render_benchmark").Ok());
+  std::vector<std::unique_ptr<RenderClient>> clients;
+  std::vector<int> datasets(4, -1);
+  for (size_t i = 0; i < datasets.size(); ++i) {
+	clients.emplace_back(new RenderClient());
+	QVERIFY(clients.back()->Connect("mylib_render_benchmark").Ok());
+	QVERIFY(clients.back()->OpenDataset("render_server_benchmark", datasets[i]).Ok());
+  }
+  QBENCHMARK {
+	std::vector<std::unique_ptr<QThread>> threads;
+	for (size_t i = 0; i < clients.size(); ++i) {
+	  threads.emplace_back(QThread::create([&, i] {
+		for (int frame = 0; frame < 10; ++frame) {
+		  if (!clients[i]->RenderSurface(datasets[i], 500).Ok()) {
+			return;
+		  }
+		}
+	  }));
+	  threads.back()->start();
+	}
+	for (auto &thread : threads) {
+	  thread->wait();
+	}
+  }
+  clients.clear();
+  server.Stop();
+  QVERIFY(QDir("render_server_benchmark").removeRecursively());
+}
+
+void MyLibUnitTest::RegionConnectivityTest() {
+  QVERIFY((voxel_kernels::LinearOffsets<6>(10, 20)[5] == 200 && voxel_kernels::LinearOffsets<26>(10, 20)[25] == 211));
+
+  // A vessel that only touches along edges is cut by 6-connectivity, one that touches at corners also by 18
+  QVERIFY((GrowAlongVessel<int16_t, 6>(false, -1000) == 1 && GrowAlongVessel<int16_t, 18>(false, -1000) == 12));
+  QVERIFY((GrowAlongVessel<int16_t, 18>(true, -1000) == 1 && GrowAlongVessel<int16_t, 26>(true, -1000) == 12));
+  QVERIFY((GrowAlongVessel<uint8_t, 18>(false, 0) == 12 && GrowAlongVessel<uint8_t, 26>(true, 0) == 12));
+  QVERIFY((GrowAlongVessel<uint16_t, 6>(true, 0) == 1 && GrowAlongVessel<uint16_t, 26>(true, 0) == 12));
+  QVERIFY((GrowAlongVessel<float, 18>(false, -0.5) == 12 && GrowAlongVessel<float, 26>(true, -0.5) == 12));
+
+  // The 6-connected kernel labels exactly like a bounds-checked flood fill over MyLib::FindNeighbors3D, including the
+  // visited voxels below the threshold and a region that reaches the border of the volume
+  int const width = 23;
+  int const height = 17;
+  int const layers = 11;
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> noise(-1000, 1000);
+  std::vector<int16_t> volume(width * height * layers);
+  for (auto &value : volume) {
+	value = static_cast<int16_t>(noise(rng));
+  }
+  Eigen::Vector3i const seed(0, 0, 0);
+  std::vector<int> expected(volume.size(), 0);
+  std::vector<Eigen::Vector3i> stack{seed};
+  std::vector<Eigen::Vector3i> neighbors;
+  expected[0] = 1;
+  while (!stack.empty()) {
+	Eigen::Vector3i const voxel = stack.back();
+	stack.pop_back();
+	MyLib::FindNeighbors3D(voxel, neighbors);
+	for (auto const &nb : neighbors) {
+	  if ((nb.array() < 0).any() || nb.x() >= width || nb.y() >= height || nb.z() >= layers) {
+		continue;
+	  }
+	  int &label = expected[nb.x() + nb.y() * width + nb.z() * width * height];
+	  if (label == 0) {
+		label = volume[nb.x() + nb.y() * width + nb.z() * width * height] >= -300 ? 1 : 2;
+		if (label == 1) {
+		  stack.push_back(nb);
+		}
+	  }
+	}
+  }
+  QVERIFY(std::count(expected.begin(), expected.end(), 1) > 100);
+  std::vector<int> labels(volume.size(), 0);
+  voxel_kernels::GrowRegion<int16_t, 6>(volume.data(), width, height, layers, seed, -300, labels.data());
+  QVERIFY2(labels == expected, "6-connected region differs from the reference flood fill");
+
+  // The runtime selection runs the same instantiation, for every voxel type
+  std::vector<float> volume_float(volume.begin(), volume.end());
+  std::vector<int> selected(volume.size(), 0);
+  voxel_kernels::SelectRegionGrowing(VoxelType::FLOAT, Connectivity::FACES)(volume_float.data(), width, height,
+																			  layers, seed, -300, selected.data());
+  QVERIFY(selected == expected);
+  std::fill(selected.begin(), selected.end(), 0);
+  std::fill(labels.begin(), labels.end(), 0);
+  voxel_kernels::SelectRegionGrowing(VoxelType::INT16, Connectivity::CORNERS)(volume.data(), width, height, layers,
+																			   seed, -300, selected.data());
+  voxel_kernels::GrowRegion<int16_t, 26>(volume.data(), width, height, layers, seed, -300, labels.data());
+  QVERIFY(selected == labels);
+  QVERIFY(std::count(labels.begin(), labels.end(), 1) >= std::count(expected.begin(), expected.end(), 1));
+
+  // Thresholds beyond the range of the voxel type, and a seed outside the volume
+  std::vector<uint8_t> volume_byte(volume.size(), 255);
+  std::fill(labels.begin(), labels.end(), 0);
+  voxel_kernels::GrowRegion<uint8_t, 6>(volume_byte.data(), width, height, layers, seed, 300, labels.data());
+  QVERIFY(std::count(labels.begin(), labels.end(), 1) == 1);
+  std::fill(labels.begin(), labels.end(), 0);
+  voxel_kernels::GrowRegion<uint8_t, 18>(volume_byte.data(), width, height, layers, seed, -5, labels.data());
+  QVERIFY(std::all_of(labels.begin(), labels.end(), [](int label) { return label == 1; }));
+  std::fill(labels.begin(), labels.end(), 0);
+  voxel_kernels::GrowRegion<uint8_t, 6>(volume_byte.data(), width, height, layers, Eigen::Vector3i(0, height, 0), 0,
+										labels.data());
+  QVERIFY(std::all_of(labels.begin(), labels.end(), [](int label) { return label == 0; }));
+
+  // The dataset grows over the connectivity it is set to
+  QVERIFY(QDir().mkpath("connectivity_test"));
+  int const size = 24;
+  for (int z = 0; z < size; ++z) {
+	std::vector<uint16_t> pixels(size * size, 24);
+	pixels[z + z * size] = 1524;
+	QVERIFY(WriteDicomSlice(QString("connectivity_test/slice_") + QString::number(z) + ".dcm", true, "1.2.3.8", z, z,
+							size, size, pixels, -1024));
+  }
+  CTDataset dataset;
+  QVERIFY(dataset.ImportDicomSeries("connectivity_test").Ok());
+  QVERIFY(dataset.GetRegionConnectivity() == Connectivity::FACES);
+  Eigen::Vector3i vessel_seed(3, 3, 3);
+  dataset.RegionGrowing3D(vessel_seed, 300);
+  QVERIFY(dataset.ExtractPointsInRegion().value().size() == 1);
+  dataset.SetRegionConnectivity(Connectivity::CORNERS);
+  dataset.RegionGrowing3D(vessel_seed, 300);
+  QVERIFY2(dataset.ExtractPointsInRegion().value().size() == static_cast<size_t>(size),
+		   "26-connected region growing did not follow the diagonal vessel");
+  QVERIFY(dataset.ExtractSurfacePoints().value().size() == static_cast<size_t>(size));
+  QVERIFY(QDir("connectivity_test").removeRecursively());
+}
+
+void MyLibUnitTest::RegionConnectivityBenchmark() {
+  std::vector<int16_t> data(512 * 512 * 256);
+  FillPhantom(data.data(), 512, 512, 256);
+  std::vector<int> labels(data.size());
+  Eigen::Vector3i const seed(256, 256, 128);
+  QBENCHMARK {
+	for (Connectivity connectivity : {Connectivity::FACES, Connectivity::EDGES, Connectivity::CORNERS}) {
+	  std::fill(labels.begin(), labels.end(), 0);
+	  voxel_kernels::SelectRegionGrowing(VoxelType::INT16, connectivity)(data.data(), 512, 512, 256, seed, 0,
+																		  labels.data());
+	}
+  }
+  QVERIFY(labels[256 + 256 * 512 + 128 * 512 * 512] == voxel_kernels::kRegion);
+}
+
+void MyLibUnitTest::GuardedBufferTest() {
+  GuardedBuffer<int> image;
+  QVERIFY(image.Empty());
+  image.Allocate(5, 4, 1, 2, 7, -9);
+  StridedView<int> view = image.View();
+  QVERIFY((view.row_stride == 9 && view.slice_stride == 72 && view.guard == 2));
+  QVERIFY((view(0, 0) == 7 && view(4, 3) == 7 && view(-2, -2) == -9 && view(6, 5) == -9 && view(-1, 2) == -9));
+  QVERIFY((view.Contains(4, 3) && !view.Contains(5, 0) && !view.Contains(0, -1) && !view.Contains(0, 0, 1)));
+  for (int y = 0; y < 4; ++y) {
+	for (int x = 0; x < 5; ++x) {
+	  view(x, y) = x + 10 * y;
+	}
+  }
+  std::vector<int> dense(20);
+  StridedView<const int>(view).CopyTo(dense.data());
+  QVERIFY((dense[7] == 12 && dense[19] == 34));
+  image.ReplicateEdges();
+  QVERIFY((view(-2, -2) == 0 && view(-1, 1) == 10 && view(6, 2) == 24 && view(6, 5) == 34 && view(2, 5) == 32));
+  image.Reset(3);
+  QVERIFY((view(2, 2) == 3 && view(-1, 1) == -9 && view(5, 3) == -9));
+
+  // A volume has guard layers before the first and after the last slice as well
+  GuardedBuffer<int> labels;
+  labels.Allocate(6, 5, 4, 1, 1, 0);
+  QVERIFY((labels.View().slice_stride == 56 && labels.View()(0, 0, -1) == 0 && labels.View()(5, 4, 4) == 0));
+
+  // A region on the image border is splatted into the guard band, not into the opposite edge of the next row
+  CTDataset dataset;
+  int16_t *data = dataset.Data();
+  std::fill_n(data, 512 * 512 * 256, static_cast<int16_t>(-1000));
+  for (int z = 100; z < 130; ++z) {
+	for (int y = 0; y < 40; ++y) {
+	  for (int x = 0; x < 4; ++x) {
+		data[x + y * 512 + z * 512 * 512] = 500;
+	  }
+	}
+  }
+  Eigen::Vector3i seed(1, 20, 115);
+  dataset.RegionGrowing3D(seed, 300);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  StridedView<const int> const depth = dataset.GetDepthBuffer();
+  QVERIFY((depth.row_stride == 512 + 2 * CTDataset::kImageGuard && depth(0, 0) >= 100 && depth(0, 0) < 130));
+  bool last_column_empty = true;
+  for (int y = 0; y < 512; ++y) {
+	last_column_empty &= depth(511, y) == 255;
+  }
+  QVERIFY2(last_column_empty, "Splats on the left border wrapped around to the previous row");
+
+  // Background pixels are shaded from clamped neighbours, as before the guard band
+  QVERIFY(dataset.RenderDepthBuffer().Ok());
+  std::vector<int> flat(512 * 512);
+  depth.CopyTo(flat.data());
+  bool clamped = true;
+  for (int y = 0; y < 512; ++y) {
+	for (int x = 0; x < 512; ++x) {
+	  if (flat[x + y * 512] != 255) {
+		continue;
+	  }
+	  int const t_x = flat[std::min(x + 1, 511) + y * 512] - flat[std::max(x - 1, 0) + y * 512];
+	  int const t_y = flat[x + std::min(y + 1, 511) * 512] - flat[x + std::max(y - 1, 0) * 512];
+	  int const shade = static_cast<int>(255.0 * 16 * (1 / std::sqrt(16.0 * t_x * t_x + 16.0 * t_y * t_y + 256)));
+	  clamped &= dataset.GetRenderedDepthBuffer()[x + y * 512] == shade;
+	}
+  }
+  QVERIFY2(clamped, "Shading of border pixels differs from clamped neighbours");
+
+  // Every covered pixel of a region in the first column gets the ID of a region voxel, not the one of the guard band
+  std::fill_n(data, 512 * 512 * 256, static_cast<int16_t>(-1000));
+  for (int z = 100; z < 130; ++z) {
+	for (int y = 0; y < 40; ++y) {
+	  data[y * 512 + z * 512 * 512] = 500;
+	}
+  }
+  seed = Eigen::Vector3i(0, 20, 115);
+  dataset.RegionGrowing3D(seed, 300);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  StridedView<const int> const ids = dataset.GetIdBuffer();
+  bool border_ids = true;
+  for (int y = 0; y < 512; ++y) {
+	for (int x = 0; x < 2; ++x) {
+	  if (depth(x, y) != 255) {
+		border_ids &= ids(x, y) >= 0 && data[ids(x, y)] == 500;
+	  }
+	}
+  }
+  QVERIFY2(border_ids, "Covered border pixels took the ID of the guard band");
+}
+
+void MyLibUnitTest::SurfaceClustersTest() {
+  SurfaceClusters clusters;
+  QVERIFY(clusters.Build({}, {}).code() == StatusCode::BUFFER_EMPTY && clusters.Empty());
+
+  // Shell of a ball with exact gradient normals, which point to its center
+  Eigen::Vector3f const ball_center(64.0f, 64.0f, 64.0f);
+  std::vector<Eigen::Vector3i> points;
+  std::vector<uint16_t> normals;
+  for (int z = 0; z < 128; ++z) {
+	for (int y = 0; y < 128; ++y) {
+	  for (int x = 0; x < 128; ++x) {
+		Eigen::Vector3f const offset = Eigen::Vector3f(x, y, z) - ball_center;
+		if (std::abs(offset.norm() - 60.0f) < 0.5f) {
+		  points.emplace_back(x, y, z);
+		  normals.push_back(NormalVolume::EncodeNormal(-offset.x(), -offset.y(), -offset.z()));
+		}
+	  }
+	}
+  }
+  QVERIFY(clusters.Build(points, normals).Ok());
+  QVERIFY(clusters.PointCount() == points.size() && clusters.Clusters().size() > 50);
+  std::vector<uint32_t> sorted_order = clusters.Order();
+  std::sort(sorted_order.begin(), sorted_order.end());
+  bool permutation = true;
+  for (size_t i = 0; i < sorted_order.size(); ++i) {
+	permutation &= sorted_order[i] == i;
+  }
+  QVERIFY2(permutation, "The clusters do not contain every point exactly once");
+
+  // Culling never rejects a point that faces the viewer or projects into the image, and rejects the back half
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+  for (int view = 0; view < 8; ++view) {
+	Eigen::Matrix3f const rotation = (Eigen::AngleAxisd(angle(rng), Eigen::Vector3d::UnitX())
+	  * Eigen::AngleAxisd(angle(rng), Eigen::Vector3d::UnitY())).toRotationMatrix().cast<float>();
+	size_t culled = 0;
+	bool sound = true;
+	for (SurfaceCluster const &cluster : clusters.Clusters()) {
+	  bool const outside_sphere = std::any_of(
+		  clusters.Order().begin() + cluster.begin, clusters.Order().begin() + cluster.end, [&](uint32_t i) {
+			return (points[i].cast<float>() - cluster.center).norm() > cluster.radius;
+		  });
+	  sound &= !outside_sphere;
+	  if (SurfaceClusters::MayBeVisible(cluster, rotation, ball_center, 128, 128, 128)) {
+		continue;
+	  }
+	  culled += cluster.end - cluster.begin;
+	  for (uint32_t k = cluster.begin; k < cluster.end; ++k) {
+		Eigen::Vector3f const normal = rotation * (ball_center - points[clusters.Order()[k]].cast<float>());
+		sound &= normal.z() < 0.0f;
+	  }
+	}
+	QVERIFY2(sound, "A cluster that faces the viewer was culled");
+	QVERIFY2(culled > points.size() / 3, "Too few back-facing points culled");
+  }
+
+  // View culling: the ball is moved half out of a small image
+  size_t culled = 0;
+  for (SurfaceCluster const &cluster : clusters.Clusters()) {
+	if (!SurfaceClusters::MayBeVisible(cluster, Eigen::Matrix3f::Identity(), ball_center, 64, 128, 128)
+	  && cluster.cone_cutoff > -1.0f) {
+	  for (uint32_t k = cluster.begin; k < cluster.end; ++k) {
+		culled += points[clusters.Order()[k]].x() >= 64 ? 1 : 0;
+	  }
+	}
+  }
+  QVERIFY(culled > points.size() / 4);
+
+  // Without normals only view culling remains
+  QVERIFY(clusters.Build(points, {}).Ok());
+  QVERIFY(std::all_of(clusters.Clusters().begin(), clusters.Clusters().end(),
+					  [](SurfaceCluster const &cluster) { return cluster.cone_cutoff < -1.0f; }));
+
+  // The splat renderer keeps the silhouette and the front surface. Without culling, the arms of the splats of the far
+  // side leak through the near side, since they are not depth tested.
+  CTDataset dataset;
+  GrowPhantomRegion(dataset);
+  QVERIFY(dataset.GetSurfaceClusters().PointCount() == dataset.ExtractSurfacePoints().value().size());
+  Eigen::Matrix3d const rotation = Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 2, 0).normalized()).toRotationMatrix();
+  std::vector<int> culled_depth(512 * 512);
+  std::vector<int> full_depth(512 * 512);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  dataset.GetDepthBuffer().CopyTo(culled_depth.data());
+  Eigen::Vector3i voxel;
+  QVERIFY(dataset.PickVoxel(256, 256, voxel).Ok() && dataset.GetGreyValue(voxel) == 1200);
+  QVERIFY2((rotation * (voxel.cast<double>() - Eigen::Vector3d(256, 256, 128))).z() < -50.0,
+		   "The picked voxel is not on the near side");
+  dataset.SetClusterCullingEnabled(false);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  dataset.GetDepthBuffer().CopyTo(full_depth.data());
+  dataset.SetClusterCullingEnabled(true);
+  int foreground_culled = 0;
+  int foreground_full = 0;
+  int nearer = 0;
+  int farther = 0;
+  for (int i = 0; i < 512 * 512; ++i) {
+	foreground_culled += culled_depth[i] != 255 ? 1 : 0;
+	foreground_full += full_depth[i] != 255 ? 1 : 0;
+	nearer += culled_depth[i] < full_depth[i] - 2 ? 1 : 0;
+	farther += culled_depth[i] > full_depth[i] + 2 ? 1 : 0;
+  }
+  QVERIFY2(std::abs(foreground_culled - foreground_full) < foreground_full / 200, "Culling changed the silhouette");
+  QVERIFY2(farther * 10 < nearer, "Culling removed parts of the near side");
+
+  // Undo drops the clusters, and the next render rebuilds them for the older region
+  Eigen::Vector3i shell_seed(256, 256, 128 + 90);
+  dataset.RegionGrowing3D(shell_seed, 1000);
+  size_t const shell_points = dataset.GetSurfaceClusters().PointCount();
+  QVERIFY(dataset.UndoRegion().Ok());
+  QVERIFY(dataset.GetSurfaceClusters().Empty());
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(dataset.GetSurfaceClusters().PointCount() == dataset.ExtractSurfacePoints().value().size());
+  QVERIFY(dataset.RedoRegion().Ok());
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(dataset.GetSurfaceClusters().PointCount() == shell_points);
+  QVERIFY(dataset.GetTemporalSplatStats().projected_points < shell_points);
+
+  // Surface points recomputed without their clusters are splatted one by one, although their number is unchanged
+  QVERIFY(dataset.FindSurfacePoints().Ok());
+  QVERIFY(dataset.GetSurfaceClusters().PointCount() == shell_points);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY2(dataset.GetTemporalSplatStats().projected_points == shell_points, "Stale clusters were used for culling");
+}
+
+void MyLibUnitTest::SurfaceClustersBenchmark() {
+  CTDataset dataset;
+  GrowPhantomRegion(dataset);
+  Eigen::Matrix3d const rotation = Eigen::AngleAxisd(0.4, Eigen::Vector3d(1, 1, 0).normalized()).toRotationMatrix();
+  QBENCHMARK {
+	QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  }
+}
+
+void MyLibUnitTest::TemporalReprojectionTest() {
+  CTDataset dataset;
+  GrowPhantomRegion(dataset);
+
+  // Without a previous frame the first update splats every cluster
+  Eigen::Matrix3d rotation = Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 0).normalized()).toRotationMatrix();
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(dataset.GetTemporalSplatStats().full_refresh);
+  size_t const full_points = dataset.GetTemporalSplatStats().projected_points;
+
+  // A drag of one degree per frame reprojects the points seen before and splats the clusters at the gaps only
+  for (int frame = 0; frame < CTDataset::kTemporalRefreshFrames; ++frame) {
+	rotation = Eigen::AngleAxisd(M_PI / 180.0, Eigen::Vector3d::UnitY()) * rotation;
+	QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(rotation).Ok());
+	TemporalSplatStats const &stats = dataset.GetTemporalSplatStats();
+	QVERIFY(!stats.full_refresh && stats.reprojected_points > 0 && stats.stale_tiles > 0);
+	QVERIFY2(stats.projected_points * 4 < full_points * 3, "The frame was not reprojected");
+  }
+  std::vector<int> temporal_depth(512 * 512);
+  std::vector<int> full_depth(512 * 512);
+  dataset.GetDepthBuffer().CopyTo(temporal_depth.data());
+  Eigen::Vector3i voxel;
+  QVERIFY(dataset.PickVoxel(256, 256, voxel).Ok() && dataset.GetGreyValue(voxel) == 1200);
+
+  // The next frame starts from scratch, so it shows how far the reprojected frames have drifted
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(dataset.GetTemporalSplatStats().full_refresh);
+  dataset.GetDepthBuffer().CopyTo(full_depth.data());
+  int foreground_full = 0;
+  int silhouette = 0;
+  int different = 0;
+  for (int i = 0; i < 512 * 512; ++i) {
+	foreground_full += full_depth[i] != 255 ? 1 : 0;
+	silhouette += (temporal_depth[i] != 255) != (full_depth[i] != 255) ? 1 : 0;
+	different += temporal_depth[i] != 255 && full_depth[i] != 255 && std::abs(temporal_depth[i] - full_depth[i]) > 4
+				 ? 1 : 0;
+  }
+  QVERIFY2(silhouette < foreground_full / 100, "The silhouette differs");
+  // Where the surface is steep, the arms of the crosses of hidden points decide the depth of a few pixels in a hundred
+  QVERIFY2(different < foreground_full / 25, "The depths differ from a frame splatted from scratch");
+
+  // The tiles to splat again grow with the rotation between the frames
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(
+	Eigen::AngleAxisd(M_PI / 180.0, Eigen::Vector3d::UnitY()) * rotation).Ok());
+  int const small_step_tiles = dataset.GetTemporalSplatStats().stale_tiles;
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(
+	Eigen::AngleAxisd(4.0 * M_PI / 180.0, Eigen::Vector3d::UnitY()) * rotation).Ok());
+  QVERIFY(!dataset.GetTemporalSplatStats().full_refresh);
+  QVERIFY(dataset.GetTemporalSplatStats().stale_tiles > small_step_tiles);
+
+  // Large rotations, other depth buffers and disabled culling start from scratch
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY(dataset.GetTemporalSplatStats().full_refresh);
+  QVERIFY(dataset.CalculateDepthBuffer(0).Ok());
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY(dataset.GetTemporalSplatStats().full_refresh);
+  dataset.SetClusterCullingEnabled(false);
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(Eigen::Matrix3d::Identity()).Ok());
+  QVERIFY(dataset.GetTemporalSplatStats().full_refresh);
+  dataset.SetClusterCullingEnabled(true);
+
+  // The inner wall of the shell is hidden behind the outer one, so a reprojected frame skips it
+  Eigen::Vector3i shell_seed(256, 256, 128 + 90);
+  dataset.RegionGrowing3D(shell_seed, 1000);
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  size_t const shell_points = dataset.GetTemporalSplatStats().projected_points;
+  rotation = Eigen::AngleAxisd(M_PI / 180.0, Eigen::Vector3d::UnitY()) * rotation;
+  QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(rotation).Ok());
+  QVERIFY(!dataset.GetTemporalSplatStats().full_refresh);
+  QVERIFY2(dataset.GetTemporalSplatStats().projected_points * 2 < shell_points, "Hidden clusters were splatted");
+}
+
+void MyLibUnitTest::TemporalReprojectionBenchmark() {
+  CTDataset dataset;
+  GrowPhantomRegion(dataset);
+  Eigen::Matrix3d rotation = Eigen::AngleAxisd(0.4, Eigen::Vector3d(1, 1, 0).normalized()).toRotationMatrix();
+  QVERIFY(dataset.CalculateDepthBufferFromRegionGrowing(rotation).Ok());
+  Eigen::Matrix3d const step = Eigen::AngleAxisd(M_PI / 180.0, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  QBENCHMARK {
+	rotation = step * rotation;
+	QVERIFY(dataset.UpdateDepthBufferFromRegionGrowing(rotation).Ok());
+  }
+}
+
 QTEST_APPLESS_MAIN(MyLibUnitTest)
 
 #include "tst_mylibunittest.moc"
@@ -1,8 +1,22 @@
 #include <QApplication>
+#include <QCoreApplication>
+#include <QDebug>
 
+#include "render_server.h"
 #include "widget.h"
 
 int main(int argc, char *argv[]) {
+  // "--render-server <name>" runs headless: the studies stay resident and viewers connect through the local socket
+  if (argc == 3 && QString(argv[1]) == "--render-server") {
+	QCoreApplication a(argc, argv);
+	RenderServer server;
+	if (!server.Start(argv[2]).Ok()) {
+	  qCritical() << "The render server could not listen on" << argv[2];
+	  return 1;
+	}
+	return a.exec();
+  }
+
   QApplication a(argc, argv);
   Widget w;
   w.show();
@@ -6,11 +6,14 @@
 Widget::Widget(QWidget *parent)
   : QWidget(parent),
 	ui(new Ui::Widget),
+	m_sliceCache(m_ctimage),
 	m_labelAtCursor(new QLabel(this)),
 	m_qImage_2d(QImage(512, 512, QImage::Format_RGB32)),
 	m_qImage(QImage(512, 512, QImage::Format_RGB32)) {
-  // Initialize rotation matrix
+  // Initialize rotation matrix and slice geometry
   m_rotationMat.setIdentity();
+  m_slicePlane = m_ctimage.GetSlicePlane(m_sliceOrientation, 0);
+  CTDataset::CreateTransferFunctionLUT(CTDataset::DefaultTransferFunction(), m_transferFunctionLUT);
 
   // Housekeeping
   ui->setupUi(this);
@@ -34,6 +37,14 @@ Widget::Widget(QWidget *parent)
   connect(ui->pushButton_safeArea, SIGNAL(clicked()), this, SLOT(SelectSafeArea()));
   connect(ui->pushButton_writeAreas, SIGNAL(clicked()), this, SLOT(WriteAreasToFile()));
   connect(ui->pushButton_startCalib, SIGNAL(clicked()), this, SLOT(StartTransformationMatrixCalibration()));
+  connect(ui->pushButton_importDicom, SIGNAL(clicked()), this, SLOT(ImportDicomSeries()));
+  connect(ui->pushButton_loadCine, SIGNAL(clicked()), this, SLOT(LoadCineSeries()));
+  connect(ui->pushButton_playCine, SIGNAL(clicked()), this, SLOT(ToggleCinePlayback()));
+
+  // 4D playback advances by one phase per tick
+  m_cineTimer.setTimerType(Qt::PreciseTimer);
+  m_cineTimer.setInterval(kCineFrameInterval);
+  connect(&m_cineTimer, SIGNAL(timeout()), this, SLOT(ShowNextCinePhase()));
 
   // Horizontal sliders
   connect(ui->horizontalSlider_threshold, SIGNAL(valueChanged(int)), this,
@@ -47,6 +58,20 @@ Widget::Widget(QWidget *parent)
   connect(ui->verticalSlider_depth, SIGNAL(valueChanged(int)), this,
 		  SLOT(UpdateDepthValue(int)));
 
+  // Combo boxes
+  connect(ui->comboBox_orientation, SIGNAL(currentIndexChanged(int)), this,
+		  SLOT(UpdateSliceOrientation(int)));
+  connect(ui->comboBox_renderMode, SIGNAL(currentIndexChanged(int)), this,
+		  SLOT(UpdateRenderMode(int)));
+  connect(ui->comboBox_prefilter, SIGNAL(currentIndexChanged(int)), this,
+		  SLOT(UpdatePrefilter(int)));
+  connect(ui->comboBox_regionRenderer, SIGNAL(currentIndexChanged(int)), this,
+		  SLOT(UpdateRegionRenderer(int)));
+
+  // Keyboard shortcuts
+  connect(new QShortcut(QKeySequence::Undo, this), SIGNAL(activated()), this, SLOT(UndoRegionGrowing()));
+  connect(new QShortcut(QKeySequence::Redo, this), SIGNAL(activated()), this, SLOT(RedoRegionGrowing()));
+
   // Initial slider values
   ui->horizontalSlider_center->setValue(0);
   ui->horizontalSlider_windowSize->setValue(1200);
@@ -56,6 +81,10 @@ Widget::Widget(QWidget *parent)
   // Fill 3D image area
   ui->label_image3D->setPixmap(QPixmap::fromImage(m_qImage));
   ui->label_imgArea->setPixmap(QPixmap::fromImage(m_qImage_2d));
+
+  // Coronal and sagittal slices are not square, keep them at the origin of the label so that cursor positions map
+  // directly to slice pixels
+  ui->label_imgArea->setAlignment(Qt::AlignLeft | Qt::AlignTop);
 }
 
 Widget::~Widget() {
@@ -71,24 +100,51 @@ void Widget::Update2DSlice() {
   int center = ui->horizontalSlider_center->value();
   int window_size = ui->horizontalSlider_windowSize->value();
 
+  const int16_t *hu_values = nullptr;
+  const uint8_t *grey_values = nullptr;
+  if (m_sliceOrientation == SliceOrientation::OBLIQUE) {
+	// Oblique slices follow the rotation of the 3D view and bypass the slice cache
+	m_slicePlane = m_ctimage.GetSlicePlane(m_sliceOrientation, depth, m_rotationMat);
+	if (!m_ctimage.ExtractSlice(m_slicePlane, m_slice).Ok()
+	  || !CTDataset::CreateWindowingLUT(center, window_size, m_windowingLUT).Ok()) {
+	  return;
+	}
+	m_windowedSlice.resize(m_slice.size());
+	CTDataset::ApplyWindowingLUT(m_slice.data(), static_cast<int>(m_slice.size()), m_windowingLUT,
+								 m_windowedSlice.data());
+	hu_values = m_slice.data();
+	grey_values = m_windowedSlice.data();
+  } else {
+	if (!m_sliceCache.GetSlice(m_sliceOrientation, depth, center, window_size, m_cachedSlice).Ok()) {
+	  return;
+	}
+	m_slicePlane = m_cachedSlice->plane;
+	hu_values = m_cachedSlice->hu_values.data();
+	grey_values = m_cachedSlice->grey_values.data();
+  }
+
+  if (m_qImage_2d.width() != m_slicePlane.width || m_qImage_2d.height() != m_slicePlane.height) {
+	m_qImage_2d = QImage(m_slicePlane.width, m_slicePlane.height, QImage::Format_RGB32);
+  }
   for (int y = 0; y < m_qImage_2d.height(); ++y) {
+	auto *line = reinterpret_cast<QRgb *>(m_qImage_2d.scanLine(y));
 	for (int x = 0; x < m_qImage_2d.width(); ++x) {
-	  int raw_value =
-		m_ctimage.Data()[(x + y * m_qImage_2d.width()) +
-		  (m_qImage_2d.height() * m_qImage_2d.width() * depth)];
-	  if (raw_value > threshold) {
-		m_qImage_2d.setPixel(x, y, qRgb(255, 0, 0));
+	  int pos = x + y * m_qImage_2d.width();
+	  if (hu_values[pos] > threshold) {
+		line[x] = qRgb(255, 0, 0);
 		continue;
 	  }
-	  if (CTDataset::WindowInputValue(raw_value, center, window_size).Ok()) {
-		int windowed_value =
-		  CTDataset::WindowInputValue(raw_value, center, window_size).value();
-		m_qImage_2d.setPixel(x, y,
-							 qRgb(windowed_value, windowed_value, windowed_value));
-	  }
+	  int windowed_value = grey_values[pos];
+	  line[x] = qRgb(windowed_value, windowed_value, windowed_value);
 	}
   }
 
+  // Planning areas are picked in axial slices
+  if (m_sliceOrientation != SliceOrientation::AXIAL) {
+	ui->label_imgArea->setPixmap(QPixmap::fromImage(m_qImage_2d));
+	return;
+  }
+
   if (m_targetAreaHasBeenDrawn) {
 	QPainter painter(&m_qImage_2d);
 	painter.setPen(Qt::white);
@@ -104,6 +160,15 @@ void Widget::Update2DSlice() {
 }
 
 void Widget::Update3DRender() {
+  if (m_renderMode == RenderMode3D::VOLUME_RENDERING) {
+	ShowVolumeRendering();
+	return;
+  }
+  if (m_renderMode != RenderMode3D::SURFACE) {
+	UpdateProjection();
+	ShowProjection();
+	return;
+  }
   if (m_ctimage.CalculateDepthBuffer(ui->horizontalSlider_threshold->value()).Ok()) {
 	if (m_ctimage.RenderDepthBuffer().Ok()) {
 	  auto val = 0;
@@ -126,8 +191,18 @@ void Widget::UpdateRotationMatrix(QPoint const &position_delta) {
 	* m_rotationMat;
 }
 
-void Widget::RenderRegionGrowing() {
-  if (m_ctimage.CalculateDepthBufferFromRegionGrowing(m_rotationMat).Ok()) {
+void Widget::RenderRegionGrowing(bool reuse_frame) {
+  // The mesh renders without gaps at any rotation, but is extracted on the first render of every new region
+  Status depth_status(StatusCode::OK);
+  if (m_renderRegionMesh) {
+	depth_status = m_ctimage.CalculateDepthBufferFromMesh(m_rotationMat);
+  } else if (reuse_frame) {
+	// While dragging, the points of the previous frame are reprojected and only the clusters at its gaps are splatted
+	depth_status = m_ctimage.UpdateDepthBufferFromRegionGrowing(m_rotationMat);
+  } else {
+	depth_status = m_ctimage.CalculateDepthBufferFromRegionGrowing(m_rotationMat);
+  }
+  if (depth_status.Ok()) {
 	if (m_ctimage.RenderDepthBuffer().Ok()) {
 	  auto val = 0;
 	  for (int y = 0; y < m_qImage.height(); ++y) {
@@ -141,12 +216,51 @@ void Widget::RenderRegionGrowing() {
   ui->label_image3D->setPixmap(QPixmap::fromImage(m_qImage));
 }
 
+void Widget::UpdateProjection() {
+  auto mode = static_cast<ProjectionMode>(static_cast<int>(m_renderMode) - 1);
+  if (!m_ctimage.CalculateRotatedProjection(mode, m_rotationMat, m_projection).Ok()) {
+	m_projection.clear();
+  }
+}
+
+void Widget::ShowProjection() {
+  if (m_projection.size() != static_cast<size_t>(m_qImage.width() * m_qImage.height())
+	|| !CTDataset::CreateWindowingLUT(ui->horizontalSlider_center->value(), ui->horizontalSlider_windowSize->value(),
+									  m_windowingLUT).Ok()) {
+	return;
+  }
+  m_windowedProjection.resize(m_projection.size());
+  CTDataset::ApplyWindowingLUT(m_projection.data(), static_cast<int>(m_projection.size()), m_windowingLUT,
+							   m_windowedProjection.data());
+  for (int y = 0; y < m_qImage.height(); ++y) {
+	auto *line = reinterpret_cast<QRgb *>(m_qImage.scanLine(y));
+	for (int x = 0; x < m_qImage.width(); ++x) {
+	  int val = m_windowedProjection[x + y * m_qImage.width()];
+	  line[x] = qRgb(val, val, val);
+	}
+  }
+  ui->label_image3D->setPixmap(QPixmap::fromImage(m_qImage));
+}
+
+void Widget::ShowVolumeRendering() {
+  if (!m_ctimage.RenderVolume(m_transferFunctionLUT, m_rotationMat, m_volumeImage).Ok()) {
+	return;
+  }
+  for (int y = 0; y < m_qImage.height(); ++y) {
+	std::copy_n(m_volumeImage.data() + y * m_qImage.width(), m_qImage.width(),
+				reinterpret_cast<QRgb *>(m_qImage.scanLine(y)));
+  }
+  ui->label_image3D->setPixmap(QPixmap::fromImage(m_qImage));
+}
+
 void Widget::ShowLabelNextToCursor(QPoint const &cursor_global_pos, QPoint const &cursor_local_pos) {
+  Eigen::Vector3d voxel = m_slicePlane.origin + m_slicePlane.axis_u * cursor_local_pos.x()
+	+ m_slicePlane.axis_v * cursor_local_pos.y();
   m_labelAtCursor->show();
   m_labelAtCursor->move(cursor_global_pos + QPoint(-50, 40));
   m_labelAtCursor->setText(QString("(X: %1 | Y: %2 | Z: %3)")
-							 .arg(QString::number(cursor_local_pos.x()), QString::number(cursor_local_pos.y()),
-								  QString::number(ui->verticalSlider_depth->value())));
+							 .arg(QString::number(qRound(voxel.x())), QString::number(qRound(voxel.y())),
+								  QString::number(qRound(voxel.z()))));
   m_labelAtCursor->raise();
 }
 
@@ -156,13 +270,14 @@ void Widget::DrawCircleAtCursor(QPoint const &cursor_local_pos, Qt::GlobalColor
 
   auto current_radius = cursor_local_pos - m_currentMousePos2Dslice;
   painter.drawEllipse(m_currentMousePos2Dslice, current_radius.x(), current_radius.x());
-  ui->label_imgArea->setPixmap(QPixmap::fromImage(m_qImage_2d));
 
   if (m_selectTargetArea) {
 	m_targetArea.x() = m_currentMousePos2Dslice.x();
 	m_targetArea.y() = m_currentMousePos2Dslice.y();
 	m_targetArea.z() = ui->verticalSlider_depth->value();
 	m_targetArea.w() = std::abs(current_radius.x());
+	UpdateTrajectories();
+	DrawTrajectories(painter);
   }
   if (m_selectSafeArea) {
 	m_safeArea.x() = m_currentMousePos2Dslice.x();
@@ -170,11 +285,32 @@ void Widget::DrawCircleAtCursor(QPoint const &cursor_local_pos, Qt::GlobalColor
 	m_safeArea.z() = ui->verticalSlider_depth->value();
 	m_safeArea.w() = std::abs(current_radius.x());
   }
+  ui->label_imgArea->setPixmap(QPixmap::fromImage(m_qImage_2d));
+}
+
+void Widget::UpdateTrajectories() {
+  PlanningSphere safe_zone{m_safeArea.head<3>().cast<double>(), -1.0};
+  if (m_safeAreaHasBeenDrawn) {
+	safe_zone.radius = m_safeArea.w() * m_ctimage.GetVoxelSpacing().x();
+  }
+  if (!m_ctimage.PlanTrajectories(m_targetArea.head<3>().cast<double>(), safe_zone, m_trajectoryParameters,
+								  m_trajectories).Ok()) {
+	m_trajectories.clear();
+  }
+}
+
+void Widget::DrawTrajectories(QPainter &painter) {
+  // The best few paths, projected onto the axial slice
+  int const shown = std::min(5, static_cast<int>(m_trajectories.size()));
+  for (int i = shown - 1; i >= 0; --i) {
+	painter.setPen(i == 0 ? Qt::GlobalColor::yellow : Qt::GlobalColor::darkYellow);
+	painter.drawLine(m_targetArea.x(), m_targetArea.y(), static_cast<int>(std::lround(m_trajectories[i].entry.x())),
+					 static_cast<int>(std::lround(m_trajectories[i].entry.y())));
+  }
 }
 
 void Widget::PickCalibrationPoints() {
-  Eigen::Vector3i rotated_point(m_currentMousePos3DImage.x(), m_currentMousePos3DImage.y(), m_currentDepthAtCursor);
-  auto calib_point = m_rotationMat.transpose() * rotated_point.cast<double>();
+  Eigen::Vector3d calib_point = m_pickedVoxel.cast<double>();
   m_calibPoints.emplace_back(calib_point);
 
   switch (m_calibPoints.size()) {
@@ -249,44 +385,210 @@ void Widget::TransformSelectedAreas() {
   m_transformedSafeArea = m_transformationMatrix * safe_area_XYZ.cast<double>();
 }
 
+void Widget::ShowCineFrame(CineFrame const &frame) {
+  if (!CTDataset::CreateWindowingLUT(ui->horizontalSlider_center->value(), ui->horizontalSlider_windowSize->value(),
+									 m_windowingLUT).Ok()) {
+	return;
+  }
+  m_windowedSlice.resize(frame.slice.size());
+  CTDataset::ApplyWindowingLUT(frame.slice.data(), static_cast<int>(frame.slice.size()), m_windowingLUT,
+							   m_windowedSlice.data());
+
+  // Axial slices and the depth render both cover the xy-plane of the phase, which need not match the loaded dataset
+  if (m_qImage_2d.width() != frame.width || m_qImage_2d.height() != frame.height) {
+	m_qImage_2d = QImage(frame.width, frame.height, QImage::Format_RGB32);
+  }
+  if (m_qImageCine.width() != frame.width || m_qImageCine.height() != frame.height) {
+	m_qImageCine = QImage(frame.width, frame.height, QImage::Format_RGB32);
+  }
+  for (int y = 0; y < frame.height; ++y) {
+	auto *slice_line = reinterpret_cast<QRgb *>(m_qImage_2d.scanLine(y));
+	auto *render_line = reinterpret_cast<QRgb *>(m_qImageCine.scanLine(y));
+	for (int x = 0; x < frame.width; ++x) {
+	  int const pos = x + y * frame.width;
+	  int const grey = m_windowedSlice[pos];
+	  slice_line[x] = (frame.slice[pos] > frame.threshold) ? qRgb(255, 0, 0) : qRgb(grey, grey, grey);
+	  int const val = frame.rendered_image[pos];
+	  render_line[x] = qRgb(val, val, val);
+	}
+  }
+  ui->label_imgArea->setPixmap(QPixmap::fromImage(m_qImage_2d));
+  ui->label_image3D->setPixmap(QPixmap::fromImage(m_qImageCine));
+  ui->label_cinePhase->setText("Phase: " + QString::number(frame.phase + 1) + " / "
+								 + QString::number(m_cine.PhaseCount()));
+}
+
+int Widget::CineSliceLayer() const {
+  // Playback shows axial slices; from another orientation it starts in the middle of the volume
+  if (m_sliceOrientation == SliceOrientation::AXIAL) {
+	return ui->verticalSlider_depth->value();
+  }
+  return m_ctimage.GetSliceCount(SliceOrientation::AXIAL) / 2;
+}
+
 // =============== Slots ===============
 
 void Widget::LoadImage3D() {
+  if (m_cineIsPlaying) {
+	ToggleCinePlayback();
+  }
   QString img_path = QFileDialog::getOpenFileName(
 	this, "Open Image", "../external/images", "Raw Image Files (*.raw)");
 
+  // The prefetch thread must not read the image data while it is being replaced
+  m_sliceCache.Invalidate();
   if (!m_ctimage.load(img_path).Ok()) {
 	QMessageBox::critical(this, "Error",
 						  "The specified file could not be opened!");
 	m_render3dClicked = false;
 	return;
   }
+  // Normals for lit rendering are computed once per dataset
+  if (!m_ctimage.ComputeNormalVolume().Ok()) {
+	qDebug() << "Normal volume could not be computed!" << "\n";
+  }
+  // A DICOM series imported before may have left other dimensions behind
+  if (m_qImage.width() != CTDataset::kRawWidth || m_qImage.height() != CTDataset::kRawHeight) {
+	m_qImage = QImage(CTDataset::kRawWidth, CTDataset::kRawHeight, QImage::Format_RGB32);
+	m_qImage_2d = QImage(CTDataset::kRawWidth, CTDataset::kRawHeight, QImage::Format_RGB32);
+  }
 #ifdef ONLY_3DRENDER
   return;
 #endif
 
-  Update2DSlice();
+  // The slider range follows the number of slices, which a DICOM series may have changed
+  UpdateSliceOrientation(ui->comboBox_orientation->currentIndex());
+}
+
+void Widget::ImportDicomSeries() {
+  QString const directory = QFileDialog::getExistingDirectory(this, "Open DICOM Series", "../external/images");
+  if (directory.isEmpty()) {
+	return;
+  }
+  if (m_cineIsPlaying) {
+	ToggleCinePlayback();
+  }
+
+  // The prefetch thread must not read the image data while it is being replaced
+  m_sliceCache.Invalidate();
+  if (!m_ctimage.ImportDicomSeries(directory).Ok()) {
+	QMessageBox::critical(this, "Error", "The directory does not contain a supported DICOM series!");
+	m_render3dClicked = false;
+	return;
+  }
+  if (!m_ctimage.ComputeNormalVolume().Ok()) {
+	qDebug() << "Normal volume could not be computed!" << "\n";
+  }
+  // The series may have other dimensions than the raw images; the 3D view covers the axial plane
+  int const width = m_ctimage.GetSliceCount(SliceOrientation::SAGITTAL);
+  int const height = m_ctimage.GetSliceCount(SliceOrientation::CORONAL);
+  if (m_qImage.width() != width || m_qImage.height() != height) {
+	m_qImage = QImage(width, height, QImage::Format_RGB32);
+  }
+  UpdateSliceOrientation(ui->comboBox_orientation->currentIndex());
+  Update3DRender();
+  m_render3dClicked = true;
+  m_depthBufferIsRendered = true;
+  m_seedPicked = false;
+  m_regionGrowingIsRendered = false;
 }
 
 void Widget::UpdateWindowingCenter(int const val) {
   ui->label_sliderCenter->setText("Center: " + QString::number(val));
   Update2DSlice();
+  // The volume rendering uses its own transfer function instead of the window
+  if (m_render3dClicked && m_renderMode != RenderMode3D::SURFACE
+	&& m_renderMode != RenderMode3D::VOLUME_RENDERING) {
+	ShowProjection();
+  }
 }
 
 void Widget::UpdateWindowingWindowSize(int const val) {
   ui->label_sliderWSize->setText("Window Size: " + QString::number(val));
   Update2DSlice();
+  // The volume rendering uses its own transfer function instead of the window
+  if (m_render3dClicked && m_renderMode != RenderMode3D::SURFACE
+	&& m_renderMode != RenderMode3D::VOLUME_RENDERING) {
+	ShowProjection();
+  }
 }
 
 void Widget::UpdateDepthValue(int const val) {
   ui->label_currentDepth->setText("Depth: " + QString::number(val));
+  if (m_cineIsPlaying) {
+	if (!m_cine.SetRenderParameters(ui->horizontalSlider_threshold->value(), CineSliceLayer()).Ok()) {
+	  qDebug() << "Cine render parameters could not be changed!" << "\n";
+	}
+	return;
+  }
+  Update2DSlice();
+}
+
+void Widget::UpdateSliceOrientation(int const index) {
+  m_sliceOrientation = static_cast<SliceOrientation>(index);
+  int slice_count = m_ctimage.GetSliceCount(m_sliceOrientation);
+  // Block the slider signals, otherwise the range change would render an intermediate slice
+  ui->verticalSlider_depth->blockSignals(true);
+  ui->verticalSlider_depth->setMaximum(slice_count - 1);
+  ui->verticalSlider_depth->setValue(slice_count / 2);
+  ui->verticalSlider_depth->blockSignals(false);
+  ui->label_currentDepth->setText("Depth: " + QString::number(ui->verticalSlider_depth->value()));
+  Update2DSlice();
+}
+
+void Widget::UpdateRenderMode(int const index) {
+  m_renderMode = static_cast<RenderMode3D>(index);
+  if (m_render3dClicked) {
+	if (m_renderMode == RenderMode3D::SURFACE && m_regionGrowingIsRendered) {
+	  RenderRegionGrowing();
+	} else {
+	  Update3DRender();
+	}
+  }
+}
+
+void Widget::UpdateRegionRenderer(int const index) {
+  // Index 0 of the combo box splats the surface points, index 1 rasterizes the mesh
+  m_renderRegionMesh = index == 1;
+  if (m_render3dClicked && m_renderMode == RenderMode3D::SURFACE && m_regionGrowingIsRendered) {
+	RenderRegionGrowing();
+  }
+}
+
+void Widget::UpdatePrefilter(int const index) {
+  // The combo box lists the filters in the order of PrefilterType
+  PrefilterParameters params;
+  params.type = static_cast<PrefilterType>(index);
+  params.sigma = kPrefilterSigma;
+  // The prefetch thread must not read the filtered volume while it is being replaced
+  m_sliceCache.Invalidate();
+  if (!m_ctimage.SetPrefilter(params).Ok()) {
+	QMessageBox::warning(this, "Error!", "The prefilter could not be applied!");
+	return;
+  }
+  if (!m_ctimage.ComputeNormalVolume().Ok()) {
+	qDebug() << "Normal volume could not be computed!" << "\n";
+  }
   Update2DSlice();
+  if (m_render3dClicked) {
+	Update3DRender();
+  }
+  m_seedPicked = false;
+  m_regionGrowingIsRendered = false;
 }
 
 void Widget::UpdateThresholdValue(int const val) {
   ui->label_sliderThreshold->setText("Threshold: " + QString::number(val));
+  if (m_cineIsPlaying) {
+	// The prefetch thread of the series recomputes the upcoming phases
+	if (!m_cine.SetRenderParameters(val, CineSliceLayer()).Ok()) {
+	  qDebug() << "Cine render parameters could not be changed!" << "\n";
+	}
+	return;
+  }
   Update2DSlice();
-  if (m_render3dClicked) {
+  // Projections do not depend on the threshold
+  if (m_render3dClicked && m_renderMode == RenderMode3D::SURFACE) {
 #ifdef THRHLD_UPDATE_BOTH
 	Update3DRender();
 #endif
@@ -310,16 +612,21 @@ void Widget::mousePressEvent(QMouseEvent *event) {
 
   if (m_render3dClicked) {
 	if (ui->label_image3D->rect().contains(local_pos_3Dimg)) {
-	  if (event->button() == Qt::LeftButton) {
-		int depth_at_cursor = m_ctimage.GetDepthBuffer()[local_pos_3Dimg.x() + local_pos_3Dimg.y() * m_qImage.width()];
+	  // The label keeps its size when a smaller series is loaded, so the cursor may be outside of the volume
+	  StridedView<const int> const depth_buffer = m_ctimage.GetDepthBuffer();
+	  if (event->button() == Qt::LeftButton && depth_buffer.Contains(local_pos_3Dimg.x(), local_pos_3Dimg.y())) {
+		int depth_at_cursor = depth_buffer(local_pos_3Dimg.x(), local_pos_3Dimg.y());
 		ui->label_currentSeed->setText(
 		  "Current Seed [px]:   X: " + QString::number(local_pos_3Dimg.x()) + "   " + "Y: "
 			+ QString::number(local_pos_3Dimg.y())
 			+ "   "
 			+ "Depth: " + QString::number(depth_at_cursor));
 
-		// Pick seed for region growing
-		m_currentSeed = Eigen::Vector3i(local_pos_3Dimg.x(), local_pos_3Dimg.y(), depth_at_cursor);
+		// Pick seed for region growing: the ID buffer yields the voxel under the cursor for any rotation
+		if (!m_ctimage.PickVoxel(local_pos_3Dimg.x(), local_pos_3Dimg.y(), m_pickedVoxel).Ok()) {
+		  m_pickedVoxel = Eigen::Vector3i(local_pos_3Dimg.x(), local_pos_3Dimg.y(), depth_at_cursor);
+		}
+		m_currentSeed = m_pickedVoxel;
 		m_seedPicked = true;
 
 		// Pick points for calibration and start calibration procedure
@@ -352,30 +659,42 @@ void Widget::mouseMoveEvent(QMouseEvent *event) {
   QPoint local_pos_2Dslice = ui->label_imgArea->mapFromParent(global_pos);
 
   if (m_render3dClicked) {
+	Eigen::Vector3d const spacing = m_ctimage.GetVoxelSpacing();
 	int cursor_x_px_3Dimg = local_pos_3Dimg.x();
-	double cursor_x_mm_3Dimg = cursor_x_px_3Dimg * 0.523; // Pixel x position * Voxel length in x
+	double cursor_x_mm_3Dimg = cursor_x_px_3Dimg * spacing.x(); // Pixel x position * Voxel length in x
 	int cursor_y_px_3Dimg = local_pos_3Dimg.y();
-	double cursor_y_mm_3Dimg = cursor_y_px_3Dimg * 0.523; // Pixel y position * Voxel length in y
+	double cursor_y_mm_3Dimg = cursor_y_px_3Dimg * spacing.y(); // Pixel y position * Voxel length in y
 
 	if (ui->label_image3D->rect().contains(local_pos_3Dimg)) {
-	  int depth_at_cursor = m_ctimage.GetDepthBuffer()[local_pos_3Dimg.x() + local_pos_3Dimg.y() * m_qImage.width()];
-	  // auto depth_at_cursor = 0;
-	  m_currentDepthAtCursor = depth_at_cursor;
-	  auto depth_mm = depth_at_cursor * 0.7; // Depth value * Voxel height
-	  m_currentMousePos3DImage = local_pos_3Dimg;
-	  ui->label_xPos->setText("X [px]: " + QString::number(cursor_x_px_3Dimg));
-	  ui->label_xPos_mm->setText("X [mm]: " + QString::number(cursor_x_mm_3Dimg));
-	  ui->label_yPos->setText("Y [px]: " + QString::number(cursor_y_px_3Dimg));
-	  ui->label_yPos_mm->setText("Y [mm]: " + QString::number(cursor_y_mm_3Dimg));
+	  // The label keeps its size when a smaller series is loaded, so the cursor may be outside of the volume
+	  StridedView<const int> const depth_buffer = m_ctimage.GetDepthBuffer();
+	  if (depth_buffer.Contains(local_pos_3Dimg.x(), local_pos_3Dimg.y())) {
+		int depth_at_cursor = depth_buffer(local_pos_3Dimg.x(), local_pos_3Dimg.y());
+		m_currentDepthAtCursor = depth_at_cursor;
+		auto depth_mm = depth_at_cursor * spacing.z(); // Depth value * Voxel height
+		m_currentMousePos3DImage = local_pos_3Dimg;
+		ui->label_xPos->setText("X [px]: " + QString::number(cursor_x_px_3Dimg));
+		ui->label_xPos_mm->setText("X [mm]: " + QString::number(cursor_x_mm_3Dimg));
+		ui->label_yPos->setText("Y [px]: " + QString::number(cursor_y_px_3Dimg));
+		ui->label_yPos_mm->setText("Y [mm]: " + QString::number(cursor_y_mm_3Dimg));
+		if (m_depthBufferIsRendered) {
+		  ui->label_depthPos->setText("Depth [px]: " + QString::number(depth_at_cursor));
+		  ui->label_depthPos_mm->setText("Depth [mm]: " + QString::number(depth_mm));
+		}
+	  }
 
 	  if (m_depthBufferIsRendered) {
-		ui->label_depthPos->setText("Depth [px]: " + QString::number(depth_at_cursor));
-		ui->label_depthPos_mm->setText("Depth [mm]: " + QString::number(depth_mm));
-
 		if (event->buttons() == Qt::RightButton) {
 		  QPoint position_delta = m_currentMousePos - global_pos;
 		  UpdateRotationMatrix(position_delta);
-		  RenderRegionGrowing();
+		  if (m_renderMode == RenderMode3D::SURFACE) {
+			RenderRegionGrowing(true);
+		  } else {
+			Update3DRender();
+		  }
+		  if (m_sliceOrientation == SliceOrientation::OBLIQUE) {
+			Update2DSlice();
+		  }
 		  m_currentMousePos = global_pos;
 		}
 	  }
@@ -384,7 +703,7 @@ void Widget::mouseMoveEvent(QMouseEvent *event) {
 	if (ui->label_imgArea->rect().contains(local_pos_2Dslice)) {
 	  ShowLabelNextToCursor(global_pos, local_pos_2Dslice);
 
-	  if (event->buttons() == Qt::LeftButton) {
+	  if (event->buttons() == Qt::LeftButton && m_sliceOrientation == SliceOrientation::AXIAL) {
 		if (m_selectTargetArea) {
 		  Update2DSlice();
 		  DrawCircleAtCursor(local_pos_2Dslice, Qt::GlobalColor::white);
@@ -411,6 +730,12 @@ void Widget::mouseReleaseEvent(QMouseEvent *event) {
 	}
   }
 
+  // The frame reused while dragging is replaced by a full render once the rotation stops
+  if (event->button() == Qt::RightButton && m_depthBufferIsRendered && m_renderMode == RenderMode3D::SURFACE
+	  && !m_renderRegionMesh) {
+	RenderRegionGrowing();
+  }
+
   if (ui->label_imgArea->rect().contains(local_pos_2Dslice)) {
 	if (m_selectTargetArea) {
 	  m_targetAreaHasBeenDrawn = true;
@@ -436,11 +761,35 @@ void Widget::StartRegionGrowingFromSeed() {
 	return;
   }
 
+  // The combo box lists the connectivities in the order of their neighbour counts
+  Connectivity const connectivities[] = {Connectivity::FACES, Connectivity::EDGES, Connectivity::CORNERS};
+  m_ctimage.SetRegionConnectivity(connectivities[ui->comboBox_connectivity->currentIndex()]);
   m_ctimage.RegionGrowing3D(m_currentSeed, ui->horizontalSlider_threshold->value());
+  // Index 0 of the combo box keeps the raw result, the others follow MorphologyOperation from OPEN on
+  int const cleanup = ui->comboBox_regionCleanup->currentIndex();
+  if (cleanup > 0) {
+	auto const operation = static_cast<MorphologyOperation>(static_cast<int>(MorphologyOperation::OPEN) + cleanup - 1);
+	if (!m_ctimage.ApplyRegionMorphology(operation, kRegionCleanupRadius).Ok()) {
+	  QMessageBox::warning(this, "Error!", "Failed to clean up the region growing result!");
+	}
+  }
   RenderRegionGrowing();
   m_regionGrowingIsRendered = true;
 }
 
+void Widget::UndoRegionGrowing() {
+  // Going back only rewrites the changed bricks of the region; the render recomputes the surface from them
+  if (m_regionGrowingIsRendered && m_ctimage.UndoRegion().Ok()) {
+	RenderRegionGrowing();
+  }
+}
+
+void Widget::RedoRegionGrowing() {
+  if (m_regionGrowingIsRendered && m_ctimage.RedoRegion().Ok()) {
+	RenderRegionGrowing();
+  }
+}
+
 void Widget::SelectTargetArea() {
   m_selectSafeArea = false;
   m_selectTargetArea = true;
@@ -505,7 +854,40 @@ void Widget::WriteAreasToFile() {
 		<< "	" << "Z [px]: " << m_transformedSafeArea.z() << "\n" << "	" << "Radius [px]: " << m_safeArea.w()
 		<< "\n\n";
 
+	// Margins of the target sphere in mm, negative if it overlaps the structure or the safe zone
+	Eigen::Vector3d const spacing = m_ctimage.GetVoxelSpacing();
+	Eigen::Vector3d const target_center = m_targetArea.head<3>().cast<double>();
+	double const target_radius_mm = m_targetArea.w() * spacing.x();
+	double const safe_radius_mm = m_safeArea.w() * spacing.x();
+	double const safe_margin = (target_center - m_safeArea.head<3>().cast<double>()).cwiseProduct(spacing).norm()
+		- target_radius_mm - safe_radius_mm;
+	out << "Abstaende:" << "\n" << "	" << "Zielbereich - Schonbereich [mm]: " << safe_margin << "\n";
+	if (m_regionGrowingIsRendered && (!m_ctimage.GetRegionDistanceField().Empty()
+		|| m_ctimage.ComputeRegionDistanceField().Ok())) {
+	  double const region_margin = m_ctimage.GetRegionDistanceField().DistanceAt(target_center) - target_radius_mm;
+	  out << "	" << "Zielbereich - Segmentierung [mm]: " << region_margin << "\n";
+	}
+	out << "\n";
+
+	if (!m_trajectories.empty()) {
+	  Trajectory const &best = m_trajectories.front();
+	  out << "Bester Zugang:" << "\n" << "	" << "X [px]: " << best.entry.x() << "\n" << "	" << "Y [px]: "
+		  << best.entry.y() << "\n" << "	" << "Z [px]: " << best.entry.z() << "\n" << "	" << "Laenge [mm]: "
+		  << best.length << "\n" << "	" << "Knochendurchgaenge: " << best.bone_crossings << "\n\n";
+	}
+
 	file.close();
+
+	// Binary exports for the navigation system, next to the planning file
+	if (m_regionGrowingIsRendered) {
+	  QFileInfo const plan_info(file_name);
+	  QString const base_name = plan_info.absolutePath() + "/" + plan_info.completeBaseName();
+	  if (!m_ctimage.ExportSurfacePoints(base_name + "_surface.ply").Ok()
+		|| !m_ctimage.ExportRegionMask(base_name + "_region.rle").Ok()
+		|| !m_ctimage.ExportRegionMesh(base_name + "_mesh.ply").Ok()) {
+		QMessageBox::warning(this, "Error!", "Failed to export the region growing result!");
+	  }
+	}
   }
 }
 
@@ -523,5 +905,56 @@ void Widget::StartTransformationMatrixCalibration() {
 						   "Welcome to the calibration procedure.\nPlease pick 6 calibration points from the 3D model!");
 }
 
+void Widget::LoadCineSeries() {
+  QStringList phase_files = QFileDialog::getOpenFileNames(
+	this, "Open 4D Image Phases", "../external/images", "Raw Image Files (*.raw)");
+  if (phase_files.isEmpty()) {
+	return;
+  }
+  // The phases are played in the order of their file names
+  phase_files.sort();
+  std::vector<QString> const phase_paths(phase_files.begin(), phase_files.end());
+  if (!m_cine.Open(phase_paths, ui->horizontalSlider_threshold->value(), CineSliceLayer()).Ok()) {
+	QMessageBox::critical(this, "Error", "The 4D series could not be opened!");
+	return;
+  }
+  m_cinePhase = -1;
+  if (!m_cineIsPlaying) {
+	ToggleCinePlayback();
+  }
+}
+
+void Widget::ToggleCinePlayback() {
+  if (m_cineIsPlaying) {
+	m_cineTimer.stop();
+	m_cineIsPlaying = false;
+	ui->pushButton_playCine->setText("Play 4D");
+	return;
+  }
+  if (m_cine.PhaseCount() == 0
+	|| !m_cine.SetRenderParameters(ui->horizontalSlider_threshold->value(), CineSliceLayer()).Ok()) {
+	return;
+  }
+  m_cineIsPlaying = true;
+  ui->pushButton_playCine->setText("Pause 4D");
+  m_cineTimer.start();
+}
+
+void Widget::ShowNextCinePhase() {
+  if (m_cine.PhaseCount() == 0) {
+	return;
+  }
+  // A phase that is not prefetched yet does not stall the timer: the current phase stays on screen for another tick
+  int const next_phase = (m_cinePhase + 1) % m_cine.PhaseCount();
+  std::shared_ptr<const CineFrame> frame;
+  Status const status = m_cine.TryGetFrame(next_phase, frame);
+  if (status.Ok()) {
+	m_cinePhase = next_phase;
+	ShowCineFrame(*frame);
+  } else if (status.code() != StatusCode::BUFFER_EMPTY) {
+	qDebug() << "Phase" << next_phase << "could not be loaded!" << "\n";
+	m_cinePhase = next_phase;
+  }
+}
 
 
@@ -1,7 +1,9 @@
 #ifndef WIDGET_H
 #define WIDGET_H
 
+#include "cine_series.h"
 #include "ct_dataset.h"
+#include "slice_cache.h"
 
 #include <ui_widget.h>
 #include <QFile>
@@ -9,6 +11,8 @@
 #include <QMessageBox>
 #include <QWidget>
 #include <QMouseEvent>
+#include <QShortcut>
+#include <QTimer>
 #include <QPainter>
 #include <QDebug>
 #include <QDataStream>
@@ -22,6 +26,22 @@ class Widget;
 }
 QT_END_NAMESPACE
 
+/**
+ * @brief Rendering mode of the 3D view
+ */
+enum class RenderMode3D {
+  /// Shaded first-hit surface of the threshold or the region growing result
+  SURFACE,
+  /// Maximum intensity projection
+  MAXIMUM_PROJECTION,
+  /// Minimum intensity projection
+  MINIMUM_PROJECTION,
+  /// Average intensity projection
+  AVERAGE_PROJECTION,
+  /// Direct volume rendering through a colour transfer function
+  VOLUME_RENDERING
+};
+
 class Widget : public QWidget {
  Q_OBJECT
 
@@ -33,33 +53,71 @@ class Widget : public QWidget {
   void Update2DSlice();
   void Update3DRender();
   void UpdateRotationMatrix(QPoint const &position_delta);
-  void RenderRegionGrowing();
+  void RenderRegionGrowing(bool reuse_frame = false);
+  void UpdateProjection();
+  void ShowProjection();
+  void ShowVolumeRendering();
   void ShowLabelNextToCursor(QPoint const &cursor_global_pos, QPoint const &cursor_local_pos);
   void DrawCircleAtCursor(QPoint const &cursor_local_pos, Qt::GlobalColor const &color);
+  void UpdateTrajectories();
+  void DrawTrajectories(QPainter &painter);
   void PickCalibrationPoints();
   void CalculateTransformationMatrix();
   void TransformSelectedAreas();
+  void ShowCineFrame(CineFrame const &frame);
+  [[nodiscard]] int CineSliceLayer() const;
 
  private:
+  /// Radius (in voxels) of the ball used to open or close the region growing result
+  static constexpr int kRegionCleanupRadius = 1;
+
+  /// Standard deviation (in voxels) of the Gaussian prefilter
+  static constexpr double kPrefilterSigma = 1.0;
+
+  /// Display time of one phase during 4D playback (in ms)
+  static constexpr int kCineFrameInterval = 200;
+
   Ui::Widget *ui;
   CTDataset m_ctimage;
+  SliceCache m_sliceCache;
+  CineSeries m_cine;
+  QTimer m_cineTimer;
+  int m_cinePhase{0};
   QImage m_qImage;
   QImage m_qImage_2d;
+  QImage m_qImageCine;
   Eigen::Matrix3d m_rotationMat;
   QLabel *m_labelAtCursor;
 
+  SliceOrientation m_sliceOrientation{SliceOrientation::AXIAL};
+  SlicePlane m_slicePlane;
+  std::shared_ptr<const WindowedSlice> m_cachedSlice;
+  std::vector<int16_t> m_slice;
+  std::vector<uint8_t> m_windowedSlice;
+  std::vector<uint8_t> m_windowingLUT;
+
+  RenderMode3D m_renderMode{RenderMode3D::SURFACE};
+  bool m_renderRegionMesh{false};
+  std::vector<int16_t> m_projection;
+  std::vector<uint8_t> m_windowedProjection;
+  std::vector<TransferFunctionEntry> m_transferFunctionLUT;
+  std::vector<uint32_t> m_volumeImage;
+
   QPoint m_currentMousePos;
   QPoint m_currentMouseGlobalPos;
   QPoint m_currentMousePos2Dslice;
   QPoint m_currentMousePos3DImage;
   int m_currentDepthAtCursor{0};
   Eigen::Vector3i m_currentSeed;
+  Eigen::Vector3i m_pickedVoxel;
   bool m_seedPicked{false};
 
   Eigen::Vector4i m_targetArea;
   Eigen::Vector4i m_safeArea;
   Eigen::Vector3d m_transformedTargetArea;
   Eigen::Vector3d m_transformedSafeArea;
+  TrajectoryParameters m_trajectoryParameters;
+  std::vector<Trajectory> m_trajectories;
 
   std::vector<Eigen::Vector3d> m_calibPoints;
   Eigen::Isometry3d m_transformationMatrix;
@@ -73,22 +131,33 @@ class Widget : public QWidget {
   bool m_safeAreaHasBeenDrawn{false};
   bool m_calibrationStarted{false};
   bool m_calibrationOccured{false};
+  bool m_cineIsPlaying{false};
 
  private slots:
   void LoadImage3D();
+  void ImportDicomSeries();
   void UpdateWindowingCenter(int const val);
   void UpdateWindowingWindowSize(int const val);
   void UpdateDepthValue(int const val);
+  void UpdateSliceOrientation(int const index);
+  void UpdateRenderMode(int const index);
+  void UpdatePrefilter(int const index);
+  void UpdateRegionRenderer(int const index);
   void UpdateThresholdValue(int const val);
   void Render3D();
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
   void StartRegionGrowingFromSeed();
+  void UndoRegionGrowing();
+  void RedoRegionGrowing();
   void SelectTargetArea();
   void SelectSafeArea();
   void WriteAreasToFile();
   void StartTransformationMatrixCalibration();
+  void LoadCineSeries();
+  void ToggleCinePlayback();
+  void ShowNextCinePhase();
 };
 
 #endif //WIDGET_H